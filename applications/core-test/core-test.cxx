@@ -29,6 +29,9 @@
 #include "dabc/Factory.h"
 #include "dabc/Application.h"
 #include "dabc/Pointer.h"
+#include "dabc/Command.h"
+#include "dabc/Checksum.h"
+#include "dabc/HierarchyStore.h"
 
 
 #define BUFFERSIZE 1024
@@ -952,6 +955,291 @@ extern "C" void RunTimeTest()
 
 
 
+extern "C" void RunRecordTest()
+{
+   // micro-benchmark of commands fields, used by every command and hierarchy node
+
+   const int nrepeat = 200000;
+
+   const char *names[] = { "Name", "Kind", "_kind", "value", "_hidden", "ParName", "debug", "Timeout",
+                           "MasterNode", "NumOutputs", "address", "_history", "time", "size", "Status", "id" };
+   const int nnames = sizeof(names) / sizeof(names[0]);
+
+   dabc::TimeStamp tm = dabc::Now();
+
+   for (int n = 0; n < nrepeat; n++) {
+      dabc::Command cmd("TestCmd");
+      cmd.SetStr("Name", "Generic");
+      cmd.SetInt("NumOutputs", n);
+      cmd.SetDouble("Timeout", 1.5);
+      cmd.SetBool("debug", true);
+      cmd.SetStr("address", "dabc://host:1234/Module");
+   }
+
+   double spent = tm.SpentTillNow(true);
+
+   DOUT0("Command create with 5 fields: %5.3f microsec", spent/nrepeat*1e6);
+
+   dabc::Command cmd("TestCmd");
+   for (int k = 0; k < nnames; k++)
+      cmd.SetInt(names[k], k);
+
+   long sum = 0;
+
+   tm.GetNow();
+
+   for (int n = 0; n < nrepeat; n++)
+      for (int k = 0; k < nnames; k++)
+         sum += cmd.GetInt(names[k]);
+
+   spent = tm.SpentTillNow(true);
+
+   DOUT0("Field access in %d fields: %5.3f microsec sum %ld", nnames, spent/nrepeat/nnames*1e6, sum);
+
+   for (int n = 0; n < nrepeat; n++)
+      for (int k = 0; k < nnames; k++)
+         cmd.SetInt(names[k], n);
+
+   spent = tm.SpentTillNow(true);
+
+   DOUT0("Field set in %d fields: %5.3f microsec", nnames, spent/nrepeat/nnames*1e6);
+
+   for (int n = 0; n < nrepeat/10; n++) {
+      dabc::Buffer buf = cmd.SaveToBuffer();
+      dabc::Command cmd2;
+      cmd2.ReadFromBuffer(buf);
+      if (cmd2.NumFields() != cmd.NumFields()) EOUT("Fields number mismatch %u %u", cmd2.NumFields(), cmd.NumFields());
+   }
+
+   spent = tm.SpentTillNow(true);
+
+   DOUT0("SaveToBuffer/ReadFromBuffer round trip: %5.3f microsec", spent/(nrepeat/10)*1e6);
+
+   for (int n = 0; n < nrepeat/10; n++)
+      for (unsigned k = 0; k < cmd.NumFields(); k++)
+         sum += cmd.FieldName(k).length();
+
+   spent = tm.SpentTillNow(true);
+
+   DOUT0("Fields iteration with FieldName(): %5.3f microsec per field", spent/(nrepeat/10)/cmd.NumFields()*1e6);
+}
+
+extern "C" void RunCompactTest()
+{
+   // fields written with compact protocol of command channel and read back
+   dabc::Command cmd("CompactTest");
+   cmd.SetInt("IntField", -12345);
+   cmd.SetDouble("DoubleField", 3.5);
+   cmd.SetStr("StrField", "compact value");
+   cmd.SetField("ArrField", std::vector<int64_t>({1, 2, 3}));
+
+   dabc::sizestream sz;
+   cmd.GetObject()->Fields().StreamCompact(sz);
+
+   std::vector<char> mem(sz.size());
+   dabc::memstream out(false, mem.data(), mem.size());
+   dabc::memstream inp(true, mem.data(), mem.size());
+
+   dabc::Command cmd2("CompactTest");
+   if (!cmd.GetObject()->Fields().StreamCompact(out) || !cmd2.GetObject()->Fields().StreamCompact(inp))
+      EOUT("Fail to stream command in compact form");
+   else if ((cmd2.GetInt("IntField") != -12345) || (cmd2.GetDouble("DoubleField") != 3.5) ||
+            (cmd2.GetStr("StrField") != "compact value") || (cmd2.GetField("ArrField").AsIntVect().size() != 3))
+      EOUT("Command fields differ after compact streaming");
+   else
+      DOUT0("Compact streaming of %u fields in %lu bytes OK", cmd2.NumFields(), (long unsigned) mem.size());
+
+   // compact string with length far beyond end of stream should be rejected
+   char data[16] = { 9, (char) 0xff, (char) 0xff, (char) 0xff, (char) 0xff, 0x0f, 'a', 'b', 'c' };
+   dabc::memstream bad(true, data, 9);
+   dabc::RecordField fld;
+   if (fld.StreamCompact(bad))
+      EOUT("Compact string with wrong length accepted");
+   else
+      DOUT0("Compact string with wrong length rejected");
+}
+
+
+static void *LoggerTestFunc(void *arg)
+{
+   long id = (long) arg;
+
+   for (int n = 0; n < 20000; n++)
+      DOUT1("Logger test thread %ld message %d", id, n);
+
+   return nullptr;
+}
+
+extern "C" void RunLoggerTest()
+{
+   // many threads write messages, compare with and without <asynclog value="true"/>
+   // loglimit should be large, otherwise most messages dropped
+
+   const int nthrds = 8;
+
+   dabc::PosixThread thrds[nthrds];
+
+   dabc::TimeStamp tm = dabc::Now();
+
+   for (long n = 0; n < nthrds; n++)
+      thrds[n].Start(LoggerTestFunc, (void *) n);
+
+   for (int n = 0; n < nthrds; n++)
+      thrds[n].Join();
+
+   double spent = tm.SpentTillNow(true);
+
+   dabc::Logger::Flush();
+
+   double flush = tm.SpentTillNow(true);
+
+   DOUT0("Logger %s mode: %d threads %5.3f microsec per message, flush %5.3f sec",
+         dabc::lgr()->IsAsync() ? "async" : "sync", nthrds, spent/20000*1e6, flush);
+}
+
+extern "C" void RunChecksumTest()
+{
+   // write file with checksums, read it back, then corrupt one block and check that reading fails
+
+   const char *fname = "core-test-crc.bin";
+   const unsigned blocksize = 0x100000, total = 64 * blocksize + 12345;
+
+   std::vector<char> data(total), res(total);
+   for (unsigned n = 0; n < total; n++)
+      data[n] = (char) (n * 7 + n / 1000);
+
+   dabc::ChecksumFileInterface io(nullptr, true, blocksize);
+
+   dabc::TimeStamp tm = dabc::Now();
+
+   auto f = io.fopen(fname, "w");
+   for (unsigned pos = 0; f && (pos < total); pos += 10000)
+      if (io.fwrite(data.data() + pos, std::min(10000U, total - pos), 1, f) != 1) {
+         EOUT("Fail to write file %s", fname);
+         break;
+      }
+   double spent = tm.SpentTillNow();
+   io.fclose(f);
+   double spent_all = tm.SpentTillNow();
+
+   DOUT0("Write with CRC32C (%s): %5.1f MB/s in output thread, %5.1f MB/s including close",
+         dabc::crc32c_hw() ? "hardware" : "table", total / spent * 1e-6, total / spent_all * 1e-6);
+
+   f = io.fopen(fname, "r");
+   bool ok = f && (io.fread(res.data(), total, 1, f) == 1) && (memcmp(data.data(), res.data(), total) == 0) && (io.GetFileIntPar(f, "CrcFailure") == 0);
+   io.fclose(f);
+   if (ok)
+      DOUT0("Checksum round trip OK");
+   else
+      EOUT("Checksum round trip FAILED");
+
+   // corrupt single byte in third block
+   FILE *plain = fopen(fname, "r+");
+   if (plain && (fseek(plain, 2 * blocksize + 100, SEEK_SET) == 0)) {
+      char c = data[2 * blocksize + 100] ^ 0x10;
+      fwrite(&c, 1, 1, plain);
+   }
+   if (plain) fclose(plain);
+
+   f = io.fopen(fname, "r");
+   size_t nread = 0;
+   while (f && (io.fread(res.data(), 0x10000, 1, f) == 1))
+      nread += 0x10000;
+   bool detected = f && (io.GetFileIntPar(f, "CrcFailure") == 1) && (nread < 3 * blocksize);
+   io.fclose(f);
+   if (detected)
+      DOUT0("Corrupted block detected after %u bytes", (unsigned) nread);
+   else
+      EOUT("Corrupted block NOT detected");
+
+   unlink(fname);
+   unlink(dabc::ChecksumFileInterface::ChecksumFileName(fname).c_str());
+}
+
+extern "C" void RunSerieTest()
+{
+   // store values of numeric item with small chunks, read them back from time index
+
+   const char *dirname = "core-test-serie";
+   const unsigned num = 40;
+   const uint64_t step = 2000, start = dabc::DateTime().GetNow().AsJSDate() - 3600000;
+
+   {
+      dabc::HierarchyStore store;
+      store.SetBasePath(dirname);
+      store.SetChunkSize(16);
+
+      dabc::Hierarchy h;
+      h.Create("Test");
+      dabc::Hierarchy item = h.CreateHChild("Rate");
+
+      for (unsigned n = 0; n < num; n++) {
+         item.SetField("value", n * 1.5);
+         h.MarkChangedItems();
+
+         dabc::DateTime now(start + n * step);
+         if (store.CheckForNextStore(now, 1., 1e6)) {
+            store.ExtractData(h);
+            store.WriteExtractedData();
+         }
+      }
+      // incomplete chunk written when store is deleted
+   }
+
+   dabc::HierarchyReading rr;
+   rr.SetBasePath(dirname);
+
+   bool ok = true;
+
+   dabc::Hierarchy res = rr.GetSerieValues("Rate", dabc::DateTime(start), dabc::DateTime(start + num * step));
+   std::vector<uint64_t> tm = res.null() ? std::vector<uint64_t>() : res.Field("time").AsUIntVect();
+   std::vector<double> val = res.null() ? std::vector<double>() : res.Field("value").AsDoubleVect();
+   if ((tm.size() != num) || (val.size() != num)) ok = false;
+   for (unsigned n = 0; ok && (n < num); n++)
+      if ((tm[n] != start + n * step) || (val[n] != n * 1.5)) ok = false;
+
+   // interval inside single chunk
+   res = rr.GetSerieValues("Rate", dabc::DateTime(start + 20 * step), dabc::DateTime(start + 29 * step));
+   if (res.null() || (res.Field("value").AsDoubleVect().size() != 10)) ok = false;
+
+   // two bins, first bin taken from chunk summary
+   res = rr.GetSerieValues("Rate", dabc::DateTime(start), dabc::DateTime(start + (num - 1) * step), 2);
+   val = res.null() ? std::vector<double>() : res.Field("value").AsDoubleVect();
+   std::vector<double> vmin = res.null() ? std::vector<double>() : res.Field("min").AsDoubleVect(),
+                       vmax = res.null() ? std::vector<double>() : res.Field("max").AsDoubleVect();
+   if ((val.size() != 2) || (vmin.size() != 2) || (vmax.size() != 2) ||
+       (val[0] != 9.5 * 1.5) || (val[1] != 29.5 * 1.5) ||
+       (vmin[0] != 0.) || (vmax[0] != 19 * 1.5) || (vmin[1] != 20 * 1.5) || (vmax[1] != 39 * 1.5)) ok = false;
+
+   // chunk with wrong number of samples rejected, samples of previous chunks still delivered
+   dabc::FileInterface io;
+   std::string sername = dabc::format("%s/%s/series/Rate.ser", dirname, dabc::DateTime(start + (num - 1) * step).OnlyDateAsString().c_str());
+   auto f = io.fopen(sername.c_str(), "a");
+   if (f) {
+      dabc::SerieChunkHeader hdr;
+      hdr.magic = dabc::SerieChunkHeader::SerieMagic;
+      hdr.num = 0xffffffff;
+      hdr.tmin = hdr.tmax = start + (num - 1) * step;
+      if (io.fwrite(&hdr, sizeof(hdr), 1, f) != 1) ok = false;
+      io.fclose(f);
+
+      dabc::HierarchyReading rr2;
+      rr2.SetBasePath(dirname);
+      res = rr2.GetSerieValues("Rate", dabc::DateTime(start), dabc::DateTime(start + num * step));
+      if (res.null() || (res.Field("value").AsDoubleVect().size() != num)) ok = false;
+   } else {
+      ok = false;
+   }
+
+   if (ok)
+      DOUT0("Serie read back OK");
+   else
+      EOUT("Serie read back FAILED");
+
+   if (system(dabc::format("rm -rf %s", dirname).c_str()) != 0)
+      EOUT("Fail to remove directory %s", dirname);
+}
+
 extern "C" void RunHeavyTest()
 {
    for (int n=10;n<200;n+=10)
@@ -0,0 +1,109 @@
+#include "hadaq/HldFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Writes plain and compressed HLD files and reads them back,
+// comparing every event with the original data
+
+const unsigned NumEvents = 5000;
+
+/** Produce event with repeating payload, every 1000th event is larger than compression frame */
+static void MakeEvent(std::vector<char> &data, uint32_t seqnr)
+{
+   uint32_t paysize = (seqnr % 1000 == 999) ? 200000 : 8 * (seqnr % 250);
+
+   size_t pos = data.size();
+   data.resize(pos + sizeof(hadaq::RawEvent) + paysize);
+
+   hadaq::RawEvent *evnt = (hadaq::RawEvent *) (data.data() + pos);
+   evnt->Init(seqnr, 1);
+   evnt->SetSize(sizeof(hadaq::RawEvent) + paysize);
+
+   uint32_t *payload = (uint32_t *) (evnt + 1);
+   for (uint32_t n = 0; n < paysize / 4; n++)
+      payload[n] = (n % 16 == 0) ? seqnr * 7 + n : n % 16;
+}
+
+static bool TestFile(const char *fname, int level)
+{
+   std::vector<char> all;
+
+   hadaq::HldFile out;
+   out.SetCompression(level, 2, 0x10000);
+   if (!out.OpenWrite(fname, 1)) return false;
+
+   // events written in portions of several events
+   std::vector<char> portion;
+   for (uint32_t seqnr = 0; seqnr < NumEvents; seqnr++) {
+      MakeEvent(portion, seqnr);
+      if ((seqnr % 7 == 6) || (seqnr == NumEvents - 1)) {
+         if (!out.WriteBuffer(portion.data(), portion.size())) {
+            printf("Fail to write event %u\n", (unsigned) seqnr);
+            return false;
+         }
+         all.insert(all.end(), portion.begin(), portion.end());
+         portion.clear();
+      }
+   }
+   out.Close();
+
+   hadaq::HldFile inp;
+   if (!inp.OpenRead(fname)) return false;
+
+   if (inp.isCompressed() != (level > 0)) {
+      printf("File %s compressed flag %s, expected %s\n", fname, inp.isCompressed() ? "true" : "false", level > 0 ? "true" : "false");
+      return false;
+   }
+
+   std::vector<char> buf(0x100000);
+   size_t pos = 0;
+   unsigned cnt = 0;
+
+   while (true) {
+      uint32_t sz = buf.size();
+      if (!inp.ReadBuffer(buf.data(), &sz, true)) break;
+      hadaq::RawEvent *evnt = (hadaq::RawEvent *) buf.data();
+      if (evnt->GetId() == hadaq::EvtId_runStart) continue;
+
+      if ((pos + sz > all.size()) || (memcmp(buf.data(), all.data() + pos, sz) != 0)) {
+         printf("File %s event %u differs from original\n", fname, cnt);
+         return false;
+      }
+      pos += sz;
+      cnt++;
+   }
+   inp.Close();
+
+   if ((cnt != NumEvents) || (pos != all.size())) {
+      printf("File %s read %u events, expected %u\n", fname, cnt, NumEvents);
+      return false;
+   }
+
+   // check skipping of events
+   if (!inp.OpenRead(fname) || !inp.SeekEvent(NumEvents / 2)) return false;
+   uint32_t sz = buf.size();
+   bool seekok = inp.ReadBuffer(buf.data(), &sz, true) && (((hadaq::RawEvent *) buf.data())->GetSeqNr() == NumEvents / 2);
+   inp.Close();
+   if (!seekok) {
+      printf("File %s fail to seek event %u\n", fname, NumEvents / 2);
+      return false;
+   }
+
+   printf("File %s level %d: %u events, %lu bytes read back OK\n", fname, level, cnt, (long unsigned) pos);
+
+   remove(fname);
+
+   return true;
+}
+
+int main()
+{
+   bool ok = TestFile("hld-test-plain.hld", 0) &&
+             TestFile("hld-test-comp.hld", 5);
+
+   printf("HLD round trip %s\n", ok ? "OK" : "FAILED");
+
+   return ok ? 0 : 1;
+}
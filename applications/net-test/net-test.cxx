@@ -25,11 +25,25 @@
 #include "dabc/Url.h"
 #include "dabc/Configuration.h"
 
+#include <sys/resource.h>
+
+/** Returns user and system CPU time, used by the process */
+static void GetProcessCpu(double &user, double &sys)
+{
+   struct rusage usage;
+   getrusage(RUSAGE_SELF, &usage);
+   user = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec*1e-6;
+   sys = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec*1e-6;
+}
+
 class NetTestSenderModule : public dabc::ModuleAsync {
    protected:
       std::string         fKind;
       unsigned            fSendCnt;
       unsigned            fIgnoreNode;
+      uint64_t            fSendBytes{0};
+      dabc::TimeStamp     fStartTm;
+      double              fStartUser{0}, fStartSys{0};
 
    public:
       NetTestSenderModule(const std::string &name, dabc::Command cmd) :
@@ -75,6 +89,7 @@ class NetTestSenderModule : public dabc::ModuleAsync {
 
             dabc::Buffer buf = TakeBuffer();
             if (buf.null()) return false;
+            fSendBytes += buf.GetTotalSize();
             Send(nout, buf);
             return true;
          }
@@ -85,6 +100,7 @@ class NetTestSenderModule : public dabc::ModuleAsync {
 
             dabc::Buffer buf = TakeBuffer();
             if (buf.null()) return false;
+            fSendBytes += buf.GetTotalSize();
             Send(nout, buf);
 
             do {
@@ -103,6 +119,9 @@ class NetTestSenderModule : public dabc::ModuleAsync {
       {
          DOUT0("NetTestSenderModule starting");
 
+         fStartTm.GetNow();
+         GetProcessCpu(fStartUser, fStartSys);
+
          if (IsCmdTest()) {
             DOUT1("Start command test");
             SendNextCommand();
@@ -135,6 +154,19 @@ class NetTestSenderModule : public dabc::ModuleAsync {
       void AfterModuleStop() override
       {
          DOUT2("SenderModule finish");
+
+         if (fSendBytes == 0) return;
+
+         // CPU time of complete process, includes also receiving
+         double spent = fStartTm.SpentTillNow(), user = 0, sys = 0;
+         GetProcessCpu(user, sys);
+         user -= fStartUser;
+         sys -= fStartSys;
+         double gb = fSendBytes / 1024. / 1024. / 1024.;
+
+         DOUT0("Sender: %.1f MB in %.2f s, %.1f MB/s, CPU user %.2f s sys %.2f s, %.2f CPU s per GB",
+               fSendBytes / 1024. / 1024., spent, spent > 0 ? fSendBytes / 1024. / 1024. / spent : 0.,
+               user, sys, (user + sys) / gb);
       }
 };
 
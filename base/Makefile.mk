@@ -7,6 +7,7 @@ DABC_BASEDIRRUN  = $(DABC_BASEDIR)/run
 
 DABC_BASEEXE      = $(DABCBINPATH)/dabc_exe
 DABC_XMLEXE       = $(DABCBINPATH)/dabc_xml
+DABC_CRCEXE       = $(DABCBINPATH)/dabc_crc
 DABC_BASESH       = $(DABCBINPATH)/dabc_run
 
 BASE_H            = $(wildcard $(DABC_BASEDIRI)/*.$(HedSuf))
@@ -35,16 +36,20 @@ DABC_XMLEXES      = $(wildcard $(DABC_BASEDIRRUN)/dabc_xml.$(SrcSuf))
 DABC_XMLEXEO      = $(patsubst %.$(SrcSuf), $(BLD_DIR)/%.$(ObjSuf), $(DABC_XMLEXES))
 DABC_XMLEXED      = $(patsubst %.$(SrcSuf), $(BLD_DIR)/%.$(DepSuf), $(DABC_XMLEXES))
 
+DABC_CRCEXES      = $(wildcard $(DABC_BASEDIRRUN)/dabc_crc.$(SrcSuf))
+DABC_CRCEXEO      = $(patsubst %.$(SrcSuf), $(BLD_DIR)/%.$(ObjSuf), $(DABC_CRCEXES))
+DABC_CRCEXED      = $(patsubst %.$(SrcSuf), $(BLD_DIR)/%.$(DepSuf), $(DABC_CRCEXES))
+
 BASERUN_SH        = $(DABC_BASEDIRRUN)/dabc_run
 
 ######### used in main Makefile
 
 ALLHDRS          += $(DABCINCPATH)/dabc/defines.h $(patsubst $(DABC_BASEDIR)/%.h, $(DABCINCPATH)/%.h, $(BASE_H))
-ALLDEPENDENC     += $(BASE_D) $(BASERUN_D) $(DABC_XMLEXED)
+ALLDEPENDENC     += $(BASE_D) $(BASERUN_D) $(DABC_XMLEXED) $(DABC_CRCEXED)
 
 libs:: $(DABCBASE_LIB)
 
-exes:: $(DABC_BASEEXE) $(DABC_XMLEXE) $(DABC_BASESH)
+exes:: $(DABC_BASEEXE) $(DABC_XMLEXE) $(DABC_CRCEXE) $(DABC_BASESH)
 
 ##### local rules #####
 
@@ -77,7 +82,7 @@ $(DABCINCPATH)/%.h: $(DABC_BASEDIR)/%.h
 	@cp -f $< $@
 
 $(DABCBASE_LIB):   $(BASE_CORE_O) $(BASE_SOCKET_O)
-	@$(MakeLib) $(DABCBASE_LIBNAME) "$(BASE_CORE_O) $(BASE_SOCKET_O)" $(DABCDLLPATH) "$(LIBS_SYSSET)"
+	@$(MakeLib) $(DABCBASE_LIBNAME) "$(BASE_CORE_O) $(BASE_SOCKET_O)" $(DABCDLLPATH) "$(LIBS_SYSSET) $(BASE_EXTRALIBS)"
 
 #$(DABCSOCKET_LIB): $(BASE_SOCKET_O)
 #	@$(MakeLib) $(DABCSOCKET_LIBNAME) "$(BASE_SOCKET_O)" $(DABCDLLPATH) "-lpthread -ldl $(LIBRT)"
@@ -90,8 +95,19 @@ $(DABC_BASEEXE):  $(BASERUN_O) $(DABCBASE_LIB)
 $(DABC_XMLEXE) : $(DABC_XMLEXEO) $(DABC_BASESUB_O) 
 	$(LD) $(LDFLAGSPRE) -O $(DABC_XMLEXEO) $(DABC_BASESUB_O) -lpthread $(LIBRT) -o $(DABC_XMLEXE)
 
+$(DABC_CRCEXE):  $(DABC_CRCEXEO) $(DABCBASE_LIB)
+	$(LD) $(LDFLAGSPRE) -O $(DABC_CRCEXEO) $(LIBS_CORESET) -o $(DABC_CRCEXE)
+
 $(DABC_BASESH): $(BASERUN_SH)
 	@echo "Produce $@"
 	@cp -f $< $@
 
-$(BASE_D) $(BASERUN_D) $(DABC_XMLEXED) : $(DABCINCPATH)/dabc/defines.h
+$(BASE_D) $(BASERUN_D) $(DABC_XMLEXED) $(DABC_CRCEXED) : $(DABCINCPATH)/dabc/defines.h
+
+########### extra rules #############
+ifdef DABC_ZLIB
+BASE_EXTRALIBS = $(DABC_ZLIB_LIB)
+$(BLD_DIR)/$(DABC_BASEDIRS)/NetworkTransport.$(ObjSuf): INCLUDES += $(DABC_ZLIB_INC)
+else
+$(BLD_DIR)/$(DABC_BASEDIRS)/NetworkTransport.$(ObjSuf): DEFINITIONS += DABC_WITHOUT_ZLIB
+endif
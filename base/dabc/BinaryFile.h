@@ -57,6 +57,12 @@ namespace dabc {
          virtual bool fseek(Handle f, long int offset, bool relative = true)
          { return !f ? false : ::fseek((FILE*)f, offset, relative ? SEEK_CUR : SEEK_SET) == 0; }
 
+         /** Reserve disk space for file opened for writing, current position is not changed */
+         virtual bool fallocate(Handle f, uint64_t size);
+
+         /** Truncate file opened for writing at current position, removes preallocated tail */
+         virtual bool ftruncate(Handle f);
+
          /** Produce list of files, object must be explicitly destroyed with ref.Destroy call
           * One could decide if files or directories should be listed */
          virtual Object *fmatch(const char *fmask, bool select_files = true);
@@ -77,6 +83,8 @@ namespace dabc {
 
    };
 
+   class PrefetchFileInterface;
+
    // ==============================================================================
 
    /** \brief Base class for file writing/reading in DABC
@@ -120,6 +128,12 @@ namespace dabc {
             iowoner = _ioowner;
          }
 
+         /** Enable CRC32C checksums for written and read data, must be called before file is opened */
+         void EnableChecksum();
+
+         /** Enable reading ahead in background thread, must be called before file is opened */
+         PrefetchFileInterface *EnablePrefetch(unsigned depth = 4, unsigned blocksize = 0x100000);
+
          ~BasicFile()
          {
             CloseBasicFile();
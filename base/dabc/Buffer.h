@@ -309,6 +309,10 @@ namespace dabc {
       /** This static method create Buffer instance, which contains pointer on specified peace of memory
        * Therefore it can be used in standalone case */
       static Buffer CreateBuffer(const void* ptr, unsigned size, bool owner = false, bool makecopy = false) throw();
+
+      /** This static method create Buffer instance for external memory, managed by keeper object.
+       * Buffer holds reference on the keeper, memory can be reused when keeper is destroyed */
+      static Buffer CreateBuffer(const void* ptr, unsigned size, const Reference &keeper) throw();
    };
 
 };
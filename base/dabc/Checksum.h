@@ -0,0 +1,96 @@
+// $Id$
+
+/************************************************************
+ * The Data Acquisition Backbone Core (DABC)                *
+ ************************************************************
+ * Copyright (C) 2009 -                                     *
+ * GSI Helmholtzzentrum fuer Schwerionenforschung GmbH      *
+ * Planckstr. 1, 64291 Darmstadt, Germany                   *
+ * Contact:  http://dabc.gsi.de                             *
+ ************************************************************
+ * This software can be used under the GPL license          *
+ * agreements as stated in LICENSE.txt file                 *
+ * which is part of the distribution.                       *
+ ************************************************************/
+
+#ifndef DABC_Checksum
+#define DABC_Checksum
+
+#ifndef DABC_BinaryFile
+#include "dabc/BinaryFile.h"
+#endif
+
+#include <string>
+
+namespace dabc {
+
+   /** \brief Calculate CRC32C (Castagnoli) checksum
+    *
+    * Uses SSE4.2 or ARMv8 CRC instructions when available, otherwise table-based implementation.
+    * Previous value of crc can be provided to continue calculation, 0 should be used for the first portion */
+   uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
+
+   /** \brief Table-based CRC32C calculation, produces same results as \ref dabc::crc32c */
+   uint32_t crc32c_sw(uint32_t crc, const void *buf, size_t len);
+
+   /** \brief Returns true when hardware CRC32C instructions are used */
+   bool crc32c_hw();
+
+   /** \brief File interface, calculating CRC32C checksums for written and read data
+    *
+    * \ingroup dabc_all_classes
+    *
+    * Works on top of any other file interface. Data stream is split into blocks
+    * of fixed size and checksum of each block is stored in text side file with ".crc" suffix.
+    * When writing, data copied into blocks and separate thread calculates checksums and writes data to the file.
+    * When file opened for reading and side file exists, every block is verified.
+    * Reading fails when checksum does not match.
+    */
+
+   class ChecksumFileInterface : public FileInterface {
+      protected:
+         FileInterface *fInner{nullptr};   ///< interface doing real I/O
+         bool fInnerOwner{false};          ///< if inner interface owned
+         unsigned fBlockSize{0};           ///< size of block for checksum
+         unsigned fQueueDepth{0};          ///< maximal number of blocks queued for writing
+
+         bool CheckBlock(void *handle);
+
+      public:
+
+         ChecksumFileInterface(FileInterface *inner, bool owner, unsigned blocksize = 0x100000, unsigned depth = 4);
+         virtual ~ChecksumFileInterface();
+
+         Handle fopen(const char *fname, const char *mode, const char *opt = nullptr) override;
+
+         void fclose(Handle f) override;
+
+         size_t fwrite(const void* ptr, size_t sz, size_t nmemb, Handle f) override;
+
+         size_t fread(void* ptr, size_t sz, size_t nmemb, Handle f) override;
+
+         bool feof(Handle f) override;
+
+         bool fflush(Handle f) override;
+
+         bool fseek(Handle f, long int offset, bool relative = true) override;
+
+         bool fallocate(Handle f, uint64_t size) override;
+
+         bool ftruncate(Handle f) override;
+
+         Object *fmatch(const char *fmask, bool select_files = true) override { return fInner->fmatch(fmask, select_files); }
+
+         bool mkdir(const char *path) override { return fInner->mkdir(path); }
+
+         int GetFileIntPar(Handle h, const char *parname) override;
+
+         bool GetFileStrPar(Handle h, const char *parname, char* sbuf, int sbuflen) override;
+
+         /** Name of side file with checksums */
+         static std::string ChecksumFileName(const std::string &fname) { return fname + ".crc"; }
+   };
+
+}
+
+#endif
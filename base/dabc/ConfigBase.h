@@ -36,6 +36,8 @@ namespace dabc {
    extern const char *xmlDeviceAttr;
    extern const char *xmlThreadAttr;
    extern const char *xmlUseacknAttr;
+   extern const char *xmlShmAttr;
+   extern const char *xmlCompressAttr;
    extern const char *xmlOptionalAttr;
    extern const char *xmlPoolAttr;
    extern const char *xmlTimeoutAttr;
@@ -69,6 +71,7 @@ namespace dabc {
    extern const char *xmlSysloglevel;
    extern const char *xmlSyslog;
    extern const char *xmlLoglimit;
+   extern const char *xmlAsyncLog;
    extern const char *xmlRunTime;
    extern const char *xmlHaltTime;
    extern const char *xmlThrdStopTime;
@@ -40,6 +40,10 @@ namespace dabc {
 
        void SetUseAcknDirectly(bool on) { SetAllowedField(xmlUseacknAttr); SetUseAckn(on); }
 
+       void SetUseShmDirectly(bool on) { SetAllowedField(xmlShmAttr); SetUseShm(on); }
+
+       void SetCompressDirectly(int level) { SetAllowedField(xmlCompressAttr); SetCompress(level); }
+
        void SetConnTimeoutDirectly(double tm) { SetAllowedField(xmlTimeoutAttr); SetConnTimeout(tm); }
 
        std::string GetServerId() const { GET_PAR_FIELD(fServerId,"") }
@@ -217,6 +217,12 @@ namespace dabc {
       /** Use of acknowledge in protocol */
       bool GetUseAckn() const { return GetField(xmlUseacknAttr).AsBool(false); }
 
+      /** Use shared memory when both sides are running on the same node */
+      bool GetUseShm() const { return GetField(xmlShmAttr).AsBool(false); }
+
+      /** zlib compression level for transported buffers, 0 - no compression */
+      int GetCompress() const { return GetField(xmlCompressAttr).AsInt(0); }
+
       /** time required to establish connection, if expired connection will be switched to "failed" state */
       double GetConnTimeout() const { return GetField(xmlTimeoutAttr).AsDouble(10.); }
 
@@ -231,6 +237,10 @@ namespace dabc {
 
       void SetUseAckn(bool on = true) { SetField(xmlUseacknAttr, on); }
 
+      void SetUseShm(bool on = true) { SetField(xmlShmAttr, on); }
+
+      void SetCompress(int level) { SetField(xmlCompressAttr, level); }
+
       void SetConnTimeout(double tm) { SetField(xmlTimeoutAttr, tm); }
 
       void SetConnThread(const std::string &name) { SetField(xmlThreadAttr, name); }
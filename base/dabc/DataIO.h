@@ -28,6 +28,8 @@ namespace dabc {
 
    class Buffer;
    class InputTransport;
+   class BasicFile;
+   class PrefetchFileInterface;
 
    enum DataInputCodes {
       di_ValidSize     = 0xFFFFFFF0,   // last valid size for buffer
@@ -256,9 +258,19 @@ namespace dabc {
          bool                 fLoop{false}; //!< read file(s) in endless loop
          bool                 fCloseOnError{false}; //!< normally close file in case of read error
          double               fReduce{0.};  //!< factor to reduce buffer size when reading
+         bool                 fChecksum{false}; //!< verify CRC32C checksums of data
+         unsigned             fPrefetchDepth{0}; //!< number of blocks read ahead, 0 - no prefetch
+         bool                 fPrefetchNext{false}; //!< open next file from the list in advance
+         dabc::PrefetchFileInterface *fPrefetch{nullptr}; //!< prefetch interface of current file, not owned
 
          bool InitFilesList();
          bool TakeNextFileName();
+
+         /** Configure checksum and prefetch for the file, must be called after each file SetIO() */
+         void ConfigureFile(dabc::BasicFile &f);
+
+         /** Start opening of next file from the list in advance */
+         void PrepareNextFile();
          const std::string &CurrentFileName() const { return fCurrentName; }
          void ClearCurrentFileName() { fCurrentName.clear(); }
 
@@ -297,6 +309,11 @@ namespace dabc {
          std::vector<std::string> fFileDirs;
          unsigned                 fFileDirsCounter{0};
 
+         unsigned                 fStripeBlockSize{0};   ///< block size for striped output, 0 - striping disabled
+         std::vector<std::string> fStripeDirs;          ///< directories for stripe files
+
+         bool                     fChecksum{false};     ///< write CRC32C checksums of data
+
          dabc::FileInterface *fIO{nullptr};
 
          int                  fCurrentFileNumber{0};
@@ -321,6 +338,10 @@ namespace dabc {
 
          int GetSizeLimitMB() const { return fSizeLimitMB; }
 
+         /** Returns file interface for striped writing, when configured with "stripe" option and several dirs.
+          * Only output which calls this method supports striping, otherwise dirs used one after another */
+         dabc::FileInterface *CreateStripedIO();
+
       public:
 
          virtual ~FileOutput();
@@ -262,6 +262,10 @@ namespace dabc {
           * If specified, all childs will be checked */
          bool IsNodeChanged(bool withchilds = true);
 
+         /** \brief Returns true if node (or any of its childs) was changed, but not yet marked with version.
+          * Contrary to \ref IsNodeChanged, hierarchy is not modified */
+         bool HasUnmarkedChanges(bool withchilds) const;
+
          uint64_t GetVersion() const { return fNodeVersion; }
 
          uint64_t GetChildsVersion() const { return fChildsVersion; }
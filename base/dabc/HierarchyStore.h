@@ -28,8 +28,32 @@
 #include "dabc/timing.h"
 #endif
 
+#include <map>
+
 namespace dabc {
 
+   /** \brief Header of the chunk in item time index
+    *
+    * Index file of the item is sequence of chunks, each chunk is header followed by
+    * columns of time stamps (uint64_t, JS ms) and values (double). Header provides summary of the chunk,
+    * therefore chunks outside requested time interval can be skipped without reading the data */
+
+   struct SerieChunkHeader {
+      uint32_t magic{0};       ///< magic number, see \ref SerieMagic
+      uint32_t num{0};         ///< number of samples in chunk
+      uint64_t tmin{0};        ///< time of first sample
+      uint64_t tmax{0};        ///< time of last sample
+      double   vmin{0.};       ///< minimal value
+      double   vmax{0.};       ///< maximal value
+      double   vsum{0.};       ///< sum of all values
+
+      enum { SerieMagic = 0x53424144 };
+
+      uint64_t PayloadSize() const { return num * (sizeof(uint64_t) + sizeof(double)); }
+   };
+
+   // =====================================================================
+
    class HierarchyStore {
       protected:
          std::string fBasePath;      ///! base directory for data store
@@ -45,6 +69,22 @@ namespace dabc {
          Buffer    fStoreBuf;
          Buffer    fFlushBuf;
 
+         /** \brief Samples of numeric item, not yet written to the index */
+         struct SerieBuffer {
+            std::vector<uint64_t> fTime;   ///! time stamps
+            std::vector<double>   fValue;  ///! values
+         };
+
+         std::map<std::string, SerieBuffer> fSeries;  ///! collected samples for all numeric items
+         unsigned  fChunkSize{256};      ///! number of samples in single index chunk
+
+         void CollectSeries(dabc::Hierarchy& item, const std::string &itemname);
+
+         bool WriteSerieChunk(const std::string &itemname, SerieBuffer &buf, unsigned num);
+
+         /** \brief Write filled chunks to index files, if all specified also incomplete chunks are written */
+         bool WriteSeries(bool all);
+
       public:
          HierarchyStore();
          virtual ~HierarchyStore();
@@ -52,6 +92,9 @@ namespace dabc {
          /** \brief Set base path for data storage, can only be changed when all files are closed */
          bool SetBasePath(const std::string &path);
 
+         /** \brief Set number of samples in one chunk of items time index */
+         void SetChunkSize(unsigned sz) { fChunkSize = sz < 16 ? 16 : sz; }
+
 
          bool StartFile(dabc::Buffer buf);
 
@@ -91,6 +134,9 @@ namespace dabc {
 
          dabc::Buffer ReadBuffer(dabc::BinaryFile& f);
 
+         /** \brief Find tree node with data directory of the entry, itemname is entry name relative to that node */
+         Hierarchy FindSerieDir(Hierarchy& tree, const std::string &entry, std::string &itemname);
+
       public:
 
          HierarchyReading();
@@ -108,6 +154,13 @@ namespace dabc {
          /** Get entry with history for specified time interval */
          Hierarchy GetSerie(const std::string &entry, const DateTime& from, const DateTime& till);
 
+         /** \brief Get values of numeric entry for specified time interval, using items time index
+          * \details Only chunks which overlap with time interval are read.
+          * If maxpoints specified, interval divided on maxpoints bins and for each bin average, "min" and "max" values are
+          * delivered. Chunks which fit into single bin are taken from the chunk summary without reading samples.
+          * Returned item has "time" and "value" array fields */
+         Hierarchy GetSerieValues(const std::string &entry, const DateTime& from, const DateTime& till, unsigned maxpoints = 0);
+
    };
 
 }
@@ -24,6 +24,10 @@
 #include "dabc/BuffersQueue.h"
 #endif
 
+#ifndef DABC_Metrics
+#include "dabc/Metrics.h"
+#endif
+
 
 namespace dabc {
 
@@ -62,8 +66,12 @@ namespace dabc {
          bool fBlockWhenUnconnected{false}; ///< should queue block when input port not connected, default false
          bool fBlockWhenConnected{false};   ///< should queue block when input port connected, default true
 
+         MetricsSlot fMetrics;              ///< queue level and traffic, updated under queue mutex
+
          enum { MaskInp = 0x1, MaskOut = 0x2, MaskConn = 0x3 };
 
+         enum { mtrSize, mtrCapacity, mtrBuffers, mtrBytes, mtrDropped };
+
          LocalTransport(unsigned capacity, bool withmutex);
 
          virtual ~LocalTransport();
@@ -20,6 +20,10 @@
 #include "dabc/ModuleAsync.h"
 #endif
 
+#ifndef DABC_Metrics
+#include "dabc/Metrics.h"
+#endif
+
 namespace dabc {
 
    class Mutex;
@@ -65,6 +69,12 @@ namespace dabc {
 
          bool                     fUseThread{false};      ///< indicate if thread functionality should be used to process supplied requests
 
+         uint64_t                 fUsedSize{0};   ///< size of buffers with non-zero reference counter
+
+         MetricsSlot              fMetrics;       ///< pool usage, updated under pool mutex
+
+         enum { mtrSize, mtrUsed, mtrTaken };
+
          static unsigned          fDfltAlignment;   ///< default alignment for memory allocation
          static unsigned          fDfltBufSize;     ///< default buffer size
 
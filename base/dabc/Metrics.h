@@ -0,0 +1,109 @@
+// $Id$
+
+/************************************************************
+ * The Data Acquisition Backbone Core (DABC)                *
+ ************************************************************
+ * Copyright (C) 2009 -                                     *
+ * GSI Helmholtzzentrum fuer Schwerionenforschung GmbH      *
+ * Planckstr. 1, 64291 Darmstadt, Germany                   *
+ * Contact:  http://dabc.gsi.de                             *
+ ************************************************************
+ * This software can be used under the GPL license          *
+ * agreements as stated in LICENSE.txt file                 *
+ * which is part of the distribution.                       *
+ ************************************************************/
+
+#ifndef DABC_Metrics
+#define DABC_Metrics
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <string>
+
+namespace dabc {
+
+   /** \brief Set of metrics values, exported in OpenMetrics format
+    *
+    * \ingroup dabc_all_classes
+    *
+    * Slot belongs to single object (queue, pool, transport) and updated only by thread, which owns the object
+    * or under the object mutex. Values stored in atomic variables with relaxed ordering, therefore
+    * update costs just normal memory write and exporter can read values without locking the object.
+    * All values must be defined with \ref Define before slot is registered.
+    */
+
+   class MetricsSlot {
+
+      friend class Metrics;
+
+      protected:
+
+         struct Entry {
+            std::string fName;                 ///< metric family name
+            std::string fHelp;                 ///< help string
+            bool fCounter{false};              ///< counter or gauge
+            std::atomic<uint64_t> fValue{0};   ///< counter value or bits of double gauge value
+         };
+
+         std::deque<Entry> fEntries;           ///< defined values
+         std::string fLabels;                  ///< labels like port="1",name="abc"
+         bool fRegistered{false};              ///< is slot registered
+
+      public:
+
+         MetricsSlot() = default;
+         MetricsSlot(const MetricsSlot &) = delete;
+         MetricsSlot &operator=(const MetricsSlot &) = delete;
+         ~MetricsSlot() { Unregister(); }
+
+         /** Define counter or gauge, returns id of the value. Only allowed before \ref Register */
+         unsigned Define(const std::string &name, const std::string &help, bool counter = true);
+
+         /** Add label, only allowed before \ref Register */
+         void AddLabel(const std::string &name, const std::string &value);
+
+         bool IsRegistered() const { return fRegistered; }
+
+         /** Make slot visible for exporter */
+         void Register();
+
+         /** Remove slot from exporter, returns when exporter does not use slot any longer */
+         void Unregister();
+
+         /** Increment counter, only single thread should update value */
+         inline void Add(unsigned id, uint64_t v = 1)
+         {
+            auto &val = fEntries[id].fValue;
+            val.store(val.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+         }
+
+         /** Set counter value, used when object already has own counter */
+         inline void SetCounter(unsigned id, uint64_t v) { fEntries[id].fValue.store(v, std::memory_order_relaxed); }
+
+         /** Set gauge value */
+         inline void SetGauge(unsigned id, double v)
+         {
+            uint64_t bits;
+            memcpy(&bits, &v, sizeof(bits));
+            fEntries[id].fValue.store(bits, std::memory_order_relaxed);
+         }
+   };
+
+   // ____________________________________________________________________
+
+   /** \brief Registry of all metrics slots
+    *
+    * \ingroup dabc_all_classes
+    */
+
+   class Metrics {
+      public:
+         /** Produce OpenMetrics text presentation of all registered slots */
+         static std::string FormatOpenMetrics();
+   };
+
+}
+
+#endif
@@ -20,6 +20,8 @@
 #include "dabc/Transport.h"
 #endif
 
+#include <vector>
+
 namespace dabc {
 
    /** \brief Network interface
@@ -48,6 +50,24 @@ namespace dabc {
     * \ingroup dabc_all_classes
     *
     * Base class to implement transport between modules on different nodes
+    *
+    * When acknowledge is enabled, credit-based flow control is used.
+    * Every receive operation, submitted by receiver, grants one credit to the sender.
+    * Several receive operations are reserved for separate credit messages and never granted.
+    * Separate credit message has same format as acknowledge message of previous versions.
+    * When other side indicates (with netot_Credits flag) that it understands it, credits also
+    * delivered in upper bits of kind field of data headers going in reverse direction,
+    * separate credit message only sent when there is no data to carry them.
+    * Sender submits data only when it has credits. Header, which uses last credit, is marked
+    * and receiver grants new credits immediately, otherwise credits are collected into
+    * bigger portions. Time spent by sender without credits is accounted.
+    *
+    * Optionally sender compresses buffers payload with zlib, receiver decompresses received data into other pool buffer.
+    * Compressed payload starts with original buffer size, type id transported in the header as usual.
+    * Compressed data of send operations kept in reusable storages, one per output queue entry.
+    * Compressed payload never sent as inline data - original buffer is sent when it is so small.
+    * If buffer cannot be compressed well, it is sent as is and compression
+    * skipped for several following buffers.
     */
 
    class NetworkTransport : public Transport {
@@ -60,6 +80,7 @@ namespace dabc {
             Buffer   buf;
             void*    header{nullptr};
             void*    inlinebuf{nullptr};
+            int      zslot{-1};   // index of storage with compressed data
          };
 
       #pragma pack(1)
@@ -74,7 +95,11 @@ namespace dabc {
          enum ENetworkOperTypes {
             netot_Send     = 0x001U,
             netot_Recv     = 0x002U,
-            netot_HdrSend  = 0x004U // use to send only network header without any additional data
+            netot_HdrSend  = 0x004U, // use to send only network header without any additional data
+            netot_Starved  = 0x008U, // set in header when sender used its last credit
+            netot_Compressed = 0x010U, // payload compressed
+            netot_Credits  = 0x020U, // sender of header accepts credits in data headers
+            netot_CreditsMask = 0xffff0000U // credits granted with data header
          };
 
       protected:
@@ -94,25 +119,55 @@ namespace dabc {
          int           fNumUsedRecs{0};
 
          unsigned      fOutputQueueSize{0}; // number of output operations, submitted to the records
-         unsigned      fAcknAllowedOper{0};
-         NetIORecsQueue fAcknSendQueue;
-         bool          fAcknSendBufBusy{false}; // indicate if ackn sending is under way
+         unsigned      fSendCredits{0};     // number of send operations, allowed by receiver
+         bool          fPeerCredits{false}; // other side accepts credits in data headers
+         NetIORecsQueue fAcknSendQueue;      // send operations, waiting for credits
+         unsigned      fNumNotPacked{0};    // data send operations, submitted but header not yet packed
+         bool          fAcknSendBufBusy{false}; // indicate if credits message sending is under way
 
          unsigned      fInputQueueSize{0}; // total number of buffers, using for receiving : in device recv queue and input queue, not yet cleaned by user
-         bool          fFirstAckn{false};      // indicates, if first ackn packet was send or not
-         unsigned      fAcknReadyCounter{0}; // counter of submitted to device recv packets
+         bool          fFirstAckn{false};      // indicates, if first credits were granted or not
+         unsigned      fAcknReadyCounter{0}; // number of credits, not yet granted to the sender
+         unsigned      fGrantLimit{0};      // number of credits collected before separate message is sent
+         unsigned      fGrantMaxLimit{0};   // maximal value of grant limit
+         unsigned      fRecvReserve{0};     // number of receive operations reserved for credits messages
+         unsigned      fReserveAvail{0};    // reserved receive operations currently submitted
+
+         bool          fStarved{false};     // sender has data, but no credits
+         TimeStamp     fStarvedTm;          // time when sender run out of credits
+         double        fStarvedTime{0.};    // total time spent without credits
+         uint64_t      fStarvedCnt{0};      // number of times when sender run out of credits
+         uint64_t      fGrantMsgs{0};       // number of separate credits messages
+         uint64_t      fGrantPiggy{0};      // number of credits portions, delivered with data
 
          BufferSize_t  fFullHeaderSize{0};  // total header size
          BufferSize_t  fInlineDataSize{0};  // part of the header, which can be used for inline data (in the end of header)
 
          bool          fStartBufReq{false};     ///< if true, request to memory pool was started and one should wait until it is finished
 
+         int           fCompressLevel{0};   // zlib compression level for sent buffers, 0 - disabled
+         void         *fDeflate{nullptr};   // compression stream
+         void         *fInflate{nullptr};   // decompression stream
+         unsigned      fCompressSkip{0};    // number of buffers which will be sent without compression
+         unsigned      fCompressBackoff{1}; // number of buffers skipped after next failed compression
+         std::vector<std::vector<char>> fDeflateScratch; // reusable storages for compressed data of send operations
+         std::vector<int> fDeflateFree;     // indexes of storages not used by send operations
+         uint64_t      fCompressBufs{0};    // number of compressed buffers
+         uint64_t      fCompressSkipped{0}; // number of buffers sent without compression
+         uint64_t      fCompressRaw{0};     // original size of compressed buffers
+         uint64_t      fCompressPacked{0};  // compressed size
+
          uint32_t TakeRec(Buffer& buf, uint32_t kind = 0, uint32_t extras = 0);
          void ReleaseRec(uint32_t recid);
 
          void FillRecvQueue(Buffer* freebuf = nullptr, bool onlyfreebuf = false);
          bool CheckAcknReadyCounter(unsigned newitems = 0);
          void SubmitAllowedSendOperations();
+         uint32_t TakeSendCredit();
+         void AddSendCredits(unsigned credits);
+
+         bool CompressBuffer(Buffer &buf, int &slot);
+         bool DecompressBuffer(Buffer &buf, BufferSize_t size);
 
          // methods inherited from the module
          void OnThreadAssigned() override;
@@ -121,6 +176,8 @@ namespace dabc {
          void ProcessPoolEvent(unsigned pool) override;
          void ProcessTimerEvent(unsigned timer) override;
 
+         int ExecuteCommand(Command cmd) override;
+
          // methods inherited from transport
          bool StartTransport() override;
          bool StopTransport() override;
@@ -130,7 +187,7 @@ namespace dabc {
          const char *ClassName() const override { return "NetworkTransport"; }
 
          NetworkTransport(dabc::Command cmd, const PortRef& inpport, const PortRef& outport,
-                          bool useackn, WorkerAddon* addon);
+                          bool useackn, WorkerAddon* addon, int compress = 0);
          virtual ~NetworkTransport();
 
          unsigned GetFullHeaderSize() const { return fFullHeaderSize; }
@@ -0,0 +1,94 @@
+// $Id$
+
+/************************************************************
+ * The Data Acquisition Backbone Core (DABC)                *
+ ************************************************************
+ * Copyright (C) 2009 -                                     *
+ * GSI Helmholtzzentrum fuer Schwerionenforschung GmbH      *
+ * Planckstr. 1, 64291 Darmstadt, Germany                   *
+ * Contact:  http://dabc.gsi.de                             *
+ ************************************************************
+ * This software can be used under the GPL license          *
+ * agreements as stated in LICENSE.txt file                 *
+ * which is part of the distribution.                       *
+ ************************************************************/
+
+#ifndef DABC_PrefetchFile
+#define DABC_PrefetchFile
+
+#ifndef DABC_BinaryFile
+#include "dabc/BinaryFile.h"
+#endif
+
+#include <string>
+
+namespace dabc {
+
+   /** \brief File interface, reading data ahead in background thread
+    *
+    * \ingroup dabc_all_classes
+    *
+    * Works on top of any other file interface. For every file opened for reading
+    * separate thread keeps up to "depth" blocks filled ahead of the consumer.
+    * Next file can be opened and prefetched in advance with \ref Prepare method.
+    * Number of reads served from already prefetched data (hits) and reads
+    * which had to wait for the disk (misses) are accounted.
+    */
+
+   class PrefetchFileInterface : public FileInterface {
+      protected:
+         FileInterface *fInner{nullptr};    ///< interface doing real I/O
+         bool fInnerOwner{false};           ///< if inner interface owned
+         unsigned fDepth{0};                ///< number of blocks read ahead
+         unsigned fBlockSize{0};            ///< size of single block
+         Handle fPrepared{nullptr};         ///< file opened in advance
+
+         uint64_t fHits{0};                 ///< reads served from prefetched data
+         uint64_t fMisses{0};               ///< reads which waited for data
+         uint64_t fPreparedHits{0};         ///< number of files opened in advance and used
+
+         Handle OpenReading(const char *fname, const char *opt);
+
+      public:
+
+         PrefetchFileInterface(FileInterface *inner, bool owner, unsigned depth = 4, unsigned blocksize = 0x100000);
+         virtual ~PrefetchFileInterface();
+
+         Handle fopen(const char *fname, const char *mode, const char *opt = nullptr) override;
+
+         void fclose(Handle f) override;
+
+         size_t fwrite(const void* ptr, size_t sz, size_t nmemb, Handle f) override;
+
+         size_t fread(void* ptr, size_t sz, size_t nmemb, Handle f) override;
+
+         bool feof(Handle f) override;
+
+         bool fflush(Handle f) override;
+
+         bool fseek(Handle f, long int offset, bool relative = true) override;
+
+         bool fallocate(Handle f, uint64_t size) override;
+
+         bool ftruncate(Handle f) override;
+
+         Object *fmatch(const char *fmask, bool select_files = true) override { return fInner->fmatch(fmask, select_files); }
+
+         bool mkdir(const char *path) override { return fInner->mkdir(path); }
+
+         int GetFileIntPar(Handle h, const char *parname) override;
+
+         bool GetFileStrPar(Handle h, const char *parname, char* sbuf, int sbuflen) override;
+
+         /** Open file for reading in advance, next fopen() with same name will use it.
+          * File opened and read by separate thread, method returns immediately */
+         void Prepare(const std::string &fname);
+
+         uint64_t GetHits() const { return fHits; }
+         uint64_t GetMisses() const { return fMisses; }
+         uint64_t GetPreparedHits() const { return fPreparedHits; }
+   };
+
+}
+
+#endif
@@ -28,10 +28,44 @@
 
 #ifdef DABC_PROFILER
 
+#include <atomic>
+
 namespace dabc {
 
    class ProfilerGuard;
 
+   /** \brief Timeline of profiler blocks
+    *
+    * \ingroup dabc_all_classes
+    *
+    * When active, every \ref ProfilerGuard block records begin/end events into ring buffer of current thread.
+    * Buffer keeps only last events, they can be saved in Chrome trace format and viewed
+    * with chrome://tracing or https://ui.perfetto.dev. When not active, guard only checks single flag.
+    */
+
+   class ProfilerTrace {
+
+      friend class ProfilerGuard;
+
+      static std::atomic<bool> gActive;
+
+      /** Add event to the ring of current thread, returns true if event was recorded */
+      static bool AddEvent(char phase, unsigned long long clock, const char *name, unsigned slot);
+
+   public:
+
+      /** \brief Start trace, ringsize is number of events kept for each thread */
+      static void Start(unsigned ringsize = 65536);
+
+      /** \brief Stop trace, recorded events are preserved */
+      static void Stop();
+
+      static bool IsActive() { return gActive.load(std::memory_order_relaxed); }
+
+      /** \brief Produce JSON in Chrome trace format with events recorded since last start */
+      static std::string MakeJSON(unsigned *numevents = nullptr);
+   };
+
    class Profiler {
 
       friend class ProfilerGuard;
@@ -74,6 +108,7 @@ namespace dabc {
       Profiler &fProfiler;
       unsigned fCnt{0};
       Profiler::clock_t fLast{0};
+      bool fTraced{false};   // begin event recorded for current block
 
    public:
       ProfilerGuard(Profiler &prof, const char *name = nullptr, unsigned lvl = 0) :
@@ -87,11 +122,22 @@ namespace dabc {
 
          if (name && fProfiler.fEntries[fCnt].fName.empty())
             fProfiler.fEntries[fCnt].fName = name;
+
+         if (ProfilerTrace::IsActive())
+            fTraced = ProfilerTrace::AddEvent('B', fLast, fProfiler.fEntries[fCnt].fName.c_str(), fCnt);
       }
 
       ~ProfilerGuard()
       {
-         Next();
+         if (!fProfiler.fActive || (fCnt >= fProfiler.fEntries.size()))
+            return;
+
+         auto now = fProfiler.GetClock();
+
+         fProfiler.fEntries[fCnt].fSum += (now - fLast);
+
+         if (fTraced)
+            ProfilerTrace::AddEvent('E', now, fProfiler.fEntries[fCnt].fName.c_str(), fCnt);
       }
 
       void Next(const char *name = nullptr, unsigned lvl = 0)
@@ -103,6 +149,11 @@ namespace dabc {
 
          fProfiler.fEntries[fCnt].fSum += (now - fLast);
 
+         if (fTraced) {
+            ProfilerTrace::AddEvent('E', now, fProfiler.fEntries[fCnt].fName.c_str(), fCnt);
+            fTraced = false;
+         }
+
          fLast = now;
 
          if (lvl)
@@ -112,6 +163,9 @@ namespace dabc {
 
          if (name && (fCnt < fProfiler.fEntries.size()) && fProfiler.fEntries[fCnt].fName.empty())
             fProfiler.fEntries[fCnt].fName = name;
+
+         if ((fCnt < fProfiler.fEntries.size()) && ProfilerTrace::IsActive())
+            fTraced = ProfilerTrace::AddEvent('B', now, fProfiler.fEntries[fCnt].fName.c_str(), fCnt);
       }
 
    };
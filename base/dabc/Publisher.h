@@ -20,6 +20,8 @@
 #include "dabc/Worker.h"
 #endif
 
+#include <map>
+
 namespace dabc {
 
    class PublisherRef;
@@ -42,6 +44,36 @@ namespace dabc {
       }
    };
 
+   /** Command to get values of numeric item from time index of hierarchy store.
+    * Time interval specified in JS milliseconds, zero values mean begin of the store and current time.
+    * If maxpoints specified, values are downsampled. Result is JSON with "time" and "value" arrays in raw data */
+   class CmdGetSerie : public Command {
+      DABC_COMMAND(CmdGetSerie, "CmdGetSerie");
+
+      CmdGetSerie(const std::string &path, uint64_t from, uint64_t till, unsigned maxpoints = 0) :
+         Command(CmdName())
+      {
+         SetStr("Item", path);
+         SetUInt("From", from);
+         SetUInt("Till", till);
+         SetUInt("MaxPoints", maxpoints);
+      }
+   };
+
+   /** Command to get JSON for several items at once. Publisher requests all items concurrently,
+    * result is JSON array with entries for every item, delivered in raw data */
+   class CmdMultiGet : public Command {
+      DABC_COMMAND(CmdMultiGet, "CmdMultiGet");
+
+      CmdMultiGet(const std::string &path, const std::vector<std::string> &items, const std::string &query) :
+         Command(CmdName())
+      {
+         SetStr("Path", path);
+         SetField("Items", items);
+         SetStr("Query", query);
+      }
+   };
+
    /** Command submitted to worker when item in hierarchy defined as DABC.Command
     * and used to produce custom binary data for published in hierarchy entries */
    class CmdHierarchyExec : public Command {
@@ -80,6 +112,39 @@ namespace dabc {
    };
 
 
+   /** Command to subscribe for diffs of hierarchy item, which are pushed by the publisher of node where item is produced */
+   class CmdSubscribeDiff : public Command {
+      DABC_COMMAND(CmdSubscribeDiff, "CmdSubscribeDiff");
+
+      /** Item is path in hierarchy, subscriber - address of worker which gets \ref CmdPushDiff commands,
+       * period - minimal interval between two pushes, keepalive - maximal interval between two pushes */
+      CmdSubscribeDiff(const std::string &path, const std::string &subscriber, int subid, double period = 1., double keepalive = 5.) :
+         Command(CmdName())
+      {
+         SetStr("Item", path);
+         SetStr("Subscriber", subscriber);
+         SetInt("SubId", subid);
+         SetDouble("Period", period);
+         SetDouble("KeepAlive", keepalive);
+      }
+   };
+
+   /** Command, delivered to subscriber with diff of hierarchy item in raw data.
+    * Diff made relative to "BaseVersion" and should be applied with \ref Hierarchy::UpdateFromBuffer.
+    * Without raw data command just indicates that item was not changed.
+    * Subscriber should reply cmd_false if it is no longer interested in the diffs */
+   class CmdPushDiff : public Command {
+      DABC_COMMAND(CmdPushDiff, "CmdPushDiff");
+
+      CmdPushDiff(int subid, uint64_t basever, uint64_t version) :
+         Command(CmdName())
+      {
+         SetInt("SubId", subid);
+         SetUInt("BaseVersion", basever);
+         SetUInt("Version", version);
+      }
+   };
+
    class CmdSubscriber : public Command {
       DABC_COMMAND(CmdSubscriber, "CmdSubscriber");
 
@@ -101,6 +166,7 @@ namespace dabc {
       bool waiting_publisher{false};  // indicate if next request is submitted
       Hierarchy rem;                  // remote hierarchy
       HierarchyStore* store{nullptr}; // store object for the registered hierarchy
+      uint64_t snapvers{0};           // version of local hierarchy in last snapshot
 
       PublisherEntry() :
          id(0), path(), worker(), fulladdr(), hier(nullptr),
@@ -138,9 +204,53 @@ namespace dabc {
          hlimit(0), fEntry(), version(0), waiting_worker(false) {}
    };
 
+   struct PushEntry {
+      unsigned id{0};              // unique id in the worker
+      std::string item;            // item name, requested by subscriber
+      std::string worker;          // local worker which manages item
+      std::string subitem;         // item name in the worker hierarchy
+      void* hier{nullptr};         // worker hierarchy pointer, one not allowed to use it from publisher
+      std::string subscriber;      // address of subscriber
+      int subid{0};                // id provided by subscriber
+      double period{1.};           // minimal interval between two pushes
+      double keepalive{5.};        // maximal interval between two pushes
+      uint64_t version{0};         // last version delivered to subscriber
+      TimeStamp lastcheck;         // last time when item was checked
+      TimeStamp lastpush;          // last time when push was delivered
+      bool waiting{false};         // when request to worker or push to subscriber is pending
+      int errcnt{0};               // counter of consequent errors
+   };
+
+   struct MultiGetEntry {
+      unsigned id{0};                    // unique id of request
+      Command cmd;                       // original command
+      std::vector<std::string> items;    // requested items
+      std::vector<std::string> results;  // JSON for each item, empty when not available
+      unsigned waiting{0};               // number of pending requests
+   };
+
+   struct CachedJson {
+      uint64_t version{0};         // version of the item
+      std::string json;            // JSON produced for the item
+      TimeStamp lastused;          // last time when entry was used
+   };
+
    /** \brief %Module manages published hierarchies and provide optimize access to them
     *
     * \ingroup dabc_all_classes
+    *
+    * Remote workers can subscribe with \ref CmdSubscribeDiff for changes of hierarchy item.
+    * Publisher of node where item is produced periodically checks item version and
+    * sends only changed parts of item with \ref CmdPushDiff, next push only after previous is replied.
+    *
+    * After each update cycle publisher provides snapshots of local and global hierarchies.
+    * Snapshot is never modified - when hierarchy changes, new snapshot is created.
+    * Therefore other threads (like http server) can read snapshot without submitting commands to publisher.
+    * Local and global hierarchies contain only names structure, they change only when items
+    * added, removed or their properties changed.
+    * Once item values are requested from other thread, every local worker also provides
+    * complete copy of its hierarchy, which is used to produce get.json, dabc.json and similar replies.
+    * Such copy is created only when worker hierarchy was changed, copies of other workers are kept.
     */
 
    class Publisher : public dabc::Worker {
@@ -159,12 +269,28 @@ namespace dabc {
 
          typedef std::list<SubscriberEntry> SubscribersList;
 
+         typedef std::list<PushEntry> PushList;
+
          PublishersList fPublishers;
 
          SubscribersList fSubscribers;
 
+         PushList fPushes;
+
          unsigned fCnt{0};            ///! counter for new records
 
+         TimeStamp fLastScanTm;       ///! last time when publishers were scanned
+
+         std::list<MultiGetEntry> fMultiGets;          ///! pending multiget requests
+         std::map<std::string, CachedJson> fJsonCache; ///! last JSON for items, requested with multiget
+
+         Mutex       fSnapshotMutex;    ///! protects access to snapshots
+         Hierarchy   fLocalSnapshot;    ///! copy of local hierarchy, can be used from other threads
+         Hierarchy   fGlobalSnapshot;   ///! global hierarchy, can be used from other threads
+         uint64_t    fSnapshotVers{0};  ///! version of local hierarchy in snapshot
+         std::map<std::string, Hierarchy> fItemSnapshots; ///! complete copies of local workers hierarchies, key is path
+         bool        fWithItemSnapshots{false}; ///! set when item snapshots were requested
+
          std::string fMgrPath;     ///! path for manager
          Hierarchy   fMgrHiearchy; ///! this is manager hierarchy, published by ourselfs
 
@@ -186,6 +312,30 @@ namespace dabc {
 
          void CheckDnsSubscribers();
 
+         /** \brief Request versions of subscribed items, returns minimal push period */
+         double ProcessPushes(double tmout);
+
+         /** \brief Process replies of worker and subscriber for pushed item */
+         void ProcessPushReply(Command cmd);
+
+         /** \brief Register new push entry, if item produced on other node command is redirected */
+         int AddPushEntry(Command cmd);
+
+         /** \brief Submit requests for all items in \ref CmdMultiGet */
+         int StartMultiGet(Command cmd);
+
+         /** \brief Process reply for single item of multiget request */
+         void ProcessMultiGetReply(Command cmd);
+
+         /** \brief Read values of item from time index of the store, see \ref CmdGetSerie */
+         int ExecuteGetSerie(Command cmd);
+
+         /** \brief Create new snapshots if local or global hierarchy was changed */
+         void MakeSnapshots(bool global_changed);
+
+         /** \brief Replace or remove (when snap is empty) copy of local worker hierarchy */
+         void SetItemSnapshot(const std::string &path, const Hierarchy &snap);
+
          /** \brief Method marks that global version is out of date and should be rebuild */
          void InvalidateGlobal();
 
@@ -213,6 +363,14 @@ namespace dabc {
 
          static const char *DfltName() { return "/publ"; }
 
+         /** \brief Returns last snapshots of local and global hierarchies, can be called from any thread.
+          * Global snapshot is empty when there are no remote hierarchies */
+         bool GetSnapshots(Hierarchy &local, Hierarchy &global);
+
+         /** \brief Returns copy of local worker hierarchy, which contains item, can be called from any thread.
+          * subitem is name of item inside returned hierarchy. First call enables production of such copies */
+         Hierarchy GetItemSnapshot(const std::string &itemname, std::string &subitem);
+
          const char *ClassName() const override { return "Publisher"; }
    };
 
@@ -248,6 +406,13 @@ namespace dabc {
       /** Returns 1 - need auth,  0 - no need auth, -1 - undefined */
       int NeedAuth(const std::string &path);
 
+      /** Executes \ref CmdGetNamesList, if possible result produced from hierarchy snapshot in caller thread */
+      int ExecuteNamesList(Command cmd);
+
+      /** Produce get.json, dabc.json and similar replies for local item from hierarchy snapshot in caller thread.
+       * Returns false if reply cannot be produced from snapshot and request should be submitted to publisher */
+      bool GetItemReply(const std::string &fullname, const std::string &kind, const std::string &query, std::string &reply);
+
       /** Return different kinds of binary data, depends from kind */
       Buffer GetBinary(const std::string &fullname, const std::string &kind, const std::string &query, double tmout = 5.);
 
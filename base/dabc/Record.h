@@ -25,7 +25,6 @@
 #endif
 
 #include <vector>
-#include <map>
 
 namespace dabc {
 
@@ -94,6 +93,18 @@ namespace dabc {
 
          /** \brief Restore string from the stream */
          bool read_str(std::string& str);
+
+         /** \brief Store unsigned value with variable length (7 bits per byte) */
+         bool write_varint(uint64_t v);
+
+         /** \brief Restore unsigned value, stored with \ref write_varint */
+         bool read_varint(uint64_t& v);
+
+         /** \brief Store string as varint length and characters, without alignment */
+         bool write_varstr(const std::string &str);
+
+         /** \brief Restore string, stored with \ref write_varstr */
+         bool read_varstr(std::string& str);
    };
 
    // ===================================================================================
@@ -274,6 +285,9 @@ namespace dabc {
 
          void SetArrStrDirect(int64_t size, char* arr, bool owner = false);
 
+         /** Take value and flags from other field without copying data, source field becomes empty */
+         void steal(RecordField &src);
+
          void constructor() { fKind = kind_none; fModified = false; fTouched = false; fProtected = false; }
 
       public:
@@ -307,6 +321,9 @@ namespace dabc {
          bool IsProtected() const { return fProtected; }
          void SetProtected(bool on = true) { fProtected = on; }
 
+         /** Returns true when field contains scalar integer or floating point value */
+         bool IsNumeric() const { return (fKind == kind_int) || (fKind == kind_uint) || (fKind == kind_double); }
+
          bool IsArray() const
          {
             return (fKind == kind_arrint) ||
@@ -365,21 +382,45 @@ namespace dabc {
          uint64_t StoreSize();
          bool Stream(iostream& s);
 
+         /** \brief Stream field in compact form - kind byte and value without alignment,
+          * integers stored as varint. Arrays, buffers and references use normal \ref Stream */
+         bool StreamCompact(iostream& s);
+
          static bool NeedJsonReformat(const std::string &str);
          static std::string JsonReformat(const std::string &str);
 
          static bool StrToStrVect(const char *str, std::vector<std::string>& vect, bool verbose = true);
    };
 
+   /** \brief Fields of the record
+    *
+    * Fields kept in flat vector, sorted by name. Most records have only few fields,
+    * therefore binary search in continuous memory is faster than tree walk and
+    * creation/destruction of the map does not require allocation per field.
+    * Reference, returned by \ref Field method, valid only until next field is add or removed.
+    */
+
    class RecordFieldsMap {
       protected:
-         typedef std::map<std::string, dabc::RecordField> FieldsMap;
+         struct Entry {
+            std::string name;
+            RecordField field;
+
+            Entry(const std::string &_name) : name(_name), field() {}
+            Entry(Entry &&src) noexcept : name(std::move(src.name)), field() { field.steal(src.field); }
+            Entry &operator=(Entry &&src) noexcept { name = std::move(src.name); field.steal(src.field); return *this; }
+         };
 
-         FieldsMap fMap;
+         typedef std::vector<Entry> FieldsVector;
+
+         FieldsVector fArr;                     ///< fields, sorted by name
 
          bool   fChanged{false};               ///< true when field was removed
 
-         void clear() { fMap.clear(); }
+         void clear() { fArr.clear(); }
+
+         /** Returns position of field with such name or where it should be inserted */
+         FieldsVector::const_iterator find_pos(const std::string &name) const;
 
          static bool match_prefix(const std::string &name, const std::string &prefix);
 
@@ -391,14 +432,21 @@ namespace dabc {
          uint64_t StoreSize(const std::string &nameprefix = "");
          bool Stream(iostream& s, const std::string &nameprefix = "");
 
+         /** \brief Compact streaming of fields, see \ref RecordField::StreamCompact
+          * When reading, fields are add to existing. Fields for which accept function returns false are not written */
+         bool StreamCompact(iostream& s, bool (*accept)(const std::string &) = nullptr);
+
          bool HasField(const std::string &name) const;
          bool RemoveField(const std::string &name);
 
-         unsigned NumFields() const { return fMap.size(); }
-         std::string FieldName(unsigned n) const;
+         unsigned NumFields() const { return fArr.size(); }
+         std::string FieldName(unsigned n) const { return n < fArr.size() ? fArr[n].name : std::string(); }
+
+         /** \brief Direct access to the fields, field created when not exists */
+         RecordField& Field(const std::string &name);
 
-         /** \brief Direct access to the fields */
-         RecordField& Field(const std::string &name) { return fMap[name]; }
+         /** \brief Returns pointer on the field or nullptr, field is not created */
+         const RecordField* FindField(const std::string &name) const;
 
          /** Save all field in json format */
          bool SaveTo(HStore& res);
@@ -470,7 +518,7 @@ namespace dabc {
             { return Fields().FieldName(cnt); }
 
          virtual RecordField GetField(const std::string &name) const
-            { return Fields().Field(name); }
+            { auto fld = Fields().FindField(name); return fld ? *fld : RecordField(); }
 
          virtual bool SetField(const std::string &name, const RecordField& v)
             { return Fields().Field(name).SetValue(v); }
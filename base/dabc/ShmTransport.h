@@ -0,0 +1,145 @@
+// $Id$
+
+/************************************************************
+ * The Data Acquisition Backbone Core (DABC)                *
+ ************************************************************
+ * Copyright (C) 2009 -                                     *
+ * GSI Helmholtzzentrum fuer Schwerionenforschung GmbH      *
+ * Planckstr. 1, 64291 Darmstadt, Germany                   *
+ * Contact:  http://dabc.gsi.de                             *
+ ************************************************************
+ * This software can be used under the GPL license          *
+ * agreements as stated in LICENSE.txt file                 *
+ * which is part of the distribution.                       *
+ ************************************************************/
+
+#ifndef DABC_ShmTransport
+#define DABC_ShmTransport
+
+#ifndef DABC_SocketThread
+#include "dabc/SocketThread.h"
+#endif
+
+#ifndef DABC_NetworkTransport
+#include "dabc/NetworkTransport.h"
+#endif
+
+#include <string>
+
+namespace dabc {
+
+   /** \brief Named POSIX shared memory region
+    *
+    * \ingroup dabc_all_classes
+    *
+    * Region created by one process and opened by another, mapping released in destructor.
+    */
+
+   class ShmRegion {
+      protected:
+         std::string fName;            ///< name of shared memory object
+         void       *fAddr{nullptr};   ///< mapped address
+         size_t      fSize{0};         ///< mapped size
+         bool        fLinked{false};   ///< if name still exists in the system
+
+      public:
+         ShmRegion() = default;
+         ~ShmRegion() { Close(); }
+
+         /** Create new region, stale region with same name is removed */
+         bool Create(const std::string &name, size_t size);
+
+         /** Open region, created by other process */
+         bool Open(const std::string &name);
+
+         /** Remove name of the region, mapping remains valid */
+         void Unlink();
+
+         /** Unlink (if owner) and unmap region */
+         void Close();
+
+         void *Addr() const { return fAddr; }
+         size_t Size() const { return fSize; }
+         const std::string &Name() const { return fName; }
+
+         /** Produce name of region for the connection, each side of connection has own region */
+         static std::string MakeName(const std::string &connid, bool server);
+   };
+
+   // ______________________________________________________________
+
+   /** \brief Network transport between processes on same node via shared memory
+    *
+    * \ingroup dabc_all_classes
+    *
+    * Each side of the connection writes data into own shared memory region and reads from region of other side.
+    * Region contains descriptors ring and data area, where headers and buffers are placed one after another.
+    * Sender copies buffer into data area and passes offset via descriptors ring.
+    * Receiver does not copy data - buffer, delivered to the module, points directly to shared memory;
+    * when buffer is released, its memory marked as free and can be reused by the sender.
+    * Socket, used to establish connection, only transports single-byte wake-up messages
+    * when other side waits for new data or for free space.
+    */
+
+   class ShmNetworkInetrface : public SocketIOAddon,
+                               public NetworkInetrface {
+      protected:
+
+         typedef Queue<uint32_t> RecIdsQueue;
+
+         enum EShmEvents { evntShmSendCompl = evntSocketLast, evntShmRecv };
+
+         ShmRegion  *fTx{nullptr};             ///< own region, used for sending
+         Reference   fLink;                    ///< access to region of other side, shared with received buffers
+         char*       fHeaders{nullptr};        ///< memory for network headers
+         RecIdsQueue fSendQueue;               ///< records waiting for send
+         RecIdsQueue fRecvQueue;               ///< records waiting for data
+         RecIdsQueue fComplQueue;              ///< records with data copied, completion delivered via event
+         char        fBell[64];                ///< buffer to receive wake-up messages
+
+         uint64_t    fDataHead{0};             ///< position in data area for next chunk
+         uint64_t    fDataTail{0};             ///< begin of data, not yet released by receiver
+
+         bool        fSendProcessing{false};   ///< true when send queue is processed
+         bool        fRecvProcessing{false};   ///< true when received descriptors are processed
+         bool        fRecvFired{false};        ///< event to process receive queue is fired
+
+         uint64_t    fSendRecs{0};             ///< number of sent records
+         uint64_t    fRecvRecs{0};             ///< number of received records
+         uint64_t    fBellsSent{0};            ///< number of wake-up messages sent
+         uint64_t    fSpaceWaits{0};           ///< number of times sender waits for free space
+
+         long Notify(const std::string&, int) override;
+
+         void ProcessEvent(const EventId &) override;
+
+         void OnThreadAssigned() override;
+
+         void OnSendCompleted() override {}
+         void OnRecvCompleted() override;
+
+         void OnSocketError(int msg, const std::string &info) override;
+
+         void ProcessSendQueue();
+         void ProcessRecvQueue();
+
+         bool ReclaimSpace();
+
+      public:
+         /** Interface takes ownership over both regions */
+         ShmNetworkInetrface(int fd, ShmRegion *tx, ShmRegion *rx);
+         virtual ~ShmNetworkInetrface();
+
+         /** \brief Create and initialize region with data area of specified size */
+         static ShmRegion *CreateRegion(const std::string &name, size_t datasize);
+
+         /** \brief Open and verify region, created by other side */
+         static ShmRegion *OpenRegion(const std::string &name);
+
+         void AllocateNet(unsigned fulloutputqueue, unsigned fullinputqueue) override;
+         void SubmitSend(uint32_t recid) override;
+         void SubmitRecv(uint32_t recid) override;
+   };
+}
+
+#endif
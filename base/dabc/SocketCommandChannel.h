@@ -20,11 +20,17 @@
 #include "dabc/SocketThread.h"
 #endif
 
+#include <deque>
+#include <vector>
+
 namespace dabc {
 
 
    /*! \brief Defines syntax of raw packet, transformed on the command channels
     *
+    * Packet header followed by command in compact binary form and optional raw data.
+    * Request id and command result are transported in header, therefore several commands
+    * can be in flight and replies can arrive in any order.
     */
 
    struct SocketCmdPacket {
@@ -41,6 +47,10 @@ namespace dabc {
 
       uint32_t data_rawsize;  ///< which part of data at the end is raw data
 
+      uint32_t data_cmdid;    ///< request id, used to find command when reply is received
+
+      int32_t  data_result;   ///< command result, used in reply
+
       /** data here are depends from the kind specified */
    };
 
@@ -52,6 +62,10 @@ namespace dabc {
    /** \brief Client side of command connection between two nodes
     *
     * \ingroup dabc_all_classes
+    *
+    * Queued commands are send in batches with single gather write, replies are matched
+    * by request id. For every connection histogram of reply times is collected,
+    * it can be requested with "GetCmdLatency" command of \ref SocketCommandChannel
     */
 
    class SocketCommandClient : public Worker {
@@ -64,7 +78,10 @@ namespace dabc {
          };
 
          enum {
-            headerDabc = 123707321
+            headerDabc = 123707322,   ///< identifies packet, changed with protocol
+            MaxBatchCmds = 32,        ///< maximal number of commands send at once
+            MaxBatchSize = 0x100000,  ///< maximal size of commands data send at once
+            NumLatencyBins = 20       ///< number of bins in latency histogram
          };
 
          enum ECmdDataKindNew {
@@ -96,9 +113,9 @@ namespace dabc {
 
          EState             fState{stConnecting};             ///< current state of the worker
 
-         SocketCmdPacket    fSendHdr;           ///< header for send command
-         dabc::Buffer       fSendBuf;           ///< content of transported command
-         dabc::Buffer       fSendRawData;       ///< raw data, which should be send with command
+         std::vector<char>  fSendData;          ///< headers and commands, send in current operation
+         std::vector<dabc::Buffer> fSendRawData; ///< raw data of commands, send in current operation
+         std::vector<uint64_t> fSendParts;      ///< positions in fSendData where raw data are inserted
          bool               fSendingActive{false};     ///< indicate if currently send active
          SocketCmdPacket    fRecvHdr;           ///< buffer for receiving header
          char*              fRecvBuf{nullptr};           ///< raw buffer for receiving command
@@ -109,6 +126,12 @@ namespace dabc {
 
          ERecvState         fRecvState{recvInit};         ///< state that happens with receiver (server)
 
+         std::deque<std::pair<uint32_t,TimeStamp>> fSendTimes; ///< id and send time of commands waiting for reply
+         uint64_t           fLatencyHist[NumLatencyBins]; ///< histogram of reply time, bin 0 below 100 us, each next bin twice wider
+         uint64_t           fLatencyCnt{0};      ///< number of measured replies
+         double             fLatencySum{0.};     ///< sum of reply times
+         double             fLatencyMax{0.};     ///< maximal reply time
+
          // these are fields, used to manage information about remote node
          bool               fRemoteObserver{false};   ///< if true, channel automatically used to update information from remote
          std::string        fRemoteName;       ///< name of connection, appeared in the browser
@@ -140,8 +163,18 @@ namespace dabc {
          /** \brief Send submitted commands to remote */
          void SendSubmittedCommands();
 
-         /** Send next command to the remote */
-         void SendCommand(dabc::Command cmd, bool asreply = false);
+         /** Encode next command into send data, returns false if command was not added */
+         bool SendCommand(dabc::Command cmd, bool asreply = false);
+
+         /** Account reply time of command with specified id */
+         void AccountLatency(uint32_t cmdid);
+
+         /** Fill latency statistic into the command */
+         void FillLatency(Command cmd);
+
+         static bool EncodeCommand(iostream &s, Command &cmd, bool asreply);
+
+         static bool DecodeCommand(iostream &s, Command &cmd);
 
          /** \brief Called when connection must be closed due to the error */
          void CloseClient(bool iserr = false, const char *msg = nullptr);
@@ -44,6 +44,8 @@ namespace dabc {
          int                    fBindPort{0};   // selected port number
          std::string            fCmdChannelId; // server id of command channel, which will redirect sockets
          bool                   fDebugMode{false};   // debug mode
+         unsigned               fZeroCopyMin{0};   // minimal payload for MSG_ZEROCOPY send, 0 - disabled
+         unsigned               fShmSize{64};      // size of shared memory data area in MB
 
          double ProcessTimeout(double last_diff) override;
 
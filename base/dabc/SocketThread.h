@@ -61,6 +61,7 @@ namespace dabc {
          int           fIOPriority{0};                 ///< priority of socket I/O events, default 1
          bool          fDeliverEventsToWorker{false};  ///< if true, completion events will be delivered to the worker
          bool          fDeleteWorkerOnClose{false};    ///< if true, worker will be deleted when socket closed or socket in error
+         bool          fWaitErrQueue{false};           ///< if true, socket checked for error queue notifications
 
          void ProcessEvent(const EventId &) override;
 
@@ -72,6 +73,10 @@ namespace dabc {
           * When it will be possible, worker get evntSocketWrite event */
          inline void SetDoingOutput(bool on = true) { fDoingOutput = on; }
 
+         /** \brief Indicate that notifications from socket error queue are expected.
+          * Socket will be polled even when no I/O operation is running, worker get evntSocketError event */
+         inline void SetWaitErrQueue(bool on = true) { fWaitErrQueue = on; }
+
          /** Generic error handler. Also invoked when socket is closed (msg == 0) */
          virtual void OnSocketError(int msg, const std::string &info);
 
@@ -109,6 +114,7 @@ namespace dabc {
 
          inline bool IsDoingInput() const { return fDoingInput; }
          inline bool IsDoingOutput() const { return fDoingOutput; }
+         inline bool IsWaitErrQueue() const { return fWaitErrQueue; }
 
          void CloseSocket();
          void SetSocket(int fd);
@@ -153,6 +159,13 @@ namespace dabc {
          unsigned      fSendIOVNumber{0};  ///< number of elements in current send operation
          struct sockaddr_in fSendAddr;  ///< optional send address for next send operation
          bool          fSendUseAddr{false};    ///< if true, fSendAddr will be used
+         bool          fSendZeroCopy{false};   ///< if true, current send operation uses MSG_ZEROCOPY
+
+         // zero-copy transmission
+         bool          fZeroCopy{false};       ///< if SO_ZEROCOPY enabled for the socket
+         uint32_t      fZeroCopyNext{0};       ///< id of next sendmsg() call with MSG_ZEROCOPY
+         uint32_t      fZeroCopyDone{0};       ///< all calls with smaller id are completed
+         uint64_t      fZeroCopyCopied{0};     ///< number of notifications where kernel had to copy data
 
          // receiving data
          bool          fRecvUseMsg{false};     ///< use recvmsg for transport
@@ -162,6 +175,7 @@ namespace dabc {
          unsigned      fRecvIOVNumber{0};  ///< number of elements in current recv operation
          struct sockaddr_in fRecvAddr;  ///< source address of last receive operation
          unsigned      fLastRecvSize{0};   ///< size of last recv operation
+         bool          fRecvAny{false};    ///< complete recv operation when any data received
 
 #ifdef SOCKET_PROFILING
          long           fSendOper;
@@ -196,11 +210,19 @@ namespace dabc {
             if (IsDeliverEventsToWorker()) FireWorkerEvent(evntSocketRecvInfo);
          }
 
+         /** \brief Method called when zero-copy send completions are received.
+          * \details All sendmsg() calls with id less than \ref GetZeroCopyDone() are completed,
+          * memory used in these calls can be reused */
+         virtual void OnZeroCopyCompleted() {}
+
+         /** \brief Read completion notifications from socket error queue, returns number of read notifications */
+         unsigned ReadZeroCopyNotifications();
+
          /** \brief Method provide address of last receive operation */
          struct sockaddr_in& GetRecvAddr() { return fRecvAddr; }
 
          /** \brief Method return size of last buffer read from socket. Useful
-          * only for datagram sockets, which can reads complete packet at once  */
+          * for datagram sockets, which can reads complete packet at once, and after \ref StartRecvAvailable */
          unsigned GetRecvSize() const { return fLastRecvSize; }
 
       public:
@@ -222,12 +244,39 @@ namespace dabc {
 
          bool StartRecvHdr(void* hdr, unsigned hdrsize, void* buf, size_t size);
 
+         /** \brief Start recv of up to size bytes, operation completed as soon as any data are received.
+          * \details Number of received bytes provided by \ref GetRecvSize() */
+         bool StartRecvAvailable(void* buf, size_t size);
+
          bool StartSend(const Buffer& buf);
          bool StartRecv(Buffer& buf, BufferSize_t datasize);
 
          bool StartNetRecv(void *hdr, unsigned hdrsize, Buffer &buf, BufferSize_t datasize);
          bool StartNetSend(void *hdr, unsigned hdrsize, const Buffer &buf, BufferSize_t datasize = 0);
 
+         /** \brief Start send of gather list, provided by caller.
+          * \details Elements copied into internal vector, memory they point to must be valid until send is completed.
+          * Number of elements should not exceed \ref MaxSendIOV().
+          * When zerocopy specified and enabled for the socket, data sent with MSG_ZEROCOPY flag */
+         bool StartSendIOV(const struct iovec *iov, unsigned num, bool zerocopy = false);
+
+         /** \brief Enable MSG_ZEROCOPY transmission for the socket, returns false when not supported.
+          * \details Memory, used in zero-copy send, must not be changed until completion
+          * notification arrives, see \ref OnZeroCopyCompleted() */
+         bool EnableZeroCopy();
+
+         bool IsZeroCopy() const { return fZeroCopy; }
+
+         /** \brief Id of next sendmsg() call with MSG_ZEROCOPY flag */
+         uint32_t GetZeroCopyNext() const { return fZeroCopyNext; }
+         /** \brief All zero-copy calls with smaller id are completed */
+         uint32_t GetZeroCopyDone() const { return fZeroCopyDone; }
+         /** \brief Number of completions, where kernel copied data (like for loopback device) */
+         uint64_t GetZeroCopyCopied() const { return fZeroCopyCopied; }
+
+         /** \brief Maximal number of elements which can be sent with single sendmsg() call */
+         static unsigned MaxSendIOV();
+
          /** \brief Method should be used to cancel all running I/O operation of the socket.
           * Should be used for instance when worker want to be deleted */
          void CancelIOOperations();
@@ -24,11 +24,21 @@
 #include "dabc/NetworkTransport.h"
 #endif
 
+#include <vector>
+#include <deque>
+
 namespace dabc {
 
    /** \brief Specific implementation of network transport for socket
     *
     * \ingroup dabc_all_classes
+    *
+    * When several send records are queued, their headers and data are sent with single sendmsg() call.
+    * On the receiving side data are read into staging buffer as much as available,
+    * several headers and small buffers are taken from there; rest of big buffer read directly.
+    * Optionally large batches are sent with MSG_ZEROCOPY, then buffers are kept until kernel
+    * signals completion of transmission. Batches with compressed records never use MSG_ZEROCOPY,
+    * while compressed data storage is reused by transport directly after send completion.
     */
 
    class SocketNetworkInetrface : public SocketIOAddon,
@@ -40,10 +50,40 @@ namespace dabc {
          char*       fHeaders{nullptr};
          RecIdsQueue fSendQueue;
          RecIdsQueue fRecvQueue;
-         int         fRecvStatus{0};  ///< 0 - idle, 1 - header, 2 - front buffer from recv queue
-         uint32_t    fRecvRecid{0};   ///< if of the record, used for data receiving (status != 0)
+         int         fRecvStatus{0};  ///< 0 - idle, 2 - front buffer from recv queue, 3 - staging buffer
+         uint32_t    fRecvRecid{0};   ///< if of the record, used for data receiving (status == 2)
          int         fSendStatus{0};  ///< 0 - idle, 1 - sending
-         uint32_t    fSendRecid{0};   ///< id of the active send record
+
+         std::vector<uint32_t> fSendBatch;     ///< ids of records, sent with current operation
+         std::vector<struct iovec> fSendIOVBatch; ///< gather list for current send operation
+         unsigned    fSendBatchMax{0};         ///< maximal number of records in one send operation
+         unsigned    fSendBatchBytes{0};       ///< no more records added when batch exceeds this size
+
+         std::vector<char> fRecvStage;         ///< staging buffer for received data
+         unsigned    fStageBeg{0};             ///< begin of not yet processed data in staging buffer
+         unsigned    fStageEnd{0};             ///< end of received data in staging buffer
+         BufferSize_t fLastPayload{0};         ///< size of last received payload
+         Buffer      fRecvRest;                ///< part of buffer, read directly from socket
+         bool        fRecvProcessing{false};   ///< true when staged data are processed
+
+         uint64_t    fSendCalls{0};            ///< number of send operations
+         uint64_t    fSendRecs{0};             ///< number of sent records
+         uint64_t    fRecvCalls{0};            ///< number of reads into staging buffer
+         uint64_t    fRecvRecs{0};             ///< number of received records
+
+         /** \brief Buffers and headers of zero-copy send, kept until completion notification */
+         struct ZeroCopyRec {
+            std::vector<Buffer> bufs;          ///< references on sent buffers
+            std::vector<char> headers;         ///< copy of sent headers
+            uint32_t    lastid{0};             ///< id of last sendmsg() call of operation
+            bool        sent{false};           ///< send operation completed, lastid is valid
+         };
+
+         unsigned    fZeroCopyMin{0};          ///< minimal payload of send operation to use MSG_ZEROCOPY, 0 - disabled
+         bool        fSendIsZeroCopy{false};   ///< current send operation uses MSG_ZEROCOPY
+         std::deque<ZeroCopyRec> fZeroCopyRecs; ///< not yet completed zero-copy operations
+         uint64_t    fZeroCopyCalls{0};        ///< number of zero-copy send operations
+         unsigned    fZeroCopyMaxPending{0};   ///< maximal number of pending zero-copy operations
 
          std::string fMcastAddr;   ///< mcast address
 
@@ -54,6 +94,10 @@ namespace dabc {
 
          void OnSocketError(int msg, const std::string &info) override;
 
+         void ProcessStagedData(NetworkTransport* tr);
+
+         void OnZeroCopyCompleted() override;
+
       public:
          SocketNetworkInetrface(int fd, bool datagram = false);
          virtual ~SocketNetworkInetrface();
@@ -61,6 +105,9 @@ namespace dabc {
          /** \brief Set mcast address, required to correctly close socket */
          void SetMCastAddr(const std::string addr) { fMcastAddr = addr; }
 
+         /** \brief Use MSG_ZEROCOPY for send operations with at least minsize bytes of payload */
+         bool SetZeroCopy(unsigned minsize);
+
          void AllocateNet(unsigned fulloutputqueue, unsigned fullinputqueue) override;
          void SubmitSend(uint32_t recid) override;
          void SubmitRecv(uint32_t recid) override;
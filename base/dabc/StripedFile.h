@@ -0,0 +1,73 @@
+// $Id$
+
+/************************************************************
+ * The Data Acquisition Backbone Core (DABC)                *
+ ************************************************************
+ * Copyright (C) 2009 -                                     *
+ * GSI Helmholtzzentrum fuer Schwerionenforschung GmbH      *
+ * Planckstr. 1, 64291 Darmstadt, Germany                   *
+ * Contact:  http://dabc.gsi.de                             *
+ ************************************************************
+ * This software can be used under the GPL license          *
+ * agreements as stated in LICENSE.txt file                 *
+ * which is part of the distribution.                       *
+ ************************************************************/
+
+#ifndef DABC_StripedFile
+#define DABC_StripedFile
+
+#ifndef DABC_BinaryFile
+#include "dabc/BinaryFile.h"
+#endif
+
+#include <string>
+#include <vector>
+
+namespace dabc {
+
+   /** \brief File interface, distributing data over several directories
+    *
+    * \ingroup dabc_all_classes
+    *
+    * Data stream is split into blocks of fixed size, which are written round-robin
+    * into stripe files, located in different directories (devices).
+    * Each stripe file is written by its own thread.
+    * At the place of original file name text manifest is created, which lists stripe files.
+    * When opened for reading, manifest is used to read blocks back in original order.
+    */
+
+   class StripedFileInterface : public FileInterface {
+      protected:
+         std::vector<std::string> fDirs;    ///< directories for stripe files
+         unsigned fBlockSize{0};            ///< size of single block
+         unsigned fQueueDepth{0};           ///< maximal number of blocks queued for each stripe
+
+      public:
+
+         StripedFileInterface(const std::vector<std::string> &dirs = {}, unsigned blocksize = 0x400000, unsigned depth = 4);
+
+         Handle fopen(const char *fname, const char *mode, const char * = nullptr) override;
+
+         void fclose(Handle f) override;
+
+         size_t fwrite(const void* ptr, size_t sz, size_t nmemb, Handle f) override;
+
+         size_t fread(void* ptr, size_t sz, size_t nmemb, Handle f) override;
+
+         bool feof(Handle f) override;
+
+         bool fflush(Handle f) override;
+
+         bool fseek(Handle f, long int offset, bool relative = true) override;
+
+         bool fallocate(Handle, uint64_t) override { return false; }
+
+         bool ftruncate(Handle) override { return false; }
+
+         /** Returns true if specified file is manifest of striped file */
+         static bool IsStripedFile(const std::string &fname);
+   };
+
+}
+
+#endif
@@ -337,6 +337,7 @@ namespace dabc {
          void* MainLoop() override;
 
          inline bool IsItself() const { return PosixThread::IsItself(); }
+         inline Thread_t Id() const { return PosixThread::Id(); }
          void SetPriority(int prio = 0) { PosixThread::SetPriority(prio); }
 
          // set stop timeout if required in the thread destructir
@@ -196,6 +196,14 @@ namespace dabc {
 
          static int cmd_bool(bool v) { return v ? cmd_true : cmd_false; }
 
+         /** \brief Returns true if kind of \ref CmdGetBinary request produces text from hierarchy item like get.json or dabc.xml */
+         static bool IsItemReplyKind(const std::string &binkind);
+
+         /** \brief Produce reply for get.json, dabc.json and similar requests to hierarchy item.
+          * If command with "CacheVersion" field provided, reply is not produced when item was not changed.
+          * \returns cmd_true when reply is produced, cmd_ignore when item or field does not exist */
+         static int ProduceItemReply(Hierarchy &h, std::string item, const std::string &binkind, const std::string &query, Command cmd, std::string &replybuf);
+
          enum EWorkerEventsCodes {
             evntFirstCore   = 1,    // events   1  .. 99 used only by Worker itself
             evntFirstAddOn  = 100,  // events 100 .. 199 are dedicated for specific add-ons
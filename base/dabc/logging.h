@@ -20,6 +20,8 @@
 
 #include <cstdint>
 
+#include <atomic>
+
 #ifndef DABC_string
 #include "dabc/string.h"
 #endif
@@ -37,6 +39,8 @@ namespace dabc {
    class LoggerEntry;
    class LoggerLineEntry;
    class Mutex;
+   struct LoggerRecord;
+   struct LoggerAsync;
 
    /** \brief Logging class
     *
@@ -44,9 +48,15 @@ namespace dabc {
     *
     * Accessible via dabc::lgr() function.
     *
+    * In asynchronous mode (see \ref StartAsync) messages are placed into per-thread ring buffers
+    * without any locking and written by separate logger thread. Frequent messages from same call site
+    * are dropped before they placed into ring buffer.
     */
 
    class Logger {
+
+      friend struct LoggerAsync;
+
       public:
          enum EShowInfo {
             lPrefix  = 0x0001,  // show configured debug prefix
@@ -97,12 +107,26 @@ namespace dabc {
          /** \brief Close any file open by logger */
          void CloseFile();
 
+         /** \brief Switch to asynchronous mode, ringsize is number of messages in ring buffer of each thread */
+         bool StartAsync(unsigned ringsize = 1024);
+
+         /** \brief Stop asynchronous mode, all collected messages are written */
+         void StopAsync();
+
+         bool IsAsync() const { return fAsync.load(std::memory_order_relaxed); }
+
+         /** \brief Write all messages collected in ring buffers, called also when process crashes */
+         static void Flush();
+
          static void CheckTimeout();
 
          static void DisableLogReopen();
 
          static inline Logger* Instance() { return gDebug; }
 
+         /** \brief Returns true if message of given level will be shown, used to skip formatting of the message */
+         static inline bool IsEnabled(int level) { return Instance() && (level <= Instance()->fLevel); }
+
          static inline void Debug(int level, const char *filename, unsigned linenumber, const char *funcname, const char *message)
          {
             if (Instance() && (level <= Instance()->fLevel))
@@ -115,6 +139,14 @@ namespace dabc {
 
          virtual void DoOutput(int level, const char *filename, unsigned linenumber, const char *funcname, const char *message);
 
+         void PushAsync(int level, const char *filename, unsigned linenumber, const char *funcname, const char *message);
+
+         LoggerEntry *_GetEntry(int level, const char *filename, unsigned linenumber, const char *funcname);
+
+         void _OutputEntry(int level, LoggerEntry* entry, bool drop_msg, bool doflush, std::string &syslogout);
+
+         void _WriteRecord(LoggerRecord &rec);
+
          void _ExtendLines(unsigned max);
 
          void _FillString(std::string& str, unsigned mask, LoggerEntry* entry);
@@ -141,10 +173,12 @@ namespace dabc {
          bool              fLogFileModified{false};   // true if any string was written into file
          unsigned          fLogLimit{0};              // maximum number of log messages before drop
          bool              fLogReopenDisabled{false}; // disable file reopen when doing shutdown
+         std::atomic<bool> fAsync{false};             // asynchronous mode is active
    };
 
+   // message formatted only when it will be shown
    #define DOUT(level, args ... ) \
-     dabc::Logger::Debug(level, __FILE__, __LINE__, __func__, dabc::format( args ).c_str())
+     (dabc::Logger::IsEnabled(level) ? dabc::Logger::Debug(level, __FILE__, __LINE__, __func__, dabc::format( args ).c_str()) : (void) 0)
 
    #if DEBUGLEVEL > -2
       #define EOUT( args ... ) DOUT(-1, args )
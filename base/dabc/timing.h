@@ -25,6 +25,7 @@
 namespace dabc {
 
    class Profiler;
+   class ProfilerTrace;
 
    /** \brief Class for acquiring and holding timestamps.
     *
@@ -42,6 +43,7 @@ namespace dabc {
    struct TimeStamp {
 
       friend class Profiler;
+      friend class ProfilerTrace;
 
       protected:
          double fValue{0};  ///< time since start of the application in seconds
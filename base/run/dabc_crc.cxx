@@ -0,0 +1,114 @@
+// $Id$
+
+/************************************************************
+ * The Data Acquisition Backbone Core (DABC)                *
+ ************************************************************
+ * Copyright (C) 2009 -                                     *
+ * GSI Helmholtzzentrum fuer Schwerionenforschung GmbH      *
+ * Planckstr. 1, 64291 Darmstadt, Germany                   *
+ * Contact:  http://dabc.gsi.de                             *
+ ************************************************************
+ * This software can be used under the GPL license          *
+ * agreements as stated in LICENSE.txt file                 *
+ * which is part of the distribution.                       *
+ ************************************************************/
+
+#include "dabc/Checksum.h"
+#include "dabc/timing.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+
+int usage(const char *errstr = nullptr)
+{
+   if (errstr) printf("Error: %s\n\n", errstr);
+
+   printf("Utility for CRC32C checksums of DABC data files\n");
+   printf("   dabc_crc file.hld [file2.lmd ...] - verify files against checksums in .crc side files\n");
+   printf("   dabc_crc -bench [sizeMB]          - measure checksum throughput\n");
+
+   return errstr ? 1 : 0;
+}
+
+int bench(unsigned sizemb)
+{
+   std::vector<char> buf(sizemb * 1024 * 1024);
+   for (size_t n = 0; n < buf.size(); n++)
+      buf[n] = (char) (n * 7 + (n >> 11));
+
+   printf("Hardware CRC32C instructions: %s\n", dabc::crc32c_hw() ? "available" : "not available");
+
+   for (int kind = 0; kind < 2; kind++) {
+      if ((kind == 0) && !dabc::crc32c_hw()) continue;
+
+      dabc::TimeStamp tm = dabc::Now();
+      uint32_t crc = 0;
+      unsigned cnt = 0;
+      do {
+         crc = (kind == 0) ? dabc::crc32c(0, buf.data(), buf.size()) : dabc::crc32c_sw(0, buf.data(), buf.size());
+         cnt++;
+      } while (tm.SpentTillNow() < 1.);
+
+      double spent = tm.SpentTillNow();
+
+      printf("%8s  crc %08x  %8.1f MB/s\n", (kind == 0 ? "hardware" : "table"), (unsigned) crc, cnt * sizemb / spent);
+   }
+
+   return 0;
+}
+
+int verify(const char *fname)
+{
+   std::string crcname = dabc::ChecksumFileInterface::ChecksumFileName(fname);
+   FILE *f = fopen(crcname.c_str(), "r");
+   if (!f) {
+      printf("%s: checksum file %s not found\n", fname, crcname.c_str());
+      return 1;
+   }
+   fclose(f);
+
+   dabc::ChecksumFileInterface io(nullptr, true);
+
+   auto fd = io.fopen(fname, "r");
+   if (!fd) {
+      printf("%s: cannot open\n", fname);
+      return 1;
+   }
+
+   std::vector<char> buf(0x400000);
+   uint64_t total = 0;
+   size_t res;
+   dabc::TimeStamp tm = dabc::Now();
+
+   while ((res = io.fread(buf.data(), 1, buf.size(), fd)) > 0)
+      total += res;
+
+   bool failure = io.GetFileIntPar(fd, "CrcFailure") != 0;
+   io.fclose(fd);
+
+   double spent = tm.SpentTillNow();
+
+   printf("%s: %s  %lu bytes  %5.1f MB/s\n", fname, failure ? "FAILED" : "OK",
+          (long unsigned) total, spent > 0 ? total / spent / 1024. / 1024. : 0.);
+
+   return failure ? 2 : 0;
+}
+
+int main(int argc, char* argv[])
+{
+   if ((argc < 2) || !strcmp(argv[1], "-help") || !strcmp(argv[1], "?")) return usage();
+
+   if (!strcmp(argv[1], "-bench")) {
+      unsigned sizemb = argc > 2 ? atoi(argv[2]) : 0;
+      return bench(sizemb > 0 ? sizemb : 64);
+   }
+
+   int res = 0;
+   for (int n = 1; n < argc; n++)
+      res = std::max(res, verify(argv[n]));
+
+   return res;
+}
@@ -20,6 +20,7 @@
 #include "dabc/Manager.h"
 #include "dabc/Configuration.h"
 #include "dabc/Url.h"
+#include "dabc/Profiler.h"
 
 dabc::Application::Application(const char *classname) :
    Worker(dabc::mgr(), xmlAppDfltName),
@@ -38,6 +39,12 @@ dabc::Application::Application(const char *classname) :
    CreateCmdDef(stcmdDoStop());
    CreateCmdDef(stcmdDoHalt());
 
+#ifdef DABC_PROFILER
+   CreateCmdDef("ProfilerTrace").AddArg("action", "string", true, "dump")
+                                .AddArg("file", "string", false, "dabc-trace.json")
+                                .AddArg("ringsize", "int", false, 65536);
+#endif
+
    SetAppState(stHalted());
 
    fSelfControl = Cfg("self").AsBool(true);
@@ -104,6 +111,48 @@ int dabc::Application::ExecuteCommand(dabc::Command cmd)
    if (cmd.IsName(stcmdDoHalt()))
       return DoTransition(stHalted(), cmd);
 
+#ifdef DABC_PROFILER
+   if (cmd.IsName("ProfilerTrace")) {
+      // action can be start, stop or dump
+      std::string action = cmd.GetStr("action", "dump");
+
+      if (action == "start") {
+         ProfilerTrace::Start(cmd.GetUInt("ringsize", 65536));
+         return cmd_true;
+      }
+
+      if (action == "stop") {
+         ProfilerTrace::Stop();
+         return cmd_true;
+      }
+
+      if (action != "dump") return cmd_false;
+
+      unsigned numevents = 0;
+      std::string json = ProfilerTrace::MakeJSON(&numevents);
+      std::string fname = cmd.GetStr("file");
+
+      cmd.SetUInt("events", numevents);
+
+      // without file name trace delivered with command itself
+      if (fname.empty()) {
+         cmd.SetStr("json", json);
+         return cmd_true;
+      }
+
+      FILE *f = fopen(fname.c_str(), "w");
+      if (!f) {
+         EOUT("Cannot create profiler trace file %s", fname.c_str());
+         return cmd_false;
+      }
+      fwrite(json.c_str(), 1, json.length(), f);
+      fclose(f);
+
+      DOUT0("Profiler trace with %u events saved to %s", numevents, fname.c_str());
+      return cmd_true;
+   }
+#endif
+
    if (cmd.IsName("AddAppObject")) {
       if (cmd.GetStr("kind") == "device")
          fAppDevices.emplace_back(cmd.GetStr("name"));
@@ -22,9 +22,12 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <cstring>
+#include <fcntl.h>
 
 #include "dabc/Object.h"
 #include "dabc/logging.h"
+#include "dabc/Checksum.h"
+#include "dabc/PrefetchFile.h"
 
 bool dabc::FileInterface::mkdir(const char *path)
 {
@@ -57,6 +60,26 @@ bool dabc::FileInterface::mkdir(const char *path)
 }
 
 
+bool dabc::FileInterface::fallocate(Handle f, uint64_t size)
+{
+   if (!f || (size == 0)) return false;
+
+#if defined(__MACH__)
+   return false;
+#else
+   return posix_fallocate(fileno((FILE *) f), 0, size) == 0;
+#endif
+}
+
+bool dabc::FileInterface::ftruncate(Handle f)
+{
+   if (!f || (::fflush((FILE *) f) != 0)) return false;
+
+   long pos = ::ftell((FILE *) f);
+
+   return (pos >= 0) && (::ftruncate(fileno((FILE *) f), pos) == 0);
+}
+
 dabc::Object *dabc::FileInterface::fmatch(const char *fmask, bool select_files)
 {
    if (!fmask || (*fmask == 0)) return nullptr;
@@ -107,3 +130,26 @@ dabc::Object *dabc::FileInterface::fmatch(const char *fmask, bool select_files)
 
    return res;
 }
+
+void dabc::BasicFile::EnableChecksum()
+{
+   if (dynamic_cast<ChecksumFileInterface *>(io)) return;
+
+   CheckIO();
+
+   io = new ChecksumFileInterface(io, iowoner);
+   iowoner = true;
+}
+
+dabc::PrefetchFileInterface *dabc::BasicFile::EnablePrefetch(unsigned depth, unsigned blocksize)
+{
+   auto prefetch = dynamic_cast<PrefetchFileInterface *>(io);
+   if (prefetch) return prefetch;
+
+   CheckIO();
+
+   prefetch = new PrefetchFileInterface(io, iowoner, depth, blocksize);
+   io = prefetch;
+   iowoner = true;
+   return prefetch;
+}
@@ -21,6 +21,7 @@ dabc::BinaryFileInput::BinaryFileInput(const dabc::Url& url) :
    fCurrentBufSize(0),
    fCurrentBufType(0)
 {
+   ConfigureFile(fFile);
 }
 
 dabc::BinaryFileInput::~BinaryFileInput()
@@ -50,6 +51,8 @@ bool dabc::BinaryFileInput::OpenNextFile()
 
    DOUT1("Open bin file %s for reading", CurrentFileName().c_str());
 
+   PrepareNextFile();
+
    return true;
 }
 
@@ -126,6 +129,9 @@ bool dabc::BinaryFileOutput::Write_Init(const dabc::WorkerRef& wrk, const dabc::
 
    fFile.SetIO(fIO, false);
 
+   if (fChecksum)
+      fFile.EnableChecksum();
+
    return StartNewFile();
 }
 
@@ -126,7 +126,7 @@ void dabc::Buffer::SetTotalSize(BufferSize_t len)
 
    if (nseg<NumSegments()) {
 
-      dabc::MemoryPool* pool = (dabc::MemoryPool*) GetObject()->fPool();
+      dabc::MemoryPool* pool = dynamic_cast<dabc::MemoryPool*> (GetObject()->fPool());
 
       if (pool)
          pool->DecreaseSegmRefs(Segments()+nseg, NumSegments() - nseg);
@@ -446,6 +446,20 @@ dabc::Buffer dabc::Buffer::CreateBuffer(const void* ptr, unsigned size, bool own
    return res;
 }
 
+dabc::Buffer dabc::Buffer::CreateBuffer(const void* ptr, unsigned size, const Reference &keeper) throw()
+{
+   dabc::Buffer res;
+
+   res.AllocateContainer(8);
+
+   res.GetObject()->fPool = keeper;
+   res.GetObject()->fNumSegments = 1;
+   res.GetObject()->fSegm[0].buffer = (void*) ptr;
+   res.GetObject()->fSegm[0].datasize = size;
+
+   return res;
+}
+
 
 bool dabc::Buffer::CanSafelyChange() const
 {
@@ -0,0 +1,561 @@
+// $Id$
+
+/************************************************************
+ * The Data Acquisition Backbone Core (DABC)                *
+ ************************************************************
+ * Copyright (C) 2009 -                                     *
+ * GSI Helmholtzzentrum fuer Schwerionenforschung GmbH      *
+ * Planckstr. 1, 64291 Darmstadt, Germany                   *
+ * Contact:  http://dabc.gsi.de                             *
+ ************************************************************
+ * This software can be used under the GPL license          *
+ * agreements as stated in LICENSE.txt file                 *
+ * which is part of the distribution.                       *
+ ************************************************************/
+
+#include "dabc/Checksum.h"
+
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <vector>
+
+#include "dabc/logging.h"
+#include "dabc/string.h"
+#include "dabc/threads.h"
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__) && defined(__linux__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+namespace dabc {
+
+   /** Tables for slicing-by-8 CRC32C calculation, reflected polynomial 0x82F63B78 */
+   struct Crc32cTables {
+      uint32_t t[8][256];
+
+      Crc32cTables()
+      {
+         for (unsigned n = 0; n < 256; n++) {
+            uint32_t crc = n;
+            for (int k = 0; k < 8; k++)
+               crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78 : crc >> 1;
+            t[0][n] = crc;
+         }
+         for (unsigned n = 0; n < 256; n++)
+            for (int k = 1; k < 8; k++)
+               t[k][n] = (t[k-1][n] >> 8) ^ t[0][t[k-1][n] & 0xff];
+      }
+   };
+
+#if defined(__x86_64__)
+
+   __attribute__((target("sse4.2")))
+   static uint32_t crc32c_hwimpl(uint32_t crc, const void *buf, size_t len)
+   {
+      const unsigned char *p = (const unsigned char *) buf;
+      uint64_t c = ~crc;
+
+      while (len && ((uintptr_t) p & 7)) {
+         c = _mm_crc32_u8(c, *p++);
+         len--;
+      }
+      while (len >= 8) {
+         uint64_t v;
+         memcpy(&v, p, 8);
+         c = _mm_crc32_u64(c, v);
+         p += 8;
+         len -= 8;
+      }
+      while (len--)
+         c = _mm_crc32_u8(c, *p++);
+
+      return ~((uint32_t) c);
+   }
+
+   static bool crc32c_detect() { return __builtin_cpu_supports("sse4.2"); }
+
+#elif defined(__aarch64__) && defined(__linux__)
+
+   __attribute__((target("+crc")))
+   static uint32_t crc32c_hwimpl(uint32_t crc, const void *buf, size_t len)
+   {
+      const unsigned char *p = (const unsigned char *) buf;
+      uint32_t c = ~crc;
+
+      while (len && ((uintptr_t) p & 7)) {
+         c = __crc32cb(c, *p++);
+         len--;
+      }
+      while (len >= 8) {
+         uint64_t v;
+         memcpy(&v, p, 8);
+         c = __crc32cd(c, v);
+         p += 8;
+         len -= 8;
+      }
+      while (len--)
+         c = __crc32cb(c, *p++);
+
+      return ~c;
+   }
+
+   static bool crc32c_detect() { return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0; }
+
+#else
+
+   static uint32_t crc32c_hwimpl(uint32_t crc, const void *buf, size_t len) { return crc32c_sw(crc, buf, len); }
+
+   static bool crc32c_detect() { return false; }
+
+#endif
+
+   static bool gCrc32cHw = crc32c_detect();
+
+   /** \brief Write-behind thread, calculating checksums and writing data
+    *
+    * Output thread only copies data into blocks, checksum calculation and
+    * writing of data and side file performed by this thread */
+
+   class ChecksumWriter {
+      public:
+         Mutex                 fMutex;
+         Condition             fJobCond;          ///< fired when new block is queued
+         Condition             fSpaceCond;        ///< fired when block is written
+         PosixThread           fThrd;
+         FileInterface        *fIO{nullptr};      ///< interface doing real I/O
+         FileInterface::Handle fFile{nullptr};    ///< data file
+         FileInterface::Handle fCrcFile{nullptr}; ///< side file with checksums
+         unsigned              fBlockSize{0};
+         uint32_t              fCrc{0};           ///< checksum of current block
+         unsigned              fFill{0};          ///< bytes in current block
+         std::list<std::vector<char>> fQueue;     ///< data to write, first entry is written now
+         std::list<std::vector<char>> fFree;      ///< already written entries, can be reused
+         unsigned              fDepth{0};
+         bool                  fStop{false};
+         bool                  fError{false};
+
+         ChecksumWriter(FileInterface *io, FileInterface::Handle f, FileInterface::Handle crcf, unsigned blocksize, unsigned depth) :
+            fMutex(), fJobCond(&fMutex), fSpaceCond(&fMutex), fIO(io), fFile(f), fCrcFile(crcf), fBlockSize(blocksize), fDepth(depth)
+         {
+            fThrd.Start(ChecksumWriter::RunFunc, this);
+            fThrd.SetThreadName("CrcWriter");
+         }
+
+         /** Stop thread, write checksum of last partial block. Returns false if any write error happened */
+         bool Stop()
+         {
+            {
+               LockGuard lock(fMutex);
+               fStop = true;
+               fJobCond._DoFire();
+            }
+            fThrd.Join();
+            if (fFill > 0) WriteCrc();
+            return !fError;
+         }
+
+         /** Take entry which can be filled, reuse memory when possible */
+         void TakeFree(std::vector<char> &blk)
+         {
+            LockGuard lock(fMutex);
+            if (!fFree.empty()) {
+               blk.swap(fFree.front());
+               fFree.pop_front();
+            }
+            blk.clear();
+         }
+
+         /** Queue data for writing, blocks when too many entries are queued */
+         bool Push(std::vector<char> &blk)
+         {
+            LockGuard lock(fMutex);
+            while ((fQueue.size() >= fDepth) && !fError)
+               fSpaceCond._DoWait(-1);
+            if (fError) return false;
+            fQueue.emplace_back();
+            fQueue.back().swap(blk);
+            fJobCond._DoFire();
+            return true;
+         }
+
+         /** Wait until all queued data are written */
+         bool Drain()
+         {
+            LockGuard lock(fMutex);
+            while (!fQueue.empty() && !fError)
+               fSpaceCond._DoWait(-1);
+            return !fError;
+         }
+
+         bool WriteCrc()
+         {
+            std::string line = dabc::format("%08x\n", (unsigned) fCrc);
+            fCrc = 0;
+            fFill = 0;
+            return fIO->fwrite(line.c_str(), line.length(), 1, fCrcFile) == 1;
+         }
+
+         bool Process(const std::vector<char> &blk)
+         {
+            const char *src = blk.data();
+            size_t total = blk.size();
+            bool ok = true;
+
+            while (total > 0) {
+               size_t portion = fBlockSize - fFill;
+               if (portion > total) portion = total;
+               fCrc = crc32c(fCrc, src, portion);
+               fFill += portion;
+               src += portion;
+               total -= portion;
+
+               if ((fFill == fBlockSize) && !WriteCrc()) ok = false;
+            }
+
+            return (fIO->fwrite(blk.data(), blk.size(), 1, fFile) == 1) && ok;
+         }
+
+         static void *RunFunc(void *args)
+         {
+            ChecksumWriter *w = (ChecksumWriter *) args;
+
+            while (true) {
+               std::vector<char> *blk = nullptr;
+               {
+                  LockGuard lock(w->fMutex);
+                  while (w->fQueue.empty() && !w->fStop)
+                     w->fJobCond._DoWait(-1);
+                  if (w->fQueue.empty()) break;
+                  blk = &w->fQueue.front();
+               }
+
+               bool ok = w->Process(*blk);
+
+               LockGuard lock(w->fMutex);
+               if (!ok) {
+                  EOUT("Fail to write %u bytes with checksum", (unsigned) blk->size());
+                  w->fError = true;
+               }
+               w->fFree.splice(w->fFree.end(), w->fQueue, w->fQueue.begin());
+               if (w->fFree.size() > 2) w->fFree.pop_front();
+               w->fSpaceCond._DoFire();
+            }
+
+            return nullptr;
+         }
+   };
+
+   /** \brief Handle of file opened via \ref ChecksumFileInterface */
+
+   struct ChecksumHandle {
+      FileInterface::Handle fFile{nullptr};   ///< data file
+      FileInterface::Handle fCrcFile{nullptr}; ///< side file with checksums, used when writing
+      ChecksumWriter       *fWriter{nullptr}; ///< write-behind thread, used when writing
+      std::vector<char>     fBlock;           ///< data collected for the writer
+      bool                  fReading{false};
+      unsigned              fBlockSize{0};
+      uint32_t              fCrc{0};          ///< checksum of current block, used when reading
+      unsigned              fFill{0};         ///< bytes in current block, used when reading
+      uint64_t              fPos{0};          ///< position in data file when reading
+      uint64_t              fVerified{0};     ///< data up to this position are verified
+      std::vector<uint32_t> fCrcs;            ///< stored checksums, used when reading
+      bool                  fVerify{false};   ///< verification is active
+      bool                  fFailure{false};  ///< checksum mismatch detected
+   };
+
+}
+
+uint32_t dabc::crc32c_sw(uint32_t crc, const void *buf, size_t len)
+{
+   static Crc32cTables tables;
+   const uint32_t (*t)[256] = tables.t;
+
+   const unsigned char *p = (const unsigned char *) buf;
+   uint32_t c = ~crc;
+
+   while (len && ((uintptr_t) p & 7)) {
+      c = t[0][(c ^ *p++) & 0xff] ^ (c >> 8);
+      len--;
+   }
+
+   while (len >= 8) {
+      uint32_t lo, hi;
+      memcpy(&lo, p, 4);
+      memcpy(&hi, p + 4, 4);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+      lo = __builtin_bswap32(lo);
+      hi = __builtin_bswap32(hi);
+#endif
+      lo ^= c;
+      c = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+          t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+      p += 8;
+      len -= 8;
+   }
+
+   while (len--)
+      c = t[0][(c ^ *p++) & 0xff] ^ (c >> 8);
+
+   return ~c;
+}
+
+uint32_t dabc::crc32c(uint32_t crc, const void *buf, size_t len)
+{
+   return gCrc32cHw ? crc32c_hwimpl(crc, buf, len) : crc32c_sw(crc, buf, len);
+}
+
+bool dabc::crc32c_hw()
+{
+   return gCrc32cHw;
+}
+
+// ==================================================================
+
+dabc::ChecksumFileInterface::ChecksumFileInterface(FileInterface *inner, bool owner, unsigned blocksize, unsigned depth) :
+   FileInterface(),
+   fInner(inner),
+   fInnerOwner(owner),
+   fBlockSize(blocksize < 0x1000 ? 0x1000 : blocksize),
+   fQueueDepth(depth < 1 ? 1 : depth)
+{
+   if (!fInner) {
+      fInner = new FileInterface;
+      fInnerOwner = true;
+   }
+}
+
+dabc::ChecksumFileInterface::~ChecksumFileInterface()
+{
+   if (fInnerOwner) delete fInner;
+   fInner = nullptr;
+}
+
+dabc::FileInterface::Handle dabc::ChecksumFileInterface::fopen(const char *fname, const char *mode, const char *opt)
+{
+   if (!fname || !mode) return nullptr;
+
+   Handle f = fInner->fopen(fname, mode, opt);
+   if (!f) return nullptr;
+
+   ChecksumHandle *h = new ChecksumHandle;
+   h->fFile = f;
+   h->fReading = (*mode == 'r');
+   h->fBlockSize = fBlockSize;
+
+   std::string crcname = ChecksumFileName(fname);
+
+   if (!h->fReading) {
+      h->fCrcFile = fInner->fopen(crcname.c_str(), "w", opt);
+      if (!h->fCrcFile) {
+         EOUT("Cannot create checksum file %s", crcname.c_str());
+         fInner->fclose(f);
+         delete h;
+         return nullptr;
+      }
+      std::string line = dabc::format("# DABC crc32c %u\n", h->fBlockSize);
+      fInner->fwrite(line.c_str(), line.length(), 1, h->fCrcFile);
+      h->fWriter = new ChecksumWriter(fInner, f, h->fCrcFile, h->fBlockSize, fQueueDepth);
+      h->fBlock.reserve(h->fBlockSize);
+      return h;
+   }
+
+   Handle crcf = fInner->fopen(crcname.c_str(), "r", opt);
+   if (!crcf) {
+      EOUT("Checksum file %s not found, data will not be verified", crcname.c_str());
+      return h;
+   }
+
+   std::string content;
+   char sbuf[4096];
+   size_t len;
+   while ((len = fInner->fread(sbuf, 1, sizeof(sbuf), crcf)) > 0)
+      content.append(sbuf, len);
+   fInner->fclose(crcf);
+
+   unsigned blocksize = 0;
+   if (sscanf(content.c_str(), "# DABC crc32c %u", &blocksize) != 1 || (blocksize == 0)) {
+      EOUT("Wrong format of checksum file %s", crcname.c_str());
+      return h;
+   }
+
+   h->fBlockSize = blocksize;
+   size_t pos = content.find('\n');
+   while ((pos != std::string::npos) && (pos + 1 < content.length())) {
+      unsigned value = 0;
+      if (sscanf(content.c_str() + pos + 1, "%x", &value) == 1)
+         h->fCrcs.emplace_back(value);
+      pos = content.find('\n', pos + 1);
+   }
+
+   h->fVerify = true;
+
+   return h;
+}
+
+void dabc::ChecksumFileInterface::fclose(Handle f)
+{
+   ChecksumHandle *h = (ChecksumHandle *) f;
+   if (!h) return;
+
+   if (h->fWriter) {
+      if (!h->fBlock.empty())
+         h->fWriter->Push(h->fBlock);
+      if (!h->fWriter->Stop())
+         EOUT("Failure when writing file with checksums");
+      delete h->fWriter;
+   }
+
+   if (h->fCrcFile)
+      fInner->fclose(h->fCrcFile);
+
+   fInner->fclose(h->fFile);
+
+   delete h;
+}
+
+size_t dabc::ChecksumFileInterface::fwrite(const void* ptr, size_t sz, size_t nmemb, Handle f)
+{
+   ChecksumHandle *h = (ChecksumHandle *) f;
+   if (!h || !ptr || !h->fWriter) return 0;
+
+   const char *src = (const char *) ptr;
+   size_t total = sz * nmemb;
+
+   while (total > 0) {
+      size_t portion = h->fBlockSize - h->fBlock.size();
+      if (portion > total) portion = total;
+      h->fBlock.insert(h->fBlock.end(), src, src + portion);
+      src += portion;
+      total -= portion;
+
+      if (h->fBlock.size() == h->fBlockSize) {
+         if (!h->fWriter->Push(h->fBlock)) return 0;
+         h->fWriter->TakeFree(h->fBlock);
+         h->fBlock.reserve(h->fBlockSize);
+      }
+   }
+
+   return nmemb;
+}
+
+bool dabc::ChecksumFileInterface::CheckBlock(void *handle)
+{
+   ChecksumHandle *h = (ChecksumHandle *) handle;
+
+   uint64_t nblock = (h->fVerified - 1) / h->fBlockSize;
+   if ((nblock >= h->fCrcs.size()) || (h->fCrcs[nblock] != h->fCrc)) {
+      EOUT("CRC32C mismatch in block %lu", (long unsigned) nblock);
+      h->fFailure = true;
+      return false;
+   }
+   h->fCrc = 0;
+   h->fFill = 0;
+   return true;
+}
+
+size_t dabc::ChecksumFileInterface::fread(void* ptr, size_t sz, size_t nmemb, Handle f)
+{
+   ChecksumHandle *h = (ChecksumHandle *) f;
+   if (!h || !ptr || !h->fReading || h->fFailure) return 0;
+
+   size_t res = fInner->fread(ptr, sz, nmemb, h->fFile);
+   size_t len = res * sz;
+   const char *src = (const char *) ptr;
+
+   if (h->fVerify && (h->fPos + len > h->fVerified)) {
+      // only data which were not yet verified are accounted
+      size_t skip = h->fVerified - h->fPos;
+      src += skip;
+      len -= skip;
+
+      while (len > 0) {
+         size_t portion = h->fBlockSize - h->fFill;
+         if (portion > len) portion = len;
+         h->fCrc = crc32c(h->fCrc, src, portion);
+         h->fFill += portion;
+         h->fVerified += portion;
+         src += portion;
+         len -= portion;
+
+         if ((h->fFill == h->fBlockSize) && !CheckBlock(h)) return 0;
+      }
+   }
+
+   // last partial block is verified when end of file is reached
+   if (h->fVerify && (h->fFill > 0) && (res < nmemb) && fInner->feof(h->fFile) && !CheckBlock(h))
+      return 0;
+
+   h->fPos += res * sz;
+
+   return res;
+}
+
+bool dabc::ChecksumFileInterface::feof(Handle f)
+{
+   ChecksumHandle *h = (ChecksumHandle *) f;
+   return h ? fInner->feof(h->fFile) : false;
+}
+
+bool dabc::ChecksumFileInterface::fflush(Handle f)
+{
+   ChecksumHandle *h = (ChecksumHandle *) f;
+   if (!h) return false;
+   if (h->fWriter) {
+      if (!h->fBlock.empty()) {
+         if (!h->fWriter->Push(h->fBlock)) return false;
+         h->fWriter->TakeFree(h->fBlock);
+         h->fBlock.reserve(h->fBlockSize);
+      }
+      if (!h->fWriter->Drain()) return false;
+      fInner->fflush(h->fCrcFile);
+   }
+   return fInner->fflush(h->fFile);
+}
+
+bool dabc::ChecksumFileInterface::fseek(Handle f, long int offset, bool relative)
+{
+   ChecksumHandle *h = (ChecksumHandle *) f;
+   if (!h || !h->fReading || !fInner->fseek(h->fFile, offset, relative)) return false;
+
+   h->fPos = relative ? h->fPos + offset : offset;
+
+   if (h->fVerify && (h->fPos > h->fVerified)) {
+      DOUT1("Data skipped when reading file, checksum verification disabled");
+      h->fVerify = false;
+   }
+
+   return true;
+}
+
+bool dabc::ChecksumFileInterface::fallocate(Handle f, uint64_t size)
+{
+   ChecksumHandle *h = (ChecksumHandle *) f;
+   return h ? fInner->fallocate(h->fFile, size) : false;
+}
+
+bool dabc::ChecksumFileInterface::ftruncate(Handle f)
+{
+   ChecksumHandle *h = (ChecksumHandle *) f;
+   if (!h) return false;
+   // file truncated at current position, therefore all data must be written before
+   if (h->fWriter && !fflush(f)) return false;
+   return fInner->ftruncate(h->fFile);
+}
+
+int dabc::ChecksumFileInterface::GetFileIntPar(Handle f, const char *parname)
+{
+   ChecksumHandle *h = (ChecksumHandle *) f;
+   if (h && parname && !strcmp(parname, "CrcFailure")) return h->fFailure ? 1 : 0;
+   return fInner->GetFileIntPar(h ? h->fFile : nullptr, parname);
+}
+
+bool dabc::ChecksumFileInterface::GetFileStrPar(Handle f, const char *parname, char* sbuf, int sbuflen)
+{
+   ChecksumHandle *h = (ChecksumHandle *) f;
+   return fInner->GetFileStrPar(h ? h->fFile : nullptr, parname, sbuf, sbuflen);
+}
@@ -37,6 +37,8 @@ namespace dabc {
    const char *xmlDeviceAttr       = "device";
    const char *xmlThreadAttr       = "thread";
    const char *xmlUseacknAttr      = "useackn";
+   const char *xmlShmAttr          = "shm";
+   const char *xmlCompressAttr     = "compress";
    const char *xmlOptionalAttr     = "optional";
    const char *xmlPoolAttr         = "pool";
    const char *xmlTimeoutAttr      = "timeout";
@@ -67,6 +69,7 @@ namespace dabc {
    const char *xmlNoDebugPrefix    = "nodebugprefix";
    const char *xmlLogfile          = "logfile";
    const char *xmlLoglimit         = "loglimit";
+   const char *xmlAsyncLog         = "asynclog";
    const char *xmlLoglevel         = "loglevel";
    const char *xmlSysloglevel      = "sysloglevel";
    const char *xmlSyslog           = "syslog";
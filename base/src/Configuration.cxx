@@ -113,8 +113,29 @@ bool dabc::Configuration::SelectContext(unsigned nodeid, unsigned numnodes)
       dabc::Logger::Instance()->Syslog(syslog.c_str());
 
    log = Find1(fSelected, "", xmlRunNode, xmlLoglimit);
-   if (log.length()>0)
-      dabc::Logger::Instance()->SetLogLimit(std::stoi(log));
+   if (log.length()>0) {
+      long long unsigned limit = 0;
+      if (dabc::str_to_lluint(log.c_str(), &limit))
+         dabc::Logger::Instance()->SetLogLimit(limit > 0xffffffffLLU ? 0xffffffffU : (unsigned) limit);
+      else
+         EOUT("Wrong loglimit value %s", log.c_str());
+   }
+
+   // value is true/yes/on, false/no/off or size of ring buffer of each thread
+   log = Find1(fSelected, "", xmlRunNode, xmlAsyncLog);
+   if (!log.empty()) {
+      int ringsize = 0;
+      bool enabled = false;
+      if (dabc::str_to_int(log.c_str(), &ringsize)) {
+         enabled = ringsize > 0;
+      } else if (!dabc::str_to_bool(log.c_str(), &enabled)) {
+         enabled = (log == "yes") || (log == "on");
+         if (!enabled && (log != "no") && (log != "off"))
+            EOUT("Wrong asynclog value %s, use true/false or ring buffer size", log.c_str());
+      }
+      if (enabled)
+         dabc::Logger::Instance()->StartAsync(ringsize > 0 ? ringsize : 1024);
+   }
 
    fLocalHost = Find1(fSelected, "", xmlRunNode, xmlSocketHost);
 
@@ -486,6 +486,8 @@ bool dabc::ConnectionManager::FillAnswerOnRemoteConnectCmd(Command cmd, Connecti
       cmd.SetInt("ServerInlineSize", req.GetInlineDataSize());
       cmd.SetDouble("ServerTimeout", req.GetConnTimeout());
       cmd.SetBool(dabc::xmlUseAcknowledge, req.GetUseAckn());
+      cmd.SetBool(dabc::xmlShmAttr, req.GetUseShm());
+      cmd.SetInt(dabc::xmlCompressAttr, req.GetCompress());
 
    } else {
       // should not happened
@@ -551,6 +553,9 @@ void dabc::ConnectionManager::HandleCmdGlobalConnectReply(CmdGlobalConnect cmd)
             req.SetConnTimeoutDirectly(cmd.GetDouble("ServerTimeout", 10.));
             // this acknowledge parameter of protocol, one can later code it inside serverid
             req.SetUseAcknDirectly(cmd.GetBool(dabc::xmlUseAcknowledge, false));
+            // client can use shared memory only when server allows it
+            req.SetUseShmDirectly(cmd.GetBool(dabc::xmlShmAttr, false));
+            req.SetCompressDirectly(cmd.GetInt(dabc::xmlCompressAttr, 0));
 
             int inlinesize = cmd.GetInt("ServerInlineSize");
             if (inlinesize != req.GetInlineDataSize()) {
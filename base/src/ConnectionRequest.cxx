@@ -140,6 +140,21 @@ void dabc::ConnectionRequest::SetConfigFromXml(XMLNodePointer_t node)
       SetUseAckn(strcmp(useackn, xmlTrueValue) == 0);
    }
 
+   const char *useshm = Xml::GetAttr(node, xmlShmAttr);
+   if (useshm) {
+      SetAllowedField(xmlShmAttr);
+      SetUseShm(strcmp(useshm, xmlTrueValue) == 0);
+   }
+
+   const char *compress = Xml::GetAttr(node, xmlCompressAttr);
+   if (compress) {
+      int level = 0;
+      if (strcmp(compress, xmlTrueValue) == 0) level = 1;
+      else if (!str_to_int(compress, &level)) EOUT("Wrong compress value %s", compress);
+      SetAllowedField(xmlCompressAttr);
+      SetCompress(level);
+   }
+
    const char *isserver = Xml::GetAttr(node, "server");
    if (isserver) {
       SetAllowedField("server");
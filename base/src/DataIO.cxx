@@ -17,6 +17,8 @@
 
 #include "dabc/Manager.h"
 #include "dabc/BinaryFile.h"
+#include "dabc/StripedFile.h"
+#include "dabc/PrefetchFile.h"
 
 #include <fstream>
 
@@ -112,8 +114,13 @@ dabc::FileInput::FileInput(const dabc::Url& url) :
    fCurrentName(),
    fLoop(url.HasOption("loop")),
    fCloseOnError(url.HasOption("close_on_error")),
-   fReduce(url.GetOptionDouble("reduce",1.))
+   fReduce(url.GetOptionDouble("reduce",1.)),
+   fChecksum(url.HasOption("crc")),
+   fPrefetchNext(url.HasOption("prefetchnext"))
 {
+   if (url.HasOption("prefetch") || fPrefetchNext)
+      fPrefetchDepth = url.GetOptionInt("prefetch", 4);
+
    if (fReduce > 1.)
       fReduce = 1;
    else if (fReduce < 0.01)
@@ -192,10 +199,32 @@ bool dabc::FileInput::TakeNextFileName()
    return !fCurrentName.empty();
 }
 
+void dabc::FileInput::ConfigureFile(dabc::BasicFile &f)
+{
+   if (fChecksum)
+      f.EnableChecksum();
+
+   // prefetch is outer layer, therefore checksums also calculated in prefetch thread
+   fPrefetch = fPrefetchDepth > 0 ? f.EnablePrefetch(fPrefetchDepth) : nullptr;
+}
+
+void dabc::FileInput::PrepareNextFile()
+{
+   if (!fPrefetch || !fPrefetchNext || (fFilesList.NumChilds() == 0)) return;
+
+   const char *nextname = fFilesList.GetChild(0).GetName();
+   if (nextname) fPrefetch->Prepare(nextname);
+}
+
 bool dabc::FileInput::Read_Stat(dabc::Command cmd)
 {
    cmd.SetStr("InputFileName", fFileName);
    cmd.SetStr("InputCurrFileName", fCurrentName);
+   if (fPrefetch) {
+      cmd.SetUInt("PrefetchHits", fPrefetch->GetHits());
+      cmd.SetUInt("PrefetchMisses", fPrefetch->GetMisses());
+      cmd.SetUInt("PrefetchNextFiles", fPrefetch->GetPreparedHits());
+   }
    return true;
 }
 
@@ -215,6 +244,10 @@ dabc::FileOutput::FileOutput(const dabc::Url& url, const std::string &ext) :
    fTotalNumBufs(0),
    fTotalNumEvents(0)
 {
+   if (url.HasOption("stripe"))
+      fStripeBlockSize = url.GetOptionInt("stripe", 4) * 1024 * 1024;
+
+   fChecksum = url.HasOption("crc");
 }
 
 dabc::FileOutput::~FileOutput()
@@ -253,6 +286,9 @@ bool dabc::FileOutput::Write_Init(const dabc::WorkerRef &wrk, const dabc::Comman
    }
    fFileDirsCounter = 0;
 
+   if ((fStripeBlockSize > 0) && (fFileDirs.size() < 2))
+      ShowInfo(-1, "stripe option requires several dirs, striping disabled");
+
    int maxnumber = -1;
 
    for (unsigned ndir = 0; ndir < fFileDirs.size(); ++ndir) {
@@ -294,6 +330,19 @@ bool dabc::FileOutput::Write_Init(const dabc::WorkerRef &wrk, const dabc::Comman
    return true;
 }
 
+dabc::FileInterface *dabc::FileOutput::CreateStripedIO()
+{
+   if ((fStripeBlockSize == 0) || (fFileDirs.size() < 2)) return nullptr;
+
+   // all dirs used simultaneously by striped file, manifest file created without dir prefix
+   fStripeDirs.swap(fFileDirs);
+   fFileDirs.clear();
+   fFileDirs.push_back("");
+   ShowInfo(0, dabc::format("striped output over %u directories", (unsigned) fStripeDirs.size()));
+
+   return new dabc::StripedFileInterface(fStripeDirs, fStripeBlockSize);
+}
+
 std::string dabc::FileOutput::ProduceFileName(unsigned ndir, const std::string &suffix)
 {
    std::string fname = fFileName;
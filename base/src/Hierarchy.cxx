@@ -253,8 +253,9 @@ bool dabc::HierarchyContainer::Stream(iostream& s, unsigned kind, uint64_t versi
             store_diff = false;
             break;
          default: // full stream
-            store_fields = fNodeVersion >= version;
-            store_childs = fChildsVersion >= version;
+            // items changed after last marking also belong to the diff
+            store_fields = (fNodeVersion >= version) || ((version > 0) && HasUnmarkedChanges(false));
+            store_childs = (fChildsVersion >= version) || ((version > 0) && HasUnmarkedChanges(true));
             store_history = !fHist.null() && (hlimit > 0);
             break;
       }
@@ -747,6 +748,19 @@ unsigned dabc::HierarchyContainer::MarkVersionIfChanged(uint64_t ver, uint64_t&
    return mask;
 }
 
+bool dabc::HierarchyContainer::HasUnmarkedChanges(bool withchilds) const
+{
+   if (fNodeChanged || fNamesChanged || fChildsChanged || Fields().WasChanged()) return true;
+
+   if (withchilds)
+      for (unsigned indx = 0; indx < NumChilds(); indx++) {
+         const dabc::HierarchyContainer* child = (const dabc::HierarchyContainer*) GetChild(indx);
+         if (child && child->HasUnmarkedChanges(withchilds)) return true;
+      }
+
+   return false;
+}
+
 uint64_t dabc::HierarchyContainer::GetNextVersion() const
 {
    const HierarchyContainer* top = this, *prnt = this;
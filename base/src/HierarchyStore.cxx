@@ -33,6 +33,8 @@ dabc::HierarchyStore::HierarchyStore() :
 
 dabc::HierarchyStore::~HierarchyStore()
 {
+   WriteSeries(true);
+
    CloseFile();
 
    if (fIO) {
@@ -148,8 +150,105 @@ bool dabc::HierarchyStore::CheckForNextStore(DateTime& now, double store_period,
    return fDoStore || fDoFlush;
 }
 
+void dabc::HierarchyStore::CollectSeries(dabc::Hierarchy& item, const std::string &itemname)
+{
+   for (unsigned n = 0; n < item.NumChilds(); n++) {
+      dabc::Hierarchy chld = item.GetChild(n);
+
+      // node version also changed when any child is changed
+      if (chld.GetVersion() <= fLastVersion) continue;
+
+      std::string name = itemname.empty() ? std::string(chld.GetName()) : itemname + "/" + chld.GetName();
+
+      if (chld.HasField("value") && chld.Field("value").IsNumeric()) {
+         uint64_t tm = chld.HasField(dabc::prop_time) ? chld.Field(dabc::prop_time).AsUInt() : fLastStoreTm.AsJSDate();
+
+         auto &buf = fSeries[name];
+         // time stamps in index must be monotonic
+         if (!buf.fTime.empty() && (tm < buf.fTime.back())) tm = buf.fTime.back();
+
+         buf.fTime.emplace_back(tm);
+         buf.fValue.emplace_back(chld.Field("value").AsDouble());
+      }
+
+      CollectSeries(chld, name);
+   }
+}
+
+bool dabc::HierarchyStore::WriteSerieChunk(const std::string &itemname, SerieBuffer &buf, unsigned num)
+{
+   if ((num == 0) || (num > buf.fTime.size())) return false;
+
+   SerieChunkHeader hdr;
+   hdr.magic = SerieChunkHeader::SerieMagic;
+   hdr.num = num;
+   hdr.tmin = buf.fTime[0];
+   hdr.tmax = buf.fTime[num-1];
+   hdr.vmin = hdr.vmax = buf.fValue[0];
+   for (unsigned n = 0; n < num; n++) {
+      double v = buf.fValue[n];
+      if (v < hdr.vmin) hdr.vmin = v;
+      if (v > hdr.vmax) hdr.vmax = v;
+      hdr.vsum += v;
+   }
+
+   // chunk placed in directory of the date of its first sample
+   std::string path = fBasePath;
+   if ((path.length() > 0) && (path[path.length()-1] != '/')) path.append("/");
+   path.append(dabc::DateTime(hdr.tmin).OnlyDateAsString());
+   path.append("/series/");
+   path.append(itemname);
+   path.append(".ser");
+
+   if (!fIO) fIO = new FileInterface;
+
+   std::string dirname = path.substr(0, path.rfind('/'));
+   if (!fIO->mkdir(dirname.c_str())) {
+      EOUT("Cannot create path %s for time index", dirname.c_str());
+      return false;
+   }
+
+   auto f = fIO->fopen(path.c_str(), "a");
+   if (!f) {
+      EOUT("Cannot open index file %s", path.c_str());
+      return false;
+   }
+
+   bool res = (fIO->fwrite(&hdr, sizeof(hdr), 1, f) == 1) &&
+              (fIO->fwrite(buf.fTime.data(), sizeof(uint64_t), num, f) == num) &&
+              (fIO->fwrite(buf.fValue.data(), sizeof(double), num, f) == num);
+
+   fIO->fclose(f);
+
+   if (!res) EOUT("Fail to write chunk into index file %s", path.c_str());
+
+   buf.fTime.erase(buf.fTime.begin(), buf.fTime.begin() + num);
+   buf.fValue.erase(buf.fValue.begin(), buf.fValue.begin() + num);
+
+   return res;
+}
+
+bool dabc::HierarchyStore::WriteSeries(bool all)
+{
+   bool res = true;
+
+   for (auto &item : fSeries) {
+      while (item.second.fTime.size() >= fChunkSize)
+         if (!WriteSerieChunk(item.first, item.second, fChunkSize)) res = false;
+
+      if (all && (item.second.fTime.size() > 0))
+         if (!WriteSerieChunk(item.first, item.second, item.second.fTime.size())) res = false;
+   }
+
+   return res;
+}
+
 bool dabc::HierarchyStore::ExtractData(dabc::Hierarchy& h)
 {
+   // collect values of all numeric items changed since last store
+   if (fDoStore || fDoFlush)
+      CollectSeries(h, "");
+
    if (fDoStore) {
       // we record diff to previous version, including all history entries
 
@@ -189,9 +288,13 @@ bool dabc::HierarchyStore::WriteExtractedData()
    if (fDoFlush) {
       if (!fFlushBuf.null()) StartFile(fFlushBuf);
       fFlushBuf.Release();
-      fDoFlush = false;
    }
 
+   // incomplete chunks written with every flush
+   WriteSeries(fDoFlush);
+
+   fDoFlush = false;
+
    return true;
 }
 
@@ -464,3 +567,184 @@ dabc::Hierarchy dabc::HierarchyReading::GetSerie(const std::string &entry, const
 
    return res;
 }
+
+dabc::Hierarchy dabc::HierarchyReading::FindSerieDir(Hierarchy& tree, const std::string &entry, std::string &itemname)
+{
+   if (tree.HasField("dabc:path")) {
+      std::string prefix = tree.ItemName();
+      while ((prefix.length() > 0) && (prefix[0] == '/')) prefix.erase(0, 1);
+      if (prefix.empty()) {
+         itemname = entry;
+         return tree;
+      }
+      if ((entry.compare(0, prefix.length(), prefix) == 0) && (entry.length() > prefix.length() + 1) && (entry[prefix.length()] == '/')) {
+         itemname = entry.substr(prefix.length() + 1);
+         return tree;
+      }
+      return nullptr;
+   }
+
+   for (unsigned n = 0; n < tree.NumChilds(); n++) {
+      Hierarchy tree_chld = tree.GetChild(n);
+      Hierarchy res = FindSerieDir(tree_chld, entry, itemname);
+      if (!res.null()) return res;
+   }
+
+   return nullptr;
+}
+
+dabc::Hierarchy dabc::HierarchyReading::GetSerieValues(const std::string &entry, const DateTime& from, const DateTime& till, unsigned maxpoints)
+{
+   dabc::Hierarchy res;
+
+   if (fTree.null()) {
+      if (!ScanTree()) return res;
+   }
+
+   if (!fIO) return res;
+
+   std::string path = entry, itemname;
+   while ((path.length() > 0) && (path[0] == '/')) path.erase(0, 1);
+   while ((path.length() > 0) && (path[path.length()-1] == '/')) path.erase(path.length()-1);
+
+   Hierarchy dir = FindSerieDir(fTree, path, itemname);
+   if (dir.null()) {
+      EOUT("Cannot locate entry %s in the storage", entry.c_str());
+      return res;
+   }
+
+   std::string fpath = dir.Field("dabc:path").AsStr();
+
+   uint64_t tfrom = from.null() ? dir.Field("dabc:mindt").AsUInt() : from.AsJSDate(),
+            ttill = till.null() ? dabc::DateTime().GetNow().AsJSDate() : till.AsJSDate();
+
+   if (tfrom > ttill) return res;
+
+   const uint64_t daylen = 24*3600*1000LU;
+
+   // chunk, started on previous day, can contain samples for requested interval
+   std::vector<std::string> dates;
+   uint64_t t = tfrom > daylen ? tfrom - daylen : 0;
+   while (true) {
+      if (t > ttill) t = ttill;
+      std::string date = dabc::DateTime(t).OnlyDateAsString();
+      if (dates.empty() || (dates.back() != date)) dates.emplace_back(date);
+      if (t == ttill) break;
+      t += daylen;
+   }
+
+   uint64_t binwidth = 0;
+   std::vector<uint64_t> bincnt;
+   std::vector<double> binsum, binmin, binmax;
+   if (maxpoints > 0) {
+      binwidth = (ttill - tfrom) / maxpoints + 1;
+      bincnt.resize(maxpoints, 0);
+      binsum.resize(maxpoints, 0.);
+      binmin.resize(maxpoints, 0.);
+      binmax.resize(maxpoints, 0.);
+   }
+
+   auto fill_bin = [&](unsigned bin, uint64_t cnt, double sum, double vmin, double vmax) {
+      if (bincnt[bin] == 0) {
+         binmin[bin] = vmin;
+         binmax[bin] = vmax;
+      } else {
+         if (vmin < binmin[bin]) binmin[bin] = vmin;
+         if (vmax > binmax[bin]) binmax[bin] = vmax;
+      }
+      bincnt[bin] += cnt;
+      binsum[bin] += sum;
+   };
+
+   std::vector<uint64_t> restime, tmbuf;
+   std::vector<double> resvalue, valbuf;
+   unsigned nread = 0, nskip = 0, nsummary = 0;
+
+   for (auto &date : dates) {
+      std::string fname = fpath + date + "/series/" + itemname + ".ser";
+
+      auto f = fIO->fopen(fname.c_str(), "r");
+      if (!f) continue;
+
+      SerieChunkHeader hdr;
+
+      while (fIO->fread(&hdr, sizeof(hdr), 1, f) == 1) {
+         if ((hdr.magic != SerieChunkHeader::SerieMagic) || (hdr.num == 0)) {
+            EOUT("Corrupted index file %s", fname.c_str());
+            break;
+         }
+
+         // chunks in the file are ordered in time
+         if (hdr.tmin > ttill) break;
+
+         if (hdr.tmax < tfrom) {
+            nskip++;
+            if (!fIO->fseek(f, hdr.PayloadSize())) break;
+            continue;
+         }
+
+         if ((binwidth > 0) && (hdr.tmin >= tfrom) && (hdr.tmax <= ttill) &&
+             ((hdr.tmin - tfrom) / binwidth == (hdr.tmax - tfrom) / binwidth)) {
+            nsummary++;
+            fill_bin((hdr.tmin - tfrom) / binwidth, hdr.num, hdr.vsum, hdr.vmin, hdr.vmax);
+            if (!fIO->fseek(f, hdr.PayloadSize())) break;
+            continue;
+         }
+
+         // number of samples not trusted, check that complete payload exists before allocating memory
+         char probe = 0;
+         if (!fIO->fseek(f, hdr.PayloadSize() - 1) || (fIO->fread(&probe, 1, 1, f) != 1) ||
+             !fIO->fseek(f, -((long int) hdr.PayloadSize()))) {
+            EOUT("Corrupted chunk with %u samples in index file %s", (unsigned) hdr.num, fname.c_str());
+            break;
+         }
+
+         nread++;
+         tmbuf.resize(hdr.num);
+         valbuf.resize(hdr.num);
+         if ((fIO->fread(tmbuf.data(), sizeof(uint64_t), hdr.num, f) != hdr.num) ||
+             (fIO->fread(valbuf.data(), sizeof(double), hdr.num, f) != hdr.num)) {
+            EOUT("Fail to read chunk from index file %s", fname.c_str());
+            break;
+         }
+
+         for (unsigned n = 0; n < hdr.num; n++) {
+            if ((tmbuf[n] < tfrom) || (tmbuf[n] > ttill)) continue;
+            if (binwidth > 0) {
+               fill_bin((tmbuf[n] - tfrom) / binwidth, 1, valbuf[n], valbuf[n], valbuf[n]);
+            } else {
+               restime.emplace_back(tmbuf[n]);
+               resvalue.emplace_back(valbuf[n]);
+            }
+         }
+      }
+
+      fIO->fclose(f);
+   }
+
+   DOUT2("Serie %s chunks read %u skipped %u from summary %u", entry.c_str(), nread, nskip, nsummary);
+
+   std::string name = path;
+   size_t pos = name.rfind('/');
+   if (pos != std::string::npos) name.erase(0, pos + 1);
+
+   res.Create(name);
+
+   if (binwidth > 0) {
+      std::vector<double> resmin, resmax;
+      for (unsigned bin = 0; bin < maxpoints; bin++) {
+         if (bincnt[bin] == 0) continue;
+         restime.emplace_back(tfrom + bin * binwidth + binwidth / 2);
+         resvalue.emplace_back(binsum[bin] / bincnt[bin]);
+         resmin.emplace_back(binmin[bin]);
+         resmax.emplace_back(binmax[bin]);
+      }
+      res.SetField("min", resmin);
+      res.SetField("max", resmax);
+   }
+
+   res.SetField("time", restime);
+   res.SetField("value", resvalue);
+
+   return res;
+}
@@ -36,6 +36,13 @@ dabc::LocalTransport::LocalTransport(unsigned capacity, bool withmutex) :
 {
    SetFlag(flAutoDestroy, true);
 
+   fMetrics.Define("dabc_queue_buffers", "Number of buffers in the port queue", false);
+   fMetrics.Define("dabc_queue_capacity", "Capacity of the port queue", false);
+   fMetrics.Define("dabc_queue_sent_buffers", "Buffers sent via the port queue");
+   fMetrics.Define("dabc_queue_sent_bytes", "Bytes sent via the port queue");
+   fMetrics.Define("dabc_queue_dropped_buffers", "Buffers dropped by non-blocking port queue");
+   fMetrics.SetGauge(mtrCapacity, capacity);
+
    DOUT3("Create buffers queue %p", this);
 }
 
@@ -68,6 +75,7 @@ bool dabc::LocalTransport::Send(Buffer& buf)
    dabc::Buffer skipbuf;
    dabc::WorkerRef mdl;
    unsigned id = 0;
+   BufferSize_t bufsize = buf.GetTotalSize();
 
    {
       dabc::LockGuard lock(QueueMutex());
@@ -100,6 +108,11 @@ bool dabc::LocalTransport::Send(Buffer& buf)
 
       if (!buf.null()) { EOUT("Something went wrong - buffer is not null here"); exit(3); }
 
+      fMetrics.SetGauge(mtrSize, fQueue.Size());
+      fMetrics.Add(mtrBuffers);
+      fMetrics.Add(mtrBytes, bufsize);
+      if (!skipbuf.null()) fMetrics.Add(mtrDropped);
+
       if (fSignalOut == 2) fSignalOut = 3; // mark that output operation done
 
       bool makesig = false;
@@ -150,6 +163,8 @@ bool dabc::LocalTransport::Recv(Buffer& buf)
 
       fQueue.PopBuffer(buf);
 
+      fMetrics.SetGauge(mtrSize, fQueue.Size());
+
       if (fSignalInp == 2) fSignalInp = 3;
 
       bool makesig = false;
@@ -324,6 +339,9 @@ void dabc::LocalTransport::Disconnect(bool isinp, bool witherr)
 void dabc::LocalTransport::CleanupQueue()
 {
    fQueue.Cleanup(QueueMutex());
+
+   LockGuard lock(QueueMutex());
+   fMetrics.SetGauge(mtrSize, fQueue.Size());
 }
 
 
@@ -399,6 +417,9 @@ int dabc::LocalTransport::ConnectPorts(Reference port1ref, Reference port2ref, C
       DOUT3("REUSE queue of input port %s", port_inp.ItemName().c_str());
    } else {
       q = new LocalTransport(queuesize, withmutex);
+      q()->fMetrics.AddLabel("output", port_out.ItemName());
+      q()->fMetrics.AddLabel("input", port_inp.ItemName());
+      q()->fMetrics.Register();
    }
 
    if (blocking == "disconnected") {
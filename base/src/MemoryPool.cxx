@@ -147,6 +147,12 @@ dabc::MemoryPool::MemoryPool(const std::string &name, bool withmanager) :
 {
    DOUT3("MemoryPool %p name %s constructor", this, GetName());
    SetAutoStop(false);
+
+   fMetrics.Define("dabc_pool_size_bytes", "Memory allocated in the pool", false);
+   fMetrics.Define("dabc_pool_used_bytes", "Memory of the pool used by buffers", false);
+   fMetrics.Define("dabc_pool_taken_buffers", "Buffers taken from the pool");
+   fMetrics.AddLabel("pool", GetName());
+   fMetrics.Register();
 }
 
 dabc::MemoryPool::~MemoryPool()
@@ -197,6 +203,10 @@ bool dabc::MemoryPool::_Allocate(BufferSize_t bufsize, unsigned number) throw()
 
    fChangeCounter++;
 
+   fUsedSize = 0;
+   fMetrics.SetGauge(mtrSize, 1.*bufsize*number);
+   fMetrics.SetGauge(mtrUsed, 0);
+
    return true;
 }
 
@@ -217,6 +227,12 @@ bool dabc::MemoryPool::Assign(bool isowner, const std::vector<void*>& bufs, cons
    fMem = new MemoryBlock;
    fMem->Assign(isowner, bufs, sizes);
 
+   double sum = 0;
+   for (auto sz : sizes) sum += sz;
+   fUsedSize = 0;
+   fMetrics.SetGauge(mtrSize, sum);
+   fMetrics.SetGauge(mtrUsed, 0);
+
    return true;
 }
 
@@ -228,6 +244,9 @@ bool dabc::MemoryPool::Release() throw()
       delete fMem;
       fMem = nullptr;
       fChangeCounter++;
+      fUsedSize = 0;
+      fMetrics.SetGauge(mtrSize, 0);
+      fMetrics.SetGauge(mtrUsed, 0);
    }
 
    return true;
@@ -401,6 +420,10 @@ dabc::Buffer dabc::MemoryPool::_TakeBuffer(BufferSize_t size, bool except, bool
 
    res.GetObject()->fNumSegments = cnt;
 
+   fUsedSize += sum;
+   fMetrics.SetGauge(mtrUsed, fUsedSize);
+   fMetrics.Add(mtrTaken);
+
    res.SetTypeId(mbt_Generic);
 
    return res;
@@ -475,9 +498,14 @@ void dabc::MemoryPool::DecreaseSegmRefs(MemSegment* segm, unsigned num)
       if (fMem->fArr[id].refcnt == 0)
          throw dabc::Exception(ex_Pool, "Reference counter of specified segment is already 0", ItemName());
 
-      if (--(fMem->fArr[id].refcnt) == 0) fMem->fFree.Push(id);
+      if (--(fMem->fArr[id].refcnt) == 0) {
+         fMem->fFree.Push(id);
+         fUsedSize -= fMem->fArr[id].size;
+      }
    }
 
+   fMetrics.SetGauge(mtrUsed, fUsedSize);
+
 }
 
 
@@ -0,0 +1,144 @@
+// $Id$
+
+/************************************************************
+ * The Data Acquisition Backbone Core (DABC)                *
+ ************************************************************
+ * Copyright (C) 2009 -                                     *
+ * GSI Helmholtzzentrum fuer Schwerionenforschung GmbH      *
+ * Planckstr. 1, 64291 Darmstadt, Germany                   *
+ * Contact:  http://dabc.gsi.de                             *
+ ************************************************************
+ * This software can be used under the GPL license          *
+ * agreements as stated in LICENSE.txt file                 *
+ * which is part of the distribution.                       *
+ ************************************************************/
+
+#include "dabc/Metrics.h"
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include "dabc/threads.h"
+#include "dabc/string.h"
+
+namespace dabc {
+
+   /** Mutex and list of registered slots. Mutex only used by registration and by exporter,
+    * therefore update of slots values never blocked */
+   struct MetricsRegistry {
+      Mutex fMutex;
+      std::list<MetricsSlot *> fSlots;
+   };
+
+   static MetricsRegistry &GetMetricsRegistry()
+   {
+      static MetricsRegistry reg;
+      return reg;
+   }
+
+}
+
+unsigned dabc::MetricsSlot::Define(const std::string &name, const std::string &help, bool counter)
+{
+   if (fRegistered) return 0;
+
+   fEntries.emplace_back();
+   auto &entry = fEntries.back();
+   entry.fName = name;
+   entry.fHelp = help;
+   entry.fCounter = counter;
+   return fEntries.size() - 1;
+}
+
+void dabc::MetricsSlot::AddLabel(const std::string &name, const std::string &value)
+{
+   if (fRegistered) return;
+
+   if (!fLabels.empty()) fLabels.append(",");
+   fLabels.append(name);
+   fLabels.append("=\"");
+   for (auto symb : value) {
+      switch (symb) {
+         case '\\': fLabels.append("\\\\"); break;
+         case '\"': fLabels.append("\\\""); break;
+         case '\n': fLabels.append("\\n"); break;
+         default: fLabels.push_back(symb);
+      }
+   }
+   fLabels.append("\"");
+}
+
+void dabc::MetricsSlot::Register()
+{
+   if (fRegistered || fEntries.empty()) return;
+
+   auto &reg = GetMetricsRegistry();
+   LockGuard lock(reg.fMutex);
+   reg.fSlots.emplace_back(this);
+   fRegistered = true;
+}
+
+void dabc::MetricsSlot::Unregister()
+{
+   if (!fRegistered) return;
+
+   auto &reg = GetMetricsRegistry();
+   LockGuard lock(reg.fMutex);
+   reg.fSlots.remove(this);
+   fRegistered = false;
+}
+
+std::string dabc::Metrics::FormatOpenMetrics()
+{
+   struct Family {
+      std::string help;
+      bool counter{false};
+      std::vector<std::string> samples;
+   };
+
+   std::map<std::string, Family> families;
+
+   {
+      auto &reg = GetMetricsRegistry();
+      LockGuard lock(reg.fMutex);
+
+      for (auto slot : reg.fSlots) {
+         std::string labels = slot->fLabels.empty() ? std::string() : std::string("{") + slot->fLabels + "}";
+
+         for (auto &entry : slot->fEntries) {
+            auto &fam = families[entry.fName];
+            if (fam.samples.empty()) {
+               fam.help = entry.fHelp;
+               fam.counter = entry.fCounter;
+            }
+
+            uint64_t bits = entry.fValue.load(std::memory_order_relaxed);
+
+            if (entry.fCounter) {
+               fam.samples.emplace_back(dabc::format("%s_total%s %lu", entry.fName.c_str(), labels.c_str(), (long unsigned) bits));
+            } else {
+               double v;
+               memcpy(&v, &bits, sizeof(v));
+               fam.samples.emplace_back(dabc::format("%s%s %.10g", entry.fName.c_str(), labels.c_str(), v));
+            }
+         }
+      }
+   }
+
+   std::string res;
+
+   for (auto &item : families) {
+      res.append(dabc::format("# TYPE %s %s\n", item.first.c_str(), item.second.counter ? "counter" : "gauge"));
+      if (!item.second.help.empty())
+         res.append(dabc::format("# HELP %s %s\n", item.first.c_str(), item.second.help.c_str()));
+      for (auto &sample : item.second.samples) {
+         res.append(sample);
+         res.append("\n");
+      }
+   }
+
+   res.append("# EOF\n");
+
+   return res;
+}
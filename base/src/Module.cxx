@@ -453,6 +453,10 @@ int dabc::Module::PreviewCommand(Command cmd)
 
          req.SetUseAckn(port.Cfg(xmlUseacknAttr).AsBool(false));
 
+         req.SetUseShm(port.Cfg(xmlShmAttr).AsBool(false));
+
+         req.SetCompress(port.Cfg(xmlCompressAttr).AsInt(0));
+
          req.SetOptional(port.Cfg(xmlOptionalAttr).AsBool(false));
 
          req.SetConnDevice(port.Cfg(xmlDeviceAttr).AsStr());
@@ -18,7 +18,16 @@
 #include "dabc/Manager.h"
 #include "dabc/Pointer.h"
 
-dabc::NetworkTransport::NetworkTransport(dabc::Command cmd, const PortRef& inpport, const PortRef& outport, bool useackn, WorkerAddon* addon) :
+#ifndef DABC_WITHOUT_ZLIB
+#include "zlib.h"
+#endif
+
+// smaller buffers are never compressed
+#define NetCompressMinSize 1024
+// maximal number of buffers sent without compression after failed attempt
+#define NetCompressMaxSkip 64
+
+dabc::NetworkTransport::NetworkTransport(dabc::Command cmd, const PortRef& inpport, const PortRef& outport, bool useackn, WorkerAddon* addon, int compress) :
     dabc::Transport(cmd, inpport, outport),
     fNet(nullptr),
     fTransportId(0),
@@ -29,8 +38,9 @@ dabc::NetworkTransport::NetworkTransport(dabc::Command cmd, const PortRef& inppo
     fRecsCounter(0),
     fRecs(nullptr),
     fOutputQueueSize(0),
-    fAcknAllowedOper(0),
+    fSendCredits(0),
     fAcknSendQueue(),
+    fNumNotPacked(0),
     fAcknSendBufBusy(false),
     fInputQueueSize(0),
     fFirstAckn(true),
@@ -79,10 +89,20 @@ dabc::NetworkTransport::NetworkTransport(dabc::Command cmd, const PortRef& inppo
    fFirstAckn = true;
    fAcknReadyCounter = 0;
 
+   // initially credits collected in big portions, limit reduced when sender starving
+   fGrantMaxLimit = fInputQueueCapacity / 2;
+   if (fGrantMaxLimit < 1) fGrantMaxLimit = 1;
+   fGrantLimit = fGrantMaxLimit;
+
    fInlineDataSize = 32; // TODO: configure via port properties
    fFullHeaderSize = sizeof(NetworkHeader) + fInlineDataSize;
 
-   fNumRecs = fInputQueueCapacity + fOutputQueueCapacity + 1;
+   // credits messages from other side should always find submitted receive operation,
+   // therefore sender keeps several receive operations which are never granted as credits
+   if (IsOutputTransport() && fUseAckn)
+      fRecvReserve = AcknoledgeQueueLength;
+
+   fNumRecs = fInputQueueCapacity + fRecvReserve + fOutputQueueCapacity + 1;
    fRecsCounter = 0;
    fNumUsedRecs = 0;
    if (fNumRecs>0) {
@@ -97,7 +117,8 @@ dabc::NetworkTransport::NetworkTransport(dabc::Command cmd, const PortRef& inppo
       }
    }
 
-   if (IsInputTransport() && fUseAckn)
+   // sender waits for the credits before submitting data
+   if (IsOutputTransport() && fUseAckn)
       fAcknSendQueue.Allocate(fOutputQueueCapacity);
 
    if (IsInputTransport() && (NumPools() == 0)) {
@@ -107,11 +128,56 @@ dabc::NetworkTransport::NetworkTransport(dabc::Command cmd, const PortRef& inppo
 
    fNet->AllocateNet(fOutputQueueCapacity + AcknoledgeQueueLength,
                      fInputQueueCapacity + AcknoledgeQueueLength);
+
+   if (compress > 0) {
+#ifdef DABC_WITHOUT_ZLIB
+      EOUT("Compression of network transport requested, but ZLIB is not available");
+#else
+      if (compress > Z_BEST_COMPRESSION) compress = Z_BEST_COMPRESSION;
+      z_stream *zs = new z_stream;
+      memset(zs, 0, sizeof(z_stream));
+      if (deflateInit(zs, compress) == Z_OK) {
+         fDeflate = zs;
+         fCompressLevel = compress;
+         // not more than queue capacity buffers can be compressed and not yet sent
+         fDeflateScratch.resize(fOutputQueueCapacity);
+         for (int n = fOutputQueueCapacity - 1; n >= 0; n--)
+            fDeflateFree.push_back(n);
+      } else {
+         EOUT("Fail to initialize zlib compression level %d", compress);
+         delete zs;
+      }
+#endif
+   }
+
+#ifndef DABC_WITHOUT_ZLIB
+   // other side may compress data, decompression always possible
+   if (IsInputTransport()) {
+      z_stream *zs = new z_stream;
+      memset(zs, 0, sizeof(z_stream));
+      if (inflateInit(zs) == Z_OK)
+         fInflate = zs;
+      else
+         delete zs;
+   }
+#endif
 }
 
 dabc::NetworkTransport::~NetworkTransport()
 {
    DOUT2("#### ~NetworkTransport fRecs %p", fRecs);
+
+#ifndef DABC_WITHOUT_ZLIB
+   if (fDeflate) {
+      deflateEnd((z_stream *) fDeflate);
+      delete (z_stream *) fDeflate;
+   }
+   if (fInflate) {
+      inflateEnd((z_stream *) fInflate);
+      delete (z_stream *) fInflate;
+   }
+#endif
+   fDeflate = fInflate = nullptr;
 }
 
 void dabc::NetworkTransport::TransportCleanup()
@@ -120,6 +186,14 @@ void dabc::NetworkTransport::TransportCleanup()
 
    DOUT3("NetworkTransport::TransportCleanup");
 
+   if (fUseAckn)
+      DOUT2("%s credits starved %lu times %5.3f s, grant messages %lu, with data %lu", GetName(),
+            (long unsigned) fStarvedCnt, fStarvedTime, (long unsigned) fGrantMsgs, (long unsigned) fGrantPiggy);
+
+   if (fCompressLevel > 0)
+      DOUT2("%s compressed %lu buffers %lu -> %lu bytes, sent uncompressed %lu", GetName(),
+            (long unsigned) fCompressBufs, (long unsigned) fCompressRaw, (long unsigned) fCompressPacked, (long unsigned) fCompressSkipped);
+
    // at this moment net should be destroyed by the addon cleanup
    fNet = nullptr;
 
@@ -174,6 +248,10 @@ void dabc::NetworkTransport::ReleaseRec(uint32_t recid)
 {
    if (recid < fNumRecs) {
       if (!fRecs[recid].buf.null()) EOUT("Buffer is not empty when record is released !!!!");
+      if (fRecs[recid].zslot >= 0) {
+         fDeflateFree.push_back(fRecs[recid].zslot);
+         fRecs[recid].zslot = -1;
+      }
       fRecs[recid].used = false;
       fNumUsedRecs--;
    } else {
@@ -192,13 +270,34 @@ int dabc::NetworkTransport::PackHeader(uint32_t recid)
 
    hdr->chkword = 123;
    hdr->kind = fRecs[recid].kind;
+
+   if ((hdr->kind & netot_Send) && (fNumNotPacked > 0)) fNumNotPacked--;
+
+   uint32_t credits = 0;
+
+   if (fUseAckn) {
+      hdr->kind |= netot_Credits;
+
+      // all collected credits delivered with credits message or with data header when other side supports it
+      if (IsInputTransport() && (fAcknReadyCounter > 0) && ((hdr->kind & netot_HdrSend) || fPeerCredits)) {
+         credits = fAcknReadyCounter;
+         if (!(hdr->kind & netot_HdrSend)) {
+            if (credits > (netot_CreditsMask >> 16)) credits = netot_CreditsMask >> 16;
+            hdr->kind |= credits << 16;
+            fGrantPiggy++;
+         }
+         fAcknReadyCounter -= credits;
+      }
+   }
+
    if (fRecs[recid].buf.null()) {
       hdr->size = 0;
       hdr->typid = 0;
 
+      // same format as acknowledge message of previous versions
       if (hdr->kind & netot_HdrSend) {
          hdr->typid = mbt_AcknCounter;
-         hdr->size = fRecs[recid].extras;
+         hdr->size = credits;
       }
 
       return 1;
@@ -249,6 +348,9 @@ void dabc::NetworkTransport::FillRecvQueue(Buffer* freebuf, bool onlyfreebuf)
       numcansubmit = fInputQueueCapacity;
    }
 
+   // reserved receive operations are not limited by output queue
+   numcansubmit += fRecvReserve;
+
    while (fInputQueueSize < numcansubmit) {
       Buffer buf;
 
@@ -266,7 +368,11 @@ void dabc::NetworkTransport::FillRecvQueue(Buffer* freebuf, bool onlyfreebuf)
 
       uint32_t recvrec = TakeRec(buf, netot_Recv);
       fInputQueueSize++;
-      newitems++;
+      // first refill receive operations for credits messages, only others are granted to the sender
+      if (fReserveAvail < fRecvReserve)
+         fReserveAvail++;
+      else
+         newitems++;
       fNet->SubmitRecv(recvrec);
 
       // if we want to reuse only free buffer, just break and do not try to submit any new requests
@@ -281,34 +387,38 @@ void dabc::NetworkTransport::FillRecvQueue(Buffer* freebuf, bool onlyfreebuf)
 
 bool dabc::NetworkTransport::CheckAcknReadyCounter(unsigned newitems)
 {
-   // check if count of newly submitted recv buffers exceed limit
-   // after which one should send acknowledge packet to receiver
+   // each newly submitted recv buffer is credit for the sender
+   // check if separate message should be send to grant these credits
 
    DOUT5("CheckAcknReadyCounter ackn:%s pool:%s inp:%s", DBOOL(fUseAckn), PoolName().c_str(), DBOOL(IsInputTransport()));
 
    if (!fUseAckn || (NumPools() == 0) || !IsInputTransport()) return false;
 
-   fAcknReadyCounter+=newitems;
+   fAcknReadyCounter += newitems;
 
-   if (fAcknSendBufBusy) return false;
+   if (fAcknSendBufBusy || (fAcknReadyCounter == 0)) return false;
 
-   unsigned ackn_limit = fFirstAckn ? fInputQueueCapacity : fInputQueueCapacity/2;
-   if (ackn_limit<1) ackn_limit = 1;
+   // credits will be delivered with header of next data packet
+   if (fPeerCredits && (fNumNotPacked > 0)) return false;
 
-   DOUT5("fAcknReadyCounter = %d limit = %d", fAcknReadyCounter, ackn_limit);
+   DOUT5("fAcknReadyCounter = %u limit = %u", fAcknReadyCounter, fGrantLimit);
 
-   // check if we need to send ackn packet
-   if (fAcknReadyCounter<ackn_limit) return false;
+   // first credits granted immediately, later collected in portions
+   if (!fFirstAckn && (fAcknReadyCounter < fGrantLimit)) return false;
 
    fAcknSendBufBusy = true;
-
-   fAcknReadyCounter -= ackn_limit;
-
    fFirstAckn = false;
+   fGrantMsgs++;
+
+   // while sender does not complain, collect more credits for the next message
+   fGrantLimit *= 2;
+   if (fGrantLimit > fGrantMaxLimit) fGrantLimit = fGrantMaxLimit;
 
    dabc::Buffer buf;
 
-   uint32_t recid = TakeRec(buf, netot_HdrSend, ackn_limit);
+   // credits counter itself will be packed into header,
+   // message does not require credit while other side reserves receive operations for it
+   uint32_t recid = TakeRec(buf, netot_HdrSend);
 
    fNet->SubmitSend(recid);
 
@@ -317,11 +427,170 @@ bool dabc::NetworkTransport::CheckAcknReadyCounter(unsigned newitems)
 
 void dabc::NetworkTransport::SubmitAllowedSendOperations()
 {
-   while ((fAcknAllowedOper > 0) && (fAcknSendQueue.Size() > 0)) {
+   while ((fSendCredits > 0) && (fAcknSendQueue.Size() > 0)) {
       uint32_t recid = fAcknSendQueue.Pop();
-      fAcknAllowedOper--;
+      fRecs[recid].kind |= TakeSendCredit();
+      fNumNotPacked++;
       fNet->SubmitSend(recid);
    }
+
+   if (!fStarved && (fAcknSendQueue.Size() > 0)) {
+      fStarved = true;
+      fStarvedTm.GetNow();
+      fStarvedCnt++;
+   }
+}
+
+uint32_t dabc::NetworkTransport::TakeSendCredit()
+{
+   if (fSendCredits > 0) fSendCredits--;
+
+   // when last credit is used, receiver should know it
+   return fSendCredits == 0 ? (uint32_t) netot_Starved : 0U;
+}
+
+void dabc::NetworkTransport::AddSendCredits(unsigned credits)
+{
+   if (credits == 0) return;
+
+   fSendCredits += credits;
+
+   if (fStarved) {
+      fStarvedTime += fStarvedTm.SpentTillNow();
+      fStarved = false;
+   }
+
+   SubmitAllowedSendOperations();
+}
+
+bool dabc::NetworkTransport::CompressBuffer(Buffer &buf, int &slot)
+{
+#ifdef DABC_WITHOUT_ZLIB
+   (void) buf; (void) slot;
+   return false;
+#else
+   z_stream *zs = (z_stream *) fDeflate;
+   if (!zs || buf.null() || fDeflateFree.empty()) return false;
+
+   BufferSize_t rawsize = buf.GetTotalSize();
+   if (rawsize < NetCompressMinSize) return false;
+
+   if (fCompressSkip > 0) {
+      fCompressSkip--;
+      fCompressSkipped++;
+      return false;
+   }
+
+   deflateReset(zs);
+
+   // storage only grows, therefore after first buffers no more memory allocated
+   std::vector<char> &scratch = fDeflateScratch[fDeflateFree.back()];
+   BufferSize_t bound = sizeof(uint32_t) + deflateBound(zs, rawsize);
+   if (scratch.size() < bound) scratch.resize(bound);
+
+   char *out = scratch.data();
+   *((uint32_t *) out) = rawsize;
+
+   zs->next_out = (Bytef *) out + sizeof(uint32_t);
+   zs->avail_out = bound - sizeof(uint32_t);
+
+   int ret = Z_OK;
+   for (unsigned n = 0; (n < buf.NumSegments()) && (ret == Z_OK); n++) {
+      zs->next_in = (Bytef *) buf.SegmentPtr(n);
+      zs->avail_in = buf.SegmentSize(n);
+      ret = deflate(zs, n + 1 == buf.NumSegments() ? Z_FINISH : Z_NO_FLUSH);
+   }
+
+   BufferSize_t packed = sizeof(uint32_t) + zs->total_out;
+
+   // buffer with incompressible data sent as is, next buffers most probably also incompressible
+   if ((ret != Z_STREAM_END) || (packed > rawsize - rawsize/8)) {
+      fCompressSkipped++;
+      fCompressSkip = fCompressBackoff;
+      if (fCompressBackoff < NetCompressMaxSkip) fCompressBackoff *= 2;
+      return false;
+   }
+
+   // such small payload would be sent inline, receiver expects only uncompressed inline data
+   if (packed <= fInlineDataSize) return false;
+
+   Buffer res = Buffer::CreateBuffer(out, packed);
+   if (res.null()) return false;
+
+   fCompressBackoff = 1;
+   fCompressBufs++;
+   fCompressRaw += rawsize;
+   fCompressPacked += packed;
+
+   slot = fDeflateFree.back();
+   fDeflateFree.pop_back();
+
+   res.SetTypeId(buf.GetTypeId());
+   buf = res;
+   return true;
+#endif
+}
+
+bool dabc::NetworkTransport::DecompressBuffer(Buffer &buf, BufferSize_t size)
+{
+#ifdef DABC_WITHOUT_ZLIB
+   (void) buf; (void) size;
+   EOUT("Compressed data received, but ZLIB is not available");
+   return false;
+#else
+   z_stream *zs = (z_stream *) fInflate;
+   if (!zs || buf.null() || (size < sizeof(uint32_t)) || (size > buf.GetTotalSize())) {
+      EOUT("Cannot decompress received buffer of size %u", (unsigned) size);
+      return false;
+   }
+
+   Pointer src(buf, 0, size);
+   uint32_t rawsize = 0;
+   src.copyto_shift(&rawsize, sizeof(rawsize));
+
+   // data inflated directly from received buffer, therefore other buffer required
+   Buffer res = TakeBuffer();
+   // when pool is exhausted, data decompressed into standalone buffer
+   if (res.null() || (res.GetTotalSize() < rawsize))
+      res = Buffer::CreateBuffer(rawsize);
+   if (res.null()) {
+      EOUT("No buffer of size %u to decompress data", (unsigned) rawsize);
+      return false;
+   }
+
+   inflateReset(zs);
+   zs->avail_in = 0;
+   zs->avail_out = 0;
+
+   int ret = Z_OK;
+   unsigned seg = 0;
+   while (ret == Z_OK) {
+      // compressed data may be distributed over several segments of received buffer
+      if (zs->avail_in == 0) {
+         if (src.null()) break;
+         zs->next_in = (Bytef *) src.ptr();
+         zs->avail_in = src.rawsize();
+         src.shift(src.rawsize());
+      }
+      if (zs->avail_out == 0) {
+         if (seg >= res.NumSegments()) break;
+         zs->next_out = (Bytef *) res.SegmentPtr(seg);
+         zs->avail_out = res.SegmentSize(seg++);
+      }
+      ret = inflate(zs, Z_NO_FLUSH);
+      // no progress possible only when input or output exhausted
+      if ((ret == Z_BUF_ERROR) && ((zs->avail_in == 0) || (zs->avail_out == 0))) ret = Z_OK;
+   }
+
+   if ((ret != Z_STREAM_END) || (zs->total_out != rawsize)) {
+      EOUT("Fail to decompress buffer, error %d size %lu expected %u", ret, (long unsigned) zs->total_out, (unsigned) rawsize);
+      return false;
+   }
+
+   buf = res;
+   buf.SetTotalSize(rawsize);
+   return true;
+#endif
 }
 
 void dabc::NetworkTransport::ProcessSendCompl(uint32_t recid)
@@ -337,6 +606,8 @@ void dabc::NetworkTransport::ProcessSendCompl(uint32_t recid)
       fOutputQueueSize--;
 
       if (!CanRecv()) {
+         // completion delivered after input was disconnected, transport will be destroyed
+         if (!IsInputConnected()) { ReleaseRec(recid); return; }
          EOUT("One cannot recieve buffer!!!!");
          exit(333);
       }
@@ -380,16 +651,32 @@ void dabc::NetworkTransport::ProcessRecvCompl(uint32_t recid)
       return;
    }
 
+   bool starved = false;
+
+   if (fUseAckn) {
+      if (hdr->kind & netot_Credits) fPeerCredits = true;
+
+      // sender used last credit, grant new as soon as possible
+      if (hdr->kind & netot_Starved) {
+         fGrantLimit = 1;
+         starved = true;
+      }
+
+      if (hdr->kind & netot_HdrSend)
+         AddSendCredits(hdr->size);
+      else if (hdr->kind & netot_Credits)
+         AddSendCredits(hdr->kind >> 16);
+   }
+
    // check special case when we send only network header and nothing else
-   // for the moment this is only work with AcknCounter, later can be extend for other applications
+   // for the moment this is only work with credits, later can be extend for other applications
    if (hdr->kind & netot_HdrSend) {
-      uint32_t extras = hdr->size;
-
-      fAcknAllowedOper += extras;
-      SubmitAllowedSendOperations();
 
       fInputQueueSize--;
 
+      // credits message uses reserved receive operation
+      if (fReserveAvail > 0) fReserveAvail--;
+
       Buffer buf;
 
       buf << fRecs[recid].buf;
@@ -406,17 +693,27 @@ void dabc::NetworkTransport::ProcessRecvCompl(uint32_t recid)
 
       buf << fRecs[recid].buf;
 
-      buf.SetTotalSize(hdr->size);
-      buf.SetTypeId(hdr->typid);
-
+      // inline data copied first, compressed payload never sent inline
       if ((hdr->size>0) && (hdr->size <= fInlineDataSize))
          Pointer(buf).copyfrom(fRecs[recid].inlinebuf, hdr->size);
 
+      if (hdr->kind & netot_Compressed) {
+         if (!DecompressBuffer(buf, hdr->size)) {
+            ReleaseRec(recid);
+            CloseTransport(true);
+            return;
+         }
+      } else {
+         buf.SetTotalSize(hdr->size);
+      }
+      buf.SetTypeId(hdr->typid);
+
       ReleaseRec(recid);
 
       Send(buf);
-   }
 
+      if (starved) CheckAcknReadyCounter(0);
+   }
 }
 
 
@@ -437,11 +734,17 @@ void dabc::NetworkTransport::ProcessInputEvent(unsigned port)
       // original reference will remain in the port queue until send operation is completed
       Buffer buf = RecvQueueItem(port, fOutputQueueSize);
 
-      uint32_t recid = TakeRec(buf, netot_Send);
+      uint32_t kind = netot_Send;
+      int zslot = -1;
+      // original buffer remains in the port queue, record gets compressed copy
+      if ((fCompressLevel > 0) && CompressBuffer(buf, zslot)) kind |= netot_Compressed;
+
+      uint32_t recid = TakeRec(buf, kind);
       if (recid==fNumRecs) {
          EOUT("No available recs!!!");
          exit(543);
       }
+      fRecs[recid].zslot = zslot;
 
       fOutputQueueSize++;
 
@@ -449,6 +752,7 @@ void dabc::NetworkTransport::ProcessInputEvent(unsigned port)
       if (fAcknSendQueue.Capacity() > 0) {
          fAcknSendQueue.Push(recid);
       } else {
+         fNumNotPacked++;
          fNet->SubmitSend(recid);
       }
    }
@@ -473,6 +777,30 @@ void dabc::NetworkTransport::ProcessTimerEvent(unsigned)
 }
 
 
+int dabc::NetworkTransport::ExecuteCommand(Command cmd)
+{
+   if (cmd.IsName("GetTransportStatistic")) {
+      cmd.SetBool("UseCredits", fUseAckn);
+      if (fUseAckn) {
+         cmd.SetUInt("SendCredits", fSendCredits);
+         cmd.SetUInt("StarvedCnt", fStarvedCnt);
+         cmd.SetDouble("StarvedTime", fStarvedTime + (fStarved ? fStarvedTm.SpentTillNow() : 0.));
+         cmd.SetUInt("GrantLimit", fGrantLimit);
+         cmd.SetUInt("GrantMessages", fGrantMsgs);
+         cmd.SetUInt("GrantWithData", fGrantPiggy);
+      }
+      cmd.SetInt("CompressLevel", fCompressLevel);
+      if (fCompressLevel > 0) {
+         cmd.SetUInt("CompressedBufs", fCompressBufs);
+         cmd.SetUInt("UncompressedBufs", fCompressSkipped);
+         cmd.SetDouble("CompressRatio", fCompressPacked > 0 ? 1. * fCompressRaw / fCompressPacked : 0.);
+      }
+      return cmd_true;
+   }
+
+   return dabc::Transport::ExecuteCommand(cmd);
+}
+
 bool dabc::NetworkTransport::StartTransport()
 {
    dabc::Transport::StartTransport();
@@ -528,7 +856,7 @@ bool dabc::NetworkTransport::Make(const ConnectionRequest& req, WorkerAddon* add
    dabc::CmdCreateTransport cmd;
    cmd.SetPoolName(req.GetPoolName());
 
-   TransportRef tr = new NetworkTransport(cmd, inpport, outport, req.GetUseAckn(), addon);
+   TransportRef tr = new NetworkTransport(cmd, inpport, outport, req.GetUseAckn(), addon, req.GetCompress());
 
    if (tr.MakeThreadForWorker(newthrdname)) {
       tr.ConnectPoolHandles();
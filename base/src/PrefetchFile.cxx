@@ -0,0 +1,393 @@
+// $Id$
+
+/************************************************************
+ * The Data Acquisition Backbone Core (DABC)                *
+ ************************************************************
+ * Copyright (C) 2009 -                                     *
+ * GSI Helmholtzzentrum fuer Schwerionenforschung GmbH      *
+ * Planckstr. 1, 64291 Darmstadt, Germany                   *
+ * Contact:  http://dabc.gsi.de                             *
+ ************************************************************
+ * This software can be used under the GPL license          *
+ * agreements as stated in LICENSE.txt file                 *
+ * which is part of the distribution.                       *
+ ************************************************************/
+
+#include "dabc/PrefetchFile.h"
+
+#include <cstring>
+#include <list>
+#include <vector>
+
+#include "dabc/threads.h"
+#include "dabc/logging.h"
+
+namespace dabc {
+
+   /** \brief Handle of file opened via \ref PrefetchFileInterface
+    *
+    * When reading, thread reads blocks from inner file into fReady list.
+    * Consumer takes data from the first block, which is kept until data from
+    * next block are required - this allows seeking back inside last block */
+
+   class PrefetchHandle {
+      public:
+         FileInterface        *fInner{nullptr};
+         FileInterface::Handle fFile{nullptr};
+         std::string           fName;
+         bool                  fReading{false};
+         bool                  fOpening{false};   ///< file should be opened by reader thread
+         unsigned              fDepth{0};
+         unsigned              fBlockSize{0};
+
+         Mutex       fMutex;
+         Condition   fDataCond;                 ///< fired when new block is read
+         Condition   fSpaceCond;                ///< fired when block is consumed or position changed
+         PosixThread fThrd;
+         bool        fThrdStarted{false};
+
+         std::list<std::vector<char>> fReady;  ///< blocks read from file
+         std::list<std::vector<char>> fFree;   ///< consumed blocks, can be reused
+         uint64_t    fBase{0};                 ///< position of first ready block in file
+         size_t      fOffset{0};               ///< consumed data in first ready block
+         bool        fEnd{false};              ///< reader reached end of file
+         bool        fStop{false};             ///< reader should stop
+         bool        fReset{false};            ///< reader should continue from fBase position
+         unsigned    fGen{0};                  ///< changed when prefetched data are dropped
+         bool        fEOF{false};              ///< eof flag, seen by consumer
+
+         PrefetchHandle() : fMutex(), fDataCond(&fMutex), fSpaceCond(&fMutex) {}
+
+         void StartReader()
+         {
+            fThrd.Start(PrefetchHandle::RunFunc, this);
+            fThrd.SetThreadName("FilePrefetch");
+            fThrdStarted = true;
+         }
+
+         void StopReader()
+         {
+            if (!fThrdStarted) return;
+            {
+               LockGuard lock(fMutex);
+               fStop = true;
+               fSpaceCond._DoFire();
+            }
+            fThrd.Join();
+            fThrdStarted = false;
+         }
+
+         /** Wait until reader thread opened the file, returns false if open failed */
+         bool WaitOpened()
+         {
+            LockGuard lock(fMutex);
+            while (fOpening)
+               fDataCond._DoWait(-1);
+            return fFile != nullptr;
+         }
+
+         /** Drop all prefetched data and let reader continue from specified position */
+         void _Reset(uint64_t pos)
+         {
+            fFree.splice(fFree.end(), fReady);
+            fBase = pos;
+            fOffset = 0;
+            fEnd = false;
+            fReset = true;
+            fGen++;
+            fSpaceCond._DoFire();
+         }
+
+         static void *RunFunc(void *args)
+         {
+            PrefetchHandle *h = (PrefetchHandle *) args;
+
+            if (h->fOpening) {
+               // file prepared in advance, opening may take time as well
+               auto f = h->fInner->fopen(h->fName.c_str(), "r");
+               if (!f) DOUT1("Cannot open file %s in advance", h->fName.c_str());
+
+               LockGuard lock(h->fMutex);
+               h->fFile = f;
+               h->fOpening = false;
+               h->fDataCond._DoFire();
+               if (!f) return nullptr;
+            }
+
+            std::vector<char> blk;
+
+            while (true) {
+               unsigned gen = 0;
+               {
+                  LockGuard lock(h->fMutex);
+                  while (!h->fStop && !h->fReset && (h->fEnd || (h->fReady.size() >= h->fDepth)))
+                     h->fSpaceCond._DoWait(-1);
+
+                  if (h->fStop) break;
+
+                  if (h->fReset) {
+                     h->fReset = false;
+                     if (!h->fInner->fseek(h->fFile, h->fBase, false)) {
+                        h->fEnd = true;
+                        h->fDataCond._DoFire();
+                        continue;
+                     }
+                  }
+
+                  gen = h->fGen;
+                  if (!h->fFree.empty()) {
+                     blk.swap(h->fFree.front());
+                     h->fFree.pop_front();
+                  }
+               }
+
+               blk.resize(h->fBlockSize);
+               size_t res = h->fInner->fread(blk.data(), 1, blk.size(), h->fFile);
+               blk.resize(res);
+
+               LockGuard lock(h->fMutex);
+               // position was changed while reading, data not required
+               if (gen != h->fGen) continue;
+
+               if (res > 0) {
+                  h->fReady.emplace_back();
+                  h->fReady.back().swap(blk);
+               }
+               if (res < h->fBlockSize) h->fEnd = true;
+               h->fDataCond._DoFire();
+            }
+
+            return nullptr;
+         }
+   };
+
+}
+
+dabc::PrefetchFileInterface::PrefetchFileInterface(FileInterface *inner, bool owner, unsigned depth, unsigned blocksize) :
+   FileInterface(),
+   fInner(inner),
+   fInnerOwner(owner),
+   fDepth(depth < 2 ? 2 : depth),
+   fBlockSize(blocksize < 0x1000 ? 0x1000 : blocksize)
+{
+   if (!fInner) {
+      fInner = new FileInterface;
+      fInnerOwner = true;
+   }
+}
+
+dabc::PrefetchFileInterface::~PrefetchFileInterface()
+{
+   fclose(fPrepared);
+   fPrepared = nullptr;
+
+   if (fHits + fMisses > 0)
+      DOUT2("File prefetch statistic: hits %lu misses %lu next files %lu", (long unsigned) fHits, (long unsigned) fMisses, (long unsigned) fPreparedHits);
+
+   if (fInnerOwner) delete fInner;
+   fInner = nullptr;
+}
+
+dabc::FileInterface::Handle dabc::PrefetchFileInterface::OpenReading(const char *fname, const char *opt)
+{
+   Handle f = fInner->fopen(fname, "r", opt);
+   if (!f) return nullptr;
+
+   PrefetchHandle *h = new PrefetchHandle;
+   h->fInner = fInner;
+   h->fFile = f;
+   h->fName = fname;
+   h->fReading = true;
+   h->fDepth = fDepth;
+   h->fBlockSize = fBlockSize;
+   h->StartReader();
+
+   return h;
+}
+
+void dabc::PrefetchFileInterface::Prepare(const std::string &fname)
+{
+   if (fPrepared && (((PrefetchHandle *) fPrepared)->fName == fname)) return;
+
+   fclose(fPrepared);
+
+   // file opened by reader thread, caller does not wait
+   PrefetchHandle *h = new PrefetchHandle;
+   h->fInner = fInner;
+   h->fName = fname;
+   h->fReading = true;
+   h->fOpening = true;
+   h->fDepth = fDepth;
+   h->fBlockSize = fBlockSize;
+   h->StartReader();
+
+   fPrepared = h;
+}
+
+dabc::FileInterface::Handle dabc::PrefetchFileInterface::fopen(const char *fname, const char *mode, const char *opt)
+{
+   if (!fname || !mode) return nullptr;
+
+   if (*mode == 'r') {
+      if (fPrepared) {
+         Handle h = fPrepared;
+         fPrepared = nullptr;
+         if ((((PrefetchHandle *) h)->fName == fname) && ((PrefetchHandle *) h)->WaitOpened()) {
+            fPreparedHits++;
+            return h;
+         }
+         fclose(h);
+      }
+      return OpenReading(fname, opt);
+   }
+
+   Handle f = fInner->fopen(fname, mode, opt);
+   if (!f) return nullptr;
+
+   PrefetchHandle *h = new PrefetchHandle;
+   h->fInner = fInner;
+   h->fFile = f;
+   h->fName = fname;
+   return h;
+}
+
+void dabc::PrefetchFileInterface::fclose(Handle f)
+{
+   PrefetchHandle *h = (PrefetchHandle *) f;
+   if (!h) return;
+
+   h->StopReader();
+   if (h->fFile) fInner->fclose(h->fFile);
+   delete h;
+}
+
+size_t dabc::PrefetchFileInterface::fwrite(const void* ptr, size_t sz, size_t nmemb, Handle f)
+{
+   PrefetchHandle *h = (PrefetchHandle *) f;
+   if (!h || h->fReading) return 0;
+
+   return fInner->fwrite(ptr, sz, nmemb, h->fFile);
+}
+
+size_t dabc::PrefetchFileInterface::fread(void* ptr, size_t sz, size_t nmemb, Handle f)
+{
+   PrefetchHandle *h = (PrefetchHandle *) f;
+   if (!h || !ptr || !h->fReading || (sz == 0)) return 0;
+
+   char *tgt = (char *) ptr;
+   size_t total = sz * nmemb, done = 0;
+   bool waited = false;
+
+   LockGuard lock(h->fMutex);
+
+   while (done < total) {
+      if (!h->fReady.empty()) {
+         auto &front = h->fReady.front();
+         if (h->fOffset < front.size()) {
+            size_t portion = front.size() - h->fOffset;
+            if (portion > total - done) portion = total - done;
+            memcpy(tgt + done, front.data() + h->fOffset, portion);
+            done += portion;
+            h->fOffset += portion;
+         } else {
+            // first block fully consumed and more data required
+            h->fBase += front.size();
+            h->fOffset = 0;
+            h->fFree.splice(h->fFree.end(), h->fReady, h->fReady.begin());
+            h->fSpaceCond._DoFire();
+         }
+      } else if (h->fEnd) {
+         break;
+      } else {
+         waited = true;
+         h->fDataCond._DoWait(-1);
+      }
+   }
+
+   if (waited) fMisses++; else fHits++;
+
+   // like for normal file, partially read element is not counted
+   if (done < total) h->fEOF = true;
+
+   return done / sz;
+}
+
+bool dabc::PrefetchFileInterface::feof(Handle f)
+{
+   PrefetchHandle *h = (PrefetchHandle *) f;
+   if (!h) return false;
+   if (!h->fReading) return fInner->feof(h->fFile);
+
+   LockGuard lock(h->fMutex);
+   return h->fEOF;
+}
+
+bool dabc::PrefetchFileInterface::fflush(Handle f)
+{
+   PrefetchHandle *h = (PrefetchHandle *) f;
+   return h && !h->fReading ? fInner->fflush(h->fFile) : false;
+}
+
+bool dabc::PrefetchFileInterface::fseek(Handle f, long int offset, bool relative)
+{
+   PrefetchHandle *h = (PrefetchHandle *) f;
+   if (!h) return false;
+   if (!h->fReading) return fInner->fseek(h->fFile, offset, relative);
+
+   LockGuard lock(h->fMutex);
+
+   uint64_t curr = h->fBase + h->fOffset, target = offset;
+   if (relative) {
+      if ((offset < 0) && ((uint64_t) -offset > curr)) return false;
+      target = curr + offset;
+   } else if (offset < 0) {
+      return false;
+   }
+
+   uint64_t end = h->fBase;
+   for (auto &blk : h->fReady)
+      end += blk.size();
+
+   if ((target >= h->fBase) && (target <= end)) {
+      // target position is inside prefetched data
+      while (!h->fReady.empty() && (target >= h->fBase + h->fReady.front().size())) {
+         h->fBase += h->fReady.front().size();
+         h->fFree.splice(h->fFree.end(), h->fReady, h->fReady.begin());
+         h->fSpaceCond._DoFire();
+      }
+      h->fOffset = target - h->fBase;
+   } else {
+      h->_Reset(target);
+   }
+
+   h->fEOF = false;
+   return true;
+}
+
+bool dabc::PrefetchFileInterface::fallocate(Handle f, uint64_t size)
+{
+   PrefetchHandle *h = (PrefetchHandle *) f;
+   return h && !h->fReading ? fInner->fallocate(h->fFile, size) : false;
+}
+
+bool dabc::PrefetchFileInterface::ftruncate(Handle f)
+{
+   PrefetchHandle *h = (PrefetchHandle *) f;
+   return h && !h->fReading ? fInner->ftruncate(h->fFile) : false;
+}
+
+int dabc::PrefetchFileInterface::GetFileIntPar(Handle f, const char *parname)
+{
+   PrefetchHandle *h = (PrefetchHandle *) f;
+   if (parname) {
+      if (!strcmp(parname, "PrefetchHits")) return (int) fHits;
+      if (!strcmp(parname, "PrefetchMisses")) return (int) fMisses;
+   }
+   return fInner->GetFileIntPar(h ? h->fFile : nullptr, parname);
+}
+
+bool dabc::PrefetchFileInterface::GetFileStrPar(Handle f, const char *parname, char* sbuf, int sbuflen)
+{
+   PrefetchHandle *h = (PrefetchHandle *) f;
+   return fInner->GetFileStrPar(h ? h->fFile : nullptr, parname, sbuf, sbuflen);
+}
@@ -17,6 +17,212 @@
 
 #ifdef DABC_PROFILER
 
+#include <list>
+#include <map>
+#include <cstring>
+
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "dabc/threads.h"
+#include "dabc/Thread.h"
+#include "dabc/Manager.h"
+#include "dabc/Record.h"
+
+namespace dabc {
+
+   /** Single begin or end event */
+   struct ProfilerEvent {
+      unsigned long long fClock{0};
+      char fPhase{0};
+      char fName[23];
+   };
+
+   /** Ring of events, filled only by owner thread */
+   struct ProfilerRing {
+      std::vector<ProfilerEvent> fEvents;
+      std::atomic<uint64_t> fHead{0};   ///< number of events ever written
+      Thread_t fThrd;                   ///< pthread id, used to find name of dabc thread
+      long fTid{0};                     ///< system thread id, shown in trace
+      std::string fName;                ///< system name of thread when ring was created
+      std::atomic<bool> fFinished{false}; ///< thread is finished, ring deleted after next dump
+
+      ProfilerRing(unsigned sz) : fEvents(sz) {}
+   };
+
+   /** Rings of all threads, ring of finished thread kept until its events are saved */
+   struct ProfilerTraceRegistry {
+      Mutex fMutex;
+      std::list<ProfilerRing *> fRings;
+      unsigned fRingSize{65536};
+      unsigned long long fStartClock{0};
+   };
+
+   static ProfilerTraceRegistry &GetTraceRegistry()
+   {
+      static ProfilerTraceRegistry *reg = new ProfilerTraceRegistry;
+      return *reg;
+   }
+
+   /** Ring of the thread, marked as finished when thread exits */
+   struct ProfilerRingHolder {
+      ProfilerRing *fRing{nullptr};
+      ~ProfilerRingHolder()
+      {
+         if (fRing) fRing->fFinished.store(true, std::memory_order_release);
+         fRing = nullptr;
+      }
+   };
+
+   static thread_local ProfilerRingHolder gProfilerRing;
+
+   /** Returns string, which can be placed in JSON in quotes */
+   static std::string ProfilerJsonStr(const std::string &str)
+   {
+      return RecordField::NeedJsonReformat(str) ? RecordField::JsonReformat(str) : str;
+   }
+
+}
+
+std::atomic<bool> dabc::ProfilerTrace::gActive{false};
+
+bool dabc::ProfilerTrace::AddEvent(char phase, unsigned long long clock, const char *name, unsigned slot)
+{
+   auto ring = gProfilerRing.fRing;
+
+   if (!ring) {
+      auto &reg = GetTraceRegistry();
+      LockGuard lock(reg.fMutex);
+      ring = new ProfilerRing(reg.fRingSize);
+      ring->fThrd = PosixThread::Self();
+      ring->fTid = syscall(SYS_gettid);
+      char sbuf[100];
+      if (pthread_getname_np(ring->fThrd, sbuf, sizeof(sbuf)) == 0)
+         ring->fName = sbuf;
+      reg.fRings.emplace_back(ring);
+      gProfilerRing.fRing = ring;
+   }
+
+   uint64_t head = ring->fHead.load(std::memory_order_relaxed);
+
+   auto &evnt = ring->fEvents[head % ring->fEvents.size()];
+   evnt.fClock = clock;
+   evnt.fPhase = phase;
+   if (name && *name) {
+      strncpy(evnt.fName, name, sizeof(evnt.fName) - 1);
+      evnt.fName[sizeof(evnt.fName) - 1] = 0;
+   } else {
+      snprintf(evnt.fName, sizeof(evnt.fName), "slot%u", slot);
+   }
+
+   ring->fHead.store(head + 1, std::memory_order_release);
+
+   return true;
+}
+
+void dabc::ProfilerTrace::Start(unsigned ringsize)
+{
+   auto &reg = GetTraceRegistry();
+
+   {
+      LockGuard lock(reg.fMutex);
+      // size only used for new rings
+      reg.fRingSize = ringsize < 1024 ? 1024 : ringsize;
+      reg.fStartClock = TimeStamp::GetFastClock();
+   }
+
+   gActive = true;
+}
+
+void dabc::ProfilerTrace::Stop()
+{
+   gActive = false;
+}
+
+std::string dabc::ProfilerTrace::MakeJSON(unsigned *numevents)
+{
+   auto &reg = GetTraceRegistry();
+
+   // full names of dabc threads
+   std::map<Thread_t, std::string> names;
+   if (dabc::mgr()) {
+      Reference folder = dabc::mgr.FindChild(Manager::ThreadsFolderName());
+      for (unsigned n = 0; n < folder.NumChilds(); n++) {
+         ThreadRef thrd = folder.GetChild(n);
+         if (!thrd.null()) names[thrd()->Id()] = thrd.GetName();
+      }
+   }
+
+   int pid = getpid();
+   unsigned cnt = 0;
+   double mult = TimeStamp::gFastClockMult * 1e6;
+
+   std::string res = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+   LockGuard lock(reg.fMutex);
+
+   std::vector<ProfilerEvent> events;
+
+   for (auto ring : reg.fRings) {
+      bool finished = ring->fFinished.load(std::memory_order_acquire);
+
+      std::string name = ring->fName;
+      for (auto &item : names)
+         if (pthread_equal(item.first, ring->fThrd))
+            name = item.second;
+      if (name.empty()) name = dabc::format("thread%ld", ring->fTid);
+
+      if (ring != reg.fRings.front()) res.append(",");
+      res.append(dabc::format("\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%ld,\"args\":{\"name\":\"%s\"}}",
+                              pid, ring->fTid, ProfilerJsonStr(name).c_str()));
+
+      uint64_t size = ring->fEvents.size(),
+               head = ring->fHead.load(std::memory_order_acquire),
+               base = head > size ? head - size : 0;
+
+      events.resize(head - base);
+      for (uint64_t n = base; n < head; n++)
+         events[n - base] = ring->fEvents[n % size];
+
+      // ring can be filled while events are copied, exclude events which could be overwritten
+      uint64_t first = base, head2 = ring->fHead.load(std::memory_order_acquire);
+      if (head2 + 1 > first + size) first = head2 + 1 - size;
+
+      int depth = 0;
+
+      for (uint64_t n = first; n < head; n++) {
+         auto &evnt = events[n - base];
+         if (evnt.fClock < reg.fStartClock) continue;
+
+         // skip end events without begin
+         if (evnt.fPhase == 'B') {
+            depth++;
+         } else {
+            if (depth == 0) continue;
+            depth--;
+         }
+
+         res.append(dabc::format(",\n{\"name\":\"%s\",\"cat\":\"dabc\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%ld}",
+                                 ProfilerJsonStr(evnt.fName).c_str(), evnt.fPhase, (evnt.fClock - TimeStamp::gFastClockZero) * mult, pid, ring->fTid));
+         cnt++;
+      }
+
+      // events of finished thread are saved, ring is not required any longer
+      if (finished) ring->fEvents.clear();
+   }
+
+   reg.fRings.remove_if([](ProfilerRing *ring) {
+      if (ring->fEvents.empty()) { delete ring; return true; }
+      return false;
+   });
+
+   res.append("\n]}\n");
+
+   if (numevents) *numevents = cnt;
+
+   return res;
+}
+
 void dabc::Profiler::MakeStatistic()
 {
 
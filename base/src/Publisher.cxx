@@ -93,6 +93,78 @@ dabc::PublisherEntry::~PublisherEntry()
 
 // ======================================================================
 
+namespace dabc {
+
+   /** Search item in snapshots, same as Publisher::IdentifyItem() when producer is not requested */
+   static bool FindSnapshotItem(Hierarchy &local, Hierarchy &global, const std::string &itemname, bool &islocal, std::string &item_name, std::string &request_name)
+   {
+      std::string item1 = itemname, sub;
+
+      while (!item1.empty()) {
+         Hierarchy h = local.GetFolder(item1);
+         islocal = !h.null();
+         if (h.null() && !global.null()) h = global.GetFolder(item1);
+
+         if (!h.null()) {
+            item_name = item1;
+            request_name = sub;
+            return true;
+         }
+
+         if (item1.length() < 2) break;
+
+         size_t pos = item1.find_last_of("/", item1.length()-2);
+         if (pos == std::string::npos) break;
+
+         std::string part = item1.substr(pos+1); // keep slash
+         item1.resize(pos+1);
+
+         if (!part.empty() && !sub.empty() && (part[part.length()-1] != '/')) part.append("/");
+         sub = part + sub;
+      }
+
+      return false;
+   }
+
+   /** Define user interface kind for the item, used by http server */
+   static std::string DefineUIKind(Hierarchy &h, bool islocal, const std::string &item_name, std::string request_name, std::string &path, std::string &fname)
+   {
+      if (islocal && h.Field(dabc::prop_kind).AsStr()=="DABC.HTML") {
+         path = h.GetField("_UserFilePath").AsStr();
+         if (request_name.empty()) request_name = h.GetField("_UserFileMain").AsStr();
+         fname = request_name;
+         return "__user__";
+      }
+
+      path = item_name;
+      fname = request_name;
+
+      // publisher can only identify existing entries
+      // all extra entries (like objects members in Go4 events browser) appears as subfolders in request
+      size_t pos = request_name.rfind("/");
+      if ((pos != std::string::npos) && (pos != request_name.length()-1)) {
+         path = item_name + request_name.substr(0, pos);
+         fname = request_name.substr(pos+1);
+      }
+
+      return "";
+   }
+
+   /** Returns 1 - need auth,  0 - no need auth, -1 - undefined */
+   static int DefineNeedAuth(Hierarchy h)
+   {
+      while (!h.null()) {
+         if (h.HasField(dabc::prop_auth))
+            return h.GetField(dabc::prop_auth).AsBool() ? 1 : 0;
+
+         h = h.GetParentRef();
+      }
+
+      return -1;
+   }
+
+}
+
 dabc::Publisher::Publisher(const std::string &name, dabc::Command cmd) :
    dabc::Worker(MakePair(name)),
    fGlobal(),
@@ -122,6 +194,67 @@ dabc::Publisher::Publisher(const std::string &name, dabc::Command cmd) :
 
 dabc::Publisher::~Publisher()
 {
+   LockGuard lock(fSnapshotMutex);
+   fLocalSnapshot.Release();
+   fGlobalSnapshot.Release();
+   fItemSnapshots.clear();
+}
+
+bool dabc::Publisher::GetSnapshots(Hierarchy &local, Hierarchy &global)
+{
+   LockGuard lock(fSnapshotMutex);
+   local = fLocalSnapshot;
+   global = fGlobalSnapshot;
+   return !local.null();
+}
+
+void dabc::Publisher::MakeSnapshots(bool global_changed)
+{
+   Hierarchy local;
+
+   if (fLocal.GetVersion() != fSnapshotVers) {
+      // copy of local hierarchy, only fields and childs are copied
+      local.Create(fLocal.GetName());
+      local.Duplicate(fLocal);
+      fSnapshotVers = fLocal.GetVersion();
+   } else if (!global_changed) {
+      return;
+   }
+
+   // global hierarchy is never modified after creation, therefore it is used as is
+   LockGuard lock(fSnapshotMutex);
+   if (!local.null()) fLocalSnapshot << local;
+   if (global_changed) fGlobalSnapshot = fGlobal;
+}
+
+void dabc::Publisher::SetItemSnapshot(const std::string &path, const Hierarchy &snap)
+{
+   LockGuard lock(fSnapshotMutex);
+   if (snap.null())
+      fItemSnapshots.erase(path);
+   else
+      fItemSnapshots[path] = snap;
+}
+
+dabc::Hierarchy dabc::Publisher::GetItemSnapshot(const std::string &itemname, std::string &subitem)
+{
+   LockGuard lock(fSnapshotMutex);
+
+   fWithItemSnapshots = true;
+
+   // select hierarchy with longest path, which contains item
+   auto found = fItemSnapshots.end();
+   for (auto iter = fItemSnapshots.begin(); iter != fItemSnapshots.end(); iter++) {
+      const std::string &path = iter->first;
+      if ((itemname.compare(0, path.length(), path) != 0) ||
+          ((itemname.length() > path.length()) && (path[path.length()-1] != '/') && (itemname[path.length()] != '/'))) continue;
+      if ((found == fItemSnapshots.end()) || (path.length() > found->first.length())) found = iter;
+   }
+
+   if (found == fItemSnapshots.end()) return Hierarchy();
+
+   subitem = itemname.substr(found->first.length());
+   return found->second;
 }
 
 
@@ -170,6 +303,11 @@ double dabc::Publisher::ProcessTimeout(double)
    // when application terminated - do not try to update any records
    if (dabc::mgr.IsTerminated()) return -1;
 
+   // pushes may require more frequent timeout, publishers scanned with 0.5 s period
+   double spent = fLastScanTm.SpentTillNow();
+   if ((spent > 0) && (spent < 0.45)) return ProcessPushes(0.5 - spent);
+   fLastScanTm.GetNow();
+
    bool is_any_global = false;
    bool rebuild_global = fLocal.GetVersion() > fLastLocalVers;
 /*
@@ -242,6 +380,11 @@ double dabc::Publisher::ProcessTimeout(double)
          cmd.SetUInt("version", iter->version);
          cmd.SetPtr("hierarchy", iter->hier);
          cmd.SetUInt("recid", iter->id);
+         {
+            LockGuard lock(fSnapshotMutex);
+            cmd.SetBool("snapshot", fWithItemSnapshots);
+         }
+         cmd.SetUInt("snapvers", iter->snapvers);
          if (iter->store && iter->store->CheckForNextStore(storetm, fStorePeriod, fTimeLimit)) {
             cmd.SetPtr("store", iter->store);
             dostore = true;
@@ -260,8 +403,11 @@ double dabc::Publisher::ProcessTimeout(double)
 //      DOUT0("Submit command to worker %s id %u", iter->worker.c_str(), iter->id);
    }
 
+   bool global_changed = false;
+
    if (rebuild_global && is_any_global) {
       // recreate global structures again
+      global_changed = true;
 
       fGlobal.Release();
       fGlobal.Create("Global");
@@ -285,10 +431,20 @@ double dabc::Publisher::ProcessTimeout(double)
       //DOUT0("GLOBAL\n%s", fGlobal.SaveToXml().c_str());
    } else
    if (!is_any_global) {
+      global_changed = !fGlobal.null();
       fGlobal.Release();
       fLastLocalVers = 0;
    }
 
+   MakeSnapshots(global_changed);
+
+   // remove JSON for items which are not requested for long time
+   for (auto iter = fJsonCache.begin(); iter != fJsonCache.end();)
+      if (iter->second.lastused.Expired(60.))
+         iter = fJsonCache.erase(iter);
+      else
+         iter++;
+
    for (auto &entry : fSubscribers) {
       if (entry.waiting_worker) continue;
 
@@ -297,7 +453,255 @@ double dabc::Publisher::ProcessTimeout(double)
       // here direct request can be submitted, do it later, may be even not here
    }
 
-   return 0.5;
+   return ProcessPushes(0.5);
+}
+
+double dabc::Publisher::ProcessPushes(double tmout)
+{
+   for (auto &push : fPushes) {
+      if (push.period < tmout) tmout = push.period;
+
+      if (push.waiting || !push.lastcheck.Expired(push.period)) continue;
+
+      push.lastcheck.GetNow();
+      push.waiting = true;
+
+      // worker provides only nodes changed after last delivered version
+      std::string query = "childs";
+      if (push.version > 0) query += dabc::format("&version=%lu", (long unsigned) push.version + 1);
+
+      CmdGetBinary cmd(push.item, "hierarchy", query);
+      cmd.SetReceiver(push.worker);
+      cmd.SetPtr("hierarchy", push.hier);
+      cmd.SetStr("subitem", push.subitem);
+      cmd.SetUInt("#push_id", push.id);
+      cmd.SetTimeout(10.);
+      dabc::mgr.Submit(Assign(cmd));
+   }
+
+   return tmout;
+}
+
+void dabc::Publisher::ProcessPushReply(Command cmd)
+{
+   unsigned id = cmd.GetUInt("#push_id");
+
+   auto iter = fPushes.begin();
+   while ((iter != fPushes.end()) && (iter->id != id)) iter++;
+   if (iter == fPushes.end()) return;
+
+   if (cmd.IsName(CmdGetBinary::CmdName())) {
+      uint64_t version = cmd.GetUInt("version");
+
+      if ((cmd.GetResult() != cmd_true) || ((version == iter->version) && !iter->lastpush.Expired(iter->keepalive))) {
+         iter->waiting = false;
+         return;
+      }
+
+      // without changes only keep-alive message is send
+      CmdPushDiff push(iter->subid, iter->version, version);
+      if (version != iter->version) push.SetRawData(cmd.GetRawData());
+      push.SetReceiver(iter->subscriber);
+      push.SetUInt("#push_id", iter->id);
+      push.SetUInt("#push_version", version);
+      push.SetTimeout(10.);
+      dabc::mgr.Submit(Assign(push));
+      return;
+   }
+
+   // reply from subscriber
+   iter->waiting = false;
+
+   if (cmd.GetResult() == cmd_true) {
+      iter->version = cmd.GetUInt("#push_version");
+      iter->lastpush.GetNow();
+      iter->errcnt = 0;
+   } else if ((cmd.GetResult() == cmd_false) || (++iter->errcnt > 3)) {
+      DOUT2("Stop pushing item %s to %s", iter->item.c_str(), iter->subscriber.c_str());
+      fPushes.erase(iter);
+   }
+}
+
+int dabc::Publisher::AddPushEntry(Command cmd)
+{
+   std::string itemname = cmd.GetStr("Item"), producer_name, request_name;
+   bool islocal = true;
+
+   if (!IdentifyItem(true, itemname, islocal, producer_name, request_name)) {
+      DOUT2("Not found producer for item %s", itemname.c_str());
+      return cmd_false;
+   }
+
+   bool producer_local = true;
+   std::string producer_server, producer_item;
+
+   if (!dabc::mgr.DecomposeAddress(producer_name, producer_local, producer_server, producer_item)) {
+      EOUT("Wrong address specified as producer %s", producer_name.c_str());
+      return cmd_false;
+   }
+
+   if (!islocal && !producer_local) {
+      // diffs should be produced by publisher on the node where item is produced
+      if (cmd.GetBool("analyzed")) {
+         EOUT("Subscription to item %s already was analyzed - something went wrong", itemname.c_str());
+         return cmd_false;
+      }
+      cmd.SetReceiver(dabc::mgr.ComposeAddress(producer_server, dabc::Publisher::DfltName()));
+      cmd.SetBool("analyzed", true);
+      dabc::mgr.Submit(cmd);
+      return cmd_postponed;
+   }
+
+   for (auto &entry : fPublishers) {
+      if (!entry.local) continue;
+
+      if ((entry.worker != producer_item) && (entry.worker != std::string("/") + producer_item)) continue;
+
+      std::string subscriber = cmd.GetStr("Subscriber");
+
+      // repeated subscription replaces previous one
+      fPushes.remove_if([&subscriber, &itemname](const PushEntry &push) { return (push.subscriber == subscriber) && (push.item == itemname); });
+
+      fPushes.emplace_back();
+      PushEntry &push = fPushes.back();
+      push.id = fCnt++;
+      push.item = itemname;
+      push.worker = entry.worker;
+      push.subitem = request_name;
+      push.hier = entry.hier;
+      push.subscriber = subscriber;
+      push.subid = cmd.GetInt("SubId");
+      push.period = cmd.GetDouble("Period", 1.);
+      push.keepalive = cmd.GetDouble("KeepAlive", 5.);
+      if (push.period < 0.05) push.period = 0.05;
+      if (push.keepalive < push.period) push.keepalive = push.period;
+
+      DOUT2("Push item %s to %s period %3.1f", itemname.c_str(), subscriber.c_str(), push.period);
+
+      ActivateTimeout(0.);
+
+      return cmd_true;
+   }
+
+   EOUT("Not found producer %s, which is correspond to item %s", producer_item.c_str(), itemname.c_str());
+   return cmd_false;
+}
+
+int dabc::Publisher::StartMultiGet(Command cmd)
+{
+   std::string path = cmd.GetStr("Path"), query = cmd.GetStr("Query");
+
+   double tmout = cmd.IsTimeoutSet() ? cmd.TimeTillTimeout()*0.9 : 5.;
+   if (tmout <= 0.) return cmd_timedout;
+
+   fMultiGets.emplace_back();
+   MultiGetEntry &entry = fMultiGets.back();
+   entry.id = fCnt++;
+   entry.cmd = cmd;
+   entry.items = cmd.GetField("Items").AsStrVect();
+   entry.results.resize(entry.items.size());
+
+   // all requests submitted at once, they are processed by producers concurrently
+   for (unsigned n = 0; n < entry.items.size(); ++n) {
+      std::string itemname = path + entry.items[n];
+
+      CmdGetBinary subcmd(itemname, "get.json", query);
+      subcmd.SetUInt("#multi_id", entry.id);
+      subcmd.SetUInt("#multi_indx", n);
+      subcmd.SetStr("#cache_key", itemname + "?" + query);
+
+      // producer replies without data if item not changed since cached version
+      auto iter = fJsonCache.find(subcmd.GetStr("#cache_key"));
+      if (iter != fJsonCache.end()) {
+         subcmd.SetUInt("CacheVersion", iter->second.version);
+         iter->second.lastused.GetNow();
+      } else {
+         subcmd.SetUInt("CacheVersion", 0);
+      }
+
+      subcmd.SetTimeout(tmout);
+
+      // reply delivered via event queue, also for not found items
+      entry.waiting++;
+      if (!RedirectCommand(Assign(subcmd), itemname))
+         subcmd.Reply(cmd_false);
+   }
+
+   if (entry.waiting == 0) ProcessMultiGetReply(Command());
+
+   return cmd_postponed;
+}
+
+int dabc::Publisher::ExecuteGetSerie(Command cmd)
+{
+   if (!DoStorage()) return cmd_false;
+
+   DateTime from, till;
+   if (cmd.GetUInt("From") > 0) from.SetJSDate(cmd.GetUInt("From"));
+   if (cmd.GetUInt("Till") > 0) till.SetJSDate(cmd.GetUInt("Till"));
+
+   HierarchyReading rr;
+   rr.SetBasePath(fStoreDir);
+
+   Hierarchy res = rr.GetSerieValues(cmd.GetStr("Item"), from, till, cmd.GetUInt("MaxPoints"));
+   if (res.null()) return cmd_false;
+
+   cmd.SetStrRawData(res.SaveToJson(dabc::storemask_Compact));
+
+   return cmd_true;
+}
+
+void dabc::Publisher::ProcessMultiGetReply(Command cmd)
+{
+   auto iter = fMultiGets.begin();
+
+   if (!cmd.null()) {
+      unsigned id = cmd.GetUInt("#multi_id"), indx = cmd.GetUInt("#multi_indx");
+
+      while ((iter != fMultiGets.end()) && (iter->id != id)) iter++;
+      if (iter == fMultiGets.end()) return;
+
+      if ((cmd.GetResult() == cmd_true) && (indx < iter->results.size())) {
+         std::string key = cmd.GetStr("#cache_key");
+         CachedJson &cache = fJsonCache[key];
+         if (cmd.GetBool("NotChanged")) {
+            iter->results[indx] = cache.json;
+         } else {
+            dabc::Buffer buf = cmd.GetRawData();
+            if (!buf.null())
+               iter->results[indx].assign((const char *) buf.SegmentPtr(), buf.SegmentSize());
+            cache.version = cmd.GetUInt("CacheVersion");
+            cache.json = iter->results[indx];
+         }
+         cache.lastused.GetNow();
+         // do not keep items without version information
+         if (cache.version == 0) fJsonCache.erase(key);
+      }
+
+      if (iter->waiting > 0) iter->waiting--;
+   }
+
+   while (iter != fMultiGets.end()) {
+      if (iter->waiting > 0) {
+         if (!cmd.null()) return;
+         iter++;
+         continue;
+      }
+
+      std::string res = "[";
+      for (unsigned n = 0; n < iter->items.size(); ++n) {
+         if (n > 0) res.append(",");
+         res.append(dabc::format("{ \"item\": \"%s\", \"result\":", iter->items[n].c_str()));
+         res.append(iter->results[n].empty() ? "null" : iter->results[n]);
+         res.append("}");
+      }
+      res.append("]");
+
+      iter->cmd.SetStrRawData(res);
+      iter->cmd.Reply(cmd_true);
+      iter = fMultiGets.erase(iter);
+      if (!cmd.null()) return;
+   }
 }
 
 void dabc::Publisher::CheckDnsSubscribers()
@@ -364,9 +768,26 @@ bool dabc::Publisher::ApplyEntryDiff(unsigned recid, dabc::Buffer& diff, uint64_
 
 bool dabc::Publisher::ReplyCommand(Command cmd)
 {
+   if (cmd.HasField("#push_id")) {
+      ProcessPushReply(cmd);
+      return true;
+   } else
+   if (cmd.HasField("#multi_id")) {
+      ProcessMultiGetReply(cmd);
+      return true;
+   } else
    if (cmd.IsName(CmdPublisher::CmdName())) {
       dabc::Buffer diff = cmd.GetRawData();
 
+      Hierarchy snap = cmd.GetRef("snapshot");
+      if (!snap.null())
+         for (auto &entry : fPublishers)
+            if (entry.id == cmd.GetUInt("recid")) {
+               entry.snapvers = cmd.GetUInt("version");
+               SetItemSnapshot(entry.path, snap);
+               break;
+            }
+
       ApplyEntryDiff(cmd.GetUInt("recid"), diff, cmd.GetUInt("version"), cmd.GetResult() != cmd_true);
 
       return true;
@@ -682,6 +1103,9 @@ int dabc::Publisher::ExecuteCommand(Command cmd)
                   DOUT1("Create store for %s", path.c_str());
                   fPublishers.back().store = new HierarchyStore();
                   fPublishers.back().store->SetBasePath(fStoreDir + path);
+                  // chunk of time index filled several times before store file is flushed
+                  if (fStorePeriod > 0)
+                     fPublishers.back().store->SetChunkSize((unsigned) (fTimeLimit / fStorePeriod / 4));
                }
             }
 
@@ -701,6 +1125,7 @@ int dabc::Publisher::ExecuteCommand(Command cmd)
                   if (!fLocal.RemoveEmptyFolders(path))
                      EOUT("Not found local entry with path %s", path.c_str());
 
+                  SetItemSnapshot(path, Hierarchy());
                   fPublishers.erase(iter);
                   find = true;
                   break;
@@ -755,7 +1180,10 @@ int dabc::Publisher::ExecuteCommand(Command cmd)
             while (iter!=fPublishers.end()) {
                if (iter->worker == worker) {
                   DOUT2("Publisher removes path %s of worker %s", iter->path.c_str(), worker.c_str());
-                  if (iter->local) fLocal.GetFolder(iter->path).Destroy();
+                  if (iter->local) {
+                     fLocal.GetFolder(iter->path).Destroy();
+                     SetItemSnapshot(iter->path, Hierarchy());
+                  }
                   fPublishers.erase(iter++);
                } else {
                   iter++;
@@ -770,6 +1198,8 @@ int dabc::Publisher::ExecuteCommand(Command cmd)
                   iter2++;
             }
 
+            fPushes.remove_if([&worker](const PushEntry &push) { return push.worker == worker; });
+
             return cmd_true;
          }
 
@@ -830,6 +1260,12 @@ int dabc::Publisher::ExecuteCommand(Command cmd)
 
       return cmd_true;
    } else
+   if (cmd.IsName(CmdSubscribeDiff::CmdName())) {
+      return AddPushEntry(cmd);
+   } else
+   if (cmd.IsName(CmdMultiGet::CmdName())) {
+      return StartMultiGet(cmd);
+   } else
    if (cmd.IsName("CreateExeCmd")) {
 
       dabc::Command res = CreateExeCmd(cmd.GetStr("path"), cmd.GetStr("query"));
@@ -849,50 +1285,26 @@ int dabc::Publisher::ExecuteCommand(Command cmd)
 
       dabc::Hierarchy h = GetWorkItem(item_name);
 
-      if (islocal && h.Field(dabc::prop_kind).AsStr()=="DABC.HTML") {
-         cmd.SetStr("ui_kind", "__user__");
-         cmd.SetStr("path", h.GetField("_UserFilePath").AsStr());
-         if (request_name.empty()) request_name = h.GetField("_UserFileMain").AsStr();
-         cmd.SetStr("fname", request_name);
-      } else {
-         cmd.SetStr("path", item_name);
-         cmd.SetStr("fname", request_name);
-
-         //if (request_name.empty())
-         //   cmd.SetStr("ui_kind", h.NumChilds() > 0 ? "__tree__" : "__single__");
-
-         // publisher can only identify existing entries
-         // all extra entries (like objects members in Go4 events browser) appears as subfolders in request
-         size_t pos = request_name.rfind("/");
-         if ((pos != std::string::npos) && (pos != request_name.length()-1)) {
-            cmd.SetStr("path", item_name + request_name.substr(0, pos));
-            cmd.SetStr("fname", request_name.substr(pos+1));
-         }
-      }
+      std::string path, fname, kind = DefineUIKind(h, islocal, item_name, request_name, path, fname);
+
+      if (!kind.empty()) cmd.SetStr("ui_kind", kind);
+      cmd.SetStr("path", path);
+      cmd.SetStr("fname", fname);
 
       return cmd_true;
 
    } else
    if (cmd.IsName("CmdNeedAuth")) {
       std::string path = cmd.GetStr("path");
-      dabc::Hierarchy h = GetWorkItem(path);
-
-      int res = -1;
-
-      while (!h.null()) {
-         if (h.HasField(dabc::prop_auth)) {
-            res = h.GetField(dabc::prop_auth).AsBool() ? 1 : 0;
-            break;
-         }
 
-         h = h.GetParentRef();
-      }
-
-      cmd.SetInt("need_auth", res);
+      cmd.SetInt("need_auth", DefineNeedAuth(GetWorkItem(path)));
 
       return cmd_true;
    }
 
+   if (cmd.IsName(CmdGetSerie::CmdName()))
+      return ExecuteGetSerie(cmd);
+
    if (cmd.IsName(CmdGetBinary::CmdName())) {
 
       // if we get command here, we need to find destination for it
@@ -958,6 +1370,20 @@ std::string dabc::PublisherRef::UserInterfaceKind(const char *uri, std::string&
 {
    if (null()) return "__error__";
 
+   Hierarchy local, global;
+   if (GetObject()->GetSnapshots(local, global)) {
+      bool islocal = true;
+      std::string item_name, request_name;
+
+      if (uri && *uri)
+         if (!FindSnapshotItem(local, global, uri, islocal, item_name, request_name)) return "__error__";
+
+      Hierarchy h = global.null() ? local : global;
+      if (!item_name.empty() && (item_name != "/")) h = h.FindChild(item_name.c_str());
+
+      return DefineUIKind(h, islocal, item_name, request_name, path, fname);
+   }
+
    dabc::Command cmd("CmdUIKind");
    cmd.SetStr("uri", uri);
 
@@ -972,6 +1398,13 @@ int dabc::PublisherRef::NeedAuth(const std::string &path)
 {
    if (null()) return -1;
 
+   Hierarchy local, global;
+   if (GetObject()->GetSnapshots(local, global)) {
+      Hierarchy h = global.null() ? local : global;
+      if (!path.empty() && (path != "/")) h = h.FindChild(path.c_str());
+      return DefineNeedAuth(h);
+   }
+
    dabc::Command cmd("CmdNeedAuth");
    cmd.SetStr("path", path);
 
@@ -982,6 +1415,27 @@ int dabc::PublisherRef::NeedAuth(const std::string &path)
 
 
 
+int dabc::PublisherRef::ExecuteNamesList(Command cmd)
+{
+   if (null()) return cmd_false;
+
+   Hierarchy local, global;
+   if (GetObject()->GetSnapshots(local, global)) {
+      std::string path = cmd.GetStr("path");
+
+      Hierarchy h = global.null() ? local : global;
+      if (!path.empty() && (path != "/")) h = h.FindChild(path.c_str());
+
+      // only when item can be extended, publisher should be involved
+      if (!h.null() && !h.HasField(dabc::prop_more) && (cmd.GetStr("query").find("more") == std::string::npos)) {
+         CmdGetNamesList::SetResNamesList(cmd, h);
+         return cmd_true;
+      }
+   }
+
+   return Execute(cmd);
+}
+
 dabc::Command dabc::PublisherRef::ExeCmd(const std::string &fullname, const std::string &query)
 {
    dabc::Command res;
@@ -1004,10 +1458,28 @@ dabc::Command dabc::PublisherRef::ExeCmd(const std::string &fullname, const std:
 }
 
 
+bool dabc::PublisherRef::GetItemReply(const std::string &fullname, const std::string &kind, const std::string &query, std::string &reply)
+{
+   if (null() || !Worker::IsItemReplyKind(kind)) return false;
+
+   // history and versions only available in original hierarchy
+   if ((query.find("history") != std::string::npos) || (query.find("version") != std::string::npos)) return false;
+
+   std::string subitem;
+   Hierarchy snap = GetObject()->GetItemSnapshot(fullname, subitem);
+   if (snap.null()) return false;
+
+   return Worker::ProduceItemReply(snap, subitem, kind, query, Command(), reply) == cmd_true;
+}
+
 dabc::Buffer dabc::PublisherRef::GetBinary(const std::string &fullname, const std::string &kind, const std::string &query, double tmout)
 {
    if (null()) return nullptr;
 
+   std::string reply;
+   if (GetItemReply(fullname, kind, query, reply))
+      return Buffer::CreateBuffer(reply.c_str(), reply.length(), false, true);
+
    CmdGetBinary cmd(fullname, kind, query);
    cmd.SetTimeout(tmout);
 
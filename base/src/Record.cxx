@@ -17,6 +17,7 @@
 
 #include <cstring>
 #include <cstdlib>
+#include <algorithm>
 #include <fnmatch.h>
 
 #include "dabc/Manager.h"
@@ -110,6 +111,48 @@ bool dabc::iostream::read_str(std::string& str)
    return verify_size(pos, sz);
 }
 
+bool dabc::iostream::write_varint(uint64_t v)
+{
+   uint8_t buf[10];
+   unsigned len = 0;
+   while (v >= 0x80) {
+      buf[len++] = (uint8_t) (v | 0x80);
+      v >>= 7;
+   }
+   buf[len++] = (uint8_t) v;
+   return write(buf, len);
+}
+
+bool dabc::iostream::read_varint(uint64_t& v)
+{
+   v = 0;
+   for (unsigned shift = 0; shift < 64; shift += 7) {
+      uint8_t b = 0;
+      if (!read(&b, 1)) return false;
+      v |= ((uint64_t) (b & 0x7f)) << shift;
+      if ((b & 0x80) == 0) return true;
+   }
+   EOUT("Wrong varint value in the stream");
+   return false;
+}
+
+bool dabc::iostream::write_varstr(const std::string &str)
+{
+   return write_varint(str.length()) && write(str.c_str(), str.length());
+}
+
+bool dabc::iostream::read_varstr(std::string& str)
+{
+   uint64_t len = 0;
+   if (!read_varint(len)) return false;
+   if (len > tmpbuf_size()) {
+      EOUT("Cannot read complete string!!!");
+      return false;
+   }
+   str.assign(tmpbuf(), len);
+   return shift(len);
+}
+
 // ===========================================================================
 
 bool dabc::memstream::shift(uint64_t len)
@@ -311,6 +354,7 @@ dabc::RecordField::RecordField(const RecordField& src)
    fKind = kind_none;
    fModified = false;
    fTouched = false;
+   fProtected = false;
 
    switch (src.fKind) {
       case kind_none: break;
@@ -454,6 +498,109 @@ bool dabc::RecordField::Stream(iostream& s)
    return s.verify_size(pos, sz);
 }
 
+bool dabc::RecordField::StreamCompact(iostream& s)
+{
+   // kind stored as single byte, special value means that normal streamer was used
+   const uint8_t kind_streamed = 0xff;
+
+   if (s.is_output()) {
+      uint8_t kind = (uint8_t) fKind;
+      switch (fKind) {
+         case kind_none:
+            return s.write(&kind, 1);
+         case kind_bool: {
+            uint8_t v = valueInt ? 1 : 0;
+            return s.write(&kind, 1) && s.write(&v, 1);
+         }
+         case kind_int:
+            // zigzag encoding, small negative values also use few bytes
+            return s.write(&kind, 1) && s.write_varint((((uint64_t) valueInt) << 1) ^ (uint64_t) (valueInt >> 63));
+         case kind_datime:
+         case kind_uint:
+            return s.write(&kind, 1) && s.write_varint(valueUInt);
+         case kind_double:
+            return s.write(&kind, 1) && s.write_double(valueDouble);
+         case kind_string: {
+            uint64_t len = strlen(valueStr);
+            return s.write(&kind, 1) && s.write_varint(len) && s.write(valueStr, len);
+         }
+         default: {
+            // normal streamer requires 8-byte aligned position in the stream
+            uint64_t zero = 0;
+            if (!s.write(&kind_streamed, 1)) return false;
+            uint64_t pad = (8 - s.size() % 8) % 8;
+            return ((pad == 0) || s.write(&zero, pad)) && Stream(s);
+         }
+      }
+   }
+
+   release();
+
+   uint8_t kind = 0;
+   if (!s.read(&kind, 1)) return false;
+
+   if (kind == kind_streamed) {
+      uint64_t pad = (8 - s.size() % 8) % 8;
+      return ((pad == 0) || s.shift(pad)) && Stream(s);
+   }
+
+   switch (kind) {
+      case kind_none:
+         return true;
+      case kind_bool: {
+         uint8_t v = 0;
+         if (!s.read(&v, 1)) return false;
+         valueInt = v ? 1 : 0;
+         break;
+      }
+      case kind_int: {
+         uint64_t v = 0;
+         if (!s.read_varint(v)) return false;
+         valueInt = (int64_t) (v >> 1) ^ -((int64_t) (v & 1));
+         break;
+      }
+      case kind_datime:
+      case kind_uint:
+         if (!s.read_varint(valueUInt)) return false;
+         break;
+      case kind_double:
+         if (!s.read_double(valueDouble)) return false;
+         break;
+      case kind_string: {
+         // length validated against rest of the stream
+         std::string str;
+         if (!s.read_varstr(str)) return false;
+         valueStr = (char *) std::malloc(str.length() + 1);
+         if (!valueStr) return false;
+         memcpy(valueStr, str.c_str(), str.length() + 1);
+         break;
+      }
+      default:
+         EOUT("Wrong field kind %u in compact stream", (unsigned) kind);
+         return false;
+   }
+
+   fKind = (ValueKind) kind;
+   return true;
+}
+
+void dabc::RecordField::steal(RecordField &src)
+{
+   if (&src == this) return;
+
+   release();
+
+   fKind = src.fKind;
+   valueUInt = src.valueUInt;
+   valueStr = src.valueStr;
+   fModified = src.fModified;
+   fTouched = src.fTouched;
+   fProtected = src.fProtected;
+
+   src.fKind = kind_none;
+   src.valueStr = nullptr;
+}
+
 void dabc::RecordField::release()
 {
    switch (fKind) {
@@ -1373,7 +1520,7 @@ void dabc::RecordField::SetArrStrDirect(int64_t size, char* arr, bool owner)
 // =========================================================================
 
 dabc::RecordFieldsMap::RecordFieldsMap() :
-   fMap(),
+   fArr(),
    fChanged(false)
 {
 }
@@ -1382,39 +1529,53 @@ dabc::RecordFieldsMap::~RecordFieldsMap()
 {
 }
 
-bool dabc::RecordFieldsMap::HasField(const std::string &name) const
+dabc::RecordFieldsMap::FieldsVector::const_iterator dabc::RecordFieldsMap::find_pos(const std::string &name) const
 {
-   return fMap.find(name) != fMap.end();
+   return std::lower_bound(fArr.begin(), fArr.end(), name,
+                           [](const Entry &entry, const std::string &n) { return entry.name < n; });
 }
 
-bool dabc::RecordFieldsMap::RemoveField(const std::string &name)
+dabc::RecordField& dabc::RecordFieldsMap::Field(const std::string &name)
 {
-   auto iter = fMap.find(name);
-   if (iter == fMap.end()) return false;
-   fMap.erase(iter);
-   fChanged = true;
-   return true;
-}
+   auto iter = find_pos(name);
+   if ((iter != fArr.end()) && (iter->name == name))
+      return fArr[iter - fArr.begin()].field;
+
+   // typical command or hierarchy node has less than 8 fields, avoid several reallocations
+   if (fArr.capacity() == 0) {
+      fArr.reserve(8);
+      return fArr.emplace(fArr.end(), name)->field;
+   }
 
+   return fArr.emplace(iter, name)->field;
+}
 
-std::string dabc::RecordFieldsMap::FieldName(unsigned n) const
+const dabc::RecordField* dabc::RecordFieldsMap::FindField(const std::string &name) const
 {
-   if (n >= fMap.size()) return "";
+   auto iter = find_pos(name);
+   return (iter != fArr.end()) && (iter->name == name) ? &iter->field : nullptr;
+}
 
-   for (auto iter = fMap.begin(); iter!=fMap.end(); iter++) {
-      if (n == 0) return iter->first;
-      n--;
-   }
+bool dabc::RecordFieldsMap::HasField(const std::string &name) const
+{
+   return FindField(name) != nullptr;
+}
 
-   return "";
+bool dabc::RecordFieldsMap::RemoveField(const std::string &name)
+{
+   auto iter = find_pos(name);
+   if ((iter == fArr.end()) || (iter->name != name)) return false;
+   fArr.erase(iter);
+   fChanged = true;
+   return true;
 }
 
 bool dabc::RecordFieldsMap::WasChanged() const
 {
    if (fChanged) return true;
 
-   for (auto iter = fMap.begin(); iter!=fMap.end(); iter++)
-      if (iter->second.IsModified()) return true;
+   for (auto &entry : fArr)
+      if (entry.field.IsModified()) return true;
 
    return false;
 }
@@ -1424,9 +1585,9 @@ bool dabc::RecordFieldsMap::WasChangedWith(const std::string &prefix)
 {
    // returns true when field with specified prefix was modified
 
-   for (auto &&fld: fMap) {
-      if (fld.second.IsModified())
-         if (fld.first.find(prefix) == 0) return true;
+   for (auto &entry : fArr) {
+      if (entry.field.IsModified())
+         if (entry.name.find(prefix) == 0) return true;
    }
 
    return false;
@@ -1436,16 +1597,20 @@ bool dabc::RecordFieldsMap::WasChangedWith(const std::string &prefix)
 void dabc::RecordFieldsMap::ClearChangeFlags()
 {
    fChanged = false;
-   for (auto &&fld: fMap)
-      fld.second.SetModified(false);
+   for (auto &entry : fArr)
+      entry.field.SetModified(false);
 }
 
 dabc::RecordFieldsMap *dabc::RecordFieldsMap::Clone()
 {
    auto res = new dabc::RecordFieldsMap;
 
-   for (auto &entry: fMap)
-      res->Field(entry.first).SetValue(entry.second);
+   // source is sorted, therefore fields can be add directly to the end
+   res->fArr.reserve(fArr.size());
+   for (auto &entry : fArr) {
+      res->fArr.emplace_back(entry.name);
+      res->fArr.back().field.SetValue(entry.field);
+   }
 
    return res;
 }
@@ -1467,6 +1632,34 @@ bool dabc::RecordFieldsMap::match_prefix(const std::string &name, const std::str
 }
 
 
+bool dabc::RecordFieldsMap::StreamCompact(iostream& s, bool (*accept)(const std::string &))
+{
+   if (s.is_output()) {
+      uint64_t num = 0;
+      for (auto &entry : fArr)
+         if (!accept || accept(entry.name)) num++;
+
+      if (!s.write_varint(num)) return false;
+
+      for (auto &entry : fArr) {
+         if (accept && !accept(entry.name)) continue;
+         if (!s.write_varstr(entry.name) || !entry.field.StreamCompact(s)) return false;
+      }
+      return true;
+   }
+
+   uint64_t num = 0;
+   if (!s.read_varint(num)) return false;
+
+   std::string name;
+   for (uint64_t n = 0; n < num; n++) {
+      if (!s.read_varstr(name)) return false;
+      if (!Field(name).StreamCompact(s)) return false;
+   }
+
+   return true;
+}
+
 bool dabc::RecordFieldsMap::Stream(iostream& s, const std::string &nameprefix)
 {
    uint32_t storesz = 0, storenum = 0, storevers = 0;
@@ -1478,17 +1671,17 @@ bool dabc::RecordFieldsMap::Stream(iostream& s, const std::string &nameprefix)
       sz = s.is_real() ? StoreSize(nameprefix) : 0;
       storesz = sz/8;
       storenum = 0;
-      for (auto &entry : fMap) {
-         if (match_prefix(entry.first, nameprefix)) storenum++;
+      for (auto &entry : fArr) {
+         if (match_prefix(entry.name, nameprefix)) storenum++;
       }
 
       s.write_uint32(storesz);
       s.write_uint32(storenum  | (storevers<<24));
 
-      for (auto &entry : fMap) {
-         if (!match_prefix(entry.first, nameprefix)) continue;
-         s.write_str(entry.first);
-         entry.second.Stream(s);
+      for (auto &entry : fArr) {
+         if (!match_prefix(entry.name, nameprefix)) continue;
+         s.write_str(entry.name);
+         entry.field.Stream(s);
       }
 
    } else {
@@ -1505,25 +1698,24 @@ bool dabc::RecordFieldsMap::Stream(iostream& s, const std::string &nameprefix)
       storenum = storenum & 0xffffff;
 
       // first clear touch flags
-      for (auto &entry : fMap)
-         entry.second.fTouched = false;
+      for (auto &entry : fArr)
+         entry.field.fTouched = false;
 
+      // count not trusted, every field occupies at least 16 bytes - name and field header
+      if (fArr.empty()) fArr.reserve(std::min((uint64_t) storenum, s.maxstoresize() / 16));
+
+      std::string name;
       for (uint32_t n=0;n<storenum;n++) {
-         std::string name;
-         s.read_str(name);
-         RecordField& fld = fMap[name];
+         if (!s.read_str(name)) return false;
+         RecordField& fld = Field(name);
          fld.Stream(s);
          fld.fTouched = true;
       }
 
-      auto iter = fMap.begin();
       // now we should remove all fields, which were not touched
-      while (iter != fMap.end()) {
-         if (iter->second.fTouched) { iter++; continue; }
-         if (!match_prefix(iter->first, nameprefix)) { iter++; continue; }
-         fMap.erase(iter++);
-      }
-
+      fArr.erase(std::remove_if(fArr.begin(), fArr.end(),
+                 [&nameprefix](const Entry &entry) { return !entry.field.fTouched && match_prefix(entry.name, nameprefix); }),
+                 fArr.end());
    }
 
    return s.verify_size(pos, sz);
@@ -1531,43 +1723,47 @@ bool dabc::RecordFieldsMap::Stream(iostream& s, const std::string &nameprefix)
 
 bool dabc::RecordFieldsMap::SaveTo(HStore& res)
 {
-   for (auto &entry : fMap) {
+   for (auto &entry : fArr) {
 
-      if (entry.first.empty() || (entry.first[0] == '#')) continue;
+      if (entry.name.empty() || (entry.name[0] == '#')) continue;
 
       // discard attributes, which using quotes or any special symbols in the names
-      if (entry.first.find_first_of(" #&\"\'!@%^*()=-\\/|~.,") != std::string::npos) continue;
+      if (entry.name.find_first_of(" #&\"\'!@%^*()=-\\/|~.,") != std::string::npos) continue;
 
-      res.SetField(entry.first.c_str(), entry.second.AsJson().c_str());
+      res.SetField(entry.name.c_str(), entry.field.AsJson().c_str());
    }
    return true;
 }
 
 void dabc::RecordFieldsMap::CopyFrom(const RecordFieldsMap& src, bool overwrite)
 {
-   for (auto &entry : src.fMap)
-      if (overwrite || !HasField(entry.first))
-         fMap[entry.first] = entry.second;
+   if (&src == this) return;
+
+   for (auto &entry : src.fArr)
+      if (overwrite || !HasField(entry.name))
+         Field(entry.name) = entry.field;
 }
 
 void dabc::RecordFieldsMap::MoveFrom(RecordFieldsMap& src)
 {
+   if (&src == this) return;
+
    std::vector<std::string> delfields;
 
-   for (auto &entry : fMap) {
-      if (entry.second.IsProtected()) continue;
-      if (!src.HasField(entry.first))
-         delfields.emplace_back(entry.first);
+   for (auto &entry : fArr) {
+      if (entry.field.IsProtected()) continue;
+      if (!src.HasField(entry.name))
+         delfields.emplace_back(entry.name);
    }
 
    for (unsigned n=0;n<delfields.size();n++)
       RemoveField(delfields[n]);
 
-   for (auto &entry : src.fMap) {
+   for (auto &entry : src.fArr) {
       // should we completely preserve protected fields???
       // if (iter->second.IsProtected()) continue;
 
-      fMap[entry.first].SetValue(entry.second);
+      Field(entry.name).SetValue(entry.field);
    }
 }
 
@@ -1575,11 +1771,11 @@ void dabc::RecordFieldsMap::MakeAsDiffTo(const RecordFieldsMap& current)
 {
    std::vector<std::string> delfields;
 
-   for (auto &&fld : current.fMap) {
-      if (!HasField(fld.first))
-         delfields.emplace_back(fld.first);
+   for (auto &entry : current.fArr) {
+      if (!HasField(entry.name))
+         delfields.emplace_back(entry.name);
       else
-         if (!fld.second.fModified) RemoveField(fld.first);
+         if (!entry.field.fModified) RemoveField(entry.name);
    }
 
    // we remember fields, which should be delete when we start to reconstruct history
@@ -1589,12 +1785,13 @@ void dabc::RecordFieldsMap::MakeAsDiffTo(const RecordFieldsMap& current)
 
 void dabc::RecordFieldsMap::ApplyDiff(const RecordFieldsMap& diff)
 {
-   for (auto &entry : diff.fMap) {
-      if (entry.first != "dabc:del") {
-         fMap[entry.first] = entry.second;
-         fMap[entry.first].fModified = true;
+   for (auto &entry : diff.fArr) {
+      if (entry.name != "dabc:del") {
+         RecordField &fld = Field(entry.name);
+         fld = entry.field;
+         fld.fModified = true;
       } else {
-         std::vector<std::string> delfields = entry.second.AsStrVect();
+         std::vector<std::string> delfields = entry.field.AsStrVect();
          for (unsigned n = 0; n < delfields.size(); n++)
             RemoveField(delfields[n]);
       }
@@ -0,0 +1,565 @@
+// $Id$
+
+/************************************************************
+ * The Data Acquisition Backbone Core (DABC)                *
+ ************************************************************
+ * Copyright (C) 2009 -                                     *
+ * GSI Helmholtzzentrum fuer Schwerionenforschung GmbH      *
+ * Planckstr. 1, 64291 Darmstadt, Germany                   *
+ * Contact:  http://dabc.gsi.de                             *
+ ************************************************************
+ * This software can be used under the GPL license          *
+ * agreements as stated in LICENSE.txt file                 *
+ * which is part of the distribution.                       *
+ ************************************************************/
+
+#include "dabc/ShmTransport.h"
+
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+namespace dabc {
+
+   enum { ShmMagic = 0x44534d31, ShmNumDescr = 1024, ShmAlign = 64 };
+
+   enum EShmChunkState { chunkUsed = 1, chunkFree = 2 };
+
+   /** Header of shared memory region. Sender writes head, receiver writes tail,
+    * wait flags set by the side which is going to sleep and cleared by the side which sends wake-up message */
+   struct ShmRegionHeader {
+      uint32_t magic;
+      uint32_t numdescr;                   ///< number of entries in descriptors ring
+      uint64_t datasize;                   ///< size of data area
+      uint64_t dataoffset;                 ///< offset of data area from region begin
+      alignas(64) std::atomic<uint64_t> head;     ///< number of published descriptors
+      alignas(64) std::atomic<uint64_t> tail;     ///< number of consumed descriptors
+      alignas(64) std::atomic<uint32_t> recvwait; ///< receiver waits for new descriptors
+      alignas(64) std::atomic<uint32_t> sendwait; ///< sender waits for free space
+   };
+
+   /** Entry in descriptors ring */
+   struct ShmDescr {
+      uint64_t offset;                     ///< chunk offset in data area
+      uint64_t size;                       ///< chunk size
+   };
+
+   /** Header of data chunk, followed by network header and payload, all aligned to 64 bytes */
+   struct ShmChunk {
+      std::atomic<uint32_t> state;         ///< used or free, changed by receiver
+      uint32_t hdrsize;                    ///< size of network header
+      uint32_t payload;                    ///< size of payload, 0 when no buffer or inline data
+      uint32_t len;                        ///< full chunk length
+   };
+
+   static_assert(std::atomic<uint64_t>::is_always_lock_free, "64-bit atomics required for shared memory");
+
+   inline uint64_t ShmAligned(uint64_t sz) { return (sz + ShmAlign - 1) / ShmAlign * ShmAlign; }
+
+   /** Access to region of other side, referenced by interface and by all received buffers */
+   class ShmLink : public Object {
+      protected:
+         ShmRegion        *fRegion{nullptr};
+         Mutex             fMutex;
+         int               fFd{-1};
+
+      public:
+         ShmRegionHeader  *fHdr{nullptr};
+         ShmDescr         *fDescr{nullptr};
+         char             *fData{nullptr};
+
+         ShmLink(ShmRegion *reg, int fd) :
+            Object(nullptr, "", flAutoDestroy),
+            fRegion(reg),
+            fMutex(),
+            fFd(fd)
+         {
+            fHdr = (ShmRegionHeader *) reg->Addr();
+            fDescr = (ShmDescr *) ((char *) reg->Addr() + ShmAligned(sizeof(ShmRegionHeader)));
+            fData = (char *) reg->Addr() + fHdr->dataoffset;
+         }
+
+         virtual ~ShmLink()
+         {
+            delete fRegion;
+         }
+
+         /** Socket closed by interface, no more wake-up messages possible */
+         void ResetSocket()
+         {
+            LockGuard lock(fMutex);
+            fFd = -1;
+         }
+
+         /** Send wake-up message to other side, can be called from any thread */
+         bool SendBell()
+         {
+            LockGuard lock(fMutex);
+            if (fFd < 0) return false;
+            char b = 'b';
+            // when socket buffer full, other side already has unread messages
+            return ::send(fFd, &b, 1, MSG_DONTWAIT | MSG_NOSIGNAL) == 1;
+         }
+
+         /** Mark chunk as free and wake up sender when it waits for space */
+         void ReleaseChunk(ShmChunk *chunk)
+         {
+            chunk->state.store(chunkFree);
+            if (fHdr->sendwait.load() && fHdr->sendwait.exchange(0))
+               SendBell();
+         }
+   };
+
+   /** Keeps chunk of shared memory while it is used by the buffer */
+   class ShmChunkKeeper : public Object {
+      protected:
+         Reference  fLink;
+         ShmChunk  *fChunk{nullptr};
+
+      public:
+         ShmChunkKeeper(const Reference &link, ShmChunk *chunk) :
+            Object(nullptr, "", flAutoDestroy),
+            fLink(link),
+            fChunk(chunk)
+         {
+         }
+
+         virtual ~ShmChunkKeeper()
+         {
+            ShmLink *link = (ShmLink *) fLink();
+            if (link) link->ReleaseChunk(fChunk);
+            fLink.Release();
+         }
+   };
+
+}
+
+// ______________________________________________________________
+
+bool dabc::ShmRegion::Create(const std::string &name, size_t size)
+{
+   Close();
+
+   int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+   if ((fd < 0) && (errno == EEXIST)) {
+      // remove left from crashed process
+      shm_unlink(name.c_str());
+      fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+   }
+
+   if (fd < 0) {
+      EOUT("Cannot create shared memory %s: %s", name.c_str(), strerror(errno));
+      return false;
+   }
+
+   void *addr = MAP_FAILED;
+   if (ftruncate(fd, size) == 0)
+      addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+
+   if (addr == MAP_FAILED) {
+      EOUT("Cannot allocate %lu bytes of shared memory %s: %s", (long unsigned) size, name.c_str(), strerror(errno));
+      shm_unlink(name.c_str());
+      return false;
+   }
+
+   fName = name;
+   fAddr = addr;
+   fSize = size;
+   fLinked = true;
+   return true;
+}
+
+bool dabc::ShmRegion::Open(const std::string &name)
+{
+   Close();
+
+   int fd = shm_open(name.c_str(), O_RDWR, 0);
+   if (fd < 0) return false;
+
+   struct stat st;
+   void *addr = MAP_FAILED;
+   if ((fstat(fd, &st) == 0) && (st.st_size > 0))
+      addr = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+
+   if (addr == MAP_FAILED) return false;
+
+   fName = name;
+   fAddr = addr;
+   fSize = st.st_size;
+   fLinked = false;
+   return true;
+}
+
+void dabc::ShmRegion::Unlink()
+{
+   if (!fName.empty()) shm_unlink(fName.c_str());
+   fLinked = false;
+}
+
+void dabc::ShmRegion::Close()
+{
+   if (fLinked) Unlink();
+   if (fAddr) munmap(fAddr, fSize);
+   fAddr = nullptr;
+   fSize = 0;
+   fName.clear();
+}
+
+std::string dabc::ShmRegion::MakeName(const std::string &connid, bool server)
+{
+   std::string res = "/dabc_";
+   for (char c : connid)
+      res.append(1, isalnum(c) ? c : '_');
+   res.append(server ? "_s" : "_c");
+   return res;
+}
+
+// ______________________________________________________________
+
+dabc::ShmRegion *dabc::ShmNetworkInetrface::CreateRegion(const std::string &name, size_t datasize)
+{
+   datasize = ShmAligned(datasize);
+   uint64_t dataoffset = ShmAligned(ShmAligned(sizeof(ShmRegionHeader)) + ShmNumDescr * sizeof(ShmDescr));
+
+   ShmRegion *reg = new ShmRegion;
+   if (!reg->Create(name, dataoffset + datasize)) {
+      delete reg;
+      return nullptr;
+   }
+
+   ShmRegionHeader *hdr = new (reg->Addr()) ShmRegionHeader;
+   hdr->numdescr = ShmNumDescr;
+   hdr->datasize = datasize;
+   hdr->dataoffset = dataoffset;
+   hdr->head.store(0);
+   hdr->tail.store(0);
+   hdr->recvwait.store(0);
+   hdr->sendwait.store(0);
+   hdr->magic = ShmMagic;
+
+   return reg;
+}
+
+dabc::ShmRegion *dabc::ShmNetworkInetrface::OpenRegion(const std::string &name)
+{
+   ShmRegion *reg = new ShmRegion;
+
+   if (reg->Open(name)) {
+      ShmRegionHeader *hdr = (ShmRegionHeader *) reg->Addr();
+      if ((reg->Size() > sizeof(ShmRegionHeader)) && (hdr->magic == ShmMagic) &&
+          (hdr->dataoffset + hdr->datasize <= reg->Size()))
+         return reg;
+      EOUT("Shared memory %s has wrong format", name.c_str());
+   }
+
+   delete reg;
+   return nullptr;
+}
+
+dabc::ShmNetworkInetrface::ShmNetworkInetrface(int fd, ShmRegion *tx, ShmRegion *rx) :
+   SocketIOAddon(fd, false, false),
+   NetworkInetrface(),
+   fTx(tx),
+   fLink(new ShmLink(rx, fd)),
+   fSendQueue(),
+   fRecvQueue(),
+   fComplQueue()
+{
+   // wake-up messages should not be delayed
+   SocketThread::SetNoDelaySocket(fd);
+}
+
+dabc::ShmNetworkInetrface::~ShmNetworkInetrface()
+{
+   DOUT2("Shm interface: sent %lu records, received %lu records, wake-ups %lu, waits for space %lu",
+         (long unsigned) fSendRecs, (long unsigned) fRecvRecs, (long unsigned) fBellsSent, (long unsigned) fSpaceWaits);
+
+   ShmLink *link = (ShmLink *) fLink();
+   if (link) link->ResetSocket();
+   // region of other side remains mapped while received buffers are used
+   fLink.Release();
+
+   delete fTx; fTx = nullptr;
+
+   delete [] fHeaders; fHeaders = nullptr;
+}
+
+long dabc::ShmNetworkInetrface::Notify(const std::string &cmd, int arg)
+{
+   if (cmd == "GetNetworkTransportInetrface") return (long) ((NetworkInetrface*) this);
+
+   return dabc::SocketIOAddon::Notify(cmd, arg);
+}
+
+void dabc::ShmNetworkInetrface::AllocateNet(unsigned fulloutputqueue, unsigned fullinputqueue)
+{
+   NetworkTransport* tr = (NetworkTransport*) fWorker();
+
+   fHeaders = new char[tr->NumRecs() * tr->GetFullHeaderSize()];
+   for (uint32_t n = 0; n < tr->NumRecs(); n++)
+      tr->SetRecHeader(n, fHeaders + n * tr->GetFullHeaderSize());
+
+   fSendQueue.Allocate(fulloutputqueue);
+   fRecvQueue.Allocate(fullinputqueue);
+   fComplQueue.Allocate(fulloutputqueue);
+}
+
+void dabc::ShmNetworkInetrface::ProcessEvent(const EventId &evnt)
+{
+   switch (evnt.GetCode()) {
+      case evntShmSendCompl: {
+         NetworkTransport* tr = (NetworkTransport*) fWorker();
+         while (tr && (fComplQueue.Size() > 0))
+            tr->ProcessSendCompl(fComplQueue.Pop());
+         break;
+      }
+      case evntShmRecv:
+         fRecvFired = false;
+         ProcessRecvQueue();
+         break;
+      default:
+         dabc::SocketIOAddon::ProcessEvent(evnt);
+   }
+}
+
+void dabc::ShmNetworkInetrface::OnThreadAssigned()
+{
+   dabc::SocketIOAddon::OnThreadAssigned();
+
+   // socket only delivers wake-up messages
+   StartRecvAvailable(fBell, sizeof(fBell));
+}
+
+void dabc::ShmNetworkInetrface::OnRecvCompleted()
+{
+   StartRecvAvailable(fBell, sizeof(fBell));
+
+   ProcessRecvQueue();
+   ProcessSendQueue();
+}
+
+void dabc::ShmNetworkInetrface::OnSocketError(int msg, const std::string &info)
+{
+   NetworkTransport* tr = (NetworkTransport*) fWorker();
+   if (tr) tr->CloseTransport(msg != 0);
+      else EOUT("Socket msg without transport %d %s", msg, info.c_str());
+}
+
+void dabc::ShmNetworkInetrface::SubmitSend(uint32_t recid)
+{
+   fSendQueue.Push(recid);
+
+   // we are in transport thread and can call processing methods directly
+   ProcessSendQueue();
+}
+
+void dabc::ShmNetworkInetrface::SubmitRecv(uint32_t recid)
+{
+   fRecvQueue.Push(recid);
+
+   // data may be already there, but transport expects completion not from inside SubmitRecv call
+   if (!fRecvFired && !fRecvProcessing) {
+      fRecvFired = true;
+      FireWorkerEvent(evntShmRecv);
+   }
+}
+
+bool dabc::ShmNetworkInetrface::ReclaimSpace()
+{
+   ShmRegionHeader *hdr = (ShmRegionHeader *) fTx->Addr();
+   char *data = (char *) fTx->Addr() + hdr->dataoffset;
+
+   bool any = false;
+
+   // chunks released by receiver in any order, but reused only in order of allocation
+   while (fDataTail < fDataHead) {
+      ShmChunk *chunk = (ShmChunk *) (data + fDataTail % hdr->datasize);
+      if (chunk->state.load() != chunkFree) break;
+      fDataTail += chunk->len;
+      any = true;
+   }
+
+   return any;
+}
+
+void dabc::ShmNetworkInetrface::ProcessSendQueue()
+{
+   if (fSendProcessing) return;
+
+   NetworkTransport* tr = (NetworkTransport*) fWorker();
+   if (!tr) return;
+
+   fSendProcessing = true;
+
+   ShmRegionHeader *hdr = (ShmRegionHeader *) fTx->Addr();
+   ShmDescr *descr = (ShmDescr *) ((char *) fTx->Addr() + ShmAligned(sizeof(ShmRegionHeader)));
+   char *data = (char *) fTx->Addr() + hdr->dataoffset;
+   unsigned hdrsize = tr->GetFullHeaderSize();
+
+   while (fSendQueue.Size() > 0) {
+      uint32_t recid = fSendQueue.Front();
+
+      NetworkTransport::NetIORec* rec = tr->GetRec(recid);
+
+      if (!rec) {
+         EOUT("Completely wrong send recid %u", recid);
+         exit(432);
+      }
+
+      BufferSize_t bufsize = rec->buf.null() ? 0 : rec->buf.GetTotalSize();
+      uint64_t len = ShmAligned(sizeof(ShmChunk)) + ShmAligned(hdrsize) + ShmAligned(bufsize);
+
+      if (len > hdr->datasize) {
+         EOUT("Buffer of size %lu does not fit into shared memory %lu", (long unsigned) bufsize, (long unsigned) hdr->datasize);
+         tr->CloseTransport(true);
+         break;
+      }
+
+      // chunk cannot wrap around end of data area, rest of area will be skipped
+      uint64_t pos = fDataHead % hdr->datasize;
+      uint64_t skip = (pos + len > hdr->datasize) ? hdr->datasize - pos : 0;
+
+      bool has_space = (fDataHead + skip + len - fDataTail <= hdr->datasize) &&
+                       (hdr->head.load(std::memory_order_relaxed) - hdr->tail.load() < hdr->numdescr);
+
+      if (!has_space) {
+         ReclaimSpace();
+         has_space = (fDataHead + skip + len - fDataTail <= hdr->datasize) &&
+                     (hdr->head.load(std::memory_order_relaxed) - hdr->tail.load() < hdr->numdescr);
+      }
+
+      if (!has_space) {
+         // announce waiting and check again - receiver may release memory in between
+         hdr->sendwait.store(1);
+         ReclaimSpace();
+         has_space = (fDataHead + skip + len - fDataTail <= hdr->datasize) &&
+                     (hdr->head.load(std::memory_order_relaxed) - hdr->tail.load() < hdr->numdescr);
+         if (!has_space) {
+            fSpaceWaits++;
+            break;
+         }
+      }
+
+      if (skip > 0) {
+         ShmChunk *dummy = (ShmChunk *) (data + pos);
+         dummy->len = skip;
+         dummy->state.store(chunkFree);
+         fDataHead += skip;
+         pos = 0;
+      }
+
+      fSendQueue.Pop();
+
+      int sendtyp = tr->PackHeader(recid);
+
+      if (sendtyp == 0) {
+         EOUT("record %u failed", recid);
+         throw dabc::Exception("send record failed - should never happen");
+      }
+
+      ShmChunk *chunk = (ShmChunk *) (data + pos);
+      chunk->hdrsize = hdrsize;
+      chunk->len = len;
+      chunk->payload = (sendtyp == 2) ? bufsize : 0;
+      chunk->state.store(chunkUsed, std::memory_order_relaxed);
+
+      char *ptr = (char *) chunk + ShmAligned(sizeof(ShmChunk));
+      memcpy(ptr, rec->header, hdrsize);
+      if (sendtyp == 2)
+         rec->buf.CopyTo(ptr + ShmAligned(hdrsize), bufsize);
+
+      fDataHead += len;
+
+      uint64_t head = hdr->head.load(std::memory_order_relaxed);
+      descr[head % hdr->numdescr].offset = pos;
+      descr[head % hdr->numdescr].size = len;
+      hdr->head.store(head + 1);
+
+      if (hdr->recvwait.load() && hdr->recvwait.exchange(0)) {
+         ((ShmLink *) fLink())->SendBell();
+         fBellsSent++;
+      }
+
+      fSendRecs++;
+
+      // data copied, but transport expects completion not from inside SubmitSend call
+      if (fComplQueue.Size() == 0) FireWorkerEvent(evntShmSendCompl);
+      fComplQueue.Push(recid);
+   }
+
+   fSendProcessing = false;
+}
+
+void dabc::ShmNetworkInetrface::ProcessRecvQueue()
+{
+   if (fRecvProcessing) return;
+
+   NetworkTransport* tr = (NetworkTransport*) fWorker();
+   ShmLink *link = (ShmLink *) fLink();
+   if (!tr || !link) return;
+
+   fRecvProcessing = true;
+
+   ShmRegionHeader *hdr = link->fHdr;
+   unsigned hdrsize = tr->GetFullHeaderSize();
+
+   while (fRecvQueue.Size() > 0) {
+      uint64_t tail = hdr->tail.load(std::memory_order_relaxed);
+
+      if (hdr->head.load() == tail) {
+         // announce waiting and check again - sender may publish data in between
+         hdr->recvwait.store(1);
+         if (hdr->head.load() == tail) break;
+      }
+
+      ShmDescr *descr = link->fDescr + tail % hdr->numdescr;
+      ShmChunk *chunk = (ShmChunk *) (link->fData + descr->offset);
+
+      if ((descr->offset + descr->size > hdr->datasize) || (chunk->hdrsize != hdrsize) ||
+          (ShmAligned(sizeof(ShmChunk)) + ShmAligned(hdrsize) + chunk->payload > descr->size)) {
+         EOUT("Wrong data in shared memory offset %lu size %lu", (long unsigned) descr->offset, (long unsigned) descr->size);
+         tr->CloseTransport(true);
+         break;
+      }
+
+      uint32_t recid = fRecvQueue.Pop();
+
+      NetworkTransport::NetIORec* rec = tr->GetRec(recid);
+
+      if (!rec) {
+         EOUT("Completely wrong recv recid %u", recid);
+         exit(432);
+      }
+
+      char *ptr = (char *) chunk + ShmAligned(sizeof(ShmChunk));
+      memcpy(rec->header, ptr, hdrsize);
+
+      if (chunk->payload > 0) {
+         // buffer delivered without copy, chunk released together with the buffer
+         rec->buf = Buffer::CreateBuffer(ptr + ShmAligned(hdrsize), chunk->payload,
+                                         Reference(new ShmChunkKeeper(fLink, chunk)));
+      } else {
+         link->ReleaseChunk(chunk);
+      }
+
+      hdr->tail.store(tail + 1);
+      if (hdr->sendwait.load() && hdr->sendwait.exchange(0)) {
+         link->SendBell();
+         fBellsSent++;
+      }
+
+      fRecvRecs++;
+
+      tr->ProcessRecvCompl(recid);
+   }
+
+   fRecvProcessing = false;
+}
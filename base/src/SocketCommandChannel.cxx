@@ -16,7 +16,9 @@
 #include "dabc/SocketCommandChannel.h"
 
 #include <cstdlib>
+#include <cmath>
 #include <unistd.h>
+#include <sys/uio.h>
 
 #include "dabc/Manager.h"
 #include "dabc/Configuration.h"
@@ -32,9 +34,9 @@ dabc::SocketCommandClient::SocketCommandClient(Reference parent, const std::stri
    fRemoteHostName(hostname),
    fReconnectPeriod(reconnect),
    fState(stConnecting),
-   fSendHdr(),
-   fSendBuf(),
+   fSendData(),
    fSendRawData(),
+   fSendParts(),
    fSendingActive(true), // mark as active until I/O object is not yet assigned
    fRecvHdr(),
    fRecvBuf(nullptr),
@@ -42,6 +44,8 @@ dabc::SocketCommandClient::SocketCommandClient(Reference parent, const std::stri
    fSendQueue(),
    fWaitQueue(),
    fRecvState(recvInit),
+   fSendTimes(),
+   fLatencyHist(),
    fRemoteObserver(false),
    fRemoteName(),
    fMasterConn(false),
@@ -65,6 +69,10 @@ dabc::SocketCommandClient::SocketCommandClient(Reference parent, const std::stri
 
 dabc::SocketCommandClient::~SocketCommandClient()
 {
+   if (fLatencyCnt > 0)
+      DOUT2("%s commands %lu reply time mean %5.3f ms max %5.3f ms", ItemName().c_str(),
+            (long unsigned) fLatencyCnt, fLatencySum/fLatencyCnt*1e3, fLatencyMax*1e3);
+
    EnsureRecvBuffer(0);
 }
 
@@ -118,6 +126,10 @@ void dabc::SocketCommandClient::CloseClient(bool iserr, const char *msg)
 
    if (!fRemoteHostName.empty() && (fReconnectPeriod>0)) {
       AssignAddon(nullptr); // we destroy current addon
+      // data of interrupted send operation no longer required
+      fSendData.clear();
+      fSendRawData.clear();
+      fSendParts.clear();
       DOUT2("Try to reconnect worker %s to remote node %s", ItemName().c_str(), fRemoteHostName.c_str());
       fState = stConnecting;
       ActivateTimeout(fReconnectPeriod);
@@ -143,6 +155,9 @@ int dabc::SocketCommandClient::ExecuteCommand(Command cmd)
 
       fState = stWorking;
 
+      // small command packets should not be delayed
+      SocketThread::SetNoDelaySocket(fd);
+
       auto addon = new SocketIOAddon(fd);
       addon->SetDeliverEventsToWorker(true);
 
@@ -222,8 +237,8 @@ void dabc::SocketCommandClient::ProcessRecvPacket()
       return;
    }
 
-   dabc::Buffer cmddata = dabc::Buffer::CreateBuffer(fRecvBuf, fRecvHdr.data_cmdsize, false, true);
-   if (!cmd.ReadFromBuffer(cmddata)) {
+   dabc::memstream inps(true, fRecvBuf, fRecvHdr.data_cmdsize);
+   if (!DecodeCommand(inps, cmd)) {
       CloseClient(true, "cannot decode command");
       return;
    }
@@ -239,6 +254,9 @@ void dabc::SocketCommandClient::ProcessRecvPacket()
             cmd.SetRawData(rawdata);
          }
 
+         // remember request id, it will be used for the reply
+         cmd.SetUInt("#remote_id", fRecvHdr.data_cmdid);
+
          if (ExecuteCommandByItself(cmd)) {
             cmd.RemoveReceiver();
             AddCommand(cmd, true);
@@ -263,13 +281,12 @@ void dabc::SocketCommandClient::ProcessRecvPacket()
       case kindReply:
       case kindCancel: {
 
-         unsigned cmdid = cmd.GetUInt("__send_cmdid__");
-         cmd.RemoveField("__send_cmdid__");
+         dabc::Command maincmd = fWaitQueue.PopWithId(fRecvHdr.data_cmdid);
 
-         dabc::Command maincmd = fWaitQueue.PopWithId(cmdid);
+         AccountLatency(fRecvHdr.data_cmdid);
 
          if (maincmd.null()) {
-            EOUT("No command found with searched %u", cmdid);
+            EOUT("No command found with searched %u", (unsigned) fRecvHdr.data_cmdid);
          } else
          if (fRecvHdr.data_kind == kindCancel) {
             maincmd.Reply(cmd_timedout);
@@ -282,7 +299,7 @@ void dabc::SocketCommandClient::ProcessRecvPacket()
                maincmd.SetRawData(rawdata);
             }
 
-            maincmd.Reply(cmd.GetResult());
+            maincmd.Reply(fRecvHdr.data_result);
          }
 
          break;
@@ -314,6 +331,10 @@ void dabc::SocketCommandClient::ProcessEvent(const EventId& evnt)
 
          fSendingActive = false;
 
+         fSendData.clear();
+         fSendRawData.clear();
+         fSendParts.clear();
+
          // immediately try to send next commands
          SendSubmittedCommands();
 
@@ -426,76 +447,163 @@ void dabc::SocketCommandClient::AddCommand(dabc::Command cmd, bool asreply)
 
 void dabc::SocketCommandClient::SendSubmittedCommands()
 {
-   while (!fSendingActive && (fSendQueue.Size()>0)) {
+   if (fSendingActive) return;
+
+   // several commands are encoded one after another and send with single operation
+   unsigned cnt = 0;
+   while ((fSendQueue.Size() > 0) && (cnt++ < MaxBatchCmds) && (fSendData.size() < MaxBatchSize)) {
       bool isreply = (fSendQueue.FrontKind() == CommandsQueue::kindReply);
       SendCommand(fSendQueue.Pop(), isreply);
    }
+
+   if (fSendData.empty()) return;
+
+   SocketIOAddon* addon = dynamic_cast<SocketIOAddon*> (fAddon());
+
+   if (!addon) {
+      EOUT("Cannot send commands addon %p", fAddon());
+      CloseClient(true, "I/O object missing");
+      return;
+   }
+
+   std::vector<struct iovec> iov;
+   iov.reserve(fSendParts.size()*2 + 1);
+
+   uint64_t pos = 0;
+   for (unsigned n = 0; n < fSendParts.size(); n++) {
+      if (fSendParts[n] > pos)
+         iov.push_back({ fSendData.data() + pos, fSendParts[n] - pos });
+      pos = fSendParts[n];
+      for (unsigned seg = 0; seg < fSendRawData[n].NumSegments(); seg++)
+         iov.push_back({ fSendRawData[n].SegmentPtr(seg), fSendRawData[n].SegmentSize(seg) });
+   }
+   if (pos < fSendData.size())
+      iov.push_back({ fSendData.data() + pos, fSendData.size() - pos });
+
+   if (!addon->StartSendIOV(iov.data(), iov.size())) {
+      CloseClient(true, "Fail to send command");
+      return;
+   }
+
+   fSendingActive = true;
 }
 
-void dabc::SocketCommandClient::SendCommand(dabc::Command cmd, bool asreply)
+bool dabc::SocketCommandClient::SendCommand(dabc::Command cmd, bool asreply)
 {
    double send_tmout = 0;
+   uint32_t cmdid = 0;
 
    if (!asreply) {
       // first check that command is timedout
       send_tmout = cmd.TimeTillTimeout();
       if (send_tmout == 0.) {
          cmd.Reply(cmd_timedout);
-         return;
+         return false;
       }
 
-      uint32_t cmdid = fWaitQueue.Push(cmd);
-      cmd.SetUInt("__send_cmdid__", cmdid);
+      cmdid = fWaitQueue.Push(cmd);
+      fSendTimes.emplace_back(cmdid, dabc::Now());
+   } else {
+      cmdid = cmd.GetUInt("#remote_id");
    }
 
-   //   DOUT0("RAWSEND cmd %s debugid %d", fSendQueue.Front().GetName(), fSendQueue.Front().GetInt("debugid"));
+   dabc::Buffer rawdata = cmd.GetRawData();
+
+   dabc::sizestream sizes;
+   EncodeCommand(sizes, cmd, asreply);
+
+   SocketCmdPacket hdr;
+   hdr.dabc_header = headerDabc;
+   hdr.data_kind = asreply ? kindReply : kindCommand;
+   if (cmd.IsCanceled()) hdr.data_kind = kindCancel;
+   hdr.data_timeout = send_tmout > 0 ? (uint32_t) (send_tmout*1000.) : 0;
+   hdr.data_cmdsize = sizes.size();
+   hdr.data_rawsize = rawdata.GetTotalSize();
+   hdr.data_size = hdr.data_cmdsize + hdr.data_rawsize;
+   hdr.data_cmdid = cmdid;
+   hdr.data_result = asreply ? cmd.GetResult() : 0;
+
+   uint64_t pos = fSendData.size();
+   fSendData.resize(pos + sizeof(hdr) + hdr.data_cmdsize);
+   memcpy(fSendData.data() + pos, &hdr, sizeof(hdr));
+
+   dabc::memstream outs(false, fSendData.data() + pos + sizeof(hdr), hdr.data_cmdsize);
+
+   if (!EncodeCommand(outs, cmd, asreply)) {
+      EOUT("Fail to encode command %s", cmd.GetName());
+      fSendData.resize(pos);
+      if (!asreply) {
+         fWaitQueue.PopWithId(cmdid);
+         cmd.Reply(cmd_false);
+      }
+      return false;
+   }
 
-   fSendHdr.dabc_header = headerDabc;
-   fSendHdr.data_kind = asreply ? kindReply : kindCommand;
-   fSendHdr.data_timeout = send_tmout > 0 ? (unsigned) send_tmout*1000. : 0;
-   fSendHdr.data_size = 0;
-   fSendHdr.data_cmdsize = 0;
-   fSendHdr.data_rawsize = 0;
+   if (hdr.data_rawsize > 0) {
+      fSendParts.push_back(fSendData.size());
+      fSendRawData.push_back(rawdata);
+   }
 
-   fSendBuf.Release();
-   fSendRawData.Release();
+   return true;
+}
 
-   if (cmd.IsCanceled()) fSendHdr.data_kind = kindCancel;
+/** Fields with these names transported in the packet header or are local */
+static bool AcceptCmdField(const std::string &name)
+{
+   if (name.empty() || (name[0] == '#')) return false;
+   return (name != dabc::Command::ResultParName()) && (name != dabc::Command::ReceiverParName());
+}
 
-   fSendBuf = cmd.SaveToBuffer();
+bool dabc::SocketCommandClient::EncodeCommand(iostream &s, Command &cmd, bool asreply)
+{
+   if (!s.write_varstr(cmd.GetName())) return false;
+   if (!s.write_varstr(asreply ? std::string() : cmd.GetReceiver())) return false;
+   return cmd.GetObject()->Fields().StreamCompact(s, AcceptCmdField);
+}
 
-   fSendRawData = cmd.GetRawData();
+bool dabc::SocketCommandClient::DecodeCommand(iostream &s, Command &cmd)
+{
+   std::string name, receiver;
+   if (!s.read_varstr(name) || !s.read_varstr(receiver) || name.empty()) return false;
 
-   fSendHdr.data_cmdsize = fSendBuf.GetTotalSize(); // transport 0-terminated string as is
-   fSendHdr.data_rawsize = fSendRawData.GetTotalSize();
-   void* rawdata = nullptr;
-   if (fSendHdr.data_rawsize > 0) rawdata = fSendRawData.SegmentPtr();
-   fSendHdr.data_size = fSendHdr.data_cmdsize + fSendHdr.data_rawsize;
+   cmd = dabc::Command(name);
+   if (!receiver.empty()) cmd.SetReceiver(receiver);
 
-   SocketIOAddon* addon = dynamic_cast<SocketIOAddon*> (fAddon());
+   return cmd.GetObject()->Fields().StreamCompact(s);
+}
 
-   if (!addon) {
-      EOUT("Cannot send command %s addon %p", cmd.GetName(), fAddon());
+void dabc::SocketCommandClient::AccountLatency(uint32_t cmdid)
+{
+   // replies normally come in order of sending, therefore search from the front
+   for (auto iter = fSendTimes.begin(); iter != fSendTimes.end(); ++iter) {
+      if (iter->first != cmdid) continue;
 
-      CloseClient(true, "I/O object missing");
-      return;
-   }
+      double tm = iter->second.SpentTillNow();
+      fSendTimes.erase(iter);
 
-   // DOUT0("Start command send fullsize:%u cmd:%u raw:%u", fSendHdr.data_size, fSendHdr.data_cmdsize, fSendHdr.data_rawsize);
+      unsigned bin = 0;
+      if (tm >= 1e-4) bin = 1 + (unsigned) std::log2(tm / 1e-4);
+      if (bin >= NumLatencyBins) bin = NumLatencyBins - 1;
+      fLatencyHist[bin]++;
 
-   if (!addon->StartSend(&fSendHdr, sizeof(fSendHdr),
-         fSendBuf.SegmentPtr(), fSendHdr.data_cmdsize,
-         rawdata, fSendHdr.data_rawsize)) {
-      CloseClient(true, "Fail to send command");
+      fLatencyCnt++;
+      fLatencySum += tm;
+      if (tm > fLatencyMax) fLatencyMax = tm;
       return;
    }
+}
 
-   // DOUT0("Send command %s asreply %s", cmd.GetName(), DBOOL(asreply));
+void dabc::SocketCommandClient::FillLatency(Command cmd)
+{
+   std::string name = fRemoteHostName.empty() ? std::string(GetName()) : fRemoteHostName;
 
-   fSendingActive = true;
+   cmd.SetField(name, std::vector<uint64_t>(fLatencyHist, fLatencyHist + NumLatencyBins));
+   cmd.SetUInt(name + "_count", fLatencyCnt);
+   cmd.SetDouble(name + "_mean_ms", fLatencyCnt > 0 ? fLatencySum/fLatencyCnt*1e3 : 0.);
+   cmd.SetDouble(name + "_max_ms", fLatencyMax*1e3);
+   cmd.SetUInt(name + "_inflight", fWaitQueue.Size());
 }
 
-
 double dabc::SocketCommandClient::ProcessTimeout(double)
 {
    double next_tmout = 1.;
@@ -524,6 +632,10 @@ double dabc::SocketCommandClient::ProcessTimeout(double)
    fWaitQueue.ReplyTimedout();
    fSendQueue.ReplyTimedout();
 
+   // forget send time of commands which are no longer waiting for reply
+   while (fSendTimes.size() > fWaitQueue.Size())
+      fSendTimes.pop_front();
+
    return next_tmout;
 }
 
@@ -629,6 +741,8 @@ int dabc::SocketCommandChannel::ExecuteCommand(Command cmd)
          return dabc::cmd_false;
       }
 
+      SocketThread::SetNoDelaySocket(fd);
+
       auto io = new SocketIOAddon(fd);
       io->SetDeliverEventsToWorker(true);
 
@@ -693,6 +807,17 @@ int dabc::SocketCommandChannel::ExecuteCommand(Command cmd)
          return dabc::cmd_true;
       }
       return dabc::cmd_false;
+   } else if (cmd.IsName("GetCmdLatency")) {
+      std::vector<std::string> nodes;
+      for (unsigned n = 0; n < NumChilds(); n++) {
+         SocketCommandClient *client = dynamic_cast<SocketCommandClient *> (GetChild(n));
+         if (!client) continue;
+         nodes.emplace_back(client->fRemoteHostName.empty() ? std::string(client->GetName()) : client->fRemoteHostName);
+         client->FillLatency(cmd);
+      }
+      cmd.SetField("nodes", nodes);
+      cmd.SetUInt("binwidth_us", 100);
+      return dabc::cmd_true;
    } else if (cmd.IsName("EnableDebug")) {
       fDebugMode = true;
    }
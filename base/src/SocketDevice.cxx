@@ -18,6 +18,7 @@
 #include <unistd.h>
 
 #include "dabc/SocketTransport.h"
+#include "dabc/ShmTransport.h"
 #include "dabc/Manager.h"
 #include "dabc/Configuration.h"
 #include "dabc/ConnectionManager.h"
@@ -38,6 +39,9 @@ namespace dabc {
          double                 fTmOut{0};          ///< used by device to process connection timeouts
          std::string            fConnId;            ///<! connection id
          Command                fLocalCmd;          ///< command from connection manager which should be replied when connection established or failed
+         bool                   fUseShm{false};     ///< try to use shared memory for the transport
+         ShmRegion*             fShmTx{nullptr};    ///< own shared memory region
+         ShmRegion*             fShmRx{nullptr};    ///< shared memory region of other side
 
          NewConnectRec() :
             fReqItem(),
@@ -56,6 +60,20 @@ namespace dabc {
          {
             fTmOut = req.GetConnTimeout() + SocketServerTmout;
             fConnId = req.GetConnId();
+            fUseShm = req.GetUseShm();
+         }
+
+         ~NewConnectRec()
+         {
+            delete fShmTx;
+            delete fShmRx;
+         }
+
+         /** Regions are not required when connection done via socket */
+         void DropShm()
+         {
+            delete fShmTx; fShmTx = nullptr;
+            delete fShmRx; fShmRx = nullptr;
          }
 
          const char *ConnId() const { return fConnId.c_str(); }
@@ -194,6 +212,8 @@ dabc::SocketDevice::SocketDevice(const std::string &name, Command cmd1) :
 {
    fBindHost = Cfg("host", cmd1).AsStr();
    fBindPort = Cfg("port", cmd1).AsInt(-1);
+   fZeroCopyMin = Cfg("zerocopy", cmd1).AsUInt(0);
+   fShmSize = Cfg("shmsize", cmd1).AsUInt(64);
 
    if (fBindHost.empty() && (fBindPort < 0)) {
       dabc::WorkerRef chl = dabc::mgr.GetCommandChannel();
@@ -369,6 +389,11 @@ int dabc::SocketDevice::HandleManagerConnectionRequest(Command cmd)
                client->SetConnHandler(this, req.GetConnId());
 
                rec = new NewConnectRec(reqitem, req, client);
+
+               // region created in advance, server will open it if running on the same node
+               if (rec->fUseShm)
+                  rec->fShmTx = ShmNetworkInetrface::CreateRegion(ShmRegion::MakeName(rec->fConnId, false), fShmSize * 0x100000LU);
+
                AddRec(rec);
 
                thread().MakeWorkerFor(client);
@@ -504,8 +529,21 @@ void dabc::SocketDevice::ServerProtocolRequest(SocketProtocolAddon *proc, const
 
    strcpy(outmsg, "accepted");
 
+   if (rec->fUseShm && !rec->fShmRx) {
+      // region of the client can be opened only when it runs on the same node
+      rec->fShmRx = ShmNetworkInetrface::OpenRegion(ShmRegion::MakeName(rec->fConnId, false));
+      if (rec->fShmRx) {
+         rec->fShmRx->Unlink();
+         rec->fShmTx = ShmNetworkInetrface::CreateRegion(ShmRegion::MakeName(rec->fConnId, true), fShmSize * 0x100000LU);
+      }
+      if (rec->fShmRx && rec->fShmTx)
+         strcpy(outmsg, "accepted shm");
+      else
+         rec->DropShm();
+   }
+
    if (fDebugMode)
-      DOUT0("scktdev: sending accept message via socket %d", proc->Socket());
+      DOUT0("scktdev: sending %s message via socket %d", outmsg, proc->Socket());
 
    LockGuard guard(DeviceMutex());
    fProtocols.remove(proc);
@@ -530,8 +568,21 @@ bool dabc::SocketDevice::ProtocolCompleted(SocketProtocolAddon* proc, const char
 
    if (destr) return true;
 
-   bool res = true;
-   if (inmsg) res = (strcmp(inmsg, "accepted") == 0);
+   bool res = true, useshm = !inmsg && rec->fShmTx && rec->fShmRx;
+   if (inmsg) {
+      useshm = (strcmp(inmsg, "accepted shm") == 0);
+      res = useshm || (strcmp(inmsg, "accepted") == 0);
+   }
+
+   if (res && useshm && inmsg) {
+      // server already opened our region, now open region of server
+      rec->fShmRx = ShmNetworkInetrface::OpenRegion(ShmRegion::MakeName(rec->fConnId, true));
+      if (rec->fShmRx)
+         rec->fShmRx->Unlink();
+      else
+         res = false;
+      if (!rec->fShmTx) res = false;
+   }
 
    if (inmsg) DOUT3("Reply from server: %s", inmsg);
 
@@ -544,11 +595,23 @@ bool dabc::SocketDevice::ProtocolCompleted(SocketProtocolAddon* proc, const char
 
       ConnectionRequestFull req = dabc::mgr.FindPar(rec->fReqItem);
 
-      auto addon = new SocketNetworkInetrface(fd);
+      if (useshm) {
+         auto addon = new ShmNetworkInetrface(fd, rec->fShmTx, rec->fShmRx);
+         rec->fShmTx = rec->fShmRx = nullptr;
 
-      res = dabc::NetworkTransport::Make(req, addon, ThreadName());
+         res = dabc::NetworkTransport::Make(req, addon, ThreadName());
 
-      DOUT0("Create socket transport for fd %d res %s", fd, DBOOL(res));
+         DOUT0("Create shared memory transport for fd %d res %s", fd, DBOOL(res));
+      } else {
+         rec->DropShm();
+
+         auto addon = new SocketNetworkInetrface(fd);
+         if (fZeroCopyMin > 0) addon->SetZeroCopy(fZeroCopyMin);
+
+         res = dabc::NetworkTransport::Make(req, addon, ThreadName());
+
+         DOUT0("Create socket transport for fd %d res %s", fd, DBOOL(res));
+      }
    }
 
    RemoveProtocolAddon(proc, res);
@@ -20,12 +20,18 @@
 #include <sys/poll.h>
 #include <fcntl.h>
 #include <cerrno>
+#include <climits>
 #include <cstdlib>
 #include <unistd.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
 
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#include <linux/errqueue.h>
+#define DABC_SOCKET_ZEROCOPY
+#endif
+
 #include "dabc/Configuration.h"
 
 #if defined(__MACH__) /* Apple OSX section */
@@ -417,6 +423,14 @@ bool dabc::SocketIOAddon::StartRecv(void *buf, size_t size)
    return StartRecvHdr(nullptr, 0, buf, size);
 }
 
+bool dabc::SocketIOAddon::StartRecvAvailable(void *buf, size_t size)
+{
+   if (!StartRecvHdr(nullptr, 0, buf, size)) return false;
+
+   fRecvAny = true;
+   return true;
+}
+
 bool dabc::SocketIOAddon::StartSend(const Buffer &buf)
 {
    // this is simple version,
@@ -555,6 +569,103 @@ bool dabc::SocketIOAddon::StartNetSend(void *hdr, unsigned hdrsize, const Buffer
    return true;
 }
 
+bool dabc::SocketIOAddon::StartSendIOV(const struct iovec *iov, unsigned num, bool zerocopy)
+{
+   if (fSendIOVNumber > 0) {
+      EOUT("Current send operation not yet completed");
+      return false;
+   }
+
+   if (!iov || (num == 0)) {
+      EOUT("No buffer specified");
+      return false;
+   }
+
+   if (num > MaxSendIOV()) {
+      EOUT("Too many elements %u in send vector, maximum is %u", num, MaxSendIOV());
+      return false;
+   }
+
+   if (fSendIOVSize < num)
+      AllocateSendIOV(num);
+
+   memcpy(fSendIOV, iov, num * sizeof(struct iovec));
+
+   fSendUseMsg = fUseMsgOper;
+   fSendIOVFirst = 0;
+   fSendIOVNumber = num;
+   fSendZeroCopy = zerocopy && fZeroCopy && fSendUseMsg;
+
+   SetDoingOutput(true);
+
+   return true;
+}
+
+bool dabc::SocketIOAddon::EnableZeroCopy()
+{
+#ifdef DABC_SOCKET_ZEROCOPY
+   if (IsDatagramSocket() || (Socket() < 0)) return false;
+
+   int one = 1;
+   if (setsockopt(Socket(), SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) != 0) {
+      DOUT1("Socket %d cannot enable SO_ZEROCOPY: %s", Socket(), SocketErr(errno));
+      return false;
+   }
+
+   fZeroCopy = true;
+   return true;
+#else
+   return false;
+#endif
+}
+
+unsigned dabc::SocketIOAddon::ReadZeroCopyNotifications()
+{
+   unsigned cnt = 0;
+
+#ifdef DABC_SOCKET_ZEROCOPY
+   while (fZeroCopy && (Socket() >= 0)) {
+      char control[128];
+      struct msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+
+      if (recvmsg(Socket(), &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) break;
+
+      for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+         if (!(((cm->cmsg_level == SOL_IP) && (cm->cmsg_type == IP_RECVERR)) ||
+               ((cm->cmsg_level == SOL_IPV6) && (cm->cmsg_type == IPV6_RECVERR)))) continue;
+
+         struct sock_extended_err *serr = (struct sock_extended_err *) CMSG_DATA(cm);
+         if ((serr->ee_errno != 0) || (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)) continue;
+
+         // range [ee_info, ee_data] of completed calls, for TCP they come in order
+         if ((int32_t) (serr->ee_data + 1 - fZeroCopyDone) > 0)
+            fZeroCopyDone = serr->ee_data + 1;
+         if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+            fZeroCopyCopied++;
+         cnt++;
+      }
+   }
+
+   SetWaitErrQueue(fZeroCopyDone != fZeroCopyNext);
+
+   if (cnt > 0) OnZeroCopyCompleted();
+#endif
+
+   return cnt;
+}
+
+unsigned dabc::SocketIOAddon::MaxSendIOV()
+{
+#ifdef IOV_MAX
+   return IOV_MAX;
+#else
+   return 1024;
+#endif
+}
+
 void dabc::SocketIOAddon::ProcessEvent(const EventId& evnt)
 {
 //   DOUT0("IO addon:%p process event %u", this, evnt.GetCode());
@@ -634,10 +745,11 @@ void dabc::SocketIOAddon::ProcessEvent(const EventId& evnt)
 
           fLastRecvSize = res;
 
-          if (IsDatagramSocket()) {
+          if (IsDatagramSocket() || fRecvAny) {
              // for datagram the only recv message is possible
              fRecvIOVFirst = 0;
              fRecvIOVNumber = 0;
+             fRecvAny = false;
 
 //             if (IsLogging())
 //                DOUT0("Socket %d signals COMPL", Socket());
@@ -708,7 +820,25 @@ void dabc::SocketIOAddon::ProcessEvent(const EventId& evnt)
              msg.msg_controllen = 0;
              msg.msg_flags = 0;
 
-             res = sendmsg(fSocket, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+             int flags = MSG_DONTWAIT | MSG_NOSIGNAL;
+#ifdef DABC_SOCKET_ZEROCOPY
+             if (fSendZeroCopy) flags |= MSG_ZEROCOPY;
+#endif
+
+             res = sendmsg(fSocket, &msg, flags);
+
+#ifdef DABC_SOCKET_ZEROCOPY
+             if (fSendZeroCopy) {
+                if (res > 0) {
+                   fZeroCopyNext++;
+                   SetWaitErrQueue(true);
+                } else if ((res < 0) && (errno == ENOBUFS)) {
+                   // locked memory limit for zero-copy exceeded, use normal send for the rest
+                   fSendZeroCopy = false;
+                   res = sendmsg(fSocket, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+                }
+             }
+#endif
           } else
              res = send(fSocket, fSendIOV[fSendIOVFirst].iov_base, fSendIOV[fSendIOVFirst].iov_len, MSG_DONTWAIT | MSG_NOSIGNAL);
 
@@ -753,6 +883,7 @@ void dabc::SocketIOAddon::ProcessEvent(const EventId& evnt)
 
                    fSendIOVFirst = 0;
                    fSendIOVNumber = 0;
+                   fSendZeroCopy = false;
 
                    OnSendCompleted();
 
@@ -770,6 +901,27 @@ void dabc::SocketIOAddon::ProcessEvent(const EventId& evnt)
 
           break;
        }
+       case evntSocketError: {
+          // error queue also delivers zero-copy completions, they are not a failure
+          // queue can be already drained by previous event, therefore check if error condition remains
+          if (fZeroCopy) {
+             ReadZeroCopyNotifications();
+
+             struct pollfd pfd;
+             pfd.fd = Socket();
+             pfd.events = 0;
+             pfd.revents = 0;
+
+             if ((TakeSocketError() == 0) && (poll(&pfd, 1, 0) == 0)) {
+                if (fRecvIOVNumber > 0) SetDoingInput(true);
+                if (fSendIOVNumber > 0) SetDoingOutput(true);
+                return;
+             }
+          }
+
+          SocketAddon::ProcessEvent(evnt);
+          break;
+       }
        default:
           SocketAddon::ProcessEvent(evnt);
     }
@@ -777,8 +929,10 @@ void dabc::SocketIOAddon::ProcessEvent(const EventId& evnt)
 
 void dabc::SocketIOAddon::CancelIOOperations()
 {
+   fSendZeroCopy = false;
    fSendIOVNumber = 0;
    fRecvIOVNumber = 0;
+   fRecvAny = false;
 }
 
 // ___________________________________________________________________
@@ -1559,7 +1713,7 @@ bool dabc::SocketThread::WaitEvent(EventId& evnt, double tmout_sec)
       if (addon->IsDoingOutput())
          events |= POLLOUT;
 
-      if (events == 0) continue;
+      if ((events == 0) && !addon->IsWaitErrQueue()) continue;
 
       f_ufds[numufds].fd = addon->Socket();
       f_ufds[numufds].events = events;
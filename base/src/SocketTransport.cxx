@@ -15,6 +15,11 @@
 
 #include "dabc/SocketTransport.h"
 
+#include <cstring>
+#include <sys/socket.h>
+
+#include "dabc/Pointer.h"
+
 dabc::SocketNetworkInetrface::SocketNetworkInetrface(int fd, bool datagram) :
    SocketIOAddon(fd, datagram, true),
    NetworkInetrface(),
@@ -24,9 +29,10 @@ dabc::SocketNetworkInetrface::SocketNetworkInetrface(int fd, bool datagram) :
    fRecvStatus(0),
    fRecvRecid(0),
    fSendStatus(0),
-   fSendRecid(0),
    fMcastAddr()
 {
+   // records are coalesced by the transport itself, Nagle only delays small messages
+   if (!datagram) SocketThread::SetNoDelaySocket(fd);
 }
 
 dabc::SocketNetworkInetrface::~SocketNetworkInetrface()
@@ -34,6 +40,25 @@ dabc::SocketNetworkInetrface::~SocketNetworkInetrface()
    if (!fMcastAddr.empty())
       SocketThread::DettachMulticast(Socket(), fMcastAddr);
 
+   if (fSendCalls + fRecvCalls > 0)
+      DOUT2("Socket %d batching: send %lu records in %lu calls, recv %lu records in %lu calls", Socket(),
+            (long unsigned) fSendRecs, (long unsigned) fSendCalls, (long unsigned) fRecvRecs, (long unsigned) fRecvCalls);
+
+   if (fZeroCopyCalls > 0)
+      DOUT2("Socket %d zero-copy: %lu operations, max pending %u, copied by kernel %lu", Socket(),
+            (long unsigned) fZeroCopyCalls, fZeroCopyMaxPending, (long unsigned) GetZeroCopyCopied());
+
+   if (!fZeroCopyRecs.empty() && (Socket() >= 0)) {
+      // kernel may still reference memory of pending zero-copy sends,
+      // abort connection to drop queued data before buffers and headers are released
+      struct linger lng;
+      lng.l_onoff = 1;
+      lng.l_linger = 0;
+      setsockopt(Socket(), SOL_SOCKET, SO_LINGER, &lng, sizeof(lng));
+      CloseSocket();
+   }
+   fZeroCopyRecs.clear();
+
    delete [] fHeaders; fHeaders = nullptr;
 }
 
@@ -52,10 +77,44 @@ void dabc::SocketNetworkInetrface::AllocateNet(unsigned fulloutputqueue, unsigne
    fSendQueue.Allocate(fulloutputqueue); // +2 for sending and recv ackn
    fRecvQueue.Allocate(fullinputqueue);
 
+   // datagram socket can deliver only single record per packet
+   fSendBatchMax = IsDatagramSocket() ? 1 : 64;
+   fSendBatchBytes = 256*1024;
+   fSendBatch.reserve(fSendBatchMax);
+   fSendIOVBatch.reserve(16);
+
+   // staging buffer should hold several headers with inline data
+   if (!IsDatagramSocket())
+      fRecvStage.resize(std::max(16384U, 8*tr->GetFullHeaderSize()));
+
    DOUT5("Create queues inp: %d out: %d", fullinputqueue, fulloutputqueue);
 }
 
 
+bool dabc::SocketNetworkInetrface::SetZeroCopy(unsigned minsize)
+{
+   fZeroCopyMin = 0;
+
+   if (minsize == 0) return false;
+
+   if (!EnableZeroCopy()) {
+      DOUT1("Zero-copy send not supported for socket %d", Socket());
+      return false;
+   }
+
+   fZeroCopyMin = minsize;
+   return true;
+}
+
+void dabc::SocketNetworkInetrface::OnZeroCopyCompleted()
+{
+   // buffers can be released only when kernel no longer uses their memory
+   while (!fZeroCopyRecs.empty() && fZeroCopyRecs.front().sent &&
+          ((int32_t) (GetZeroCopyDone() - (fZeroCopyRecs.front().lastid + 1)) >= 0)) {
+      fZeroCopyRecs.pop_front();
+   }
+}
+
 long dabc::SocketNetworkInetrface::Notify(const std::string &cmd, int arg)
 {
    if (cmd == "GetNetworkTransportInetrface") return (long) ((NetworkInetrface*) this);
@@ -69,7 +128,7 @@ void dabc::SocketNetworkInetrface::SubmitSend(uint32_t recid)
    fSendQueue.Push(recid);
 
    // we are in transport thread and can call event-processing methods directly
-   if ((fSendQueue.Size() == 1) && (fSendStatus == 0)) OnSendCompleted();
+   if (fSendStatus == 0) OnSendCompleted();
 }
 
 void dabc::SocketNetworkInetrface::SubmitRecv(uint32_t recid)
@@ -79,7 +138,7 @@ void dabc::SocketNetworkInetrface::SubmitRecv(uint32_t recid)
    fRecvQueue.Push(recid);
 
    // we are in transport thread and can call event-processing methods directly
-   if ((fRecvQueue.Size() == 1) && (fRecvStatus == 0)) OnRecvCompleted();
+   if ((fRecvStatus == 0) && !fRecvProcessing) OnRecvCompleted();
 }
 
 
@@ -103,123 +162,277 @@ void dabc::SocketNetworkInetrface::OnSendCompleted()
 //   DOUT0("SocketNetworkInetrface::OnSendCompleted status %d ", fSendStatus);
 
    if (fSendStatus == 1) {
-      tr->ProcessSendCompl(fSendRecid);
-      fSendRecid = 0;
+      if (fSendIsZeroCopy) {
+         // no calls with MSG_ZEROCOPY flag gives lastid = first - 1 and record released at once
+         fZeroCopyRecs.back().lastid = GetZeroCopyNext() - 1;
+         fZeroCopyRecs.back().sent = true;
+         fSendIsZeroCopy = false;
+      }
+
+      // status remains 1 while records are completed,
+      // new records submitted from ProcessSendCompl only queued
+      for (unsigned n = 0; n < fSendBatch.size(); n++)
+         tr->ProcessSendCompl(fSendBatch[n]);
+      fSendBatch.clear();
       fSendStatus = 0;
+
+      if (!fZeroCopyRecs.empty()) OnZeroCopyCompleted();
    }
 
    // nothing to do, just wait for new submitted recv operation
    if (fSendQueue.Size() == 0) return;
 
-   fSendRecid = fSendQueue.Pop();
+   fSendIOVBatch.clear();
+   BufferSize_t batchsize = 0, payload = 0;
+   unsigned maxiov = MaxSendIOV();
+   bool canzerocopy = fZeroCopyMin > 0;
 
-   fSendStatus = 1;
+   while ((fSendQueue.Size() > 0) && (fSendBatch.size() < fSendBatchMax) && (batchsize < fSendBatchBytes)) {
+
+      uint32_t recid = fSendQueue.Front();
+
+      NetworkTransport::NetIORec* rec = tr->GetRec(recid);
+
+      if (!rec) {
+         EOUT("Completely wrong send recid %u", recid);
+         exit(432);
+      }
+
+      // record with many segments will be sent with next operation
+      unsigned numiov = 1 + rec->buf.NumSegments();
+      if (!fSendBatch.empty() && (fSendIOVBatch.size() + numiov > maxiov)) break;
+
+      fSendQueue.Pop();
+
+      int sendtyp = tr->PackHeader(recid);
 
-   int sendtyp = tr->PackHeader(fSendRecid);
+      if (sendtyp == 0) {
+         EOUT("record %u failed", recid);
+         throw dabc::Exception("send record failed - should never happen");
+      }
 
-   if (sendtyp == 0) {
-      EOUT("record %u failed", fSendRecid);
-      throw dabc::Exception("send record failed - should never happen");
+      fSendBatch.push_back(recid);
+
+      // compressed data kept in transport storage, reused once record is completed
+      if (rec->kind & NetworkTransport::netot_Compressed) canzerocopy = false;
+
+      struct iovec iov;
+      iov.iov_base = rec->header;
+      iov.iov_len = tr->GetFullHeaderSize();
+      fSendIOVBatch.push_back(iov);
+      batchsize += iov.iov_len;
+
+      if (sendtyp == 2)
+         for (unsigned seg = 0; seg < rec->buf.NumSegments(); seg++) {
+            if (rec->buf.SegmentSize(seg) == 0) continue;
+            iov.iov_base = rec->buf.SegmentPtr(seg);
+            iov.iov_len = rec->buf.SegmentSize(seg);
+            fSendIOVBatch.push_back(iov);
+            batchsize += iov.iov_len;
+            payload += iov.iov_len;
+         }
    }
 
-   NetworkTransport::NetIORec* rec = tr->GetRec(fSendRecid);
+   if (canzerocopy && (payload >= fZeroCopyMin) && (fSendIOVBatch.size() <= maxiov)) {
+      // headers memory reused by next records, therefore send copy of them
+      // buffers references kept until kernel completes transmission
+      fZeroCopyRecs.emplace_back();
+      ZeroCopyRec &zrec = fZeroCopyRecs.back();
+      unsigned hdrsize = tr->GetFullHeaderSize();
+      zrec.headers.resize(fSendBatch.size() * hdrsize);
+      zrec.bufs.reserve(fSendBatch.size());
+
+      // headers are placed in gather list in order of records
+      unsigned nhdr = 0;
+      for (auto &iov : fSendIOVBatch) {
+         if (nhdr >= fSendBatch.size()) break;
+         NetworkTransport::NetIORec* rec = tr->GetRec(fSendBatch[nhdr]);
+         if (iov.iov_base != rec->header) continue;
+         char *hdr = zrec.headers.data() + (nhdr++) * hdrsize;
+         memcpy(hdr, iov.iov_base, hdrsize);
+         iov.iov_base = hdr;
+         if (!rec->buf.null()) zrec.bufs.emplace_back(rec->buf);
+      }
 
-   if (!rec) {
-      EOUT("Completely wrong send recid %u", fSendRecid);
-      exit(432);
+      fSendIsZeroCopy = true;
+      fZeroCopyCalls++;
+      if (fZeroCopyRecs.size() > fZeroCopyMaxPending)
+         fZeroCopyMaxPending = fZeroCopyRecs.size();
    }
 
-//   DOUT0("Start sending rec %u typ %d buf %u", fSendRecid, sendtyp, rec->buf.GetTotalSize());
+//   DOUT0("Start sending %u records %u iov", (unsigned) fSendBatch.size(), (unsigned) fSendIOVBatch.size());
 
-   if (sendtyp == 1)
-      StartSend(rec->header, tr->GetFullHeaderSize());
-   else
-      StartNetSend(rec->header, tr->GetFullHeaderSize(), rec->buf);
+   fSendStatus = 1;
+   fSendCalls++;
+   fSendRecs += fSendBatch.size();
 
+   if (fSendIOVBatch.size() > maxiov) {
+      // single record with too many segments
+      uint32_t recid = fSendBatch[0];
+      NetworkTransport::NetIORec* rec = tr->GetRec(recid);
+      StartNetSend(rec->header, tr->GetFullHeaderSize(), rec->buf);
+   } else if (!StartSendIOV(fSendIOVBatch.data(), fSendIOVBatch.size(), fSendIsZeroCopy)) {
+      EOUT("Cannot start send - fatal error");
+      tr->CloseTransport(true);
+   }
 }
 
-void dabc::SocketNetworkInetrface::OnRecvCompleted()
+void dabc::SocketNetworkInetrface::ProcessStagedData(NetworkTransport* tr)
 {
-   NetworkTransport* tr = (NetworkTransport*) fWorker();
+   fRecvProcessing = true;
 
-//   DOUT0("dabc::SocketNetworkInetrface::OnRecvCompleted %p", tr);
+   unsigned hdrsize = tr->GetFullHeaderSize();
 
-   if (!tr) {
-      EOUT("Transport not available!!!");
-      return;
-   }
+   while (fRecvStatus == 0) {
 
-do_compl:
+      if ((fStageEnd - fStageBeg >= hdrsize) && (fRecvQueue.Size() > 0)) {
+         // complete header is available - take it
 
-   if (fRecvStatus == 2) {
-      // if we complete receiving of the buffer
+         uint32_t recid = fRecvQueue.Pop();
 
-      tr->ProcessRecvCompl(fRecvRecid);
-      fRecvRecid = 0;
-      fRecvStatus = 0;
-   }
+         NetworkTransport::NetIORec* rec = tr->GetRec(recid);
 
-   if (fRecvStatus == 1) {
-      // analyze header, set new recv operation and so on
+         if (!rec) {
+            EOUT("Completely wrong recv recid %u", recid);
+            exit(432);
+         }
 
-      fRecvStatus = 2;
+         memcpy(rec->header, fRecvStage.data() + fStageBeg, hdrsize);
+         fStageBeg += hdrsize;
 
-      NetworkTransport::NetIORec* rec = tr->GetRec(fRecvRecid);
+         NetworkTransport::NetworkHeader* nethdr = (NetworkTransport::NetworkHeader*) rec->header;
 
-      if (!rec) {
-         EOUT("Completely wrong recv rec id %u", fRecvRecid);
-         exit(75);
-      }
+         if (nethdr->typid == dabc::mbt_EOL) {
+            DOUT1("Receive buffer with EOL bufsize = %u resthdr = %lu",
+                    nethdr->size, (long unsigned) (hdrsize - sizeof(NetworkTransport::NetworkHeader)));
+         }
+
+         // inline data already delivered with the header
+         BufferSize_t payload = 0;
+         if (!(nethdr->kind & NetworkTransport::netot_HdrSend) && (nethdr->size > hdrsize - sizeof(NetworkTransport::NetworkHeader)))
+            payload = nethdr->size;
+
+         if (payload > rec->buf.GetTotalSize()) {
+            EOUT("Fatal - no buffer to receive data rec %d  sz1:%d sz2:%d",
+                    recid, nethdr->size, rec->buf.GetTotalSize());
+
+            tr->CloseTransport(true);
+            break;
+         }
+
+         fLastPayload = payload;
+         fRecvRecs++;
+
+         BufferSize_t staged = std::min((BufferSize_t) (fStageEnd - fStageBeg), payload);
+         if (staged > 0) {
+            Pointer(rec->buf).copyfrom(fRecvStage.data() + fStageBeg, staged);
+            fStageBeg += staged;
+         }
+
+         if (staged < payload) {
+            // rest of buffer read directly from the socket
+            fRecvRecid = recid;
+            fRecvStatus = 2;
+
+            bool res = false;
+            if (staged == 0) {
+               res = StartRecv(rec->buf, payload);
+            } else {
+               fRecvRest = rec->buf.Duplicate();
+               fRecvRest.CutFromBegin(staged);
+               res = StartRecv(fRecvRest, payload - staged);
+            }
 
-      NetworkTransport::NetworkHeader* nethdr = (NetworkTransport::NetworkHeader*) rec->header;
+            if (!res) {
+               EOUT("Cannot start recv - fatal error");
+               tr->CloseTransport(true);
+            }
+            break;
+         }
 
-      if (nethdr->typid == dabc::mbt_EOL) {
-         DOUT1("Receive buffer with EOL bufsize = %u resthdr = %lu",
-                 nethdr->size, (long unsigned) (tr->GetFullHeaderSize() - sizeof(NetworkTransport::NetworkHeader)));
+         tr->ProcessRecvCompl(recid);
+         continue;
       }
 
-      if (nethdr->kind & NetworkTransport::netot_HdrSend) {
-         goto do_compl;
+      // nothing to do, just wait for new submitted recv operation
+      if (fRecvQueue.Size() == 0) break;
+
+      // move rest of data to the begin of staging buffer
+      if (fStageBeg > 0) {
+         if (fStageEnd > fStageBeg)
+            memmove(fRecvStage.data(), fRecvStage.data() + fStageBeg, fStageEnd - fStageBeg);
+         fStageEnd -= fStageBeg;
+         fStageBeg = 0;
       }
 
-      if (nethdr->size > rec->buf.GetTotalSize()) {
-         EOUT("Fatal - no buffer to receive data rec %d  sz1:%d sz2:%d",
-                 fRecvRecid, nethdr->size, rec->buf.GetTotalSize());
+      // when big buffers are transported, read only header in staging buffer
+      // to let payload be received directly in the target buffer
+      unsigned want = fRecvStage.size() - fStageEnd;
+      if ((fLastPayload > fRecvStage.size() / 2) && (want > hdrsize - fStageEnd))
+         want = hdrsize - fStageEnd;
 
-         tr->CloseTransport(true);
-         return;
-      }
+      fRecvStatus = 3;
+      fRecvCalls++;
 
-      if (!StartRecv(rec->buf, nethdr->size)) {
+      if (!StartRecvAvailable(fRecvStage.data() + fStageEnd, want)) {
          EOUT("Cannot start recv - fatal error");
          tr->CloseTransport(true);
-         return;
       }
+   }
 
-      // DOUT0("Start receiving of buffer size %u", nethdr->size);
-   } else {
-      // nothing to do, just wait for new submitted recv operation
-      if (fRecvQueue.Size() == 0) return;
-      fRecvRecid = fRecvQueue.Pop();
+   fRecvProcessing = false;
+}
 
-      NetworkTransport::NetIORec* rec = tr->GetRec(fRecvRecid);
+void dabc::SocketNetworkInetrface::OnRecvCompleted()
+{
+   NetworkTransport* tr = (NetworkTransport*) fWorker();
 
-      if (!rec) {
-         EOUT("Completely wrong recv recid %u", fRecvRecid);
-         exit(432);
-      }
+//   DOUT0("dabc::SocketNetworkInetrface::OnRecvCompleted %p", tr);
 
-//      DOUT0("SocketNetworkInetrface::OnRecvCompleted start receiving socket %d thrd %s", Socket(), tr->ThreadName().c_str());
+   if (!tr) {
+      EOUT("Transport not available!!!");
+      return;
+   }
 
-      if (IsDatagramSocket()) {
-//         DOUT0("Start recv from datagram socket");
-         fRecvStatus = 2;
-         StartNetRecv(rec->header, tr->GetFullHeaderSize(), rec->buf, rec->buf.GetTotalSize());
-      } else {
-         fRecvStatus = 1;
-         // do normal recv of the header data without evolving messages
-         StartRecv(rec->header, tr->GetFullHeaderSize());
+   if (!IsDatagramSocket()) {
+      if (fRecvStatus == 3) {
+         fStageEnd += GetRecvSize();
+         fRecvStatus = 0;
+      } else if (fRecvStatus == 2) {
+         // if we complete receiving of the buffer
+         fRecvRest.Release();
+         fRecvStatus = 0;
+         uint32_t recid = fRecvRecid;
+         fRecvRecid = 0;
+         fRecvProcessing = true;
+         tr->ProcessRecvCompl(recid);
+         fRecvProcessing = false;
       }
+
+      ProcessStagedData(tr);
+      return;
    }
-}
 
+   if (fRecvStatus == 2) {
+      // if we complete receiving of the buffer
+
+      tr->ProcessRecvCompl(fRecvRecid);
+      fRecvRecid = 0;
+      fRecvStatus = 0;
+   }
+
+   // nothing to do, just wait for new submitted recv operation
+   if (fRecvQueue.Size() == 0) return;
+   fRecvRecid = fRecvQueue.Pop();
+
+   NetworkTransport::NetIORec* rec = tr->GetRec(fRecvRecid);
+
+   if (!rec) {
+      EOUT("Completely wrong recv recid %u", fRecvRecid);
+      exit(432);
+   }
+
+//   DOUT0("Start recv from datagram socket");
+   fRecvStatus = 2;
+   StartNetRecv(rec->header, tr->GetFullHeaderSize(), rec->buf, rec->buf.GetTotalSize());
+}
@@ -0,0 +1,375 @@
+// $Id$
+
+/************************************************************
+ * The Data Acquisition Backbone Core (DABC)                *
+ ************************************************************
+ * Copyright (C) 2009 -                                     *
+ * GSI Helmholtzzentrum fuer Schwerionenforschung GmbH      *
+ * Planckstr. 1, 64291 Darmstadt, Germany                   *
+ * Contact:  http://dabc.gsi.de                             *
+ ************************************************************
+ * This software can be used under the GPL license          *
+ * agreements as stated in LICENSE.txt file                 *
+ * which is part of the distribution.                       *
+ ************************************************************/
+
+#include "dabc/StripedFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <list>
+
+#include "dabc/threads.h"
+#include "dabc/string.h"
+
+namespace dabc {
+
+   static const char *StripedManifestTag = "# DABC striped file";
+
+   /** \brief Thread writing blocks into single stripe file */
+
+   class StripeWriter {
+      public:
+         Mutex       fMutex;
+         Condition   fJobCond;          ///< fired when new block is queued
+         Condition   fSpaceCond;        ///< fired when block is written
+         PosixThread fThrd;
+         FILE       *fFile{nullptr};
+         std::list<std::vector<char>> fQueue;  ///< blocks to write, first block is written now
+         std::list<std::vector<char>> fFree;   ///< already written blocks, can be reused
+         unsigned    fDepth{0};
+         bool        fStop{false};
+         bool        fError{false};
+
+         StripeWriter(FILE *f, unsigned depth) : fMutex(), fJobCond(&fMutex), fSpaceCond(&fMutex), fFile(f), fDepth(depth)
+         {
+            fThrd.Start(StripeWriter::RunFunc, this);
+            fThrd.SetThreadName("StripeWriter");
+         }
+
+         /** Stop thread and close file, returns false if any write error happened */
+         bool Close()
+         {
+            {
+               LockGuard lock(fMutex);
+               fStop = true;
+               fJobCond._DoFire();
+            }
+            fThrd.Join();
+            bool res = !fError;
+            if (fFile && (::fclose(fFile) != 0)) res = false;
+            fFile = nullptr;
+            return res;
+         }
+
+         /** Take block which can be filled, reuse memory when possible */
+         void TakeFree(std::vector<char> &blk)
+         {
+            LockGuard lock(fMutex);
+            if (!fFree.empty()) {
+               blk.swap(fFree.front());
+               fFree.pop_front();
+            }
+            blk.clear();
+         }
+
+         /** Queue block for writing, blocks when too many blocks are queued */
+         bool Push(std::vector<char> &blk)
+         {
+            LockGuard lock(fMutex);
+            while ((fQueue.size() >= fDepth) && !fError)
+               fSpaceCond._DoWait(-1);
+            if (fError) return false;
+            fQueue.emplace_back();
+            fQueue.back().swap(blk);
+            fJobCond._DoFire();
+            return true;
+         }
+
+         /** Wait until all queued blocks are written */
+         bool Drain()
+         {
+            LockGuard lock(fMutex);
+            while (!fQueue.empty() && !fError)
+               fSpaceCond._DoWait(-1);
+            return !fError;
+         }
+
+         static void *RunFunc(void *args)
+         {
+            StripeWriter *w = (StripeWriter *) args;
+
+            while (true) {
+               std::vector<char> *blk = nullptr;
+               {
+                  LockGuard lock(w->fMutex);
+                  while (w->fQueue.empty() && !w->fStop)
+                     w->fJobCond._DoWait(-1);
+                  if (w->fQueue.empty()) break;
+                  blk = &w->fQueue.front();
+               }
+
+               bool ok = ::fwrite(blk->data(), 1, blk->size(), w->fFile) == blk->size();
+
+               LockGuard lock(w->fMutex);
+               if (!ok) {
+                  EOUT("Fail to write block of size %u into stripe file", (unsigned) blk->size());
+                  w->fError = true;
+               }
+               w->fFree.splice(w->fFree.end(), w->fQueue, w->fQueue.begin());
+               if (w->fFree.size() > 2) w->fFree.pop_front();
+               w->fSpaceCond._DoFire();
+            }
+
+            return nullptr;
+         }
+   };
+
+   /** \brief Handle of opened striped file */
+
+   struct StripedHandle {
+      bool                        fReading{false};
+      unsigned                    fBlockSize{0};
+      std::vector<StripeWriter *> fWriters;    ///< writers, used when writing
+      std::vector<char>           fBlock;      ///< currently filled block
+      uint64_t                    fBlockCnt{0}; ///< number of blocks submitted
+      std::vector<FILE *>         fFiles;      ///< stripe files, used when reading
+      std::vector<uint64_t>       fFilePos;    ///< current positions in stripe files
+      uint64_t                    fPos{0};     ///< position in logical stream when reading
+      bool                        fEOF{false};
+   };
+
+}
+
+dabc::StripedFileInterface::StripedFileInterface(const std::vector<std::string> &dirs, unsigned blocksize, unsigned depth) :
+   FileInterface(),
+   fDirs(dirs),
+   fBlockSize(blocksize < 0x10000 ? 0x10000 : blocksize),
+   fQueueDepth(depth < 1 ? 1 : depth)
+{
+}
+
+bool dabc::StripedFileInterface::IsStripedFile(const std::string &fname)
+{
+   std::ifstream f(fname);
+   std::string line;
+   return f && std::getline(f, line) && (line == StripedManifestTag);
+}
+
+dabc::FileInterface::Handle dabc::StripedFileInterface::fopen(const char *fname, const char *mode, const char *)
+{
+   if (!fname || !mode) return nullptr;
+
+   StripedHandle *h = new StripedHandle;
+
+   if (*mode == 'r') {
+      std::ifstream f(fname);
+      std::string line;
+      if (!f || !std::getline(f, line) || (line != StripedManifestTag)) {
+         EOUT("File %s is not striped file manifest", fname);
+         delete h;
+         return nullptr;
+      }
+
+      h->fReading = true;
+      while (std::getline(f, line)) {
+         if (line.compare(0, 10, "blocksize ") == 0) {
+            unsigned sz = 0;
+            if (dabc::str_to_uint(line.c_str() + 10, &sz)) h->fBlockSize = sz;
+         } else if (line.compare(0, 7, "stripe ") == 0) {
+            FILE *sf = ::fopen(line.c_str() + 7, "r");
+            if (!sf) {
+               EOUT("Cannot open stripe file %s", line.c_str() + 7);
+               h->fBlockSize = 0;
+               break;
+            }
+            h->fFiles.emplace_back(sf);
+            h->fFilePos.emplace_back(0);
+         }
+      }
+
+      if ((h->fBlockSize == 0) || h->fFiles.empty()) {
+         fclose(h);
+         return nullptr;
+      }
+
+      return h;
+   }
+
+   if (fDirs.empty()) {
+      EOUT("No directories specified for striped file %s", fname);
+      delete h;
+      return nullptr;
+   }
+
+   const char *slash = strrchr(fname, '/');
+   std::string basename = slash ? slash + 1 : fname;
+
+   std::ofstream manifest(fname);
+   if (!manifest) {
+      EOUT("Cannot create manifest %s", fname);
+      delete h;
+      return nullptr;
+   }
+   manifest << StripedManifestTag << std::endl;
+   manifest << "blocksize " << fBlockSize << std::endl;
+
+   h->fBlockSize = fBlockSize;
+
+   std::vector<std::string> created;
+
+   for (auto &dir : fDirs) {
+      std::string sname = dir + basename;
+      FILE *sf = ::fopen(sname.c_str(), "w");
+      if (!sf) {
+         EOUT("Cannot create stripe file %s", sname.c_str());
+         fclose(h);
+         // incomplete striped file should not remain
+         manifest.close();
+         ::remove(fname);
+         for (auto &name : created)
+            ::remove(name.c_str());
+         return nullptr;
+      }
+      created.emplace_back(sname);
+      h->fWriters.emplace_back(new StripeWriter(sf, fQueueDepth));
+      manifest << "stripe " << sname << std::endl;
+   }
+
+   if (!manifest.flush()) {
+      EOUT("Fail to write manifest %s", fname);
+      fclose(h);
+      manifest.close();
+      ::remove(fname);
+      for (auto &name : created)
+         ::remove(name.c_str());
+      return nullptr;
+   }
+
+   h->fBlock.reserve(fBlockSize);
+
+   return h;
+}
+
+void dabc::StripedFileInterface::fclose(Handle f)
+{
+   StripedHandle *h = (StripedHandle *) f;
+   if (!h) return;
+
+   if (!h->fWriters.empty() && !h->fBlock.empty())
+      h->fWriters[h->fBlockCnt % h->fWriters.size()]->Push(h->fBlock);
+
+   for (auto w : h->fWriters) {
+      if (!w->Close())
+         EOUT("Failure when writing stripe file");
+      delete w;
+   }
+
+   for (auto sf : h->fFiles)
+      ::fclose(sf);
+
+   delete h;
+}
+
+size_t dabc::StripedFileInterface::fwrite(const void* ptr, size_t sz, size_t nmemb, Handle f)
+{
+   StripedHandle *h = (StripedHandle *) f;
+   if (!h || !ptr || h->fReading) return 0;
+
+   const char *src = (const char *) ptr;
+   size_t total = sz * nmemb;
+
+   while (total > 0) {
+      size_t portion = h->fBlockSize - h->fBlock.size();
+      if (portion > total) portion = total;
+      h->fBlock.insert(h->fBlock.end(), src, src + portion);
+      src += portion;
+      total -= portion;
+
+      if (h->fBlock.size() == h->fBlockSize) {
+         if (!h->fWriters[h->fBlockCnt++ % h->fWriters.size()]->Push(h->fBlock))
+            return 0;
+         h->fWriters[h->fBlockCnt % h->fWriters.size()]->TakeFree(h->fBlock);
+         h->fBlock.reserve(h->fBlockSize);
+      }
+   }
+
+   return nmemb;
+}
+
+size_t dabc::StripedFileInterface::fread(void* ptr, size_t sz, size_t nmemb, Handle f)
+{
+   StripedHandle *h = (StripedHandle *) f;
+   if (!h || !ptr || !h->fReading || (sz == 0)) return 0;
+
+   char *tgt = (char *) ptr;
+   size_t total = sz * nmemb, done = 0;
+
+   while ((done < total) && !h->fEOF) {
+      uint64_t blk = h->fPos / h->fBlockSize, inside = h->fPos % h->fBlockSize;
+      unsigned nstripe = blk % h->fFiles.size();
+      uint64_t spos = (blk / h->fFiles.size()) * h->fBlockSize + inside;
+
+      FILE *sf = h->fFiles[nstripe];
+      if ((h->fFilePos[nstripe] != spos) && (::fseek(sf, spos, SEEK_SET) != 0)) {
+         h->fEOF = true;
+         break;
+      }
+
+      size_t portion = h->fBlockSize - inside;
+      if (portion > total - done) portion = total - done;
+
+      size_t res = ::fread(tgt + done, 1, portion, sf);
+      h->fFilePos[nstripe] = spos + res;
+      h->fPos += res;
+      done += res;
+
+      // partial block indicates end of the stream
+      if (res < portion) h->fEOF = true;
+   }
+
+   if (done % sz != 0) {
+      // return position to the last complete element
+      h->fPos -= done % sz;
+      h->fEOF = true;
+   }
+
+   return done / sz;
+}
+
+bool dabc::StripedFileInterface::feof(Handle f)
+{
+   StripedHandle *h = (StripedHandle *) f;
+   return h ? h->fEOF : false;
+}
+
+bool dabc::StripedFileInterface::fflush(Handle f)
+{
+   StripedHandle *h = (StripedHandle *) f;
+   if (!h) return false;
+
+   // only complete blocks can be written, partial block remains until close
+   bool res = true;
+   for (auto w : h->fWriters)
+      if (!w->Drain() || (::fflush(w->fFile) != 0)) res = false;
+
+   return res;
+}
+
+bool dabc::StripedFileInterface::fseek(Handle f, long int offset, bool relative)
+{
+   StripedHandle *h = (StripedHandle *) f;
+   if (!h || !h->fReading) return false;
+
+   if (relative) {
+      if ((offset < 0) && ((uint64_t) -offset > h->fPos)) return false;
+      h->fPos += offset;
+   } else {
+      if (offset < 0) return false;
+      h->fPos = offset;
+   }
+
+   h->fEOF = false;
+   return true;
+}
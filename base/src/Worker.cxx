@@ -714,6 +714,15 @@ int dabc::Worker::PreviewCommand(Command cmd)
          Buffer diff = h.SaveToBuffer(dabc::stream_NamesList, version);
          cmd.SetRawData(diff);
 
+         // complete copy of hierarchy with values, read by other threads without locking
+         // only changed hierarchy is copied, otherwise publisher keeps previous snapshot
+         if (cmd.GetBool("snapshot") && ((h.GetVersion() != cmd.GetUInt("snapvers")) || h()->HasUnmarkedChanges(true))) {
+            Hierarchy snap;
+            snap.Create(h.GetName());
+            snap.Duplicate(h);
+            cmd.SetRef("snapshot", snap);
+         }
+
          cmd.SetUInt("version", h.GetVersion());
 
          if (store) store->ExtractData(h);
@@ -747,7 +756,6 @@ int dabc::Worker::PreviewCommand(Command cmd)
 
       unsigned hlimit = 0;
       uint64_t version = 0;
-      int compact = 0;
       bool with_childs = false;
 
       if (url.HasOption("history")) {
@@ -758,8 +766,6 @@ int dabc::Worker::PreviewCommand(Command cmd)
          int v = url.GetOptionInt("version", 0);
          if (v > 0) version = (unsigned) v;
       }
-      if (url.HasOption("compact"))
-         compact = url.GetOptionInt("compact", 3);
       if (url.HasOption("childs"))
          with_childs = true;
 
@@ -769,6 +775,7 @@ int dabc::Worker::PreviewCommand(Command cmd)
 
       if (binkind=="hierarchy") {
          if (sub.null()) return cmd_ignore;
+         // for differential request fields, modified without marking, included into diff by stream itself
          // we record only fields, everything else is ignored - even name of entry is not stored
          Buffer raw = sub.SaveToBuffer(with_childs ? dabc::stream_Full : dabc::stream_Value, version, hlimit);
          if (raw.null()) return cmd_ignore;
@@ -796,57 +803,100 @@ int dabc::Worker::PreviewCommand(Command cmd)
 
          cmd_res = cmd_true;
       } else
-      if ((binkind=="get.json") || (binkind=="value.json") || (binkind=="item.json") || (binkind=="get.xml") || (binkind=="dabc.json") || (binkind=="dabc.xml")) {
-         std::string field = "";
-         if (binkind=="value.json") field = "value";
-                               else field = url.GetOptionStr("field", "");
-
-         if (sub.null() && field.empty()) {
-            size_t separ = item.find_last_of('/');
-            if ((separ != std::string::npos) && (separ>0) && (separ < item.length()-1)) {
-               field = item.substr(separ+1);
-               item.resize(separ);
-               sub = h.GetFolder(item);
-            }
-         }
+      if (IsItemReplyKind(binkind)) {
+         std::string replybuf;
+         cmd_res = ProduceItemReply(h, item, binkind, query, cmd, replybuf);
+         if ((cmd_res == cmd_true) && !cmd.GetBool("NotChanged"))
+            cmd.SetStrRawData(replybuf);
+      }
+   }
 
-         if (sub.null()) return cmd_ignore;
+   return cmd_res;
+}
 
-         // DOUT0("Request JSON for item %s field %s compact %d", item.c_str(), field.c_str(), compact);
+bool dabc::Worker::IsItemReplyKind(const std::string &binkind)
+{
+   return (binkind=="get.json") || (binkind=="value.json") || (binkind=="item.json") || (binkind=="get.xml") || (binkind=="dabc.json") || (binkind=="dabc.xml");
+}
 
-         bool isxml = binkind.find(".xml")!=std::string::npos;
+int dabc::Worker::ProduceItemReply(Hierarchy &h, std::string item, const std::string &binkind, const std::string &query, Command cmd, std::string &replybuf)
+{
+   std::string surl = "getitem";
+   if (query.length()>0) { surl.append("?"); surl.append(query); }
 
-         std::string replybuf;
+   dabc::Url url(surl);
+   if (!url.IsValid()) return cmd_ignore;
 
-         dabc::NumericLocale loc; // ensure correct locale for conversion
+   unsigned hlimit = 0;
+   uint64_t version = 0;
+   int compact = 0;
 
-         if (field.empty()) {
-            if (compact < 0)
-               compact = 0;
-            else if (compact > storemask_Compact)
-               compact = storemask_Compact;
-            unsigned mask = compact;
-            if (hlimit>0) mask |= storemask_NoChilds | dabc::storemask_History | storemask_TopVersion;
-            if (isxml) mask |= dabc::storemask_AsXML;
+   if (url.HasOption("history")) {
+      int hist = url.GetOptionInt("history", 0);
+      if (hist > 0) hlimit = (unsigned) hist;
+   }
+   if (url.HasOption("version")) {
+      int v = url.GetOptionInt("version", 0);
+      if (v > 0) version = (unsigned) v;
+   }
+   if (url.HasOption("compact"))
+      compact = url.GetOptionInt("compact", 3);
 
-            dabc::HStore store(mask);
-            store.SetLimits(version, hlimit);
-            if (sub.SaveTo(store))
-               replybuf = store.GetResult();
+   dabc::Hierarchy sub = h.GetFolder(item);
 
-         } else {
-            if (!sub.HasField(field)) return cmd_ignore;
+   std::string field = "";
+   if (binkind=="value.json") field = "value";
+                         else field = url.GetOptionStr("field", "");
 
-            replybuf = sub.GetField(field).AsJson();
-         }
+   if (sub.null() && field.empty()) {
+      size_t separ = item.find_last_of('/');
+      if ((separ != std::string::npos) && (separ>0) && (separ < item.length()-1)) {
+         field = item.substr(separ+1);
+         item.resize(separ);
+         sub = h.GetFolder(item);
+      }
+   }
 
-         cmd.SetStrRawData(replybuf);
+   if (sub.null()) return cmd_ignore;
 
-         cmd_res = cmd_true;
+   // when caller has cached reply, check if item was changed since that
+   if (!cmd.null() && cmd.HasField("CacheVersion")) {
+      sub.MarkChangedItems();
+      uint64_t cachever = cmd.GetUInt("CacheVersion");
+      cmd.SetUInt("CacheVersion", sub.GetVersion());
+      if ((cachever > 0) && (cachever == sub.GetVersion())) {
+         cmd.SetBool("NotChanged", true);
+         return cmd_true;
       }
    }
 
-   return cmd_res;
+   // DOUT0("Request JSON for item %s field %s compact %d", item.c_str(), field.c_str(), compact);
+
+   bool isxml = binkind.find(".xml")!=std::string::npos;
+
+   dabc::NumericLocale loc; // ensure correct locale for conversion
+
+   if (field.empty()) {
+      if (compact < 0)
+         compact = 0;
+      else if (compact > storemask_Compact)
+         compact = storemask_Compact;
+      unsigned mask = compact;
+      if (hlimit>0) mask |= storemask_NoChilds | dabc::storemask_History | storemask_TopVersion;
+      if (isxml) mask |= dabc::storemask_AsXML;
+
+      dabc::HStore store(mask);
+      store.SetLimits(version, hlimit);
+      if (sub.SaveTo(store))
+         replybuf = store.GetResult();
+
+   } else {
+      if (!sub.HasField(field)) return cmd_ignore;
+
+      replybuf = sub.GetField(field).AsJson();
+   }
+
+   return cmd_true;
 }
 
 
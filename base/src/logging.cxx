@@ -16,10 +16,12 @@
 #include "dabc/logging.h"
 
 #include <cstdio>
+#include <cerrno>
 #include <cstdarg>
 #include <cstring>
 #include <iostream>
 #include <list>
+#include <vector>
 
 #ifndef _BSD_SOURCE
 #define _BSD_SOURCE
@@ -28,6 +30,7 @@
 #include <sys/time.h>
 #include <unistd.h>
 #include <syslog.h>
+#include <signal.h>
 
 #include "dabc/timing.h"
 #include "dabc/threads.h"
@@ -46,6 +49,7 @@ namespace dabc {
          int              fLevel;
          unsigned         fCounter;
          time_t           fMsgTime; // normal time when message will be output
+         double           fMsgStamp; // dabc time stamp of the message
          std::string      fLastMsg; // last shown message
          TimeStamp        fLastTm;  // dabc (fast) time of last output
          unsigned         fDropCnt; // number of dropped messages
@@ -58,6 +62,7 @@ namespace dabc {
             fLevel(lvl),
             fCounter(0),
             fMsgTime(),
+            fMsgStamp(0.),
             fLastMsg(),
             fLastTm(),
             fDropCnt(0),
@@ -96,6 +101,271 @@ namespace dabc {
          }
    };
 
+   /** Message, kept in ring buffer until written by logger thread.
+    * File and function names are string literals, therefore only pointers are stored */
+   struct LoggerRecord {
+      int         fLevel{0};
+      unsigned    fLine{0};
+      const char *fFileName{nullptr};
+      const char *fFuncName{nullptr};
+      time_t      fMsgTime{0};
+      double      fStamp{0.};
+      unsigned    fDropCnt{0};
+      std::string fMsg;
+   };
+
+   /** Ring buffer of single thread. Filled only by that thread and read only by logger thread,
+    * therefore no locking required. */
+   struct LoggerRing {
+      std::vector<LoggerRecord> fRecs;
+      std::atomic<uint64_t> fHead{0};     // next record to fill, changed by producer
+      std::atomic<uint64_t> fTail{0};     // next record to write, changed by logger thread
+      std::atomic<uint64_t> fLost{0};     // number of messages lost when ring was full
+      std::atomic<bool>     fOrphan{false}; // thread is finished, ring can be deleted
+      LoggerRing           *fNext{nullptr}; // next ring in the list
+
+      LoggerRing(unsigned sz) : fRecs(sz) {}
+   };
+
+   /** Statistic of single call site, used for lock-free drop of frequent messages */
+   struct LoggerSite {
+      std::atomic<const char *> fFileName{nullptr};
+      std::atomic<unsigned> fLine{0};
+      std::atomic<unsigned> fCounter{0};
+      std::atomic<unsigned> fDropCnt{0};
+      std::atomic<double>   fLastTm{0.};
+   };
+
+   /** Keeps ring buffers of all threads and logger thread */
+   struct LoggerAsync {
+      enum { NumSites = 4096 };
+
+      Logger                   *fOwner{nullptr};     // logger in asynchronous mode
+      unsigned                  fRingSize{1024};     // size of new rings
+      std::atomic<LoggerRing *> fRings{nullptr};     // list of rings, new rings inserted in front
+      std::atomic<bool>         fDraining{false};    // exclusive access to read rings
+      std::atomic<bool>         fStop{false};        // stop logger thread
+      PosixThread               fThrd;               // logger thread
+      LoggerSite                fSites[NumSites];    // call sites
+
+      LoggerSite *FindSite(const char *filename, unsigned line);
+
+      LoggerRing *GetRing();
+
+      unsigned Drain(bool wait);
+
+      void CrashDrain();
+
+      static void *WriterFunc(void *arg);
+   };
+
+   /** Created once and never deleted - can be used by any thread until process exit */
+   static LoggerAsync &GetLoggerAsync()
+   {
+      static LoggerAsync *async = new LoggerAsync;
+      return *async;
+   }
+
+   /** Ring of the thread, marked as orphan when thread exits */
+   struct LoggerRingHolder {
+      LoggerRing *fRing{nullptr};
+      ~LoggerRingHolder()
+      {
+         // ring deleted by logger thread, new ring created when thread logs again
+         if (fRing) fRing->fOrphan.store(true, std::memory_order_release);
+         fRing = nullptr;
+      }
+   };
+
+   static thread_local LoggerRingHolder gLoggerRing;
+
+   static void SendSyslog(const std::string &prefix, int level, const std::string &msg)
+   {
+      openlog(prefix.c_str(), LOG_ODELAY, LOG_LOCAL1);
+      syslog(level < 0 ? LOG_ERR : LOG_INFO, "%s", msg.c_str());
+      closelog();
+   }
+
+   /** Write complete buffer with write(2), can be used in signal handler */
+   static void LoggerWriteRaw(int fd, const char *buf, size_t len)
+   {
+      while (len > 0) {
+         ssize_t res = write(fd, buf, len);
+         if (res > 0) {
+            buf += res;
+            len -= res;
+         } else if ((res < 0) && (errno == EINTR)) {
+            continue;
+         } else {
+            break;
+         }
+      }
+   }
+
+   static void LoggerCrashHandler(int sig)
+   {
+      // handler installed with SA_RESETHAND, signal delivered again with default action
+      GetLoggerAsync().CrashDrain();
+      raise(sig);
+   }
+
+}
+
+dabc::LoggerSite *dabc::LoggerAsync::FindSite(const char *filename, unsigned line)
+{
+   unsigned pos = (((uintptr_t) filename >> 3) * 31 + line) % NumSites;
+
+   for (unsigned n = 0; n < 16; n++) {
+      auto &site = fSites[(pos + n) % NumSites];
+
+      const char *fname = site.fFileName.load(std::memory_order_acquire);
+      if (!fname) {
+         if (site.fFileName.compare_exchange_strong(fname, filename)) {
+            site.fLine.store(line, std::memory_order_release);
+            return &site;
+         }
+      }
+
+      if (fname != filename) continue;
+
+      unsigned l;
+      // line number is set immediately after site was claimed by other thread
+      while ((l = site.fLine.load(std::memory_order_acquire)) == 0);
+
+      if (l == line) return &site;
+   }
+
+   return nullptr;
+}
+
+dabc::LoggerRing *dabc::LoggerAsync::GetRing()
+{
+   if (gLoggerRing.fRing) return gLoggerRing.fRing;
+
+   auto ring = new LoggerRing(fRingSize);
+   ring->fNext = fRings.load(std::memory_order_relaxed);
+   while (!fRings.compare_exchange_weak(ring->fNext, ring, std::memory_order_release, std::memory_order_relaxed));
+
+   gLoggerRing.fRing = ring;
+   return ring;
+}
+
+unsigned dabc::LoggerAsync::Drain(bool wait)
+{
+   bool expected = false;
+   unsigned cnt = 0;
+   while (!fDraining.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+      // wait maximum 1 second
+      if (!wait || (++cnt > 1000)) return 0;
+      expected = false;
+      usleep(1000);
+   }
+
+   cnt = 0;
+
+   {
+      LockGuard lock(fOwner->fMutex);
+
+      LoggerRing *prev = nullptr, *ring = fRings.load(std::memory_order_acquire);
+
+      while (ring) {
+         bool orphan = ring->fOrphan.load(std::memory_order_acquire);
+
+         uint64_t tail = ring->fTail.load(std::memory_order_relaxed),
+                  head = ring->fHead.load(std::memory_order_acquire);
+
+         while (tail < head) {
+            fOwner->_WriteRecord(ring->fRecs[tail % ring->fRecs.size()]);
+            ring->fTail.store(++tail, std::memory_order_release);
+            cnt++;
+         }
+
+         uint64_t lost = ring->fLost.exchange(0, std::memory_order_relaxed);
+         if (lost > 0) {
+            LoggerRecord rec;
+            rec.fLevel = -1;
+            rec.fFileName = __FILE__;
+            rec.fLine = __LINE__;
+            rec.fFuncName = __func__;
+            rec.fMsgTime = time(nullptr);
+            rec.fStamp = dabc::Now().AsDouble();
+            rec.fMsg = dabc::format("%lu messages lost - logger ring buffer was full", (long unsigned) lost);
+            fOwner->_WriteRecord(rec);
+            cnt++;
+         }
+
+         LoggerRing *next = ring->fNext;
+
+         if (orphan) {
+            // producers only insert new rings in front, therefore only first ring removed with CAS
+            bool removed = true;
+            if (prev)
+               prev->fNext = next;
+            else
+               removed = fRings.compare_exchange_strong(ring, next);
+
+            if (removed) {
+               delete ring;
+               ring = next;
+               continue;
+            }
+         }
+
+         prev = ring;
+         ring = next;
+      }
+
+      if (cnt > 0) {
+         fflush(stdout);
+         fflush(stderr);
+         if (fOwner->fFile) fflush(fOwner->fFile);
+      }
+   }
+
+   fDraining.store(false, std::memory_order_release);
+
+   return cnt;
+}
+
+/** Write messages from all rings with write(2), used from crash signal handler.
+ * No locking, no memory allocation and no stdio calls. Rings are skipped if logger thread is busy with them */
+void dabc::LoggerAsync::CrashDrain()
+{
+   bool expected = false;
+   if (!fDraining.compare_exchange_strong(expected, true, std::memory_order_acquire)) return;
+
+   int fd = fOwner && fOwner->fFile ? fileno(fOwner->fFile) : -1;
+
+   for (LoggerRing *ring = fRings.load(std::memory_order_acquire); ring; ring = ring->fNext) {
+      uint64_t tail = ring->fTail.load(std::memory_order_relaxed),
+               head = ring->fHead.load(std::memory_order_acquire);
+
+      while (tail < head) {
+         auto &rec = ring->fRecs[tail % ring->fRecs.size()];
+         LoggerWriteRaw(STDERR_FILENO, rec.fMsg.c_str(), rec.fMsg.length());
+         LoggerWriteRaw(STDERR_FILENO, "\n", 1);
+         if (fd >= 0) {
+            LoggerWriteRaw(fd, rec.fMsg.c_str(), rec.fMsg.length());
+            LoggerWriteRaw(fd, "\n", 1);
+         }
+         ring->fTail.store(++tail, std::memory_order_release);
+      }
+   }
+
+   fDraining.store(false, std::memory_order_release);
+}
+
+void *dabc::LoggerAsync::WriterFunc(void *arg)
+{
+   auto async = (LoggerAsync *) arg;
+
+   while (!async->fStop.load(std::memory_order_acquire))
+      if (async->Drain(false) == 0)
+         usleep(5000);
+
+   async->Drain(true);
+
+   return nullptr;
 }
 
 // ____________________________________________________________
@@ -135,6 +405,8 @@ dabc::Logger::Logger(bool withmutex)
 
 dabc::Logger::~Logger()
 {
+   StopAsync();
+
    gDebug = fPrev;
 
    CloseFile();
@@ -163,6 +435,59 @@ void dabc::Logger::CloseFile()
 }
 
 
+bool dabc::Logger::StartAsync(unsigned ringsize)
+{
+   if (IsAsync()) return true;
+
+   auto &async = GetLoggerAsync();
+   if (async.fOwner && (async.fOwner != this)) return false;
+
+   async.fOwner = this;
+   async.fRingSize = ringsize < 16 ? 16 : ringsize;
+   async.fStop = false;
+   async.fThrd.Start(LoggerAsync::WriterFunc, &async);
+   async.fThrd.SetThreadName("DabcLogger");
+
+   // flush collected messages when process crashes, do not replace handlers installed by others
+   struct sigaction act, old;
+   memset(&act, 0, sizeof(act));
+   act.sa_handler = LoggerCrashHandler;
+   act.sa_flags = SA_RESETHAND;
+   sigemptyset(&act.sa_mask);
+   for (int sig : { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT }) {
+      if (sigaction(sig, nullptr, &old) != 0) continue;
+      if (((old.sa_flags & SA_SIGINFO) == 0) && (old.sa_handler == SIG_DFL))
+         sigaction(sig, &act, nullptr);
+      else
+         DOUT1("Signal %d handled by other handler, logger messages not flushed on crash", sig);
+   }
+
+   fAsync = true;
+
+   return true;
+}
+
+void dabc::Logger::StopAsync()
+{
+   if (!IsAsync()) return;
+
+   // new messages written directly
+   fAsync = false;
+
+   auto &async = GetLoggerAsync();
+   async.fStop = true;
+   async.fThrd.Join();
+
+   // messages which were pushed when logger thread was stopping
+   async.Drain(true);
+}
+
+void dabc::Logger::Flush()
+{
+   if (Instance() && Instance()->IsAsync())
+      GetLoggerAsync().Drain(true);
+}
+
 void dabc::Logger::SetDebugLevel(int level)
 {
    fDebugLevel = level;
@@ -267,9 +592,8 @@ void dabc::Logger::_FillString(std::string& str, unsigned mask, LoggerEntry* ent
    }
 
    if ((mask & lTStamp) && !(mask & lSyslgLvl)) {
-      double tm = dabc::Now().AsDouble();
       if (str.length() > 0) str+=" ";
-      str += dabc::format("%10.6f", tm);
+      str += dabc::format("%10.6f", entry->fMsgStamp);
    }
 
    if (mask & lFile) {
@@ -299,15 +623,8 @@ void dabc::Logger::_FillString(std::string& str, unsigned mask, LoggerEntry* ent
          str += dabc::format(" [Drop %u]", entry->fDropCnt);
 }
 
-void dabc::Logger::DoOutput(int level, const char *filename, unsigned linenumber, const char *funcname, const char *message)
+dabc::LoggerEntry *dabc::Logger::_GetEntry(int level, const char *filename, unsigned linenumber, const char *funcname)
 {
-   TimeStamp now = dabc::Now();
-
-   std::string syslogout;
-
-   {
-   LockGuard lock(fMutex);
-
    if (linenumber>=fMaxLine)
       _ExtendLines((linenumber/1024 + 1) * 1024);
 
@@ -318,20 +635,13 @@ void dabc::Logger::DoOutput(int level, const char *filename, unsigned linenumber
       fLines[linenumber] = lentry;
    }
 
-   LoggerEntry* entry = lentry->GetFile(filename, funcname, level);
-   entry->fCounter++;
+   return lentry->GetFile(filename, funcname, level);
+}
 
+void dabc::Logger::_OutputEntry(int level, LoggerEntry* entry, bool drop_msg, bool doflush, std::string &syslogout)
+{
    unsigned mask = level>=0 ? fDebugMask : fErrorMask;
    unsigned fmask = mask | (fFile ? fFileMask : 0);
-   bool drop_msg = (entry->fCounter > fLogLimit) &&
-                   ((now - entry->fLastTm) < 0.5);
-
-   if (drop_msg) entry->fDropCnt++;
-
-   if (drop_msg && ((mask & lNoDrop) == 0) && ((fmask & lNoDrop) == 0)) return;
-
-   entry->fMsgTime = time(nullptr);
-   entry->fLastMsg = message;
 
    if ((!drop_msg || (mask & lNoDrop)) && (level<=fDebugLevel)) {
       std::string str;
@@ -340,7 +650,7 @@ void dabc::Logger::DoOutput(int level, const char *filename, unsigned linenumber
       if (str.length() > 0) {
          FILE* out = level < 0 ? stderr : stdout;
          fprintf(out, "%s\n", str.c_str());
-         fflush(out);
+         if (doflush) fflush(out);
       }
    }
 
@@ -353,11 +663,103 @@ void dabc::Logger::DoOutput(int level, const char *filename, unsigned linenumber
       _FillString(str, fmask, entry);
       if (str.length()>0) {
          fprintf(fFile, "%s\n", str.c_str());
-         fflush(fFile);
+         if (doflush) fflush(fFile);
          fLogFileModified = true;
       }
       _DoCheckTimeout();
    }
+}
+
+void dabc::Logger::_WriteRecord(LoggerRecord &rec)
+{
+   LoggerEntry* entry = _GetEntry(rec.fLevel, rec.fFileName, rec.fLine, rec.fFuncName);
+   entry->fCounter++;
+   entry->fMsgTime = rec.fMsgTime;
+   entry->fMsgStamp = rec.fStamp;
+   entry->fDropCnt = rec.fDropCnt;
+   // ring record gets old string and reuses its memory
+   entry->fLastMsg.swap(rec.fMsg);
+
+   std::string syslogout;
+   _OutputEntry(rec.fLevel, entry, false, false, syslogout);
+   entry->fDropCnt = 0;
+
+   if (!syslogout.empty())
+      SendSyslog(fSyslogPrefix, rec.fLevel, syslogout);
+}
+
+void dabc::Logger::PushAsync(int level, const char *filename, unsigned linenumber, const char *funcname, const char *message)
+{
+   auto &async = GetLoggerAsync();
+
+   TimeStamp now = dabc::Now();
+   unsigned dropcnt = 0;
+
+   LoggerSite *site = async.FindSite(filename, linenumber);
+   if (site) {
+      unsigned cnt = site->fCounter.fetch_add(1, std::memory_order_relaxed) + 1;
+      if ((cnt > fLogLimit) && (now.AsDouble() - site->fLastTm.load(std::memory_order_relaxed) < 0.5)) {
+         site->fDropCnt.fetch_add(1, std::memory_order_relaxed);
+         unsigned mask = level>=0 ? fDebugMask : fErrorMask;
+         if (((mask | fFileMask) & lNoDrop) == 0) return;
+      } else {
+         dropcnt = site->fDropCnt.exchange(0, std::memory_order_relaxed);
+         site->fLastTm.store(now.AsDouble(), std::memory_order_relaxed);
+      }
+   }
+
+   LoggerRing *ring = async.GetRing();
+
+   uint64_t head = ring->fHead.load(std::memory_order_relaxed);
+   if (head - ring->fTail.load(std::memory_order_acquire) >= ring->fRecs.size()) {
+      ring->fLost.fetch_add(1, std::memory_order_relaxed);
+      return;
+   }
+
+   auto &rec = ring->fRecs[head % ring->fRecs.size()];
+   rec.fLevel = level;
+   rec.fLine = linenumber;
+   rec.fFileName = filename;
+   rec.fFuncName = funcname;
+   rec.fMsgTime = time(nullptr);
+   rec.fStamp = now.AsDouble();
+   rec.fDropCnt = dropcnt;
+   rec.fMsg.assign(message);
+
+   ring->fHead.store(head + 1, std::memory_order_release);
+}
+
+void dabc::Logger::DoOutput(int level, const char *filename, unsigned linenumber, const char *funcname, const char *message)
+{
+   if (IsAsync()) {
+      PushAsync(level, filename, linenumber, funcname, message);
+      return;
+   }
+
+   TimeStamp now = dabc::Now();
+
+   std::string syslogout;
+
+   {
+   LockGuard lock(fMutex);
+
+   LoggerEntry* entry = _GetEntry(level, filename, linenumber, funcname);
+   entry->fCounter++;
+
+   unsigned mask = level>=0 ? fDebugMask : fErrorMask;
+   unsigned fmask = mask | (fFile ? fFileMask : 0);
+   bool drop_msg = (entry->fCounter > fLogLimit) &&
+                   ((now - entry->fLastTm) < 0.5);
+
+   if (drop_msg) entry->fDropCnt++;
+
+   if (drop_msg && ((mask & lNoDrop) == 0) && ((fmask & lNoDrop) == 0)) return;
+
+   entry->fMsgTime = time(nullptr);
+   entry->fMsgStamp = now.AsDouble();
+   entry->fLastMsg = message;
+
+   _OutputEntry(level, entry, drop_msg, true, syslogout);
 
    if (!drop_msg) {
       entry->fDropCnt = 0;
@@ -366,12 +768,8 @@ void dabc::Logger::DoOutput(int level, const char *filename, unsigned linenumber
 
    } // end of LockGuard
 
-   if (!syslogout.empty()) {
-      openlog(fSyslogPrefix.c_str(), LOG_ODELAY, LOG_LOCAL1);
-      syslog(level < 0 ? LOG_ERR : LOG_INFO, "%s", syslogout.c_str());
-      closelog();
-   }
-
+   if (!syslogout.empty())
+      SendSyslog(fSyslogPrefix, level, syslogout);
 }
 
 void dabc::Logger::_DoCheckTimeout()
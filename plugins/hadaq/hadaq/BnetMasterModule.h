@@ -22,13 +22,16 @@
 
 #include <vector>
 #include <string>
+#include <map>
 
 
 namespace hadaq {
 
    /** \brief Master monitor for BNet components
     *
-    * Provides statistic for clients
+    * Provides statistic for clients.
+    * Master subscribes with \ref dabc::CmdSubscribeDiff to every BNET node and keeps mirror of node hierarchy,
+    * which is updated with diffs pushed by the nodes. State is evaluated from mirrors on each timer event.
     */
 
    class BnetMasterModule : public dabc::ModuleAsync {
@@ -47,10 +50,24 @@ namespace hadaq {
          int           fRefreshCnt{0};   ///< currently running refresh command
          int           fRefreshReplies{0}; ///< number of replies for current command
 
-         int           fCtrlId{0};     ///< counter for control requests
-         dabc::TimeStamp fCtrlTm;   ///< time when last control count was send
+         /** Information about BNET node, updated from pushed diffs */
+         struct NodeInfo {
+            int             subid{0};        ///< subscription id, 0 - not subscribed
+            bool            builder{false};  ///< is builder node
+            bool            valid{false};    ///< if node information was received
+            dabc::Hierarchy mirror;          ///< copy of node hierarchy
+            uint64_t        version{0};      ///< version of mirror
+            dabc::TimeStamp lastupdate;      ///< last time when push was received
+            dabc::TimeStamp subscribetm;     ///< time when subscription was requested
+         };
+
+         std::map<std::string, NodeInfo> fNodes; ///< subscribed nodes
+         int           fSubCnt{0};     ///< counter for subscriptions
+         double        fPushPeriod{1.}; ///< minimal interval between pushes from nodes
+         double        fKeepAlive{2.};  ///< maximal interval between pushes from nodes
+         bool          fNodesChanged{false}; ///< if any node information was changed since last rate calculation
+
          dabc::TimeStamp fNewRunTm;   ///< time when last control count was send
-         int           fCtrlCnt{0};    ///< how many control replies are awaited
          bool          fCtrlError{false};  ///< if there are error during current communication loop
          int           fCtrlErrorCnt{0}; ///< number of consequent control errors
          double        fCtrlStateQuality{0};  ///< <0.3 error, <0.7 warning, more is ok
@@ -80,6 +97,12 @@ namespace hadaq {
 
          void AddItem(std::vector<std::string> &items, std::vector<std::string> &nodes, const std::string &item, const std::string &node);
 
+         void UpdateSubscriptions(const std::vector<std::string> &binp, const std::vector<std::string> &bbuild);
+
+         int ApplyNodeDiff(dabc::Command cmd);
+
+         void EvaluateNodes(unsigned numinp, unsigned numbld);
+
          void PreserveLastCalibr(bool do_write = false, double quality = 1., unsigned runid = 0, bool set_time = false);
 
       public:
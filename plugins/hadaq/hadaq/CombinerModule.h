@@ -24,6 +24,10 @@
 #include "dabc/Profiler.h"
 #endif
 
+#ifndef DABC_Metrics
+#include "dabc/Metrics.h"
+#endif
+
 #ifndef HADAQ_HadaqTypeDefs
 #include "hadaq/HadaqTypeDefs.h"
 #endif
@@ -253,6 +257,9 @@ namespace hadaq {
          long               fBufCalls{0};   ///< number of buffer processing calls
          long               fTimerCalls{0}; ///< number of timer events calls
          dabc::Profiler     fBldProfiler;   ///< profiler of build event performance
+         dabc::MetricsSlot  fMetrics;       ///< copy of statistic for metrics exporter, updated in timer
+
+         void UpdateMetrics();
 
          bool BuildEvent();
 
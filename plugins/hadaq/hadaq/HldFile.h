@@ -24,8 +24,35 @@
 #include "hadaq/defines.h"
 #endif
 
+#include <vector>
+
 namespace hadaq {
 
+   enum { HldFrameMagic = 0x5A444C48 };   // "HLDZ" in little-endian byte order
+
+   enum HldFrameKind {
+      hld_FrameStored = 0,    // frame payload stored without compression
+      hld_FrameZlib   = 1     // frame payload compressed with zlib
+   };
+
+   /** \brief Header of the frame in compressed HLD file
+    *
+    * Compressed HLD file is sequence of such frames, each containing integer number of events.
+    * Sizes and events ids in the header allow to skip frames without decompression */
+
+   struct HldFrameHeader {
+      uint32_t magic{0};       ///< frame magic, HldFrameMagic
+      uint32_t kind{0};        ///< compression kind, see HldFrameKind
+      uint32_t rawsize{0};     ///< uncompressed size of frame payload
+      uint32_t compsize{0};    ///< size of frame payload stored in the file
+      uint32_t firstid{0};     ///< sequence number of first event in the frame
+      uint32_t lastid{0};      ///< sequence number of last event in the frame
+      uint32_t numevents{0};   ///< number of events in the frame
+      uint32_t reserved{0};    ///< reserved for future use
+   };
+
+   class HldCompressor;
+
    /** \brief HLD file implementation */
 
    class HldFile : public dabc::BasicFile {
@@ -33,12 +60,45 @@ namespace hadaq {
          uint32_t       fRunNumber;   //! run number
          bool           fEOF;         //! flag indicate that end-of-file was reached
 
+         int            fCompressLevel{0};   //! zlib compression level for writing, 0 - plain HLD file
+         unsigned       fCompressThrds{0};   //! number of threads used for frames compression
+         unsigned       fFrameSize{0};       //! size of uncompressed frame when writing
+         bool           fCompressed{false};  //! true when file consists of compressed frames
+         bool           fTruncate{false};    //! truncate preallocated tail when closing
+
+         std::vector<char> fStage;           //! staged events for writing or decompressed frame for reading
+         unsigned       fStagePos{0};        //! position of next event in staged data
+         HldFrameHeader fStageHdr;           //! events ids for staged data when writing
+         std::vector<char> fCompBuf;         //! buffer for compressed frame payload when reading
+
+         std::vector<HldCompressor *> fWorkers; //! workers compressing frames
+         unsigned       fNextWorker{0};      //! worker for next frame
+
+         bool FlushFrame(bool all);
+         bool WriteFrame(HldCompressor *worker);
+         bool FlushWorkers();
+         void StopWorkers();
+
+         bool ReadFrame(const HldFrameHeader *hdr = nullptr);
+         bool ReadFrameBuffer(void* ptr, uint32_t* sz, bool onlyevent);
+
       public:
          HldFile();
          ~HldFile();
 
-         /** Open file with specified name for writing */
-         bool OpenWrite(const char *fname, uint32_t rid = 0, const char *opt = nullptr);
+         /** Configure compression for next files opened for writing.
+           * \param level - zlib compression level, 0 disables compression
+           * \param nthreads - number of threads compressing frames, 0 - compress in caller thread
+           * \param framesize - size of uncompressed data in single frame */
+         void SetCompression(int level, unsigned nthreads = 2, unsigned framesize = 0x100000);
+
+         /** Returns true if opened file consists of compressed frames */
+         bool isCompressed() const { return fCompressed; }
+
+         /** Open file with specified name for writing.
+           * If \param prepared handle is specified, it is used instead of opening file.
+           * Such file supposed to be preallocated, therefore it is truncated when closed. */
+         bool OpenWrite(const char *fname, uint32_t rid = 0, const char *opt = nullptr, dabc::FileInterface::Handle prepared = nullptr);
 
          /** Opened file for reading. Internal buffer required
            * when data read partially and must be kept there. */
@@ -64,6 +124,10 @@ namespace hadaq {
           * User must be aware about correct formatting of data.
           * Returns true if data was written.*/
          bool WriteBuffer(void* buf, uint32_t bufsize);
+
+         /** Skip events until event with sequence number not less than specified one.
+           * For compressed files complete frames are skipped using stored events ids */
+         bool SeekEvent(uint32_t evid);
    };
 
 } // end of namespace
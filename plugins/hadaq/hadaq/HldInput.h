@@ -32,6 +32,7 @@ namespace hadaq {
       protected:
 
          hadaq::HldFile   fFile;
+         bool             fStriped{false};   ///< true when current file read via striped file interface
 
          bool CloseFile();
          bool OpenNextFile();
@@ -26,6 +26,8 @@
 
 namespace hadaq {
 
+   class HldNextFile;
+
    /** \brief Implementation of file output for HLD files */
 
    class HldOutput : public dabc::FileOutput {
@@ -44,10 +46,14 @@ namespace hadaq {
          std::string         fLastPrefix;            ///< last prefix submitted from BNet master
 
          hadaq::HldFile      fFile;
+         HldNextFile        *fNextFile{nullptr};    ///< prepares next file in background
 
          bool CloseFile();
          bool StartNewFile();
 
+         /** Directory where next file will be created, prepared file placed there to be renamed */
+         std::string NextFileDir();
+
       public:
 
          HldOutput(const dabc::Url& url);
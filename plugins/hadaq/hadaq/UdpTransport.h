@@ -28,6 +28,14 @@
 #include "dabc/DataTransport.h"
 #endif
 
+#ifndef DABC_Metrics
+#include "dabc/Metrics.h"
+#endif
+
+#ifndef DABC_Profiler
+#include "dabc/Profiler.h"
+#endif
+
 #ifndef HADAQ_HadaqTypeDefs
 #include "hadaq/HadaqTypeDefs.h"
 #endif
@@ -101,6 +109,15 @@ namespace hadaq {
          bool               fRunning{false};     ///< is transport running
          dabc::TimeStamp    fLastProcTm;         ///< last time when udp reading was performed
          double             fMaxProcDist{0};     ///< maximal time between calls to BuildEvent method
+         dabc::MetricsSlot  fMetrics;            ///< copy of transport counters for metrics exporter
+         unsigned           fMtrRecvPackets{0};  ///< metrics id of received packets
+         unsigned           fMtrRecvBytes{0};    ///< metrics id of received bytes
+         unsigned           fMtrDiscardPackets{0}; ///< metrics id of discarded packets
+         unsigned           fMtrDiscardBytes{0}; ///< metrics id of discarded bytes
+         unsigned           fMtrDiscard32{0};    ///< metrics id of packets with mismatch of trailing 32 bytes
+         unsigned           fMtrSkipped{0};      ///< metrics id of skipped reads
+         unsigned           fMtrProduced{0};     ///< metrics id of produced buffers
+         dabc::Profiler     fUdpProfiler;        ///< profiler for UDP readout
 
          void ProcessEvent(const dabc::EventId&) override;
 
@@ -112,6 +129,9 @@ namespace hadaq {
 
          bool CloseBuffer();
 
+         /** Copy counters into metrics slot, called from addon thread */
+         void UpdateMetrics();
+
       public:
          NewAddon(int fd, int nport, int mtu, bool debug, int maxloop, double reduce);
          virtual ~NewAddon();
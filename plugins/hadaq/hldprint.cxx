@@ -36,7 +36,7 @@ int usage(const char *errstr = nullptr)
    printf("   hldprint source [args]\n");
    printf("Following sources are supported:\n");
    printf("   hld://path/file.hld         - HLD file reading\n");
-   printf("   file.hld                    - HLD file reading (file extension MUST be '.hld')\n");
+   printf("   file.hld                    - HLD file reading (file extension MUST be '.hld'), compressed HLD files are supported\n");
    printf("   file.hll                    - list of HLD files (file extension MUST be '.hll')\n");
    printf("   file.bin                    - DABC binary file produced with rawdump.xml (file extension MUST be '.bin')\n");
    printf("   dabcnode                    - DABC stream server\n");
@@ -20,6 +20,8 @@
 
 #include "hadaq/HadaqTypeDefs.h"
 
+#include <algorithm>
+
 hadaq::BnetMasterModule::BnetMasterModule(const std::string &name, dabc::Command cmd) :
    dabc::ModuleAsync(name, cmd)
 {
@@ -29,6 +31,11 @@ hadaq::BnetMasterModule::BnetMasterModule(const std::string &name, dabc::Command
    double period = Cfg("period", cmd).AsDouble(fControl ? 0.2 : 1);
    CreateTimer("update", period);
 
+   // nodes push their state not often than PushPeriod, but at least once per KeepAlive interval
+   fPushPeriod = Cfg("PushPeriod", cmd).AsDouble(period);
+   fKeepAlive = Cfg("KeepAlive", cmd).AsDouble(2.);
+   if (fKeepAlive < fPushPeriod) fKeepAlive = fPushPeriod;
+
    fSameBuildersCnt = 0;
 
    fCmdCnt = 1;
@@ -41,10 +48,7 @@ hadaq::BnetMasterModule::BnetMasterModule(const std::string &name, dabc::Command
    fRefreshCnt = 1;
    fRefreshReplies = 0;
 
-   fCtrlId = 1;
    fNewRunTm.GetNow();
-   fCtrlTm.GetNow();
-   fCtrlCnt = 0;
    fCtrlError = false;
    fCtrlErrorCnt = 0;
    fCtrlSzLimit = 0; // no need to do something
@@ -182,6 +186,271 @@ void hadaq::BnetMasterModule::PreserveLastCalibr(bool do_write, double quality,
 }
 
 
+void hadaq::BnetMasterModule::UpdateSubscriptions(const std::vector<std::string> &binp, const std::vector<std::string> &bbuild)
+{
+   // remove nodes which are no longer in the list
+   auto iter = fNodes.begin();
+   while (iter != fNodes.end()) {
+      if ((std::find(binp.begin(), binp.end(), iter->first) == binp.end()) &&
+          (std::find(bbuild.begin(), bbuild.end(), iter->first) == bbuild.end()))
+         iter = fNodes.erase(iter);
+      else
+         iter++;
+   }
+
+   dabc::WorkerRef publ = GetPublisher();
+   if (publ.null()) return;
+
+   for (unsigned n = 0; n < binp.size() + bbuild.size(); ++n) {
+      bool is_builder = n >= binp.size();
+      const std::string &name = is_builder ? bbuild[n - binp.size()] : binp[n];
+
+      NodeInfo &node = fNodes[name];
+
+      if (node.subid > 0) {
+         // subscription is active while node pushes its state
+         if (node.valid ? !node.lastupdate.Expired(3*fKeepAlive) : !node.subscribetm.Expired(3*fKeepAlive)) continue;
+         EOUT("No updates from BNET node %s, subscribe again", name.c_str());
+      } else if (!node.subscribetm.null() && !node.subscribetm.Expired(2.)) {
+         // do not repeat failed subscription too often
+         continue;
+      }
+
+      node.subid = ++fSubCnt;
+      node.builder = is_builder;
+      node.version = 0;
+      node.subscribetm.GetNow();
+
+      dabc::CmdSubscribeDiff subcmd(name, WorkerAddress(true), node.subid, fPushPeriod, fKeepAlive);
+      subcmd.SetTimeout(10);
+      publ.Submit(Assign(subcmd));
+   }
+}
+
+int hadaq::BnetMasterModule::ApplyNodeDiff(dabc::Command cmd)
+{
+   int subid = cmd.GetInt("SubId");
+
+   auto iter = fNodes.begin();
+   while ((iter != fNodes.end()) && (iter->second.subid != subid)) iter++;
+
+   // no longer interested in such node
+   if (iter == fNodes.end()) return dabc::cmd_false;
+
+   NodeInfo &node = iter->second;
+
+   uint64_t basever = cmd.GetUInt("BaseVersion");
+
+   if (basever != node.version) {
+      EOUT("BNET node %s version mismatch %lu != %lu, subscribe again", iter->first.c_str(), (long unsigned) basever, (long unsigned) node.version);
+      node.subid = 0;
+      node.valid = false;
+      return dabc::cmd_false;
+   }
+
+   dabc::Buffer diff = cmd.GetRawData();
+
+   if (!diff.null()) {
+      if (basever == 0) {
+         node.mirror.Release();
+         node.mirror.Create("node");
+      }
+      if (!node.mirror.UpdateFromBuffer(diff)) {
+         EOUT("Fail to apply diff from BNET node %s", iter->first.c_str());
+         node.subid = 0;
+         node.valid = false;
+         return dabc::cmd_false;
+      }
+      node.valid = true;
+      fNodesChanged = true;
+   }
+
+   node.version = cmd.GetUInt("Version");
+   node.lastupdate.GetNow();
+
+   return dabc::cmd_true;
+}
+
+void hadaq::BnetMasterModule::EvaluateNodes(unsigned numinp, unsigned numbld)
+{
+   fCtrlStateQuality = 1;
+   fCtrlStateName = "";
+
+   fCtrlInpNodesCnt = 0;
+   fCtrlInpNodesExpect = 0;
+   fCtrlBldNodesCnt = 0;
+   fCtrlBldNodesExpect = 0;
+
+   fCtrlRunId = 0;
+   fCtrlRunPrefix = "";
+
+   fCurrentLost = fCurrentEvents = fCurrentData = 0;
+
+   fCtrlError = false;
+   for (auto &entry : fNodes)
+      if (entry.second.valid ? entry.second.lastupdate.Expired(3*fKeepAlive) : entry.second.subscribetm.Expired(3*fKeepAlive))
+         fCtrlError = true;
+
+   if (fCtrlError)
+      fCtrlErrorCnt++;
+   else
+      fCtrlErrorCnt = 0;
+
+   if (numinp + numbld == 0) {
+      fCtrlStateQuality = 0.;
+      fCtrlStateName = "NoNodes";
+   } else if (numinp == 0) {
+      fCtrlStateQuality = 0.;
+      fCtrlStateName = "NoInputs";
+   } else if (numbld == 0) {
+      fCtrlStateQuality = 0.;
+      fCtrlStateName = "NoBuilders";
+   } else if (fCtrlErrorCnt > 5) {
+      fCtrlStateQuality = 0.1;
+      fCtrlStateName = "LostControl";
+   }
+
+   if (!fCtrlStateName.empty()) {
+      SetParValue("State", fCtrlStateName);
+      SetParValue("Quality", fCtrlStateQuality);
+      return;
+   }
+
+   for (auto &entry : fNodes) {
+      if (!entry.second.valid) continue;
+
+      dabc::Hierarchy item = entry.second.mirror;
+
+      bool is_builder = item.GetField("_bnet").AsStr() == "receiver";
+
+      if (is_builder) fCtrlBldNodesCnt++;
+                 else fCtrlInpNodesCnt++;
+
+      std::string state = item.GetField("state").AsStr();
+      double quality = item.GetField("quality").AsDouble();
+
+      if (fCtrlStateName.empty() || (quality < fCtrlStateQuality)) {
+         fCtrlStateQuality = quality;
+         fCtrlStateName = state;
+      }
+
+      if (is_builder) {
+         fCurrentLost += item.GetField("discard_events").AsUInt();
+         fCurrentEvents += item.GetField("build_events").AsUInt();
+         fCurrentData += item.GetField("build_data").AsUInt();
+
+         // check maximal size of the run
+         if (fNewRunTm.Expired() && (fCtrlSzLimit > 0) && (fMaxRunSize > 0) && (item.GetField("runsize").AsUInt() > fMaxRunSize*1e6))
+            fCtrlSzLimit = 2;
+
+         // check current runid
+         unsigned runid = item.GetField("runid").AsUInt();
+         std::string runprefix = item.GetField("runprefix").AsStr();
+
+         if (runid && !runprefix.empty()) {
+            if (!fCtrlRunId) {
+               fCtrlRunId = runid;
+               fCtrlRunPrefix = runprefix;
+            } else if ((fCtrlRunId != runid) || (fCtrlRunPrefix != runprefix)) {
+               if ((fCtrlStateQuality > 0) && fNewRunTm.Expired()) {
+                  fCtrlStateName = "RunMismatch";
+                  fCtrlStateQuality = 0;
+               }
+            }
+         }
+
+         int ninputs = item.GetField("ninputs").AsInt();
+         if (fCtrlInpNodesExpect == 0) fCtrlInpNodesExpect = ninputs;
+
+         if ((fCtrlInpNodesExpect != ninputs) && (fCtrlStateQuality > 0)) {
+            fCtrlStateName = "InputsMismatch";
+            fCtrlStateQuality = 0;
+         }
+
+      } else {
+         int nbuilders = item.GetField("nbuilders").AsInt();
+         if (fCtrlBldNodesExpect == 0) fCtrlBldNodesExpect = nbuilders;
+         if ((fCtrlBldNodesExpect != nbuilders) && (fCtrlStateQuality > 0)) {
+            fCtrlStateName = "BuildersMismatch";
+            fCtrlStateQuality = 0;
+         }
+      }
+   }
+
+   if (fCtrlStateName.empty()) {
+      fCtrlStateName = "Ready";
+      fCtrlStateQuality = 1.;
+   }
+   if ((fCtrlInpNodesCnt == 0) && (fCtrlStateQuality > 0)) {
+      fCtrlStateName = "NoInputs";
+      fCtrlStateQuality = 0;
+   }
+
+   if ((fCtrlInpNodesExpect != fCtrlInpNodesCnt) && (fCtrlStateQuality > 0)) {
+      fCtrlStateName = "InputsMismatch";
+      fCtrlStateQuality = 0;
+   }
+
+   if ((fCtrlBldNodesCnt == 0)  && (fCtrlStateQuality > 0)) {
+      fCtrlStateName = "NoBuilders";
+      fCtrlStateQuality = 0;
+   }
+   if ((fCtrlBldNodesExpect != fCtrlBldNodesCnt) && (fCtrlStateQuality > 0)) {
+      fCtrlStateName = "BuildersMismatch";
+      fCtrlStateQuality = 0;
+   }
+
+   SetParValue("State", fCtrlStateName);
+   SetParValue("Quality", fCtrlStateQuality);
+   SetParValue("RunId", fCtrlRunId);
+   SetParValue("RunIdStr", fCtrlRunId ? dabc::HadaqFileSuffix(fCtrlRunId) : std::string("0"));
+   SetParValue("RunPrefix", fCtrlRunPrefix);
+
+   fWorkerHierarchy.GetHChild("LastPrefix").SetField("value", fCtrlRunPrefix);
+
+   DOUT3("BNET control sequence ready state %s overlimit %s", fCtrlStateName.c_str(), DBOOL(fCtrlSzLimit>1));
+
+   // rates are calculated only when new counters were delivered by the nodes
+   if (fNodesChanged) {
+      fNodesChanged = false;
+
+      bool do_set = (fTotalEvents || fTotalLost) && (fCurrentLost >= fTotalLost) && (fCurrentEvents >= fTotalEvents) && (fCurrentData >= fTotalData);
+
+      if (do_set) {
+         double spent = fLastRateTm.SpentTillNow();
+         spent = (spent > 1e-3) ? 1./spent : 0.;
+
+         fCtrlLost = (fCurrentLost-fTotalLost)*spent;
+         fCtrlEvents = (fCurrentEvents-fTotalEvents)*spent;
+         fCtrlData = (fCurrentData-fTotalData)*spent/1024./1024.;
+
+         if ((fCtrlEvents > 1e9) || (fCtrlLost > 1e9) || (fCtrlData > 1e9)) do_set = false;
+      }
+
+      fTotalLost = fCurrentLost;
+      fTotalEvents = fCurrentEvents;
+      fTotalData = fCurrentData;
+      fLastRateTm.GetNow();
+
+      if (do_set) {
+         Par("DataRate").SetValue(fCtrlData);
+         Par("EventsRate").SetValue(fCtrlEvents);
+         Par("LostRate").SetValue(fCtrlLost);
+      }
+
+      SetParValue("TotalEvents", fTotalEvents);
+      SetParValue("TotalLost", fTotalLost);
+   }
+
+   if (fControl && (fCtrlSzLimit > 1) && fCurrentFileCmd.null()) {
+      fCtrlSzLimit = 0;
+      // this is a place, where new run automatically started
+      dabc::Command newrun("StartRun");
+      newrun.SetTimeout(45);
+      Submit(newrun);
+   }
+}
+
 bool hadaq::BnetMasterModule::ReplyCommand(dabc::Command cmd)
 {
    if (cmd.IsName(dabc::CmdGetNamesList::CmdName())) {
@@ -228,73 +497,20 @@ bool hadaq::BnetMasterModule::ReplyCommand(dabc::Command cmd)
       fWorkerHierarchy.GetHChild("Builders").SetField("value", bbuild);
       fWorkerHierarchy.GetHChild("Builders").SetField("nodes", nodes_build);
 
-      if (fCtrlCnt != 0) {
-         if (!fCtrlTm.Expired()) return true;
-         if (fCtrlCnt > 0) { fCtrlError = true; EOUT("Fail to get %d control records", fCtrlCnt); }
-      }
+      UpdateSubscriptions(binp, bbuild);
 
-      if (fCtrlError)
-         fCtrlErrorCnt++;
-      else
-         fCtrlErrorCnt = 0;
-
-      fCtrlCnt = 0;
-      fCtrlId++;
-      fCtrlError = false;
-      fCtrlTm.GetNow(3.); // use 3 sec timeout for control requests
-
-      fCtrlStateQuality = 1;
-      fCtrlStateName = "";
-      fCtrlData = 0.;
-      fCtrlEvents = 0.;
-      fCtrlLost = 0.;
-
-      fCtrlInpNodesCnt = 0;
-      fCtrlInpNodesExpect = 0;
-      fCtrlBldNodesCnt = 0;
-      fCtrlBldNodesExpect = 0;
-
-      fCtrlRunId = 0;
-      fCtrlRunPrefix = "";
-
-      fCurrentLost = fCurrentEvents = fCurrentData = 0;
-
-      dabc::WorkerRef publ = GetPublisher();
-
-      for (unsigned n=0;n<bbuild.size();++n) {
-         dabc::CmdGetBinary subcmd(bbuild[n], "hierarchy", "childs");
-         subcmd.SetInt("#bnet_ctrl_id", fCtrlId);
-         subcmd.SetTimeout(10);
-         publ.Submit(Assign(subcmd));
-         fCtrlCnt++;
-      }
+      EvaluateNodes(binp.size(), bbuild.size());
 
-      for (unsigned n=0;n<binp.size();++n) {
-         dabc::CmdGetBinary subcmd(binp[n], "hierarchy", "childs");
-         subcmd.SetInt("#bnet_ctrl_id", fCtrlId);
-         subcmd.SetTimeout(10);
-         publ.Submit(Assign(subcmd));
-         fCtrlCnt++;
-      }
+      return true;
 
-      if (fCtrlCnt == 0) {
-         fCtrlStateQuality = 0.;
-         fCtrlStateName = "NoNodes";
-      } else if (binp.size() == 0) {
-         fCtrlStateQuality = 0.;
-         fCtrlStateName = "NoInputs";
-      } else if (bbuild.size() == 0) {
-         fCtrlStateQuality = 0.;
-         fCtrlStateName = "NoBuilders";
-      } else if (fCtrlErrorCnt > 5) {
-         fCtrlStateQuality = 0.1;
-         fCtrlStateName = "LostControl";
-      }
+   } else if (cmd.IsName(dabc::CmdSubscribeDiff::CmdName())) {
 
-      if (!fCtrlStateName.empty()) {
-         SetParValue("State", "NoNodes");
-         SetParValue("Quality", fCtrlStateQuality);
-      }
+      if (cmd.GetResult() != dabc::cmd_true)
+         for (auto &entry : fNodes)
+            if (entry.second.subid == cmd.GetInt("SubId")) {
+               DOUT2("Fail to subscribe BNET node %s", entry.first.c_str());
+               entry.second.subid = 0;
+            }
 
       return true;
 
@@ -340,162 +556,6 @@ bool hadaq::BnetMasterModule::ReplyCommand(dabc::Command cmd)
       }
 
       return true;
-
-   } else if (cmd.GetInt("#bnet_ctrl_id") == fCtrlId) {
-      // this commands used to send control requests
-
-      fCtrlCnt--;
-
-      if (!cmd.GetResult() || cmd.IsTimedout()) fCtrlError = true;
-
-      dabc::Hierarchy h = dabc::CmdGetNamesList::GetResNamesList(cmd);
-      dabc::Iterator iter(h);
-
-      bool is_builder = false;
-
-      while (iter.next()) {
-         dabc::Hierarchy item = iter.ref();
-         if (!item.HasField("_bnet")) {
-            if (is_builder && item.IsName("HadaqData"))
-               fCtrlData += item.GetField("value").AsDouble();
-            else if (is_builder && item.IsName("HadaqEvents"))
-               fCtrlEvents += item.GetField("value").AsDouble();
-            else if (is_builder && item.IsName("HadaqLostEvents"))
-               fCtrlLost += item.GetField("value").AsDouble();
-
-            continue;
-         }
-         // normally only that item should be used
-
-         if (item.GetField("_bnet").AsStr() == "receiver") is_builder = true;
-
-         if (is_builder) fCtrlBldNodesCnt++;
-                    else fCtrlInpNodesCnt++;
-
-         std::string state = item.GetField("state").AsStr();
-         double quality = item.GetField("quality").AsDouble();
-
-         if (fCtrlStateName.empty() || (quality < fCtrlStateQuality)) {
-            fCtrlStateQuality = quality;
-            fCtrlStateName = state;
-         }
-
-         if (is_builder) {
-            fCurrentLost += item.GetField("discard_events").AsUInt();
-            fCurrentEvents += item.GetField("build_events").AsUInt();
-            fCurrentData += item.GetField("build_data").AsUInt();
-
-            if (!fTotalData) DOUT0("FIRST TIME GET DATA %d %lu", fCtrlCnt, (long unsigned) item.GetField("build_data").AsUInt());
-
-            // check maximal size of the run
-            if (fNewRunTm.Expired() && (fCtrlSzLimit > 0) && (fMaxRunSize > 0) && (item.GetField("runsize").AsUInt() > fMaxRunSize*1e6))
-               fCtrlSzLimit = 2;
-
-            // check current runid
-            unsigned runid = item.GetField("runid").AsUInt();
-            std::string runprefix = item.GetField("runprefix").AsStr();
-
-            if (runid && !runprefix.empty()) {
-               if (!fCtrlRunId) {
-                  fCtrlRunId = runid;
-                  fCtrlRunPrefix = runprefix;
-               } else if ((fCtrlRunId != runid) || (fCtrlRunPrefix != runprefix)) {
-                  if ((fCtrlStateQuality > 0) && fNewRunTm.Expired()) {
-                     fCtrlStateName = "RunMismatch";
-                     fCtrlStateQuality = 0;
-                  }
-               }
-            }
-
-            int ninputs = item.GetField("ninputs").AsInt();
-            if (fCtrlInpNodesExpect == 0) fCtrlInpNodesExpect = ninputs;
-
-            if ((fCtrlInpNodesExpect != ninputs) && (fCtrlStateQuality > 0)) {
-               fCtrlStateName = "InputsMismatch";
-               fCtrlStateQuality = 0;
-            }
-
-         } else {
-            int nbuilders = item.GetField("nbuilders").AsInt();
-            if (fCtrlBldNodesExpect == 0) fCtrlBldNodesExpect = nbuilders;
-            if ((fCtrlBldNodesExpect != nbuilders) && (fCtrlStateQuality > 0)) {
-               fCtrlStateName = "BuildersMismatch";
-               fCtrlStateQuality = 0;
-            }
-         }
-
-         // DOUT0("BNET reply from %s state %s sz %u", item.GetField("_bnet").AsStr().c_str(), item.GetField("state").AsStr().c_str(), item.GetField("runsize").AsUInt());
-      }
-
-      if (fCtrlCnt == 0) {
-         if (fCtrlStateName.empty()) {
-            fCtrlStateName = "Ready";
-            fCtrlStateQuality = 1.;
-         }
-         if ((fCtrlInpNodesCnt == 0) && (fCtrlStateQuality > 0)) {
-            fCtrlStateName = "NoInputs";
-            fCtrlStateQuality = 0;
-         }
-
-         if ((fCtrlInpNodesExpect != fCtrlInpNodesCnt) && (fCtrlStateQuality > 0)) {
-            fCtrlStateName = "InputsMismatch";
-            fCtrlStateQuality = 0;
-         }
-
-         if ((fCtrlBldNodesCnt == 0)  && (fCtrlStateQuality > 0)) {
-            fCtrlStateName = "NoBuilders";
-            fCtrlStateQuality = 0;
-         }
-         if ((fCtrlBldNodesExpect != fCtrlBldNodesCnt) && (fCtrlStateQuality > 0)) {
-            fCtrlStateName = "BuildersMismatch";
-            fCtrlStateQuality = 0;
-         }
-
-         SetParValue("State", fCtrlStateName);
-         SetParValue("Quality", fCtrlStateQuality);
-         SetParValue("RunId", fCtrlRunId);
-         SetParValue("RunIdStr", fCtrlRunId ? dabc::HadaqFileSuffix(fCtrlRunId) : std::string("0"));
-         SetParValue("RunPrefix", fCtrlRunPrefix);
-
-         fWorkerHierarchy.GetHChild("LastPrefix").SetField("value", fCtrlRunPrefix);
-
-         DOUT3("BNET control sequence ready state %s overlimit %s", fCtrlStateName.c_str(), DBOOL(fCtrlSzLimit>1));
-
-         bool do_set = (fTotalEvents || fTotalLost) && (fCurrentLost >= fTotalLost) && (fCurrentEvents >= fTotalEvents) && (fCurrentData >= fTotalData);
-
-         if (do_set) {
-            double spent = fLastRateTm.SpentTillNow();
-            spent = (spent > 1e-3) ? 1./spent : 0.;
-
-            fCtrlLost = (fCurrentLost-fTotalLost)*spent;
-            fCtrlEvents = (fCurrentEvents-fTotalEvents)*spent;
-            fCtrlData = (fCurrentData-fTotalData)*spent/1024./1024.;
-
-            if ((fCtrlEvents > 1e9) || (fCtrlLost > 1e9) || (fCtrlData > 1e9)) do_set = false;
-         }
-
-         fTotalLost = fCurrentLost;
-         fTotalEvents = fCurrentEvents;
-         fTotalData = fCurrentData;
-         fLastRateTm.GetNow();
-
-         if (do_set) {
-            Par("DataRate").SetValue(fCtrlData);
-            Par("EventsRate").SetValue(fCtrlEvents);
-            Par("LostRate").SetValue(fCtrlLost);
-         }
-
-         SetParValue("TotalEvents", fTotalEvents);
-         SetParValue("TotalLost", fTotalLost);
-
-         if (fControl && (fCtrlSzLimit > 1) && fCurrentFileCmd.null()) {
-            fCtrlSzLimit = 0;
-            // this is a place, where new run automatically started
-            dabc::Command newrun("StartRun");
-            newrun.SetTimeout(45);
-            Submit(newrun);
-         }
-      }
    }
 
    return dabc::Module::ReplyCommand(cmd);
@@ -525,6 +585,9 @@ void hadaq::BnetMasterModule::ProcessTimerEvent(unsigned)
 
 int hadaq::BnetMasterModule::ExecuteCommand(dabc::Command cmd)
 {
+   if (cmd.IsName(dabc::CmdPushDiff::CmdName()))
+      return ApplyNodeDiff(cmd);
+
    if (cmd.IsName("StartRun") || cmd.IsName("StopRun")) {
 
       if (!fCurrentFileCmd.null()) {
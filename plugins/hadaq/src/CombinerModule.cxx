@@ -118,6 +118,15 @@ hadaq::CombinerModule::CombinerModule(const std::string &name, dabc::Command cmd
    // this will lead to effective flush time between FlushTimeout and FlushTimeout*1.5
    CreateTimer("FlushTimer", (fFlushTimeout > 0) ? fFlushTimeout/2. : 1.);
 
+   fMetrics.Define("hadaq_combiner_build_events", "Events build by combiner");
+   fMetrics.Define("hadaq_combiner_build_bytes", "Data in build events");
+   fMetrics.Define("hadaq_combiner_discard_events", "Events discarded by combiner");
+   fMetrics.Define("hadaq_combiner_dropped_bytes", "Data dropped by combiner");
+   fMetrics.Define("hadaq_combiner_full_drops", "Complete drops of all input buffers");
+   fMetrics.Define("hadaq_combiner_event_rate", "Build events rate", false);
+   fMetrics.AddLabel("module", GetName());
+   fMetrics.Register();
+
    //CreatePar("RunId");
    //Par("RunId").SetValue(fRunNumber); // to communicate with file components
 
@@ -248,6 +257,8 @@ void hadaq::CombinerModule::ProcessTimerEvent(unsigned timer)
 
    fLastEventRate = Par(fEventRateName).Value().AsDouble();
 
+   UpdateMetrics();
+
    // invoke event building, if necessary - reinjects events
    StartEventsBuilding();
 
@@ -258,6 +269,16 @@ void hadaq::CombinerModule::ProcessTimerEvent(unsigned timer)
    }
 }
 
+void hadaq::CombinerModule::UpdateMetrics()
+{
+   fMetrics.SetCounter(0, fAllBuildEvents);
+   fMetrics.SetCounter(1, fAllRecvBytes);
+   fMetrics.SetCounter(2, fAllDiscEvents);
+   fMetrics.SetCounter(3, fAllDroppedData);
+   fMetrics.SetCounter(4, fAllFullDrops);
+   fMetrics.SetGauge(5, fLastEventRate);
+}
+
 void hadaq::CombinerModule::StartEventsBuilding()
 {
    int cnt = 10;
@@ -15,6 +15,124 @@
 
 #include "hadaq/HldFile.h"
 #include "dabc/logging.h"
+#include "dabc/threads.h"
+
+#include <cstring>
+
+#ifndef DABC_WITHOUT_ZLIB
+#include "zlib.h"
+#endif
+
+namespace hadaq {
+
+   /** \brief Worker, compressing frames of HLD file
+    *
+    * Frames are distributed round-robin between workers,
+    * therefore file owner can write compressed frames in original order */
+
+   class HldCompressor {
+      public:
+         enum EState { stIdle, stBusy, stDone };
+
+         dabc::Mutex       fMutex;
+         dabc::Condition   fJobCond;        ///< fired when new job submitted
+         dabc::Condition   fDoneCond;       ///< fired when job is completed
+         dabc::PosixThread *fThrd{nullptr}; ///< thread, if not exists compression performed in caller thread
+         EState            fState{stIdle};
+         bool              fStop{false};
+         int               fLevel{0};
+         std::vector<char> fRaw;            ///< uncompressed frame payload
+         std::vector<char> fComp;           ///< compressed frame payload
+         HldFrameHeader    fHdr;            ///< header of produced frame
+
+         HldCompressor(int level, bool with_thread) : fMutex(), fJobCond(&fMutex), fDoneCond(&fMutex), fLevel(level)
+         {
+            if (with_thread) {
+               fThrd = new dabc::PosixThread();
+               fThrd->Start(HldCompressor::RunFunc, this);
+               fThrd->SetThreadName("HldCompress");
+            }
+         }
+
+         ~HldCompressor()
+         {
+            if (fThrd) {
+               {
+                  dabc::LockGuard lock(fMutex);
+                  fStop = true;
+                  fJobCond._DoFire();
+               }
+               fThrd->Join();
+               delete fThrd;
+               fThrd = nullptr;
+            }
+         }
+
+         void Compress()
+         {
+            fHdr.magic = HldFrameMagic;
+            fHdr.kind = hld_FrameStored;
+            fHdr.rawsize = fRaw.size();
+            fHdr.compsize = fRaw.size();
+
+#ifndef DABC_WITHOUT_ZLIB
+            uLongf complen = compressBound(fRaw.size());
+            fComp.resize(complen);
+            if ((compress2((Bytef *) fComp.data(), &complen, (const Bytef *) fRaw.data(), fRaw.size(), fLevel) == Z_OK) && (complen < fRaw.size())) {
+               fHdr.kind = hld_FrameZlib;
+               fHdr.compsize = complen;
+            }
+#endif
+         }
+
+         /** Submit new job, worker must be idle */
+         void Submit()
+         {
+            if (!fThrd) {
+               Compress();
+               fState = stDone;
+               return;
+            }
+            dabc::LockGuard lock(fMutex);
+            fState = stBusy;
+            fJobCond._DoFire();
+         }
+
+         /** Wait until submitted job is completed, returns true if there is frame to write */
+         bool Wait()
+         {
+            dabc::LockGuard lock(fMutex);
+            while (fState == stBusy)
+               fDoneCond._DoWait(-1);
+            return fState == stDone;
+         }
+
+         const char *FramePayload() const { return fHdr.kind == hld_FrameStored ? fRaw.data() : fComp.data(); }
+
+         static void *RunFunc(void *args)
+         {
+            HldCompressor *worker = (HldCompressor *) args;
+
+            while (true) {
+               {
+                  dabc::LockGuard lock(worker->fMutex);
+                  while ((worker->fState != stBusy) && !worker->fStop)
+                     worker->fJobCond._DoWait(-1);
+                  if (worker->fState != stBusy) break;
+               }
+
+               worker->Compress();
+
+               dabc::LockGuard lock(worker->fMutex);
+               worker->fState = stDone;
+               worker->fDoneCond._DoFire();
+            }
+
+            return nullptr;
+         }
+   };
+
+}
 
 hadaq::HldFile::HldFile() :
    dabc::BasicFile(),
@@ -26,9 +144,35 @@ hadaq::HldFile::HldFile() :
 hadaq::HldFile::~HldFile()
 {
    Close();
+   StopWorkers();
+}
+
+void hadaq::HldFile::SetCompression(int level, unsigned nthreads, unsigned framesize)
+{
+#ifdef DABC_WITHOUT_ZLIB
+   if (level > 0) {
+      EOUT("HLD file compression requested, but ZLIB is not available");
+      level = 0;
+   }
+#endif
+   if (level > 9) level = 9;
+
+   StopWorkers();
+
+   fCompressLevel = level > 0 ? level : 0;
+   fCompressThrds = nthreads;
+   fFrameSize = framesize < 0x10000 ? 0x10000 : framesize;
 }
 
-bool hadaq::HldFile::OpenWrite(const char *fname, uint32_t runid, const char *opt)
+void hadaq::HldFile::StopWorkers()
+{
+   for (auto worker : fWorkers)
+      delete worker;
+   fWorkers.clear();
+   fNextWorker = 0;
+}
+
+bool hadaq::HldFile::OpenWrite(const char *fname, uint32_t runid, const char *opt, dabc::FileInterface::Handle prepared)
 {
    if (isOpened()) return false;
 
@@ -39,13 +183,30 @@ bool hadaq::HldFile::OpenWrite(const char *fname, uint32_t runid, const char *op
 
    CheckIO();
 
-   fd = io->fopen(fname, "w", opt);
+   fd = prepared ? prepared : io->fopen(fname, "w", opt);
    if (!fd) {
       fprintf(stderr, "File open failed %s for writing\n", fname);
       return false;
    }
 
    fReadingMode = false;
+   fTruncate = prepared != nullptr;
+
+   fCompressed = fCompressLevel > 0;
+   if (fCompressed) {
+      if (fWorkers.empty())
+         for (unsigned n = 0; n < (fCompressThrds > 0 ? fCompressThrds : 1); ++n)
+            fWorkers.emplace_back(new HldCompressor(fCompressLevel, fCompressThrds > 0));
+      // frames left from previously failed file should not be written
+      for (auto worker : fWorkers) {
+         worker->Wait();
+         worker->fState = HldCompressor::stIdle;
+      }
+      fStage.clear();
+      fStage.reserve(fFrameSize + 0x10000);
+      fStagePos = 0;
+      fStageHdr = HldFrameHeader();
+   }
 
    // put here a dummy event into file:
    hadaq::RawEvent evnt;
@@ -85,15 +246,39 @@ bool hadaq::HldFile::OpenRead(const char *fname, const char *opt)
 
    // printf("starts reading into buf %u isreading %u \n", (unsigned) size, (unsigned)isReading());
 
-   if (!ReadBuffer(&evnt, &size, true)) {
+   // first words decide if this is plain or compressed HLD file
+   HldFrameHeader frame;
+   if (io->fread(&frame, sizeof(hadaq::HadTu), 1, fd) != 1) {
       fprintf(stderr,"Cannot read starting event from file\n");
       CloseBasicFile();
       return false;
    }
 
+   fCompressed = (frame.magic == HldFrameMagic);
+
+   if (fCompressed) {
+      fEOF = false;
+      if ((io->fread((char *) &frame + sizeof(hadaq::HadTu), sizeof(frame) - sizeof(hadaq::HadTu), 1, fd) != 1) || !ReadFrame(&frame) || !ReadBuffer(&evnt, &size, true)) {
+         fprintf(stderr,"Cannot read starting event from compressed file\n");
+         CloseBasicFile();
+         fCompressed = false;
+         fEOF = true;
+         return false;
+      }
+   } else {
+      memcpy((void *) &evnt, &frame, sizeof(hadaq::HadTu));
+      if ((evnt.GetPaddedSize() != sizeof(hadaq::RawEvent)) ||
+          (io->fread((char *) &evnt + sizeof(hadaq::HadTu), sizeof(hadaq::RawEvent) - sizeof(hadaq::HadTu), 1, fd) != 1)) {
+         fprintf(stderr,"Cannot read starting event from file\n");
+         CloseBasicFile();
+         return false;
+      }
+   }
+
    if ((size!=sizeof(hadaq::RawEvent)) || (evnt.GetId() != EvtId_runStart)) {
       fprintf(stderr,"Did not found start event at the file beginning\n");
       CloseBasicFile();
+      fEOF = true;
       return false;
    }
 
@@ -113,12 +298,239 @@ void hadaq::HldFile::Close()
       hadaq::RawEvent evnt;
       evnt.Init(0, fRunNumber, EvtId_runStop);
       WriteBuffer(&evnt, sizeof(evnt));
+
+      if (fCompressed && FlushFrame(true))
+         FlushWorkers();
+
+      if (fTruncate && isWriting() && !io->ftruncate(fd))
+         EOUT("Fail to truncate preallocated HLD file");
    }
 
   CloseBasicFile();
 
   fRunNumber = 0;
   fEOF = true;
+  fCompressed = false;
+  fTruncate = false;
+  fStage.clear();
+  fStagePos = 0;
+}
+
+/** Submit staged events to compression. Only complete events are taken,
+  * if \param all specified - all staged data */
+
+bool hadaq::HldFile::FlushFrame(bool all)
+{
+   // scan complete events, fStagePos marks end of already scanned events
+   while (fStagePos + sizeof(hadaq::RawEvent) <= fStage.size()) {
+      hadaq::RawEvent *evnt = (hadaq::RawEvent *) (fStage.data() + fStagePos);
+      uint32_t evsize = evnt->GetPaddedSize();
+      if ((evsize < sizeof(hadaq::HadTu)) || (fStagePos + evsize > fStage.size())) break;
+      if (fStageHdr.numevents++ == 0)
+         fStageHdr.firstid = evnt->GetSeqNr();
+      fStageHdr.lastid = evnt->GetSeqNr();
+      fStagePos += evsize;
+   }
+
+   unsigned framesize = all ? fStage.size() : fStagePos;
+   if (framesize == 0) return true;
+
+   auto worker = fWorkers[fNextWorker];
+   fNextWorker = (fNextWorker + 1) % fWorkers.size();
+
+   // previous frame of the worker should be written first
+   if (worker->Wait() && !WriteFrame(worker))
+      return false;
+
+   // staged data given to the worker, its previous buffer reused for staging
+   worker->fRaw.swap(fStage);
+   fStage.clear();
+   if (worker->fRaw.size() > framesize) {
+      // only incomplete event remains, copy it back
+      fStage.assign(worker->fRaw.begin() + framesize, worker->fRaw.end());
+      worker->fRaw.resize(framesize);
+   }
+   fStage.reserve(fFrameSize + 0x10000);
+   worker->fHdr = fStageHdr;
+   worker->Submit();
+
+   fStagePos = 0;
+   fStageHdr = HldFrameHeader();
+
+   return true;
+}
+
+/** Write compressed frame of the worker to the file */
+
+bool hadaq::HldFile::WriteFrame(HldCompressor *worker)
+{
+   worker->fState = HldCompressor::stIdle;
+
+   if ((io->fwrite(&worker->fHdr, sizeof(HldFrameHeader), 1, fd) != 1) ||
+       (io->fwrite(worker->FramePayload(), worker->fHdr.compsize, 1, fd) != 1)) {
+      EOUT("fail to write HLD frame of size %u", (unsigned) worker->fHdr.compsize);
+      CloseBasicFile();
+      return false;
+   }
+
+   return true;
+}
+
+/** Wait for all submitted frames and write them in original order */
+
+bool hadaq::HldFile::FlushWorkers()
+{
+   for (unsigned n = 0; n < fWorkers.size(); ++n) {
+      auto worker = fWorkers[(fNextWorker + n) % fWorkers.size()];
+      if (worker->Wait() && !WriteFrame(worker))
+         return false;
+   }
+   return true;
+}
+
+/** Read next frame from compressed file and decompress it into staging buffer.
+  * Frame header can be provided when it was already read */
+
+bool hadaq::HldFile::ReadFrame(const HldFrameHeader *hdr)
+{
+   HldFrameHeader frame;
+   if (hdr)
+      frame = *hdr;
+   else if (io->fread(&frame, sizeof(frame), 1, fd) != 1)
+      return false;
+
+   fStage.clear();
+   fStagePos = 0;
+
+   if (frame.magic != HldFrameMagic) {
+      fprintf(stderr, "Wrong frame magic 0x%08x in compressed HLD file\n", (unsigned) frame.magic);
+      return false;
+   }
+
+   if (frame.kind == hld_FrameStored) {
+      fStage.resize(frame.rawsize);
+      return (frame.rawsize == 0) || (io->fread(fStage.data(), frame.rawsize, 1, fd) == 1);
+   }
+
+   fCompBuf.resize(frame.compsize);
+   if ((frame.compsize > 0) && (io->fread(fCompBuf.data(), frame.compsize, 1, fd) != 1)) {
+      fprintf(stderr, "Fail to read HLD frame payload of size %u\n", (unsigned) frame.compsize);
+      return false;
+   }
+
+#ifndef DABC_WITHOUT_ZLIB
+   if (frame.kind == hld_FrameZlib) {
+      fStage.resize(frame.rawsize);
+      uLongf rawlen = frame.rawsize;
+      if ((uncompress((Bytef *) fStage.data(), &rawlen, (const Bytef *) fCompBuf.data(), frame.compsize) == Z_OK) && (rawlen == frame.rawsize))
+         return true;
+      fprintf(stderr, "Fail to decompress HLD frame of size %u\n", (unsigned) frame.compsize);
+      fStage.clear();
+      return false;
+   }
+#endif
+
+   fprintf(stderr, "Not supported HLD frame kind %u\n", (unsigned) frame.kind);
+   return false;
+}
+
+/** Copy events from decompressed frames into user buffer */
+
+bool hadaq::HldFile::ReadFrameBuffer(void* ptr, uint32_t* sz, bool onlyevent)
+{
+   uint32_t maxsz = *sz, filled = 0;
+   *sz = 0;
+
+   while (!fEOF && (filled < maxsz)) {
+      if (fStagePos >= fStage.size()) {
+         if (!ReadFrame()) {
+            fEOF = true;
+            break;
+         }
+         continue;
+      }
+
+      hadaq::HadTu *hdr = (hadaq::HadTu *) (fStage.data() + fStagePos);
+      uint32_t evsize = hdr->GetPaddedSize();
+
+      if ((evsize < sizeof(hadaq::HadTu)) || (fStagePos + evsize > fStage.size())) {
+         fprintf(stderr, "Corrupted event in compressed HLD frame\n");
+         fEOF = true;
+         break;
+      }
+
+      if ((evsize == sizeof(hadaq::RawEvent)) && (((hadaq::RawEvent*)hdr)->GetId() == EvtId_runStop)) {
+         // we are not deliver such stop event to the top
+         fEOF = true;
+         break;
+      }
+
+      if (filled + evsize > maxsz) {
+         if (filled == 0)
+            fprintf(stderr, "Buffer %u too small to read next event %u from hld file\n", (unsigned) maxsz, (unsigned) evsize);
+         break;
+      }
+
+      memcpy((char *) ptr + filled, hdr, evsize);
+      filled += evsize;
+      fStagePos += evsize;
+
+      if (onlyevent) break;
+   }
+
+   *sz = filled;
+   return filled > 0;
+}
+
+bool hadaq::HldFile::SeekEvent(uint32_t evid)
+{
+   if (!isReading()) return false;
+
+   if (fCompressed) {
+      while (!fEOF) {
+         while (fStagePos < fStage.size()) {
+            hadaq::RawEvent *evnt = (hadaq::RawEvent *) (fStage.data() + fStagePos);
+            if ((evnt->GetSeqNr() >= evid) || (evnt->GetId() == EvtId_runStop)) return true;
+            fStagePos += evnt->GetPaddedSize();
+         }
+
+         // skip complete frames which do not contain requested event
+         HldFrameHeader frame;
+         while (true) {
+            if (io->fread(&frame, sizeof(frame), 1, fd) != 1) {
+               fEOF = true;
+               return false;
+            }
+            if ((frame.numevents == 0) || (frame.lastid >= evid)) break;
+            if (!io->fseek(fd, frame.compsize, true)) {
+               // position in file is undefined, frame cannot be read any longer
+               fEOF = true;
+               return false;
+            }
+         }
+
+         if (!ReadFrame(&frame)) {
+            fEOF = true;
+            return false;
+         }
+      }
+      return false;
+   }
+
+   hadaq::RawEvent evnt;
+   while (!fEOF) {
+      if (io->fread(&evnt, sizeof(evnt), 1, fd) != 1) {
+         fEOF = true;
+         return false;
+      }
+      if ((evnt.GetSeqNr() >= evid) || (evnt.GetId() == EvtId_runStop))
+         return io->fseek(fd, -((long) sizeof(evnt)), true);
+      if (!io->fseek(fd, evnt.GetPaddedSize() - sizeof(evnt), true)) {
+         fEOF = true;
+         return false;
+      }
+   }
+   return false;
 }
 
 
@@ -127,6 +539,11 @@ bool hadaq::HldFile::WriteBuffer(void* buf, uint32_t bufsize)
 {
    if (!isWriting() || !buf || (bufsize == 0)) return false;
 
+   if (fCompressed) {
+      fStage.insert(fStage.end(), (char *) buf, (char *) buf + bufsize);
+      return (fStage.size() < fFrameSize) || FlushFrame(false);
+   }
+
    if (io->fwrite(buf, bufsize, 1, fd) != 1) {
       EOUT("fail to write buffer payload of size %u", (unsigned) bufsize);
       CloseBasicFile();
@@ -140,6 +557,9 @@ bool hadaq::HldFile::ReadBuffer(void* ptr, uint32_t* sz, bool onlyevent)
 {
    if (!isReading() || !ptr || !sz || (*sz < sizeof(hadaq::HadTu))) return false;
 
+   if (fCompressed)
+      return ReadFrameBuffer(ptr, sz, onlyevent);
+
    uint64_t maxsz = *sz; *sz = 0;
 
    size_t readsz = io->fread(ptr, 1, (onlyevent ? sizeof(hadaq::HadTu) : maxsz), fd);
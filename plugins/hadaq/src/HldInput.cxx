@@ -19,6 +19,7 @@
 #include <cstdlib>
 
 #include "dabc/Manager.h"
+#include "dabc/StripedFile.h"
 
 #include "hadaq/HadaqTypeDefs.h"
 
@@ -31,6 +32,8 @@ hadaq::HldInput::HldInput(const dabc::Url& url) :
      fFile.SetIO((dabc::FileInterface*) dabc::mgr.CreateAny("rfio::FileInterface"), true);
    else if (url.HasOption("ltsm"))
      fFile.SetIO((dabc::FileInterface*) dabc::mgr.CreateAny("ltsm::FileInterface"), true);
+
+   ConfigureFile(fFile);
 }
 
 hadaq::HldInput::~HldInput()
@@ -51,6 +54,17 @@ bool hadaq::HldInput::OpenNextFile()
 
    if (!TakeNextFileName()) return false;
 
+   // manifest of striped file requires special interface, plain interface restored afterwards
+   if (dabc::StripedFileInterface::IsStripedFile(CurrentFileName())) {
+      fFile.SetIO(new dabc::StripedFileInterface(), true);
+      fStriped = true;
+      ConfigureFile(fFile);
+   } else if (fStriped) {
+      fFile.SetIO(nullptr);
+      fStriped = false;
+      ConfigureFile(fFile);
+   }
+
    if (!fFile.OpenRead(CurrentFileName().c_str())) {
       EOUT("Cannot open file %s for reading", CurrentFileName().c_str());
       return false;
@@ -58,6 +72,8 @@ bool hadaq::HldInput::OpenNextFile()
 
    DOUT1("Open hld file %s for reading", CurrentFileName().c_str());
 
+   PrepareNextFile();
+
    return true;
 }
 
@@ -74,9 +90,16 @@ unsigned hadaq::HldInput::Read_Size()
    if (!fFile.isReading())
       return dabc::di_Error;
 
-   if (fFile.eof())
+   if (fFile.eof()) {
+      // checksum mismatch stops reading of the file, but it is not normal end of file
+      if (fFile.GetIntPar("CrcFailure") > 0) {
+         EOUT("CRC32C mismatch when reading file %s", CurrentFileName().c_str());
+         CloseFile();
+         return dabc::di_Error;
+      }
       if (!OpenNextFile())
          return dabc::di_EndOfStream;
+   }
 
    return dabc::di_DfltBufSize;
 }
@@ -92,6 +115,11 @@ unsigned hadaq::HldInput::Read_Complete(dabc::Buffer& buf)
    uint32_t bufsize = ((uint32_t) (buf.SegmentSize(0) * fReduce) / 4) * 4;
 
    if (!fFile.ReadBuffer(buf.SegmentPtr(0), &bufsize)) {
+      if (fFile.GetIntPar("CrcFailure") > 0) {
+         EOUT("CRC32C mismatch when reading file %s", CurrentFileName().c_str());
+         CloseFile();
+         return dabc::di_Error;
+      }
       // if by chance reading of buffer leads to eof, skip buffer and let switch file on the next turn
       if (fFile.eof()) return dabc::di_SkipBuffer;
       CloseFile();
@@ -17,7 +17,10 @@
 
 #include <cstring>
 #include <cstdlib>
+#include <cerrno>
 #include <cstdio>
+#include <csignal>
+#include <dirent.h>
 #include <unistd.h>
 
 #if defined(__MACH__) /* Apple OSX section */
@@ -30,6 +33,140 @@
 
 #include "hadaq/Iterator.h"
 
+namespace hadaq {
+
+   /** \brief Thread, creating and preallocating next HLD file in advance
+    *
+    * File created with temporary name in the directory of current file and
+    * renamed when output switches to the next file.
+    * Before first file prepared in the directory, temporary files left by crashed processes are removed. */
+
+   class HldNextFile {
+      public:
+         enum EState { stIdle, stBusy, stDone };
+
+         dabc::Mutex        fMutex;
+         dabc::Condition    fJobCond;         ///< fired when preparation is requested
+         dabc::Condition    fDoneCond;        ///< fired when file is prepared
+         dabc::PosixThread  fThrd;
+         dabc::FileInterface fIO;             ///< plain file interface
+         EState             fState{stIdle};
+         bool               fStop{false};
+         std::string        fName;            ///< temporary name of prepared file
+         std::string        fCleanedDir;      ///< directory, where stale files were removed
+         uint64_t           fSize{0};         ///< size to preallocate
+         dabc::FileInterface::Handle fHandle{nullptr};
+
+         HldNextFile() : fMutex(), fJobCond(&fMutex), fDoneCond(&fMutex)
+         {
+            fThrd.Start(HldNextFile::RunFunc, this);
+            fThrd.SetThreadName("HldNextFile");
+         }
+
+         ~HldNextFile()
+         {
+            Discard();
+            {
+               dabc::LockGuard lock(fMutex);
+               fStop = true;
+               fJobCond._DoFire();
+            }
+            fThrd.Join();
+         }
+
+         /** Request preparation of the file */
+         void Prepare(const std::string &name, uint64_t size)
+         {
+            dabc::LockGuard lock(fMutex);
+            if (fState != stIdle) return;
+            fName = name;
+            fSize = size;
+            fState = stBusy;
+            fJobCond._DoFire();
+         }
+
+         /** Take prepared file, waits when preparation still running */
+         dabc::FileInterface::Handle Take(std::string &name)
+         {
+            dabc::LockGuard lock(fMutex);
+            while (fState == stBusy)
+               fDoneCond._DoWait(-1);
+            if (fState != stDone) return nullptr;
+            fState = stIdle;
+            name = fName;
+            auto h = fHandle;
+            fHandle = nullptr;
+            return h;
+         }
+
+         /** Close and remove prepared file */
+         void Discard()
+         {
+            std::string name;
+            auto h = Take(name);
+            if (h) {
+               fIO.fclose(h);
+               ::unlink(name.c_str());
+            }
+         }
+
+         /** Remove temporary files of not existing processes */
+         static void RemoveStale(const std::string &dir)
+         {
+            DIR *d = ::opendir(dir.c_str());
+            if (!d) return;
+
+            while (auto entry = ::readdir(d)) {
+               int pid = 0;
+               unsigned eb = 0;
+               char tail[8];
+               if ((sscanf(entry->d_name, ".hldnext_%d_%u.%7s", &pid, &eb, tail) != 3) || strcmp(tail, "tmp")) continue;
+               if ((pid <= 0) || (pid == (int) getpid()) || (::kill(pid, 0) == 0) || (errno != ESRCH)) continue;
+
+               std::string fname = dir + entry->d_name;
+               if (::unlink(fname.c_str()) == 0)
+                  DOUT0("Remove stale prepared HLD file %s", fname.c_str());
+            }
+
+            ::closedir(d);
+         }
+
+         static void *RunFunc(void *args)
+         {
+            HldNextFile *next = (HldNextFile *) args;
+
+            while (true) {
+               {
+                  dabc::LockGuard lock(next->fMutex);
+                  while ((next->fState != stBusy) && !next->fStop)
+                     next->fJobCond._DoWait(-1);
+                  if (next->fState != stBusy) break;
+               }
+
+               size_t slash = next->fName.rfind("/");
+               std::string dir = (slash == std::string::npos) ? std::string("./") : next->fName.substr(0, slash + 1);
+               if (next->fCleanedDir != dir) {
+                  RemoveStale(dir);
+                  next->fCleanedDir = dir;
+               }
+
+               auto h = next->fIO.fopen(next->fName.c_str(), "w");
+               if (!h)
+                  EOUT("Cannot create next HLD file %s", next->fName.c_str());
+               else if ((next->fSize > 0) && !next->fIO.fallocate(h, next->fSize))
+                  DOUT1("Cannot preallocate %lu bytes for %s", (long unsigned) next->fSize, next->fName.c_str());
+
+               dabc::LockGuard lock(next->fMutex);
+               next->fHandle = h;
+               next->fState = stDone;
+               next->fDoneCond._DoFire();
+            }
+
+            return nullptr;
+         }
+   };
+
+}
 
 hadaq::HldOutput::HldOutput(const dabc::Url& url) :
    dabc::FileOutput(url,".hld"),
@@ -53,6 +190,10 @@ hadaq::HldOutput::HldOutput(const dabc::Url& url) :
    fRfio = url.HasOption("rfio");
    fLtsm = url.HasOption("ltsm");
    fPlainName = url.HasOption("plain") && (GetSizeLimitMB() <= 0);
+   if (url.HasOption("compress"))
+      fFile.SetCompression(url.GetOptionInt("compress", 1), url.GetOptionInt("compthrds", 2), url.GetOptionInt("framesize", 1024) * 1024);
+   if (url.HasOption("prealloc") && !fRfio && !fLtsm)
+      fNextFile = new HldNextFile();
    if (fRfio) {
       dabc::FileInterface* io = (dabc::FileInterface*) dabc::mgr.CreateAny("rfio::FileInterface");
 
@@ -80,6 +221,8 @@ hadaq::HldOutput::~HldOutput()
 {
    DOUT3(" hadaq::HldOutput::DTOR");
    CloseFile();
+   delete fNextFile;
+   fNextFile = nullptr;
 }
 
 bool hadaq::HldOutput::Write_Init(const dabc::WorkerRef &wrk, const dabc::Command &cmd)
@@ -87,6 +230,32 @@ bool hadaq::HldOutput::Write_Init(const dabc::WorkerRef &wrk, const dabc::Comman
    if (!dabc::FileOutput::Write_Init(wrk, cmd))
       return false;
 
+   if (fRfio || fLtsm) {
+      if (fStripeBlockSize > 0)
+         ShowInfo(-1, dabc::format("stripe option not supported for %s output, ignored", fRfio ? "rfio" : "ltsm"));
+   } else {
+      auto io = CreateStripedIO();
+      if (io) {
+         fFile.SetIO(io, true);
+         // striped files cannot be prepared in advance
+         if (fNextFile) {
+            ShowInfo(-1, "prealloc option not supported for striped output, ignored");
+            delete fNextFile;
+            fNextFile = nullptr;
+         }
+      }
+   }
+
+   if (fChecksum) {
+      fFile.EnableChecksum();
+      // checksums calculated from the beginning of file, prepared file cannot be used
+      if (fNextFile) {
+         ShowInfo(-1, "prealloc option cannot be used together with crc, ignored");
+         delete fNextFile;
+         fNextFile = nullptr;
+      }
+   }
+
    if (fRunSlave) {
       // use parameters only in slave mode
       fRunNumber = 0;
@@ -158,16 +327,44 @@ bool hadaq::HldOutput::StartNewFile()
       if (!fPlainName) fname += extens;
       fname += ".hld";
    }
+
+   // files alternating over "dirs"
+   if (fFileDirsCounter < fFileDirs.size()) {
+      fname = fFileDirs[fFileDirsCounter++] + fname;
+      if (fFileDirsCounter >= fFileDirs.size())
+         fFileDirsCounter = 0;
+   }
+
    fCurrentFileName = fname;
 
    if (fRunSlave && fRfio)
       DOUT1("Before open file %s for writing", CurrentFileName().c_str());
 
-   if (!fFile.OpenWrite(CurrentFileName().c_str(), fRunNumber, fUrlOptions.c_str())) {
+   dabc::FileInterface::Handle prepared = nullptr;
+   if (fNextFile) {
+      std::string tmpname;
+      prepared = fNextFile->Take(tmpname);
+      if (prepared && (::rename(tmpname.c_str(), CurrentFileName().c_str()) != 0)) {
+         // typically happens when file should be written on other file system
+         DOUT0("Cannot rename prepared file %s into %s - %s, open file directly", tmpname.c_str(), CurrentFileName().c_str(), strerror(errno));
+         fNextFile->fIO.fclose(prepared);
+         ::unlink(tmpname.c_str());
+         prepared = nullptr;
+      }
+   }
+
+   if (!fFile.OpenWrite(CurrentFileName().c_str(), fRunNumber, fUrlOptions.c_str(), prepared)) {
       ShowInfo(-1, dabc::format("%s cannot open file for writing", CurrentFileName().c_str()));
       return false;
    }
 
+   if (fNextFile) {
+      // next file prepared in the directory of next file, so it can be renamed
+      std::string tmpname = NextFileDir();
+      tmpname.append(dabc::format(".hldnext_%d_%u.tmp", (int) getpid(), (unsigned) fEBNumber));
+      fNextFile->Prepare(tmpname, GetSizeLimitMB() * 1024LU * 1024LU);
+   }
+
    // JAM2020: here we have to update the real filename in case that implementation changes it
    // this can happen for ltsm io where we may add subfolders for year and day
    char tmp[1024];
@@ -190,6 +387,24 @@ bool hadaq::HldOutput::StartNewFile()
    return true;
 }
 
+std::string hadaq::HldOutput::NextFileDir()
+{
+   std::string fname = fFileName;
+
+   if (fUseDaqDisk) {
+      // disk number for next file is current value of the parameter
+      dabc::Parameter par = dabc::mgr.FindPar("Combiner/Evtbuild-diskNum");
+      if (!par.null())
+         fname = dabc::format("/data%02d/data/", (int) par.Value().AsUInt());
+   }
+
+   if (fFileDirsCounter < fFileDirs.size())
+      fname = fFileDirs[fFileDirsCounter] + fname;
+
+   size_t slash = fname.rfind("/");
+   return slash == std::string::npos ? std::string() : fname.substr(0, slash + 1);
+}
+
 bool hadaq::HldOutput::Write_Retry()
 {
    // HLD output supports retry option
@@ -46,6 +46,17 @@ hadaq::NewAddon::NewAddon(int fd, int nport, int mtu, bool debug, int maxloop, d
    fMaxProcDist(0.)
 {
    fMtuBuffer = std::malloc(fMTU);
+   fUdpProfiler.Reserve(50);
+
+   fMtrRecvPackets = fMetrics.Define("hadaq_udp_recv_packets", "Received UDP packets");
+   fMtrRecvBytes = fMetrics.Define("hadaq_udp_recv_bytes", "Received UDP bytes");
+   fMtrDiscardPackets = fMetrics.Define("hadaq_udp_discard_packets", "Discarded UDP packets");
+   fMtrDiscardBytes = fMetrics.Define("hadaq_udp_discard_bytes", "Discarded UDP bytes");
+   fMtrDiscard32 = fMetrics.Define("hadaq_udp_discard32_packets", "UDP packets with mismatch of trailing 32 bytes");
+   fMtrSkipped = fMetrics.Define("hadaq_udp_skipped_reads", "Read attempts skipped while no buffer was available");
+   fMtrProduced = fMetrics.Define("hadaq_udp_produced_buffers", "Buffers filled by UDP transport");
+   fMetrics.AddLabel("port", std::to_string(nport));
+   fMetrics.Register();
 }
 
 hadaq::NewAddon::~NewAddon()
@@ -60,7 +71,7 @@ void hadaq::NewAddon::ProcessEvent(const dabc::EventId& evnt)
       // DOUT0("Addon %d get read event", fNPort);
 
       // ignore events when not waiting for the new data
-      if (fRunning) { ReadUdp(); SetDoingInput(true); }
+      if (fRunning) { ReadUdp(); UpdateMetrics(); SetDoingInput(true); }
    } else {
       dabc::SocketAddon::ProcessEvent(evnt);
    }
@@ -86,6 +97,17 @@ long hadaq::NewAddon::Notify(const std::string &msg, int arg)
 }
 
 
+void hadaq::NewAddon::UpdateMetrics()
+{
+   fMetrics.SetCounter(fMtrRecvPackets, fTotalRecvPacket);
+   fMetrics.SetCounter(fMtrRecvBytes, fTotalRecvBytes);
+   fMetrics.SetCounter(fMtrDiscardPackets, fTotalDiscardPacket);
+   fMetrics.SetCounter(fMtrDiscardBytes, fTotalDiscardBytes);
+   fMetrics.SetCounter(fMtrDiscard32, fTotalDiscard32Packet);
+   fMetrics.SetCounter(fMtrSkipped, fTotalArtificialSkip);
+   fMetrics.SetCounter(fMtrProduced, fTotalProducedBuffers);
+}
+
 bool hadaq::NewAddon::CloseBuffer()
 {
    if (fTgtPtr.null()) return false;
@@ -106,6 +128,8 @@ bool hadaq::NewAddon::ReadUdp()
 {
    if (!fRunning) return false;
 
+   PROFILER_GURAD(fUdpProfiler, "start", 0)
+
    hadaq::NewTransport* tr = dynamic_cast<hadaq::NewTransport*> (fWorker());
    if (!tr) { EOUT("No transport assigned"); return false; }
 
@@ -116,6 +140,8 @@ bool hadaq::NewAddon::ReadUdp()
 
    void *tgt = nullptr;
 
+   PROFILER_BLOCK("buf")
+
    if (fTgtPtr.null()) {
       if (!tr->AssignNewBuffer(0, this)) {
          if (fSkipCnt++<10) { fTotalArtificialSkip++; return false; }
@@ -135,6 +161,8 @@ bool hadaq::NewAddon::ReadUdp()
 
    while (cnt-- > 0) {
 
+      PROFILER_BLOCKN("recv", 5)
+
       if (tgt != fMtuBuffer) tgt = fTgtPtr.ptr();
 
       /* this was old form which is not necessary - socket is already bind with the port */
@@ -143,6 +171,8 @@ bool hadaq::NewAddon::ReadUdp()
 
       ssize_t res = recv(Socket(), tgt, fMTU, MSG_DONTWAIT);
 
+      PROFILER_BLOCK("chk")
+
       if (res == 0) {
          DOUT0("UDP:%d Seems to be, socket was closed", fNPort);
          return false;
@@ -207,6 +237,7 @@ bool hadaq::NewAddon::ReadUdp()
       // when rest size is smaller that mtu, one should close buffer
       // or if filled size bigger than allowed reduced size
       if ((rawsz < fMTU) || (fBufferSize - rawsz > fBufferSize * fReduce)) {
+         PROFILER_BLOCK("close")
          CloseBuffer();
          tr->BufferReady();
          if (!tr->AssignNewBuffer(0,this))
@@ -20,16 +20,74 @@
 #include "http/Server.h"
 #endif
 
+#ifndef DABC_Hierarchy
+#include "dabc/Hierarchy.h"
+#endif
+
 #include "../civetweb/civetweb.h"
 
+#include <list>
+#include <map>
+#include <set>
+
 namespace http {
 
    /** \brief %Server provides http access to DABC
     *
+    * Beside normal http requests, provides websocket at "/ws" address.
+    * Client specifies items and push rate in the query like "ws://host:8090/ws?items=[/Master/BNET,/Node/App]&rate=1",
+    * same string can be later send as text message to change subscription.
+    * For every item server subscribes to the diffs in the publisher and pushes to the clients
+    * JSON array with changed nodes of the items like
+    * [{"_path":"/Master/BNET","_full":false,"_changes":{"TotalEvents":{...}},"_removed":[]}]
+    * First message for every item contains all nodes and "_full":true.
+    * Every websocket client occupies civetweb thread, two threads kept for normal requests -
+    * with default "thrds" parameter 5 only 3 websocket clients are accepted.
     */
 
    class Civetweb : public Server  {
       protected:
+
+         /** Item, requested by websocket clients. Server keeps copy of item hierarchy, updated from pushed diffs */
+         struct WsItem {
+            int         fSubId{0};           ///< subscription id, 0 when not subscribed
+            uint64_t    fVersion{0};         ///< last version, delivered by publisher
+            dabc::Hierarchy fMirror;         ///< copy of item hierarchy
+            std::map<std::string, std::string> fNodes;  ///< JSON of every node, key is path relative to item
+            dabc::TimeStamp fSubscribeTm;    ///< time of last subscribe request
+            dabc::TimeStamp fLastUpdate;     ///< time of last push from publisher
+         };
+
+         /** Changes of item, not yet delivered to websocket client */
+         struct WsPending {
+            bool fFull{true};                               ///< all item nodes should be send
+            std::map<std::string, std::string> fChanges;    ///< changed nodes
+            std::set<std::string> fRemoved;                 ///< removed nodes
+         };
+
+         /** Websocket client. Messages written by own thread, therefore slow client does not delay others */
+         struct WsClient {
+            Civetweb *fServer{nullptr};                     ///< server, mutex used to protect client fields
+            struct mg_connection *fConn{nullptr};          ///< civetweb connection
+            double fPeriod{1.};                             ///< minimal interval between two messages
+            dabc::TimeStamp fLastSend;                      ///< time of last message
+            std::map<std::string, WsPending> fItems;        ///< subscribed items
+            std::string fMsg;                               ///< message prepared for sending, taken by writer thread
+            bool fWriting{false};                           ///< message is written, changes accumulated for next message
+            bool fStop{false};                              ///< writer thread should stop
+            dabc::Condition fCond;                          ///< fired when message prepared or writer should stop
+            dabc::PosixThread fThrd;                        ///< writer thread
+
+            WsClient(Civetweb *server) : fServer(server), fCond(&server->fWsMutex) {}
+         };
+
+         double fWsMaxRate{2.};               ///< maximal number of messages per second to websocket client, "ws_maxrate" parameter
+         double fWsKeepAlive{5.};             ///< maximal interval between pushes from publisher
+         dabc::Mutex fWsMutex;                ///< protects clients list, released when message is written to client
+         std::list<WsClient> fWsClients;      ///< websocket clients
+         std::map<std::string, WsItem> fWsItems;  ///< requested items, used only in server thread
+         int fWsSubCnt{0};                    ///< counter for subscriptions ids
+
          std::string fHttpPort;      ///< port number for HTTP server
          std::string fHttpsPort;     ///< port number for HTTPS server
          int fNumThreads{0};            ///< number of civetweb threads
@@ -42,6 +100,28 @@ namespace http {
 
          void OnThreadAssigned() override;
 
+         double ProcessTimeout(double last_diff) override;
+
+         int ExecuteCommand(dabc::Command cmd) override;
+
+         bool ReplyCommand(dabc::Command cmd) override;
+
+         /** Configure items and rate of client from query string, called with locked mutex */
+         void ConfigureWsClient(WsClient &client, const char *query);
+
+         /** Apply diff pushed by publisher and distribute changes to the clients */
+         int ApplyWsDiff(dabc::Command cmd);
+
+         /** Subscribe items required by clients, prepare messages with pending changes, called with locked mutex.
+          * No new message prepared while previous is not yet written, changes are merged into next message */
+         double ProcessWsClients();
+
+         /** Thread function, writing messages of single websocket client */
+         static void *WsWriterFunc(void *arg);
+
+         /** Send static file, content taken from memory cache when possible */
+         void SendStaticFile(struct mg_connection *conn, const std::string &fname);
+
       public:
          Civetweb(const std::string &name, dabc::Command cmd = nullptr);
          virtual ~Civetweb();
@@ -51,6 +131,14 @@ namespace http {
          static int begin_request_handler(struct mg_connection *conn, void*);
 
          static int log_message_handler(const struct mg_connection *conn, const char *message);
+
+         static int ws_connect_handler(const struct mg_connection *conn, void*);
+
+         static void ws_ready_handler(struct mg_connection *conn, void*);
+
+         static int ws_data_handler(struct mg_connection *conn, int bits, char *data, size_t len, void*);
+
+         static void ws_close_handler(const struct mg_connection *conn, void*);
    };
 }
 
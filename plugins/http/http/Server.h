@@ -21,6 +21,7 @@
 #endif
 
 #include <vector>
+#include <map>
 
 namespace http {
 
@@ -39,6 +40,22 @@ namespace http {
             std::string fNamePrefixRepl; ///< replacement for name prefix like "/files/"
          };
 
+         /** Rendered response for item with version */
+         struct CacheEntry {
+            uint64_t fVersion{0};          ///< item version
+            std::string fContentType;      ///< content type
+            std::string fData;             ///< rendered response
+            std::string fZipped;           ///< gzip-compressed response, produced on demand
+            dabc::TimeStamp fLastUsed;     ///< last time when entry was used
+         };
+
+         /** Content of static file, kept in memory together with compressed variant */
+         struct StaticEntry {
+            long        fMTime{0};         ///< modification time of the file
+            std::string fData;             ///< file content
+            std::string fZipped;           ///< gzip-compressed content, empty if compression does not help
+         };
+
          std::vector<Location> fLocations; ///< different locations known to server
          std::string fHttpSys;      ///< location of http plugin, need to read special files
          std::string fOwnJsRootSys; ///< location of internal JSROOT code, need to read special files
@@ -54,6 +71,21 @@ namespace http {
          std::string fDrawOpt;     ///< _drawopt value in h.json, only for top page
          int         fMonitoring{0};  ///< _monitoring value in h.json, only for top page
 
+         dabc::Mutex fCacheMutex;          ///< protects responses cache
+         std::map<std::string, CacheEntry> fCache; ///< rendered responses for items with versions
+         unsigned    fCacheSize{0};        ///< maximal number of cached responses, "cachesize" parameter
+         unsigned    fCacheId{0};          ///< unique id of server instance, used in ETag
+
+         std::map<std::string, StaticEntry> fStatic; ///< static files content, protected by fCacheMutex
+         uint64_t    fStaticSize{0};       ///< total size of cached static files
+         uint64_t    fStaticLimit{0};      ///< maximal size of static files cache, "staticcache" parameter in MB
+
+         /** Find cached response for specified version, fill content */
+         bool GetCached(const std::string &key, uint64_t version, bool zipped, std::string& content_type, std::string& content_str, dabc::Buffer& content_bin);
+
+         /** Store rendered response in cache */
+         void SetCached(const std::string &key, uint64_t version, bool zipped, const std::string& content_type, const std::string& content_str, dabc::Buffer& content_bin);
+
          /** Check if relative path below current dir - prevents file access to top directories via http */
          static bool VerifyFilePath(const char *fname);
 
@@ -65,12 +97,29 @@ namespace http {
          /** Returns true if authentication is required */
          bool IsAuthRequired(const char *uri);
 
-         /** Method process different URL requests, should be called from server thread */
+         /** Method process different URL requests, should be called from server thread.
+          * If etag matches version of requested item, content_type "__notmodified__" is returned.
+          * When gzip is accepted by client, content compressed. If stream_gzip specified,
+          * large dynamic content returned as is and flag set - caller should compress it with \ref StreamGzip */
          bool Process(const char *uri, const char *query,
                       std::string& content_type,
                       std::string& content_header,
                       std::string& content_str,
-                      dabc::Buffer& content_bin);
+                      dabc::Buffer& content_bin,
+                      const char *etag = nullptr,
+                      const char *accept_encoding = nullptr,
+                      bool *stream_gzip = nullptr);
+
+         /** Get static file content from memory cache, file read and compressed when used first time.
+          * Returns false when file does not exist or too large to be cached.
+          * If gzip accepted and compressed content exists, it will be returned and zipped flag set */
+         bool GetStaticFile(const std::string &fname, bool gzip, std::string &content, bool &zipped, std::string &etag);
+
+         /** Returns true if content of such type should be compressed */
+         static bool IsCompressible(const std::string &content_type);
+
+         /** Returns true if accept-encoding header value allows gzip */
+         static bool AcceptGzip(const char *accept_encoding);
 
       public:
          Server(const std::string &name, dabc::Command cmd = nullptr);
@@ -86,6 +135,13 @@ namespace http {
          const char *ClassName() const override { return "HttpServer"; }
 
          static const char *GetMimeType(const char *fname);
+
+         /** Compress data with gzip, output delivered in portions to the sink function.
+          * Returns false if compression or sink fails */
+         static bool StreamGzip(const void *src, size_t len, bool (*sink)(void *arg, const void *buf, size_t sz), void *arg);
+
+         /** Compress data with gzip into string */
+         static bool CompressGzip(const void *src, size_t len, std::string &res);
    };
 
 }
@@ -17,6 +17,9 @@
 
 #include <cstring>
 
+#include "dabc/Publisher.h"
+#include "dabc/Url.h"
+
 http::Civetweb::Civetweb(const std::string &name, dabc::Command cmd) :
    http::Server(name, cmd),
    fHttpPort(),
@@ -40,6 +43,8 @@ http::Civetweb::Civetweb(const std::string &name, dabc::Command cmd) :
    if (!fSslCertif.empty() && fHttpsPort.empty()) fHttpsPort = "443";
    if (fSslCertif.empty()) fHttpsPort.clear();
 
+   fWsMaxRate = Cfg("ws_maxrate", cmd).AsDouble(2.);
+
    memset(&fCallbacks, 0, sizeof(fCallbacks));
 }
 
@@ -104,9 +109,320 @@ void http::Civetweb::OnThreadAssigned()
 
    mg_set_request_handler(fCtx, "/", http::Civetweb::begin_request_handler, nullptr);
 
+   if (fCtx && (fWsMaxRate > 0))
+      mg_set_websocket_handler(fCtx, "/ws", http::Civetweb::ws_connect_handler, http::Civetweb::ws_ready_handler,
+                               http::Civetweb::ws_data_handler, http::Civetweb::ws_close_handler, this);
+
    if (!fCtx) EOUT("Fail to start civetweb on port %s", sport.c_str());
 }
 
+void http::Civetweb::ConfigureWsClient(WsClient &client, const char *query)
+{
+   std::string opt = query ? query : "";
+   dabc::Url::ReplaceSpecialSymbols(opt);
+
+   double rate = fWsMaxRate;
+   std::vector<std::string> items;
+
+   while (!opt.empty()) {
+      std::size_t separ = opt.find("&");
+      if (separ == std::string::npos) separ = opt.length();
+      std::string part = opt.substr(0, separ);
+      opt.erase(0, separ+1);
+
+      if (part.find("items=") == 0) {
+         dabc::RecordField field(part.substr(6));
+         items = field.AsStrVect();
+      } else if (part.find("rate=") == 0) {
+         if (!dabc::str_to_double(part.c_str() + 5, &rate)) rate = fWsMaxRate;
+      }
+   }
+
+   if ((rate <= 0) || (rate > fWsMaxRate)) rate = fWsMaxRate;
+   client.fPeriod = 1./rate;
+
+   // pending changes preserved for items which remain subscribed
+   std::map<std::string, WsPending> newitems;
+   for (auto name : items) {
+      while ((name.length() > 1) && (name.back() == '/')) name.pop_back();
+      if (name.empty()) continue;
+      if (name[0] != '/') name.insert(0, "/");
+      auto iter = client.fItems.find(name);
+      if (iter != client.fItems.end())
+         newitems[name] = iter->second;
+      else
+         newitems[name].fFull = true;
+   }
+   client.fItems.swap(newitems);
+}
+
+double http::Civetweb::ProcessTimeout(double)
+{
+   dabc::LockGuard lock(fWsMutex);
+   return ProcessWsClients();
+}
+
+void *http::Civetweb::WsWriterFunc(void *arg)
+{
+   WsClient *client = (WsClient *) arg;
+
+   std::string msg;
+
+   while (true) {
+      {
+         dabc::LockGuard lock(client->fServer->fWsMutex);
+         client->fWriting = false;
+         while (!client->fStop && client->fMsg.empty())
+            client->fCond._DoWait(-1);
+         if (client->fStop) break;
+         msg.swap(client->fMsg);
+         client->fWriting = true;
+      }
+
+      // write may block on slow client, therefore done without lock
+      mg_websocket_write(client->fConn, MG_WEBSOCKET_OPCODE_TEXT, msg.c_str(), msg.length());
+      msg.clear();
+   }
+
+   return nullptr;
+}
+
+/** Returns string, which can be placed in JSON in quotes */
+static std::string WsJsonStr(const std::string &str)
+{
+   return dabc::RecordField::NeedJsonReformat(str) ? dabc::RecordField::JsonReformat(str) : str;
+}
+
+double http::Civetweb::ProcessWsClients()
+{
+   std::set<std::string> required;
+   for (auto &client : fWsClients)
+      for (auto &entry : client.fItems)
+         required.insert(entry.first);
+
+   // items which are no longer required removed, next push from publisher will be rejected
+   for (auto iter = fWsItems.begin(); iter != fWsItems.end();)
+      if (required.find(iter->first) == required.end())
+         iter = fWsItems.erase(iter);
+      else
+         iter++;
+
+   dabc::WorkerRef publ = GetPublisher();
+
+   for (auto &name : required) {
+      WsItem &item = fWsItems[name];
+
+      if (item.fSubId > 0) {
+         // subscription is active while publisher sends updates
+         if (!item.fLastUpdate.Expired(3*fWsKeepAlive)) continue;
+         EOUT("No updates for item %s, subscribe again", name.c_str());
+      } else if (!item.fSubscribeTm.null() && !item.fSubscribeTm.Expired(2.)) {
+         // do not repeat failed subscription too often
+         continue;
+      }
+
+      if (publ.null()) break;
+
+      item.fSubId = ++fWsSubCnt;
+      item.fVersion = 0;
+      item.fSubscribeTm.GetNow();
+      item.fLastUpdate.GetNow();
+
+      dabc::CmdSubscribeDiff subcmd(name, WorkerAddress(true), item.fSubId, 1./fWsMaxRate, fWsKeepAlive);
+      subcmd.SetTimeout(10);
+      publ.Submit(Assign(subcmd));
+   }
+
+   double tmout = fWsClients.empty() ? -1. : 1.;
+
+   for (auto &client : fWsClients) {
+      // previous message not yet written, changes remain pending
+      if (client.fStop || client.fWriting || !client.fMsg.empty()) {
+         if (client.fPeriod < tmout) tmout = client.fPeriod;
+         continue;
+      }
+
+      double spent = client.fLastSend.SpentTillNow();
+      if (!client.fLastSend.null() && (spent < client.fPeriod)) {
+         if (client.fPeriod - spent < tmout) tmout = client.fPeriod - spent;
+         continue;
+      }
+
+      std::string msg;
+
+      for (auto &entry : client.fItems) {
+         WsPending &pend = entry.second;
+
+         if (pend.fFull) {
+            auto iter = fWsItems.find(entry.first);
+            // item hierarchy not yet delivered
+            if ((iter == fWsItems.end()) || (iter->second.fVersion == 0)) continue;
+            pend.fChanges = iter->second.fNodes;
+            pend.fRemoved.clear();
+         } else if (pend.fChanges.empty() && pend.fRemoved.empty()) {
+            continue;
+         }
+
+         msg.append(msg.empty() ? "[" : ",");
+         msg.append(dabc::format("{\"_path\":\"%s\",\"_full\":%s,\"_changes\":{", WsJsonStr(entry.first).c_str(), pend.fFull ? "true" : "false"));
+         bool first = true;
+         for (auto &chng : pend.fChanges) {
+            if (!first) msg.append(",");
+            first = false;
+            msg.append("\"");
+            msg.append(WsJsonStr(chng.first));
+            msg.append("\":");
+            msg.append(chng.second);
+         }
+         msg.append("},\"_removed\":[");
+         first = true;
+         for (auto &rem : pend.fRemoved) {
+            if (!first) msg.append(",");
+            first = false;
+            msg.append("\"");
+            msg.append(WsJsonStr(rem));
+            msg.append("\"");
+         }
+         msg.append("]}");
+
+         pend.fFull = false;
+         pend.fChanges.clear();
+         pend.fRemoved.clear();
+      }
+
+      if (msg.empty()) continue;
+
+      msg.append("]");
+
+      client.fMsg = std::move(msg);
+      client.fCond._DoFire();
+      client.fLastSend.GetNow();
+      if (client.fPeriod < tmout) tmout = client.fPeriod;
+   }
+
+   return tmout;
+}
+
+/** Collect JSON of all nodes, nodes marked with version after prevver are checked for changes */
+static void CollectWsNodes(dabc::Hierarchy node, const std::string &path, uint64_t prevver,
+                           std::map<std::string, std::string> &prev,
+                           std::map<std::string, std::string> &res,
+                           std::map<std::string, std::string> &changes)
+{
+   auto iter = prev.find(path);
+
+   if ((iter == prev.end()) || (node.GetVersion() > prevver)) {
+      std::string json = node.SaveToJson(dabc::storemask_Compact | dabc::storemask_NoChilds);
+      if ((iter == prev.end()) || (iter->second != json))
+         changes[path] = json;
+      res[path] = json;
+   } else {
+      res[path] = iter->second;
+   }
+
+   for (unsigned n = 0; n < node.NumChilds(); n++) {
+      dabc::Hierarchy child = node.GetChild(n);
+      CollectWsNodes(child, path.empty() ? child.GetName() : path + "/" + child.GetName(), prevver, prev, res, changes);
+   }
+}
+
+int http::Civetweb::ApplyWsDiff(dabc::Command cmd)
+{
+   int subid = cmd.GetInt("SubId");
+
+   auto iter = fWsItems.begin();
+   while ((iter != fWsItems.end()) && (iter->second.fSubId != subid)) iter++;
+
+   // item no longer required
+   if (iter == fWsItems.end()) return dabc::cmd_false;
+
+   WsItem &item = iter->second;
+
+   if (cmd.GetUInt("BaseVersion") != item.fVersion) {
+      EOUT("Item %s version mismatch, subscribe again", iter->first.c_str());
+      item.fSubId = 0;
+      return dabc::cmd_false;
+   }
+
+   item.fLastUpdate.GetNow();
+
+   dabc::Buffer diff = cmd.GetRawData();
+   if (diff.null()) return dabc::cmd_true;
+
+   if (item.fVersion == 0) {
+      item.fMirror.Release();
+      item.fMirror.Create(iter->first.substr(iter->first.rfind("/") + 1));
+      item.fNodes.clear();
+   }
+
+   // all changed nodes will be marked with version after prevver
+   uint64_t prevver = item.fMirror.GetVersion();
+
+   if (!item.fMirror.UpdateFromBuffer(diff)) {
+      EOUT("Fail to apply diff for item %s", iter->first.c_str());
+      item.fSubId = 0;
+      item.fVersion = 0;
+      return dabc::cmd_false;
+   }
+
+   item.fVersion = cmd.GetUInt("Version");
+
+   std::map<std::string, std::string> nodes, changes;
+   std::set<std::string> removed;
+
+   CollectWsNodes(item.fMirror, "", prevver, item.fNodes, nodes, changes);
+   for (auto &entry : item.fNodes)
+      if (nodes.find(entry.first) == nodes.end())
+         removed.insert(entry.first);
+   item.fNodes.swap(nodes);
+
+   if (changes.empty() && removed.empty()) return dabc::cmd_true;
+
+   dabc::LockGuard lock(fWsMutex);
+
+   for (auto &client : fWsClients) {
+      auto piter = client.fItems.find(iter->first);
+      if ((piter == client.fItems.end()) || piter->second.fFull) continue;
+
+      WsPending &pend = piter->second;
+      for (auto &chng : changes) {
+         pend.fChanges[chng.first] = chng.second;
+         pend.fRemoved.erase(chng.first);
+      }
+      for (auto &rem : removed) {
+         pend.fChanges.erase(rem);
+         pend.fRemoved.insert(rem);
+      }
+   }
+
+   ActivateTimeout(0.);
+
+   return dabc::cmd_true;
+}
+
+int http::Civetweb::ExecuteCommand(dabc::Command cmd)
+{
+   if (cmd.IsName(dabc::CmdPushDiff::CmdName()))
+      return ApplyWsDiff(cmd);
+
+   return http::Server::ExecuteCommand(cmd);
+}
+
+bool http::Civetweb::ReplyCommand(dabc::Command cmd)
+{
+   if (cmd.IsName(dabc::CmdSubscribeDiff::CmdName())) {
+      if (cmd.GetResult() != dabc::cmd_true)
+         for (auto &entry : fWsItems)
+            if (entry.second.fSubId == cmd.GetInt("SubId")) {
+               DOUT2("Fail to subscribe item %s", entry.first.c_str());
+               entry.second.fSubId = 0;
+            }
+      return true;
+   }
+
+   return http::Server::ReplyCommand(cmd);
+}
+
 int http::Civetweb::log_message_handler(const struct mg_connection *conn, const char *message)
 {
    //const struct mg_context *ctx = mg_get_context(conn);
@@ -119,6 +435,131 @@ int http::Civetweb::log_message_handler(const struct mg_connection *conn, const
 }
 
 
+/** Sink to send compressed data as single chunk */
+static bool civetweb_chunk_sink(void *arg, const void *buf, size_t sz)
+{
+   return mg_send_chunk((struct mg_connection *) arg, (const char *) buf, sz) > 0;
+}
+
+void http::Civetweb::SendStaticFile(struct mg_connection *conn, const std::string &fname)
+{
+   std::string content, etag;
+   bool zipped = false;
+
+   const char *mime_type = http::Server::GetMimeType(fname.c_str());
+
+   if (!GetStaticFile(fname, AcceptGzip(mg_get_header(conn, "Accept-Encoding")), content, zipped, etag)) {
+      // file not cached, let civetweb deliver it
+      mg_send_mime_file(conn, fname.c_str(), mime_type);
+      return;
+   }
+
+   const char *inm = mg_get_header(conn, "If-None-Match");
+   if (inm && (etag == inm)) {
+      mg_printf(conn, "HTTP/1.1 304 Not Modified\r\n"
+                      "ETag: %s\r\n"
+                      "Content-Length: 0\r\n"
+                      "Connection: keep-alive\r\n\r\n",
+                      etag.c_str());
+      return;
+   }
+
+   mg_printf(conn,
+             "HTTP/1.1 200 OK\r\n"
+             "Content-Type: %s\r\n"
+             "%s"
+             "Vary: Accept-Encoding\r\n"
+             "ETag: %s\r\n"
+             "Content-Length: %u\r\n"
+             "Connection: keep-alive\r\n"
+             "\r\n",
+             mime_type,
+             zipped ? "Content-Encoding: gzip\r\n" : "",
+             etag.c_str(),
+             (unsigned) content.length());
+   mg_write(conn, content.data(), content.length());
+}
+
+int http::Civetweb::ws_connect_handler(const struct mg_connection *, void *arg)
+{
+   http::Civetweb *server = (http::Civetweb *) arg;
+
+   dabc::LockGuard lock(server->fWsMutex);
+
+   // every websocket occupies civetweb thread, keep two threads for normal requests
+   // with default thrds=5 only 3 websocket clients are accepted
+   if ((int) server->fWsClients.size() + 2 >= server->fNumThreads) {
+      EOUT("Too many websocket clients %u, increase thrds parameter", (unsigned) server->fWsClients.size());
+      return 1;
+   }
+
+   return 0;
+}
+
+void http::Civetweb::ws_ready_handler(struct mg_connection *conn, void *arg)
+{
+   http::Civetweb *server = (http::Civetweb *) arg;
+   const struct mg_request_info *request_info = mg_get_request_info(conn);
+
+   {
+      dabc::LockGuard lock(server->fWsMutex);
+      server->fWsClients.emplace_back(server);
+      WsClient &client = server->fWsClients.back();
+      client.fConn = conn;
+      server->ConfigureWsClient(client, request_info ? request_info->query_string : nullptr);
+      client.fThrd.Start(http::Civetweb::WsWriterFunc, &client);
+      client.fThrd.SetThreadName("WsWriter");
+   }
+
+   DOUT2("New websocket client query %s", request_info && request_info->query_string ? request_info->query_string : "");
+
+   server->ActivateTimeout(0.);
+}
+
+int http::Civetweb::ws_data_handler(struct mg_connection *conn, int bits, char *data, size_t len, void *arg)
+{
+   http::Civetweb *server = (http::Civetweb *) arg;
+
+   int opcode = bits & 0xf;
+   if (opcode == MG_WEBSOCKET_OPCODE_CONNECTION_CLOSE) return 0;
+   if ((opcode != MG_WEBSOCKET_OPCODE_TEXT) || !data) return 1;
+
+   std::string query(data, len);
+
+   {
+      dabc::LockGuard lock(server->fWsMutex);
+      for (auto &client : server->fWsClients)
+         if (client.fConn == conn)
+            server->ConfigureWsClient(client, query.c_str());
+   }
+
+   server->ActivateTimeout(0.);
+
+   return 1;
+}
+
+void http::Civetweb::ws_close_handler(const struct mg_connection *conn, void *arg)
+{
+   http::Civetweb *server = (http::Civetweb *) arg;
+
+   std::list<WsClient>::iterator iter;
+
+   {
+      dabc::LockGuard lock(server->fWsMutex);
+      iter = server->fWsClients.begin();
+      while ((iter != server->fWsClients.end()) && (iter->fConn != conn)) iter++;
+      if (iter == server->fWsClients.end()) return;
+      iter->fStop = true;
+      iter->fCond._DoFire();
+   }
+
+   // wait until writer thread completes last message
+   iter->fThrd.Join();
+
+   dabc::LockGuard lock(server->fWsMutex);
+   server->fWsClients.erase(iter);
+}
+
 int http::Civetweb::begin_request_handler(struct mg_connection *conn, void* )
 {
    const struct mg_request_info *request_info = mg_get_request_info(conn);
@@ -130,24 +571,46 @@ int http::Civetweb::begin_request_handler(struct mg_connection *conn, void* )
    std::string filename;
 
    if (server->IsFileRequested(request_info->local_uri, filename)) {
-      const char *mime_type = http::Server::GetMimeType(filename.c_str());
-      if (mime_type)
-         mg_send_mime_file(conn, filename.c_str(), mime_type);
-      else
-         mg_send_file(conn, filename.c_str());
+      server->SendStaticFile(conn, filename);
       return 1;
    }
 
    std::string content_type, content_header, content_str;
    dabc::Buffer content_bin;
+   bool stream_gzip = false;
 
    if (!server->Process(request_info->local_uri, request_info->query_string,
-                        content_type, content_header, content_str, content_bin)) {
+                        content_type, content_header, content_str, content_bin,
+                        mg_get_header(conn, "If-None-Match"), mg_get_header(conn, "Accept-Encoding"), &stream_gzip)) {
       mg_printf(conn, "HTTP/1.1 404 Not Found\r\n"
                       "Content-Length: 0\r\n"
                       "Connection: close\r\n\r\n");
+   } else if (content_type=="__notmodified__") {
+      mg_printf(conn, "HTTP/1.1 304 Not Modified\r\n"
+                      "%s"
+                      "Content-Length: 0\r\n"
+                      "Connection: keep-alive\r\n\r\n",
+                      content_header.c_str());
    } else if (content_type=="__file__") {
-      mg_send_file(conn, content_str.c_str());
+      server->SendStaticFile(conn, content_str);
+   } else if (stream_gzip) {
+      // content compressed while sending, size is not known in advance
+      mg_printf(conn,
+                "HTTP/1.1 200 OK\r\n"
+                "Content-Type: %s\r\n"
+                "%s"
+                "Transfer-Encoding: chunked\r\n"
+                "Connection: keep-alive\r\n"
+                "\r\n",
+                content_type.c_str(),
+                content_header.c_str());
+
+      bool ok = content_bin.null() ? StreamGzip(content_str.c_str(), content_str.length(), civetweb_chunk_sink, conn)
+                                   : StreamGzip(content_bin.SegmentPtr(), content_bin.GetTotalSize(), civetweb_chunk_sink, conn);
+      if (ok)
+         mg_send_chunk(conn, "", 0);
+      else
+         EOUT("Fail to send compressed reply for %s", request_info->local_uri);
    } else if (!content_bin.null()) {
       mg_printf(conn,
                 "HTTP/1.1 200 OK\r\n"
@@ -85,6 +85,12 @@ void FCGX_DABC_send_file(FCGX_Request* request, const char *fname)
 
 
 
+/** Sink to write compressed data into fastcgi stream */
+bool FCGX_DABC_sink(void *arg, const void *buf, size_t sz)
+{
+   return FCGX_PutStr((const char *) buf, (int) sz, (FCGX_Stream *) arg) == (int) sz;
+}
+
 #endif
 
 
@@ -217,22 +223,76 @@ void* http::FastCgi::RunFunc(void* args)
 
       std::string content_type, content_header, content_str;
       dabc::Buffer content_bin;
+      bool stream_gzip = false;
+
+      const char *accept_encoding = FCGX_GetParam("HTTP_ACCEPT_ENCODING", request.envp);
+
+      // static files delivered from memory cache when possible
+      auto send_file = [server, &request, accept_encoding](const std::string &fname) {
+         std::string content, etag;
+         bool zipped = false;
+         if (!server->GetStaticFile(fname, AcceptGzip(accept_encoding), content, zipped, etag)) {
+            FCGX_DABC_send_file(&request, fname.c_str());
+            return;
+         }
+         const char *inm = FCGX_GetParam("HTTP_IF_NONE_MATCH", request.envp);
+         if (inm && (etag == inm)) {
+            FCGX_FPrintF(request.out, "Status: 304 Not Modified\r\n"
+                                      "ETag: %s\r\n"
+                                      "Content-Length: 0\r\n\r\n", etag.c_str());
+            return;
+         }
+         FCGX_FPrintF(request.out,
+                "Status: 200 OK\r\n"
+                "Content-Type: %s\r\n"
+                "%s"
+                "Vary: Accept-Encoding\r\n"
+                "ETag: %s\r\n"
+                "Content-Length: %d\r\n"
+                "\r\n", http::Server::GetMimeType(fname.c_str()), zipped ? "Content-Encoding: gzip\r\n" : "", etag.c_str(), (int) content.length());
+         FCGX_PutStr(content.data(), content.length(), request.out);
+      };
 
       if (server->IsFileRequested(inp_path, content_str)) {
-         FCGX_DABC_send_file(&request, content_str.c_str());
+         send_file(content_str);
          FCGX_Finish_r(&request);
          continue;
       }
 
       if (!server->Process(inp_path, inp_query,
-                           content_type, content_header, content_str, content_bin)) {
+                           content_type, content_header, content_str, content_bin,
+                           FCGX_GetParam("HTTP_IF_NONE_MATCH", request.envp), accept_encoding, &stream_gzip)) {
          FCGX_FPrintF(request.out, "Status: 404 Not Found\r\n"
                                    "Content-Length: 0\r\n"
                                    "Connection: close\r\n\r\n");
       } else
 
+      if (content_type=="__notmodified__") {
+         FCGX_FPrintF(request.out, "Status: 304 Not Modified\r\n"
+                                   "%s"
+                                   "Content-Length: 0\r\n"
+                                   "Connection: keep-alive\r\n\r\n",
+                                   content_header.c_str());
+      } else
+
       if (content_type=="__file__") {
-         FCGX_DABC_send_file(&request, content_str.c_str());
+         send_file(content_str);
+      } else
+
+      if (stream_gzip) {
+         // web server takes care about chunked transfer to the client
+         FCGX_FPrintF(request.out,
+                  "Status: 200 OK\r\n"
+                  "Content-Type: %s\r\n"
+                  "%s"
+                  "\r\n",
+                  content_type.c_str(),
+                  content_header.c_str());
+
+         if (content_bin.null())
+            StreamGzip(content_str.c_str(), content_str.length(), FCGX_DABC_sink, request.out);
+         else
+            StreamGzip(content_bin.SegmentPtr(), content_bin.GetTotalSize(), FCGX_DABC_sink, request.out);
       } else
 
       if (!content_bin.null()) {
@@ -17,10 +17,13 @@
 
 #include <cstring>
 #include <cstdlib>
+#include <cstdio>
+#include <sys/stat.h>
 
 #include "dabc/Configuration.h"
 #include "dabc/Url.h"
 #include "dabc/Publisher.h"
+#include "dabc/Metrics.h"
 
 #ifndef DABC_WITHOUT_ZLIB
 #include "zlib.h"
@@ -98,6 +101,98 @@ const char *http::Server::GetMimeType(const char *path)
    return "text/plain";
 }
 
+bool http::Server::IsCompressible(const std::string &content_type)
+{
+   if (content_type.find("image/") == 0) return content_type == "image/svg+xml";
+
+   if ((content_type.find("audio/") == 0) || (content_type.find("video/") == 0)) return false;
+
+   return (content_type.find("zip") == std::string::npos) && (content_type.find("compressed") == std::string::npos);
+}
+
+bool http::Server::AcceptGzip(const char *accept_encoding)
+{
+#ifdef DABC_WITHOUT_ZLIB
+   (void) accept_encoding;
+   return false;
+#else
+   if (!accept_encoding) return false;
+
+   const char *pos = strstr(accept_encoding, "gzip");
+   if (!pos) return false;
+
+   // gzip can be explicitly disabled with "gzip;q=0"
+   pos += 4;
+   while (*pos == ' ') pos++;
+   if (*pos != ';') return true;
+   pos++;
+   while (*pos == ' ') pos++;
+   if (strncmp(pos, "q=", 2) != 0) return true;
+
+   return strtod(pos + 2, nullptr) > 0.;
+#endif
+}
+
+bool http::Server::StreamGzip(const void *src, size_t len, bool (*sink)(void *arg, const void *buf, size_t sz), void *arg)
+{
+#ifdef DABC_WITHOUT_ZLIB
+   (void) src; (void) len; (void) sink; (void) arg;
+   return false;
+#else
+   z_stream strm;
+   memset(&strm, 0, sizeof(strm));
+
+   // window bits 15 + 16 produces gzip header and trailer
+   if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+      return false;
+
+   unsigned char out[0x4000];
+   const unsigned char *ptr = (const unsigned char *) src;
+   bool res = true;
+   int flush = Z_NO_FLUSH, ret = Z_OK;
+
+   do {
+      // feed input in portions, zlib counter is only 32-bit
+      if ((strm.avail_in == 0) && (flush != Z_FINISH)) {
+         size_t portion = len > 0x100000 ? 0x100000 : len;
+         strm.next_in = (Bytef *) ptr;
+         strm.avail_in = portion;
+         ptr += portion;
+         len -= portion;
+         if (len == 0) flush = Z_FINISH;
+      }
+
+      strm.next_out = out;
+      strm.avail_out = sizeof(out);
+
+      ret = deflate(&strm, flush);
+      if (ret == Z_STREAM_ERROR) { res = false; break; }
+
+      size_t have = sizeof(out) - strm.avail_out;
+      if ((have > 0) && !sink(arg, out, have)) { res = false; break; }
+
+   } while (ret != Z_STREAM_END);
+
+   deflateEnd(&strm);
+
+   return res;
+#endif
+}
+
+/** Sink function to collect compressed data in string */
+static bool http_string_sink(void *arg, const void *buf, size_t sz)
+{
+   ((std::string *) arg)->append((const char *) buf, sz);
+   return true;
+}
+
+bool http::Server::CompressGzip(const void *src, size_t len, std::string &res)
+{
+   res.clear();
+   res.reserve(len / 3 + 64);
+   return StreamGzip(src, len, http_string_sink, &res);
+}
+
 
 http::Server::Server(const std::string &server_name, dabc::Command cmd) :
    dabc::Worker(MakePair(server_name)),
@@ -156,6 +251,11 @@ http::Server::Server(const std::string &server_name, dabc::Command cmd) :
    fDrawItem = Cfg("DrawItem", cmd).AsStr("");
    fDrawOpt = Cfg("DrawOpt", cmd).AsStr("");
    fMonitoring = Cfg("Monitoring", cmd).AsInt(0);
+
+   fCacheSize = Cfg("cachesize", cmd).AsUInt(1000);
+   fCacheId = (unsigned) dabc::DateTime().GetNow().AsJSDate();
+
+   fStaticLimit = Cfg("staticcache", cmd).AsUInt(64) * 0x100000LU;
 }
 
 http::Server::~Server()
@@ -266,11 +366,125 @@ bool http::Server::IsAuthRequired(const char *uri)
    return res > 0;
 }
 
+bool http::Server::GetStaticFile(const std::string &fname, bool gzip, std::string &content, bool &zipped, std::string &etag)
+{
+   zipped = false;
+
+   if (fStaticLimit == 0) return false;
+
+   struct stat st;
+   if ((stat(fname.c_str(), &st) != 0) || !S_ISREG(st.st_mode)) return false;
+
+   // single file should not occupy more than quarter of cache
+   if ((uint64_t) st.st_size * 4 > fStaticLimit) return false;
+
+   {
+      dabc::LockGuard lock(fCacheMutex);
+      auto iter = fStatic.find(fname);
+      if ((iter != fStatic.end()) && (iter->second.fMTime == (long) st.st_mtime) && (iter->second.fData.length() == (size_t) st.st_size)) {
+         zipped = gzip && !iter->second.fZipped.empty();
+         content = zipped ? iter->second.fZipped : iter->second.fData;
+         etag = dabc::format("\"%lx.%lx%s\"", (long unsigned) st.st_mtime, (long unsigned) st.st_size, zipped ? "z" : "");
+         return true;
+      }
+   }
+
+   // file read and compressed without lock, other threads may do the same
+   FILE *f = fopen(fname.c_str(), "r");
+   if (!f) return false;
+
+   StaticEntry entry;
+   entry.fMTime = st.st_mtime;
+   entry.fData.resize(st.st_size);
+   size_t rd = st.st_size > 0 ? fread(&entry.fData[0], 1, st.st_size, f) : 0;
+   fclose(f);
+   if (rd != (size_t) st.st_size) return false;
+
+   if ((entry.fData.length() >= 512) && IsCompressible(GetMimeType(fname.c_str())) &&
+       CompressGzip(entry.fData.data(), entry.fData.length(), entry.fZipped)) {
+      // keep compressed content only when it gives benefit
+      if (entry.fZipped.length() > entry.fData.length() * 0.9) entry.fZipped.clear();
+      entry.fZipped.shrink_to_fit();
+   }
+
+   zipped = gzip && !entry.fZipped.empty();
+   content = zipped ? entry.fZipped : entry.fData;
+   etag = dabc::format("\"%lx.%lx%s\"", (long unsigned) st.st_mtime, (long unsigned) st.st_size, zipped ? "z" : "");
+
+   dabc::LockGuard lock(fCacheMutex);
+
+   uint64_t sz = entry.fData.length() + entry.fZipped.length();
+
+   auto iter = fStatic.find(fname);
+   if (iter != fStatic.end()) {
+      fStaticSize -= iter->second.fData.length() + iter->second.fZipped.length();
+      fStatic.erase(iter);
+   }
+
+   // static files are not changing, simply stop caching when limit is reached
+   if (fStaticSize + sz <= fStaticLimit) {
+      fStaticSize += sz;
+      fStatic[fname] = std::move(entry);
+   }
+
+   return true;
+}
+
+bool http::Server::GetCached(const std::string &key, uint64_t version, bool zipped, std::string& content_type, std::string& content_str, dabc::Buffer& content_bin)
+{
+   dabc::LockGuard lock(fCacheMutex);
+
+   auto iter = fCache.find(key);
+   if ((iter == fCache.end()) || (iter->second.fVersion != version)) return false;
+
+   content_type = iter->second.fContentType;
+   if (zipped && !iter->second.fZipped.empty())
+      content_bin = dabc::Buffer::CreateBuffer(iter->second.fZipped.data(), iter->second.fZipped.length(), false, true);
+   else
+      content_str = iter->second.fData;
+   iter->second.fLastUsed.GetNow();
+
+   return true;
+}
+
+void http::Server::SetCached(const std::string &key, uint64_t version, bool zipped, const std::string& content_type, const std::string& content_str, dabc::Buffer& content_bin)
+{
+   dabc::LockGuard lock(fCacheMutex);
+
+   if ((fCache.size() >= fCacheSize) && (fCache.find(key) == fCache.end())) {
+      // first remove entries which were not used recently
+      for (auto iter = fCache.begin(); iter != fCache.end();)
+         if (iter->second.fLastUsed.Expired(60.))
+            iter = fCache.erase(iter);
+         else
+            iter++;
+      if (fCache.size() >= fCacheSize) fCache.clear();
+   }
+
+   CacheEntry &entry = fCache[key];
+   if (entry.fVersion != version) {
+      entry.fVersion = version;
+      entry.fData.clear();
+      entry.fZipped.clear();
+   }
+   entry.fContentType = content_type;
+   entry.fLastUsed.GetNow();
+
+   std::string &data = zipped ? entry.fZipped : entry.fData;
+   if (!content_bin.null())
+      data.assign((const char *) content_bin.SegmentPtr(), content_bin.SegmentSize());
+   else
+      data = content_str;
+}
+
 bool http::Server::Process(const char *uri, const char *_query,
                            std::string& content_type,
                            std::string& content_header,
                            std::string& content_str,
-                           dabc::Buffer& content_bin)
+                           dabc::Buffer& content_bin,
+                           const char *etag,
+                           const char *accept_encoding,
+                           bool *stream_gzip)
 {
 
    std::string pathname, filename, query;
@@ -336,14 +550,24 @@ bool http::Server::Process(const char *uri, const char *_query,
 
    if (filename.empty()) return false;
 
-   bool iszipped = false;
+   bool iszipped = false, zipready = false;
 
    if ((filename.length() > 3) && (filename.rfind(".gz") == filename.length()-3)) {
       filename.resize(filename.length()-3);
       iszipped = true;
    }
 
-   if ((filename == "h.xml") || (filename == "h.json")) {
+   // responses for items with version can be cached, producer renders them only when item is changed
+   std::string cachekey;
+   uint64_t version = 0;
+
+   if ((filename == "metrics") && (pathname == "/")) {
+
+      // values taken from metrics slots, neither publisher nor modules are involved
+      content_type = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+      content_str = dabc::Metrics::FormatOpenMetrics();
+
+   } else if ((filename == "h.xml") || (filename == "h.json")) {
 
       bool isxml = (filename == "h.xml");
 
@@ -360,9 +584,8 @@ bool http::Server::Process(const char *uri, const char *_query,
       if (fMonitoring >= 100)
          cmd.AddHeader("_monitoring", std::to_string(fMonitoring), false);
 
-      dabc::WorkerRef wrk = GetPublisher();
-
-      if (wrk.Execute(cmd) != dabc::cmd_true)
+      // names list normally produced from publisher snapshot directly in the http thread
+      if (dabc::PublisherRef(GetPublisher()).ExecuteNamesList(cmd) != dabc::cmd_true)
          return false;
 
       content_str = cmd.GetStr("astext");
@@ -389,46 +612,91 @@ bool http::Server::Process(const char *uri, const char *_query,
          DOUT3("MULTIGET path %s items=%s rest:%s", pathname.c_str(), items.c_str(), opt.c_str());
 
          dabc::RecordField field(items);
-         std::vector<std::string> arr = field.AsStrVect();
 
-         content_str="[";
+         // all items requested by publisher concurrently, unchanged items are taken from its cache
+         dabc::CmdMultiGet cmd(pathname, field.AsStrVect(), opt);
+         cmd.SetTimeout(fTimeout);
+
          dabc::WorkerRef ref = GetPublisher();
 
-         for (unsigned n=0;n<arr.size();n++) {
-            if (n>0) content_str.append(",");
+         if (ref.Execute(cmd) == dabc::cmd_true)
+            content_bin = cmd.GetRawData();
 
-            dabc::CmdGetBinary cmd(pathname+arr[n], "get.json", opt);
-            cmd.SetTimeout(fTimeout);
+         if (content_bin.null())
+            content_str = "null";
 
-            if (ref.Execute(cmd) == dabc::cmd_true)
-               content_bin = cmd.GetRawData();
+      } else {
+         content_str = "null";
+      }
 
-            content_str.append(dabc::format("{ \"item\": \"%s\", \"result\":", arr[n].c_str()));
+   } else if (filename == "serie.json") {
 
-            if (content_bin.null())
-               content_str.append("null");
-            else
-               content_str.append((const char*) content_bin.SegmentPtr(), content_bin.SegmentSize());
+      // values from time index of hierarchy store, time in JS milliseconds or last seconds
+      content_type = "application/json";
 
-            content_str.append("}");
+      dabc::Url url;
+      url.SetOptions(query);
 
-            content_bin.Release();
-         }
+      uint64_t till = (uint64_t) url.GetOptionDouble("till", 0.),
+               from = (uint64_t) url.GetOptionDouble("from", 0.);
 
-         content_str.append("]");
+      double last = url.GetOptionDouble("last", 0.);
+      if (last > 0)
+         from = (till > 0 ? till : dabc::DateTime().GetNow().AsJSDate()) - (uint64_t) (last * 1000);
 
-      } else {
-         content_str = "null";
-      }
+      dabc::CmdGetSerie cmd(pathname, from, till, url.GetOptionInt("maxpoints", 0));
+      cmd.SetTimeout(fTimeout);
+
+      dabc::WorkerRef ref = GetPublisher();
+
+      if (ref.Execute(cmd) == dabc::cmd_true)
+         content_bin = cmd.GetRawData();
+
+      if (content_bin.null())
+         return false;
+
+   } else if (dabc::PublisherRef(GetPublisher()).GetItemReply(pathname, filename, query, content_str)) {
+
+      // reply produced in current thread from snapshot of hierarchy
+      content_type = GetMimeType(filename.c_str());
 
    } else {
 
+      bool cacheable = (fCacheSize > 0) &&
+                       ((filename == "get.json") || (filename == "value.json") || (filename == "item.json") ||
+                        (filename == "get.xml") || (filename == "dabc.json") || (filename == "dabc.xml"));
+
+      if (cacheable) {
+         cachekey = pathname + "/" + filename + "?" + query;
+         dabc::LockGuard lock(fCacheMutex);
+         auto iter = fCache.find(cachekey);
+         if (iter != fCache.end()) version = iter->second.fVersion;
+      }
+
       dabc::CmdGetBinary cmd(pathname, filename, query);
       cmd.SetTimeout(fTimeout);
+      if (cacheable) cmd.SetUInt("CacheVersion", version);
 
       dabc::WorkerRef ref = GetPublisher();
 
-      if (ref.Execute(cmd) == dabc::cmd_true) {
+      int res = ref.Execute(cmd);
+
+      if ((res == dabc::cmd_true) && cmd.GetBool("NotChanged")) {
+         if (GetCached(cachekey, version, iszipped || AcceptGzip(accept_encoding), content_type, content_str, content_bin)) {
+            zipready = !content_bin.null();
+            res = dabc::cmd_ignore;
+         } else {
+            // entry was removed meanwhile, request complete data
+            cmd = dabc::CmdGetBinary(pathname, filename, query);
+            cmd.SetTimeout(fTimeout);
+            cmd.SetUInt("CacheVersion", 0);
+            res = ref.Execute(cmd);
+         }
+      }
+
+      if (res == dabc::cmd_true) {
+         version = cacheable ? cmd.GetUInt("CacheVersion") : 0;
+
          content_type = cmd.GetStr("content_type");
 
          if (content_type.empty())
@@ -443,6 +711,11 @@ bool http::Server::Process(const char *uri, const char *_query,
          content_bin = cmd.GetRawData();
          if (content_bin.null())
             content_str = cmd.GetStr("StringReply");
+
+         if (version > 0)
+            SetCached(cachekey, version, false, content_type, content_str, content_bin);
+      } else if (res != dabc::cmd_ignore) {
+         version = 0;
       }
 
       // TODO: in some cases empty binary may be not an error
@@ -452,89 +725,66 @@ bool http::Server::Process(const char *uri, const char *_query,
       }
    }
 
-   if (iszipped) {
-#ifdef DABC_WITHOUT_ZLIB
-      DOUT0("It is requested to compress buffer, but ZLIB is not available!!!");
-#else
-
-      unsigned long objlen = 0;
-      Bytef* objptr = nullptr;
+   size_t content_len = content_bin.null() ? content_str.length() : content_bin.GetTotalSize();
 
-      if (!content_bin.null()) {
-         objlen = content_bin.GetTotalSize();
-         objptr = (Bytef*) content_bin.SegmentPtr();
-      } else {
-         objlen = content_str.length();
-         objptr = (Bytef*) content_str.c_str();
-      }
+   // compress when explicitly requested or negotiated with the client
+   bool negotiated = !iszipped && !zipready && AcceptGzip(accept_encoding);
+   bool dozip = iszipped || zipready || (negotiated && (content_len >= 512) && IsCompressible(content_type));
 
-      unsigned long objcrc = crc32(0, nullptr, 0);
-      objcrc = crc32(objcrc, objptr, objlen);
+#ifdef DABC_WITHOUT_ZLIB
+   if (dozip && !zipready) {
+      if (iszipped) DOUT0("It is requested to compress buffer, but ZLIB is not available!!!");
+      dozip = false;
+   }
+#endif
 
-      // reserve place for header plus space required for the target buffer
-      unsigned long zipbuflen = 18 + compressBound(objlen);
-      if (zipbuflen < 512) zipbuflen = 512;
-      void* zipbuf = std::malloc(zipbuflen);
+   if (version > 0) {
+      std::string tag = dabc::format("\"%x-%lu%s\"", fCacheId, (long unsigned) version, dozip ? "z" : "");
+      content_header.append(dabc::format("ETag: %s\r\n", tag.c_str()));
 
-      if (!zipbuf) {
-         EOUT("Fail to allocate %lu bytes memory !!!", zipbuflen);
+      // client already has same version of the item
+      if (etag && (tag == etag)) {
+         content_type = "__notmodified__";
+         content_str.clear();
+         content_bin.Release();
          return true;
       }
+   }
 
-      char *bufcur = (char*) zipbuf;
+   if (!iszipped && AcceptGzip(accept_encoding))
+      content_header.append("Vary: Accept-Encoding\r\n");
 
-      *bufcur++ = 0x1f;  // first byte of ZIP identifier
-      *bufcur++ = 0x8b;  // second byte of ZIP identifier
-      *bufcur++ = 0x08;  // compression method
-      *bufcur++ = 0x00;  // FLAG - empty, no any file names
-      *bufcur++ = 0;    // empty timestamp
-      *bufcur++ = 0;    //
-      *bufcur++ = 0;    //
-      *bufcur++ = 0;    //
-      *bufcur++ = 0;    // XFL (eXtra FLags)
-      *bufcur++ = 3;    // OS   3 means Unix
+   if (dozip)
+      content_header.append("Content-Encoding: gzip\r\n");
 
-      zipbuflen-=18; // ZIP cannot use header and footer
+   if (dozip && !zipready) {
+      if ((version == 0) && stream_gzip) {
+         // large dynamic content compressed by caller while sending
+         *stream_gzip = true;
+      } else {
+         std::string zipped;
+         if (!CompressGzip(content_bin.null() ? (const void *) content_str.c_str() : content_bin.SegmentPtr(), content_len, zipped)) {
+            EOUT("Fail to compress buffer with ZLIB");
+            return false;
+         }
 
-      // WORKAROUND - seems to be, compress places 2 bytes before and 4 bytes after the compressed buffer
+         DOUT3("Compress original object %lu into zip buffer %lu", (long unsigned) content_len, (long unsigned) zipped.length());
 
-      // int res = compress((Bytef*)bufcur, &zipbuflen, objptr, objlen);
-      // bufcur += zipbuflen;
+         content_bin = dabc::Buffer::CreateBuffer(zipped.data(), zipped.length(), false, true);
+         content_str.clear();
 
-      int res = compress((Bytef*)bufcur-2, &zipbuflen, objptr, objlen);
-      if (res!=Z_OK) {
-         EOUT("Fail to compress buffer with ZLIB");
-         std::free(zipbuf);
-         return true;
+         if (version > 0)
+            SetCached(cachekey, version, true, content_type, content_str, content_bin);
       }
-
-      *(bufcur-2) = 0;    // XFL (eXtra FLags)
-      *(bufcur-1) = 3;    // OS   3 means Unix
-
-      bufcur += (zipbuflen - 6);
-
-
-      *bufcur++ = objcrc & 0xff;    // CRC32
-      *bufcur++ = (objcrc >> 8) & 0xff;
-      *bufcur++ = (objcrc >> 16) & 0xff;
-      *bufcur++ = (objcrc >> 24) & 0xff;
-
-      *bufcur++ = objlen & 0xff;          // original data length
-      *bufcur++ = (objlen >> 8) & 0xff;
-      *bufcur++ = (objlen >> 16) & 0xff;
-      *bufcur++ = (objlen >> 24) & 0xff;
-
-      content_bin = dabc::Buffer::CreateBuffer(zipbuf, bufcur - (char*) zipbuf, true);
-      content_str.clear();
-
-      content_header.append("Content-Encoding: gzip\r\n");
-
-      DOUT3("Compress original object %lu into zip buffer %lu", objlen, zipbuflen);
-#endif
    }
 
-   // exclude caching of dynamic data
-   content_header.append("Cache-Control: private, no-cache, no-store, must-revalidate, max-age=0, proxy-revalidate, s-maxage=0\r\n");
+   if (version > 0) {
+      // browser may keep response, but always should revalidate it with ETag
+      content_header.append("Cache-Control: private, no-cache\r\n");
+   } else {
+      // exclude caching of dynamic data
+      content_header.append("Cache-Control: private, no-cache, no-store, must-revalidate, max-age=0, proxy-revalidate, s-maxage=0\r\n");
+   }
 
    return true;
 }
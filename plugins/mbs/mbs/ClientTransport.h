@@ -24,13 +24,25 @@
 #include "dabc/DataIO.h"
 #endif
 
+#ifndef DABC_timing
+#include "dabc/timing.h"
+#endif
+
 #ifndef MBS_MbsTypeDefs
 #include "mbs/MbsTypeDefs.h"
 #endif
 
+#include <deque>
+#include <vector>
+
 namespace mbs {
 
-   /** \brief Client transport for different kinds of MBS server */
+   /** \brief Client transport for different kinds of MBS server
+    *
+    * With stream server several requests can be kept in flight ("pipeline" url option).
+    * Server answers every request with separate buffer, therefore next buffer
+    * is transported over network while previous one is processed.
+    * Header of next buffer is received immediately after previous buffer. */
 
    class ClientTransport : public dabc::SocketIOAddon,
                            public dabc::DataInput {
@@ -55,6 +67,12 @@ namespace mbs {
             evReactivate
          };
 
+         enum ENextHeader {
+            nhNone,          // next header not requested
+            nhRecv,          // next header is receiving
+            nhReady          // next header received, but not yet processed
+         };
+
          mbs::TransportInfo   fServInfo; // data, send by transport server in the beginning
          EIOState             fState{ioInit};
          bool                 fSwapping{false};
@@ -69,6 +87,23 @@ namespace mbs {
 
          dabc::Buffer         fSpanBuffer;  //!< buffer rest, which should be copied and merged into next buffer
 
+         unsigned             fPipeline{1};      //!< maximal number of requests in flight
+         unsigned             fRequested{0};     //!< number of requests, not yet answered by server
+         unsigned             fReqQueued{0};     //!< number of requests, waiting to be sent
+         bool                 fReqSending{false}; //!< true when requests send operation is running
+         std::vector<char>    fReqBuf;           //!< buffer with several "GETEVT" requests
+         std::deque<dabc::TimeStamp> fReqTime;   //!< time when each outstanding request was issued
+
+         mbs::BufferHeader    fNextHeader;       //!< header of next buffer, received in advance
+         ENextHeader          fNextState{nhNone}; //!< state of next header
+
+         uint64_t             fStatCnt{0};       //!< number of answered requests
+         uint64_t             fStatDepth{0};     //!< sum of requests in flight when answer arrives
+         unsigned             fStatMaxDepth{0};  //!< maximal number of requests in flight
+         double               fStatRtt{0.};      //!< sum of request-response times
+         double               fStatMinRtt{0.};   //!< minimal request-response time
+         double               fStatMaxRtt{0.};   //!< maximal request-response time
+
 
          // this is part from SocketAddon
 
@@ -86,6 +121,11 @@ namespace mbs {
          void OnSocketError(int err, const std::string &info) override;
 
          void SubmitRequest();
+         void FillPipeline();
+         void SendRequests();
+         void HeaderArrived();
+         void StartNextHeader();
+         unsigned ProcessHeader();
          void MakeCallback(unsigned sz);
 
          unsigned ReadBufferSize();
@@ -95,7 +135,7 @@ namespace mbs {
 
       public:
 
-         ClientTransport(int fd, int kind);
+         ClientTransport(int fd, int kind, unsigned pipeline = 1);
          virtual ~ClientTransport();
 
          int Kind() const { return fKind; }
@@ -106,6 +146,7 @@ namespace mbs {
          unsigned Read_Start(dabc::Buffer& buf) override;
          unsigned Read_Complete(dabc::Buffer& buf) override;
          double Read_Timeout() override { return 0.1; }
+         bool Read_Stat(dabc::Command cmd) override;
 
    };
 
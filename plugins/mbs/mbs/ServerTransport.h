@@ -36,6 +36,10 @@
 #include "mbs/MbsTypeDefs.h"
 #endif
 
+#include <vector>
+#include <deque>
+#include <sys/uio.h>
+
 namespace mbs {
 
    /** \brief %Addon for output of server-side different kinds of MBS server */
@@ -70,9 +74,21 @@ namespace mbs {
          mbs::SubeventHeader   fSubHdr; // additional MBS subevent header (for non-MBS events)
          uint32_t              fEvCounter{0}; // special events counter
          uint32_t              fSubevId{0};  // full id of subevent
-         bool                  fHasExtraRequest = false;
+         unsigned              fExtraRequests{0}; // number of queued requests from stream client, each answered with separate buffer
          bool                  fLegacyFormat = false;
 
+         /** \brief Headers, produced for every non-MBS event, sent as single piece */
+         struct EvHeaders {
+            mbs::EventHeader    ev;
+            mbs::SubeventHeader sub;
+         };
+
+         unsigned                  fEventsBatch{1};  ///< maximal number of events sent with single sendmsg() call
+         std::vector<EvHeaders>    fEvHdrs;          ///< headers of events in current batch
+         std::vector<struct iovec> fEvIOV;           ///< gather list of current batch
+
+         void SendEventsBatch(bool with_header);
+
          // from addon
          void OnThreadAssigned() override;
          void OnSendCompleted() override;
@@ -93,6 +109,7 @@ namespace mbs {
 
          void FillServInfo(int32_t maxbytes, bool legacy);
          void SetServerKind(int kind) { fKind = kind; }
+         void SetEventsBatch(unsigned num);
 
          // code from the DataOutput
          unsigned Write_Check() override;
@@ -103,6 +120,37 @@ namespace mbs {
 
    // ===============================================================================
 
+   /** \brief Policies for delivering buffers to every client of MBS server */
+
+   enum EServerClientPolicy {
+      cpLossless,   ///< all buffers delivered, input blocked when client queue is full
+      cpLatest,     ///< only newest buffer kept for the client
+      cpSample      ///< every N-th buffer queued, oldest buffer dropped when client queue is full
+   };
+
+   /** \brief Queue and statistic of single MBS server client */
+
+   struct ServerClient {
+      int              fPolicy{cpLossless};      ///< delivery policy of the client
+      std::deque<dabc::Buffer>    fQueue;        ///< buffers waiting for the client
+      std::deque<dabc::TimeStamp> fQueueTm;      ///< time when buffers were queued
+      uint64_t         fCounter{0};              ///< number of buffers seen by the client, used for sampling
+      uint64_t         fSendBufs{0};             ///< number of buffers delivered
+      uint64_t         fSendBytes{0};            ///< number of bytes delivered
+      uint64_t         fDropped{0};              ///< buffers dropped while client was too slow
+      uint64_t         fSkipped{0};              ///< buffers skipped by sampling
+      uint64_t         fLastBytes{0};            ///< bytes at last statistic request
+      dabc::TimeStamp  fLastTm;                  ///< time of last statistic request
+
+      void Reset()
+      {
+         fQueue.clear();
+         fQueueTm.clear();
+         fCounter = fSendBufs = fSendBytes = fDropped = fSkipped = fLastBytes = 0;
+         fLastTm = dabc::Now();
+      }
+   };
+
    /** \brief Server transport for different kinds of MBS server */
 
    class ServerTransport : public dabc::Transport {
@@ -114,11 +162,16 @@ namespace mbs {
          int fClientsLimit{0};     ///< maximum number of simultaneous clients
          int fDoingClose{0};       ///< 0 - normal, 1 - saw EOF, 2 - all clients are gone
          bool fBlocking{false};    ///< if true, server will block buffers until it can be delivered
-         bool fDeliverAll{false};  ///< if true, server will try deliver all events when clients are there (default for transport)
+         int fPolicy{cpLossless};  ///< policy for new clients, lossless is default for transport
+         double fMaxLag{10.};      ///< lossless client blocking input longer is switched to sample policy when other clients connected
+         unsigned fClientQueue{0}; ///< maximal number of buffers queued for each client
+         unsigned fSampling{1};    ///< for sampling policy, every N-th buffer delivered to client
+         std::vector<ServerClient> fClients; ///< queues of clients, index is output port number
          std::string fIterKind;    ///< iterator kind when non-mbs events should be delivered to clients
          uint32_t fSubevId{0};     ///< subevent id when non-MBS events are used
          unsigned fBufSize{0};     ///< maximal buffer size
          bool fLegacy = false;     ///< attempt to emulate native MBS transport, which sends complete buffer
+         unsigned fEventsBatch{0}; ///< maximal number of non-MBS events sent with single sendmsg() call
 
          bool StartTransport() override;
          bool StopTransport() override;
@@ -126,13 +179,21 @@ namespace mbs {
          int ExecuteCommand(dabc::Command cmd) override;
 
          bool ProcessRecv(unsigned) override { return SendNextBuffer(); }
-         bool ProcessSend(unsigned) override { return SendNextBuffer(); }
+         bool ProcessSend(unsigned port) override { FlushClient(port); return SendNextBuffer(); }
          bool ProcessBuffer(unsigned) override { return SendNextBuffer(); }
 
          bool SendNextBuffer();
 
+         void QueueBuffer(unsigned n, dabc::Buffer &buf, bool iseof);
+         void FlushClient(unsigned n);
+         bool DowngradeClient(unsigned n);
+
+         void ProcessTimerEvent(unsigned) override { ProcessInputEvent(0); }
+
          void ProcessConnectionActivated(const std::string &name, bool on) override;
 
+         void ProcessConnectEvent(const std::string &name, bool on) override;
+
       public:
 
          ServerTransport(dabc::Command cmd, const dabc::PortRef &outport,
@@ -15,11 +15,13 @@
 
 #include "mbs/ClientTransport.h"
 
+#include <cstring>
+
 #include "dabc/DataTransport.h"
 
 #include "mbs/Iterator.h"
 
-mbs::ClientTransport::ClientTransport(int fd, int kind) :
+mbs::ClientTransport::ClientTransport(int fd, int kind, unsigned pipeline) :
    dabc::SocketIOAddon(fd),
    dabc::DataInput(),
    fState(ioInit),
@@ -27,15 +29,28 @@ mbs::ClientTransport::ClientTransport(int fd, int kind) :
    fSpanning(false),
    fKind(kind),
    fPendingStart(false),
-   fSpanBuffer()
+   fSpanBuffer(),
+   fPipeline(pipeline < 1 ? 1 : (pipeline > 64 ? 64 : pipeline))
 {
    fServInfo.iStreams = 0; // by default, new format
 
-   DOUT3("Create mbs::ClientTransport::ClientTransport() %p fd:%d kind:%d", this, fd, kind);
+   // only stream server answers requests, transport server sends buffers itself
+   if (kind != mbs::StreamServer) fPipeline = 1;
+
+   fReqBuf.resize(fPipeline * 12, 0);
+   for (unsigned n = 0; n < fPipeline; n++)
+      strcpy(fReqBuf.data() + n * 12, "GETEVT");
+
+   DOUT3("Create mbs::ClientTransport::ClientTransport() %p fd:%d kind:%d pipeline:%u", this, fd, kind, fPipeline);
 }
 
 mbs::ClientTransport::~ClientTransport()
 {
+   if (fStatCnt > 0)
+      DOUT2("MBS client requests %lu depth avg %3.1f max %u rtt avg %5.3f min %5.3f max %5.3f ms",
+            (long unsigned) fStatCnt, 1. * fStatDepth / fStatCnt, fStatMaxDepth,
+            fStatRtt / fStatCnt * 1e3, fStatMinRtt * 1e3, fStatMaxRtt * 1e3);
+
    DOUT3("Destroy mbs::ClientTransport::~ClientTransport() %p", this);
 }
 
@@ -77,12 +92,30 @@ void mbs::ClientTransport::ProcessEvent(const dabc::EventId& evnt)
 
 void mbs::ClientTransport::OnSendCompleted()
 {
+   fReqSending = false;
+   SendRequests();
 }
 
 void mbs::ClientTransport::OnRecvCompleted()
 {
    //DOUT0("mbs::ClientTransport::OnRecvCompleted() state = %d", fState);
 
+   if (fNextState == nhRecv) {
+      HeaderArrived();
+      FillPipeline();
+
+      // keep header until transport asks for next buffer
+      if (fState != ioRecvHeader) {
+         fNextState = nhReady;
+         return;
+      }
+
+      fNextState = nhNone;
+      memcpy(&fHeader, &fNextHeader, sizeof(fHeader));
+      MakeCallback(ProcessHeader());
+      return;
+   }
+
    switch (fState) {
       case ioRecvInfo:
 
@@ -122,27 +155,10 @@ void mbs::ClientTransport::OnRecvCompleted()
 
       case ioRecvHeader:
 
-         if (fSwapping) mbs::SwapData(&fHeader, sizeof(fHeader));
+         HeaderArrived();
+         FillPipeline();
 
-//         DOUT0("MbsClient:: Header received, size %u, rest size = %u used %u", fHeader.BufferLength(), ReadBufferSize(), fHeader.UsedBufferSize());
-
-         if (ReadBufferSize() > (unsigned) fServInfo.iMaxBytes) {
-            EOUT("Buffer size %u bigger than allowed by info record %d", ReadBufferSize(), fServInfo.iMaxBytes);
-            fState = ioError;
-            MakeCallback(dabc::di_Error);
-         } else
-         if (ReadBufferSize() == 0) {
-
-            DOUT4("Keep alive buffer from MBS side");
-            fState = ioReady;
-            MakeCallback(dabc::di_SkipBuffer);
-            // JAM 19-07-2024: this was not working, needed to add this in handling section in dabc::InputTransport::ProcessSend
-         } else {
-            fState = ioWaitBuffer;
-
-            // when spanning is used, we need normal-size buffer
-            MakeCallback(fSpanning ? dabc::di_DfltBufSize : ReadBufferSize());
-         }
+         MakeCallback(ProcessHeader());
 
          break;
 
@@ -154,6 +170,8 @@ void mbs::ClientTransport::OnRecvCompleted()
 
          if (fHeader.UsedBufferSize() > 0) {
             fState = ioComplBuffer;
+            // overlap processing of current buffer with receiving of next header
+            StartNextHeader();
             MakeCallback(dabc::di_Ok);
 
          } else
@@ -164,6 +182,7 @@ void mbs::ClientTransport::OnRecvCompleted()
          } else {
             DOUT4("Keep alive buffer from MBS");
             fState = ioReady;
+            StartNextHeader();
             MakeCallback(dabc::di_SkipBuffer);
          }
 
@@ -223,15 +242,88 @@ double mbs::ClientTransport::ProcessTimeout(double)
 
 void mbs::ClientTransport::SubmitRequest()
 {
-   if (Kind() == mbs::StreamServer) {
-      strcpy(fSendBuf, "GETEVT");
-      StartSend(fSendBuf, 12);
-   }
+   FillPipeline();
 
    StartRecv(&fHeader, sizeof(fHeader));
    fState = ioRecvHeader;
 }
 
+void mbs::ClientTransport::FillPipeline()
+{
+   if ((Kind() != mbs::StreamServer) || (fState == ioError) || (fState == ioClosed) || (fState == ioClosing)) return;
+
+   while (fRequested < fPipeline) {
+      fRequested++;
+      fReqQueued++;
+      fReqTime.emplace_back(dabc::Now());
+   }
+
+   SendRequests();
+}
+
+void mbs::ClientTransport::SendRequests()
+{
+   if (fReqSending || (fReqQueued == 0)) return;
+
+   // all queued requests are sent with single operation
+   if (StartSend(fReqBuf.data(), fReqQueued * 12)) {
+      fReqSending = true;
+      fReqQueued = 0;
+   }
+}
+
+void mbs::ClientTransport::HeaderArrived()
+{
+   if ((Kind() != mbs::StreamServer) || (fRequested == 0)) return;
+
+   double rtt = fReqTime.empty() ? 0. : fReqTime.front().SpentTillNow();
+   if (!fReqTime.empty()) fReqTime.pop_front();
+
+   if ((fStatCnt == 0) || (rtt < fStatMinRtt)) fStatMinRtt = rtt;
+   if (rtt > fStatMaxRtt) fStatMaxRtt = rtt;
+   if (fRequested > fStatMaxDepth) fStatMaxDepth = fRequested;
+   fStatRtt += rtt;
+   fStatDepth += fRequested;
+   fStatCnt++;
+
+   fRequested--;
+}
+
+void mbs::ClientTransport::StartNextHeader()
+{
+   // next header only expected when there are requests in flight
+   if ((fPipeline < 2) || (fRequested == 0) || (fNextState != nhNone)) return;
+
+   if (StartRecv(&fNextHeader, sizeof(fNextHeader)))
+      fNextState = nhRecv;
+}
+
+unsigned mbs::ClientTransport::ProcessHeader()
+{
+   if (fSwapping) mbs::SwapData(&fHeader, sizeof(fHeader));
+
+//   DOUT0("MbsClient:: Header received, size %u, rest size = %u used %u", fHeader.BufferLength(), ReadBufferSize(), fHeader.UsedBufferSize());
+
+   if (ReadBufferSize() > (unsigned) fServInfo.iMaxBytes) {
+      EOUT("Buffer size %u bigger than allowed by info record %d", ReadBufferSize(), fServInfo.iMaxBytes);
+      fState = ioError;
+      return dabc::di_Error;
+   }
+
+   if (ReadBufferSize() == 0) {
+      DOUT4("Keep alive buffer from MBS side");
+      fState = ioReady;
+      StartNextHeader();
+      // JAM 19-07-2024: this was not working, needed to add this in handling section in dabc::InputTransport::ProcessSend
+      return dabc::di_SkipBuffer;
+   }
+
+   fState = ioWaitBuffer;
+
+   // when spanning is used, we need normal-size buffer
+   return fSpanning ? dabc::di_DfltBufSize : ReadBufferSize();
+}
+
 void mbs::ClientTransport::MakeCallback(unsigned arg)
 {
    dabc::InputTransport* tr = dynamic_cast<dabc::InputTransport*> (fWorker());
@@ -255,6 +347,19 @@ unsigned mbs::ClientTransport::Read_Size()
          fPendingStart = true;
          return dabc::di_CallBack;
       case ioReady:
+         if (fNextState == nhReady) {
+            // header of next buffer already there
+            fNextState = nhNone;
+            memcpy(&fHeader, &fNextHeader, sizeof(fHeader));
+            FillPipeline();
+            return ProcessHeader();
+         }
+         if (fNextState == nhRecv) {
+            // header of next buffer is receiving, callback will be done when completed
+            fState = ioRecvHeader;
+            FillPipeline();
+            return dabc::di_CallBack;
+         }
          SubmitRequest();
          return dabc::di_CallBack;
       default:
@@ -407,3 +512,17 @@ unsigned mbs::ClientTransport::Read_Complete(dabc::Buffer& buf)
 
    return dabc::di_Ok;
 }
+
+bool mbs::ClientTransport::Read_Stat(dabc::Command cmd)
+{
+   cmd.SetUInt("PipelineDepth", fPipeline);
+   cmd.SetUInt("NumRequests", fStatCnt);
+   if (fStatCnt > 0) {
+      cmd.SetDouble("AvgDepth", 1. * fStatDepth / fStatCnt);
+      cmd.SetUInt("MaxDepth", fStatMaxDepth);
+      cmd.SetDouble("AvgRtt", fStatRtt / fStatCnt);
+      cmd.SetDouble("MinRtt", fStatMinRtt);
+      cmd.SetDouble("MaxRtt", fStatMaxRtt);
+   }
+   return true;
+}
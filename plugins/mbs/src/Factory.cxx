@@ -119,7 +119,10 @@ dabc::DataInput* mbs::Factory::CreateDataInput(const std::string &typ)
 
       DOUT0("Connect MBS %s server %s:%d", mbs::ServerKindToStr(kind), url.GetHostName().c_str(),  portnum);
 
-      return new mbs::ClientTransport(fd, kind);
+      // number of requests in flight, only used with stream server
+      int pipeline = url.HasOption("pipeline") ? url.GetOptionInt("pipeline", 4) : 1;
+
+      return new mbs::ClientTransport(fd, kind, pipeline > 0 ? pipeline : 1);
    }
 
    return nullptr;
@@ -31,6 +31,7 @@ mbs::LmdInput::LmdInput(const dabc::Url& url) :
    else if (url.HasOption("ltsm"))
 	  fFile.SetIO((dabc::FileInterface*) dabc::mgr.CreateAny("ltsm::FileInterface"), true);
 
+   ConfigureFile(fFile);
 }
 
 mbs::LmdInput::~LmdInput()
@@ -58,6 +59,8 @@ bool mbs::LmdInput::OpenNextFile()
 
    DOUT1("Open lmd file %s for reading", CurrentFileName().c_str());
 
+   PrepareNextFile();
+
    return true;
 }
 
@@ -41,6 +41,9 @@ mbs::LmdOutput::LmdOutput(const dabc::Url& url) :
       fFile.SetIO((dabc::FileInterface*) dabc::mgr.CreateAny("rfio::FileInterface"), true);
    else if (url.HasOption("ltsm"))
    	  fFile.SetIO((dabc::FileInterface*) dabc::mgr.CreateAny("ltsm::FileInterface"), true);
+
+   if (fChecksum)
+      fFile.EnableChecksum();
 }
 
 mbs::LmdOutput::~LmdOutput()
@@ -32,7 +32,7 @@ mbs::ServerOutputAddon::ServerOutputAddon(int fd, int kind, dabc::EventsIterator
    fSubHdr(),
    fEvCounter(0),
    fSubevId(subid),
-   fHasExtraRequest(false)
+   fExtraRequests(0)
 {
    DOUT3("Create MBS server addon fd:%d kind:%s", fd, mbs::ServerKindToStr(kind));
 }
@@ -54,6 +54,58 @@ void mbs::ServerOutputAddon::FillServInfo(int32_t maxbytes, bool legacy)
    fLegacyFormat = legacy;
 }
 
+void mbs::ServerOutputAddon::SetEventsBatch(unsigned num)
+{
+   // every event requires two elements in gather list, one more for buffer header
+   unsigned maxnum = (dabc::SocketIOAddon::MaxSendIOV() - 1) / 2;
+
+   fEventsBatch = (num < 1) ? 1 : (num > maxnum ? maxnum : num);
+
+   fEvHdrs.resize(fEventsBatch > 1 ? fEventsBatch : 0);
+   fEvIOV.reserve(fEventsBatch > 1 ? fEventsBatch * 2 + 1 : 0);
+}
+
+void mbs::ServerOutputAddon::SendEventsBatch(bool with_header)
+{
+   static_assert(sizeof(EvHeaders) == sizeof(mbs::EventHeader) + sizeof(mbs::SubeventHeader), "EvHeaders must not have padding");
+
+   dabc::EventsIterator* iter = fIter();
+
+   fEvIOV.clear();
+
+   if (with_header)
+      fEvIOV.push_back({ &fHeader, sizeof(fHeader) });
+
+   bool more = true;
+   unsigned cnt = 0;
+
+   while (more && (cnt < fEventsBatch)) {
+      unsigned evsize = iter->EventSize();
+      if (evsize % 2) evsize++;
+
+      EvHeaders &hdrs = fEvHdrs[cnt++];
+
+      hdrs.sub.InitFull(fSubevId);
+      unsigned kind = iter->EventKind();
+      if (kind > 1) hdrs.sub.iControl = kind - 1;
+      hdrs.sub.SetRawDataSize(evsize);
+
+      hdrs.ev.Init(fEvCounter++);
+      hdrs.ev.SetFullSize(evsize + sizeof(EvHeaders));
+
+      fEvIOV.push_back({ &hdrs, sizeof(EvHeaders) });
+      fEvIOV.push_back({ iter->Event(), evsize });
+
+      more = iter->NextEvent();
+   }
+
+   // if there are no more events - iterator closed when send is completed
+   if (!more)
+      fState = oSendingLastEvent;
+
+   StartSendIOV(fEvIOV.data(), fEvIOV.size());
+}
+
 void mbs::ServerOutputAddon::OnThreadAssigned()
 {
    dabc::SocketIOAddon::OnThreadAssigned();
@@ -96,6 +148,11 @@ void mbs::ServerOutputAddon::OnSendCompleted()
          return;
 
       case oSendingEvents: {
+         if (fEventsBatch > 1) {
+            SendEventsBatch(false);
+            return;
+         }
+
          dabc::EventsIterator* iter = fIter();
 
          unsigned evsize = iter->EventSize();
@@ -123,11 +180,12 @@ void mbs::ServerOutputAddon::OnSendCompleted()
          /* no break */
 
       case oSendingBuffer:
-         if (fKind == mbs::StreamServer)
-            fState = fHasExtraRequest ? oWaitingBuffer : oWaitingReq;
-         else
+         if ((fKind == mbs::StreamServer) && (fExtraRequests == 0)) {
+            fState = oWaitingReq;
+         } else {
             fState = oWaitingBuffer;
-         fHasExtraRequest = false;
+            if (fExtraRequests > 0) fExtraRequests--;
+         }
          MakeCallback(dabc::do_Ok);
          return;
 
@@ -161,7 +219,6 @@ void mbs::ServerOutputAddon::OnRecvCompleted()
 
    memset(f_sbuf, 0, sizeof(f_sbuf));
    StartRecv(f_sbuf, 12);
-   fHasExtraRequest = false;
 
    switch (fState) {
       case oInit:
@@ -169,8 +226,11 @@ void mbs::ServerOutputAddon::OnRecvCompleted()
          EOUT("Get data request before send server info was completed");
          fState = oInitReq;
          break;
+      case oInitReq:
       case oWaitingBuffer:
-         // second request - ignore it
+         // stream client may send several requests in advance, each answered with separate buffer
+         // transport server does not use requests, they are ignored as before
+         if (fKind == mbs::StreamServer) fExtraRequests++;
          break;
       case oWaitingReq:
          // normal situation
@@ -183,7 +243,7 @@ void mbs::ServerOutputAddon::OnRecvCompleted()
       case oSendingEvents:
       case oSendingLastEvent:
       case oSendingBuffer:
-         fHasExtraRequest = true;
+         if (fKind == mbs::StreamServer) fExtraRequests++;
          break;
       default:
          EOUT("Get request at wrong state %d", fState);
@@ -301,7 +361,11 @@ unsigned mbs::ServerOutputAddon::Write_Buffer(dabc::Buffer& buf)
       StartNetSend(&fHeader, sizeof(fHeader), buf, datasize);
    } else {
       fState = oSendingEvents;
-      StartSend(&fHeader, sizeof(fHeader));
+      // buffer header send together with first events
+      if (fEventsBatch > 1)
+         SendEventsBatch(true);
+      else
+         StartSend(&fHeader, sizeof(fHeader));
    }
 
    return dabc::do_CallBack;
@@ -337,7 +401,6 @@ mbs::ServerTransport::ServerTransport(dabc::Command cmd, const dabc::PortRef& ou
    fClientsLimit(0),
    fDoingClose(0),
    fBlocking(false),
-   fDeliverAll(false),
    fIterKind(),
    fSubevId(0x1f)
 {
@@ -362,6 +425,9 @@ mbs::ServerTransport::ServerTransport(dabc::Command cmd, const dabc::PortRef& ou
    if (url.HasOption("legacy"))
       fLegacy = true;
 
+   // by default as many events as possible are sent with single call
+   fEventsBatch = (unsigned) url.GetOptionInt("evbatch", dabc::SocketIOAddon::MaxSendIOV());
+
    if (fBufSize == 0) {
       dabc::MemoryPoolRef pool = dabc::mgr.FindPool(dabc::xmlWorkPool);
       auto maxbuf = pool.GetMaxBufSize();
@@ -382,18 +448,44 @@ mbs::ServerTransport::ServerTransport(dabc::Command cmd, const dabc::PortRef& ou
    // - when at least one connection established, block input until all output are ready
    fBlocking = (fKind == mbs::TransportServer);
 
-   fDeliverAll = (fKind == mbs::TransportServer);
-
    if (url.HasOption("nonblock"))
       fBlocking = false;
    else if (url.HasOption("blocking"))
       fBlocking = true;
 
-   if (url.HasOption("deliverall"))
-      fDeliverAll = true;
+   // each client gets own queue, policy decides what happens when client is slow
+   // transport server delivers all buffers, stream server drops oldest buffers
+   fPolicy = (fKind == mbs::TransportServer) ? cpLossless : cpSample;
+
+   std::string policy = url.GetOptionStr("policy");
+   if (url.HasOption("deliverall") || (policy == "lossless"))
+      fPolicy = cpLossless;
+   else if (policy == "latest")
+      fPolicy = cpLatest;
+   else if ((policy == "sample") || url.HasOption("sample"))
+      fPolicy = cpSample;
+   else if (!policy.empty())
+      EOUT("Unknown MBS server client policy %s", policy.c_str());
+
+   if (url.HasOption("sample")) {
+      int n = url.GetOptionInt("sample", 1);
+      fSampling = n > 1 ? n : 1;
+   }
 
-   DOUT0("Create %s server fd:%d kind:%s port:%d limit:%d blocking:%s deliverall:%s bufsize 0x%04x",
-         fLegacy ? "MBS legacy" : "MBS", connaddon->Socket(), mbs::ServerKindToStr(fKind), fPortNum, fClientsLimit, DBOOL(fBlocking), DBOOL(fDeliverAll), fBufSize);
+   fClientQueue = fSlaveQueueLength;
+   if (url.HasOption("clientqueue")) {
+      int n = url.GetOptionInt("clientqueue", fClientQueue);
+      fClientQueue = n > 1 ? n : 1;
+   }
+
+   // 0 disables switching of lagging lossless client
+   fMaxLag = url.GetOptionDouble("maxlag", fMaxLag);
+   if (fMaxLag > 0)
+      CreateTimer("LagTimer");
+
+   DOUT0("Create %s server fd:%d kind:%s port:%d limit:%d blocking:%s policy:%s bufsize 0x%04x",
+         fLegacy ? "MBS legacy" : "MBS", connaddon->Socket(), mbs::ServerKindToStr(fKind), fPortNum, fClientsLimit, DBOOL(fBlocking),
+         (fPolicy == cpLossless ? "lossless" : (fPolicy == cpLatest ? "latest" : dabc::format("sample%u", fSampling).c_str())), fBufSize);
 
    if (fClientsLimit > 0)
       DOUT0("Set client limit for MBS server to %d ", fClientsLimit);
@@ -455,9 +547,16 @@ int mbs::ServerTransport::ExecuteCommand(dabc::Command cmd)
       auto addon = new ServerOutputAddon(fd, fKind, iter, fSubevId);
 
       addon->FillServInfo(fBufSize, fLegacy);
+      addon->SetEventsBatch(fEventsBatch);
 
+      // for lossy policies buffers wait in client queue, where they can be dropped
       if (portindx < 0)
-         portindx = CreateOutput(dabc::format("Slave%u",NumOutputs()), fSlaveQueueLength);
+         portindx = CreateOutput(dabc::format("Slave%u",NumOutputs()), fPolicy == cpLossless ? fSlaveQueueLength : 1);
+
+      if (fClients.size() < NumOutputs())
+         fClients.resize(NumOutputs());
+      fClients[portindx].Reset();
+      fClients[portindx].fPolicy = fPolicy;
 
       dabc::TransportRef tr = new dabc::OutputTransport(dabc::Command(), FindPort(OutputName(portindx)), addon, false);
 
@@ -481,9 +580,21 @@ int mbs::ServerTransport::ExecuteCommand(dabc::Command cmd)
 
       int cnt = 0;
       std::vector<uint64_t> cansend;
+      std::vector<std::string> clinfo;
+      uint64_t dropped = 0;
       for(unsigned n=0;n<NumOutputs();n++) {
          if (IsOutputConnected(n)) {
             cnt++; cansend.emplace_back(NumCanSend(n));
+            if (n >= fClients.size()) continue;
+            auto &cl = fClients[n];
+            double tm = cl.fLastTm.SpentTillNow(true);
+            double rate = tm > 0 ? (cl.fSendBytes - cl.fLastBytes) / tm / 1024. / 1024. : 0.;
+            cl.fLastBytes = cl.fSendBytes;
+            double lag = cl.fQueueTm.empty() ? 0. : cl.fQueueTm.front().SpentTillNow();
+            dropped += cl.fDropped;
+            clinfo.emplace_back(dabc::format("%s %s bufs:%lu dropped:%lu skipped:%lu queue:%u lag:%.2fs rate:%.2fMB/s",
+                  OutputName(n).c_str(), (cl.fPolicy == cpLossless ? "lossless" : (cl.fPolicy == cpLatest ? "latest" : "sample")), (long unsigned) cl.fSendBufs, (long unsigned) cl.fDropped, (long unsigned) cl.fSkipped,
+                  (unsigned) cl.fQueue.size(), lag, rate));
          }
       }
 
@@ -494,9 +605,12 @@ int mbs::ServerTransport::ExecuteCommand(dabc::Command cmd)
       if (cnt > 1) cmd.SetField("NumCanSend", cansend); else
       cmd.SetField("NumCanSend", 0);
 
+      cmd.SetField("ClientsInfo", clinfo);
+      cmd.SetUInt("NumDropped", dropped);
+
       cmd.SetStr("MbsKind", mbs::ServerKindToStr(fKind));
       cmd.SetInt("MbsPort", fPortNum);
-      cmd.SetStr("MbsInfo", dabc::format("%s:%d NumClients:%d", mbs::ServerKindToStr(fKind), fPortNum, cnt));
+      cmd.SetStr("MbsInfo", dabc::format("%s:%d NumClients:%d Dropped:%lu", mbs::ServerKindToStr(fKind), fPortNum, cnt, (long unsigned) dropped));
 
       return dabc::cmd_true;
    }
@@ -504,6 +618,54 @@ int mbs::ServerTransport::ExecuteCommand(dabc::Command cmd)
    return dabc::Transport::ExecuteCommand(cmd);
 }
 
+void mbs::ServerTransport::QueueBuffer(unsigned n, dabc::Buffer &buf, bool iseof)
+{
+   auto &cl = fClients[n];
+
+   if (iseof) {
+      // EOF always delivered, for latest policy it replaces all other buffers
+      if (cl.fPolicy == cpLatest) {
+         cl.fDropped += cl.fQueue.size();
+         cl.fQueue.clear();
+         cl.fQueueTm.clear();
+      }
+   } else {
+      if ((cl.fPolicy == cpSample) && (cl.fCounter++ % fSampling != 0)) {
+         cl.fSkipped++;
+         return;
+      }
+
+      if (cl.fPolicy != cpLossless) {
+         unsigned limit = (cl.fPolicy == cpLatest) ? 1 : fClientQueue;
+         // when client port is free, buffer will be delivered immediately
+         if (CanSend(n)) limit++;
+         while (cl.fQueue.size() >= limit) {
+            cl.fQueue.pop_front();
+            cl.fQueueTm.pop_front();
+            cl.fDropped++;
+         }
+      }
+   }
+
+   cl.fQueue.emplace_back(buf.Duplicate());
+   cl.fQueueTm.emplace_back(dabc::Now());
+}
+
+void mbs::ServerTransport::FlushClient(unsigned n)
+{
+   if (n >= fClients.size()) return;
+
+   auto &cl = fClients[n];
+
+   while (!cl.fQueue.empty() && CanSend(n)) {
+      cl.fSendBufs++;
+      cl.fSendBytes += cl.fQueue.front().GetTotalSize();
+      Send(n, cl.fQueue.front());
+      cl.fQueue.pop_front();
+      cl.fQueueTm.pop_front();
+   }
+}
+
 bool mbs::ServerTransport::SendNextBuffer()
 {
    if (!CanRecv()) return false;
@@ -511,33 +673,26 @@ bool mbs::ServerTransport::SendNextBuffer()
    // unconnected transport server will block until any connection is established
    if ((NumOutputs() == 0) && fBlocking /*&& (fKind == mbs::TransportServer) */) return false;
 
-   bool allcansend = CanSendToAllOutputs(true);
-
-//   if (!allcansend)
-//      DOUT1("mbs::ServerTransport::ProcessRecv  numout:%u cansend:%s numwork:%u", NumOutputs(), DBOOL(allcansend), numoutputs);
-
-   // in case of transport buffer all outputs should be
-   // ready to get next buffer. Otherwise input port will be blocked
-   if (!allcansend) {
-      // if server must deliver all events, than wait (default for transport, can be enabled for stream)
-      if (fDeliverAll) return false;
-      // if server do not blocks, first wait until input queue will be filled
-      if (!RecvQueueFull()) {
-         // DOUT0("mbs::ServerTransport::SendNextBuffer %s let input queue to be filled name size:%u", GetName(), NumCanRecv());
-         // dabc::SetDebugLevel(1);
-         SignalRecvWhenFull();
-         return false;
-      }
-      // DOUT0("TRY TO SEND EVEN WHEN NOT POSSIBLE");
-   }
+   if (fClients.size() < NumOutputs())
+      fClients.resize(NumOutputs());
 
-   // this is normal situation when buffer can be send to all outputs
+   // only client with lossless policy and full queue can block the input
+   for (unsigned n = 0; n < NumOutputs(); n++)
+      if (IsOutputConnected(n) && (fClients[n].fPolicy == cpLossless) && (fClients[n].fQueue.size() >= fClientQueue))
+         if (!DowngradeClient(n))
+            return false;
 
    dabc::Buffer buf = Recv();
 
    bool iseof = (buf.GetTypeId() == dabc::mbt_EOF);
 
-   SendToAllOutputs(buf);
+   for (unsigned n = 0; n < NumOutputs(); n++)
+      if (IsOutputConnected(n)) {
+         QueueBuffer(n, buf, iseof);
+         FlushClient(n);
+      }
+
+   buf.Release();
 
    if (iseof) {
       DOUT2("Server transport saw EOF buffer");
@@ -555,6 +710,31 @@ bool mbs::ServerTransport::SendNextBuffer()
 }
 
 
+/** Lossless client, which blocks input longer than maxlag while other clients are connected,
+  * switched to sample policy. Returns true if client was switched */
+
+bool mbs::ServerTransport::DowngradeClient(unsigned n)
+{
+   if (fMaxLag <= 0) return false;
+
+   unsigned numconn = 0;
+   for (unsigned k = 0; k < NumOutputs(); k++)
+      if (IsOutputConnected(k)) numconn++;
+   if (numconn < 2) return false;
+
+   auto &cl = fClients[n];
+   double lag = cl.fQueueTm.empty() ? 0. : cl.fQueueTm.front().SpentTillNow();
+   if (lag < fMaxLag) {
+      // check client again when limit is reached
+      ShootTimer("LagTimer", fMaxLag - lag);
+      return false;
+   }
+
+   cl.fPolicy = cpSample;
+   DOUT0("MBS server client %s lags %.1f s, switch to sample policy", OutputName(n).c_str(), lag);
+   return true;
+}
+
 void mbs::ServerTransport::ProcessConnectionActivated(const std::string &name, bool on)
 {
    if (name==InputName()) {
@@ -567,7 +747,11 @@ void mbs::ServerTransport::ProcessConnectionActivated(const std::string &name, b
          return;
       }
 
-      if (!on) FindPort(name).Disconnect();
+      if (!on) {
+         FindPort(name).Disconnect();
+         unsigned n = FindOutput(name);
+         if (n < fClients.size()) fClients[n].Reset();
+      }
 
       if (fDoingClose == 1) {
          bool isany = false;
@@ -581,3 +765,27 @@ void mbs::ServerTransport::ProcessConnectionActivated(const std::string &name, b
       }
    }
 }
+
+void mbs::ServerTransport::ProcessConnectEvent(const std::string &name, bool on)
+{
+   if (!on && (name != InputName())) {
+      // client transport is destroyed, its queue should not block input any longer
+      unsigned n = FindOutput(name);
+      if (n < fClients.size()) fClients[n].Reset();
+      if (fDoingClose == 0) {
+         ProcessInputEvent(0);
+      } else if (fDoingClose == 1) {
+         bool isany = false;
+         for (unsigned k = 0; k < NumOutputs(); k++)
+            if ((k != n) && IsOutputConnected(k)) isany = true;
+         if (!isany) {
+            DOUT2("Close server transport while all clients are closed");
+            CloseTransport(false);
+            fDoingClose = 2;
+         }
+      }
+      return;
+   }
+
+   dabc::Transport::ProcessConnectEvent(name, on);
+}